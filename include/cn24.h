@@ -16,16 +16,22 @@
 
 #include "cn24/util/Config.h"
 #include "cn24/util/Dataset.h"
+#include "cn24/util/HalfPrecision.h"
 #include "cn24/util/Tensor.h"
 #include "cn24/util/CompressedTensor.h"
+#include "cn24/util/CompactTensor.h"
 #include "cn24/util/TensorViewer.h"
 #include "cn24/util/CombinedTensor.h"
 #include "cn24/util/TensorStream.h"
 #include "cn24/util/CompressedTensorStream.h"
+#include "cn24/util/CompactTensorStream.h"
 #include "cn24/util/FloatTensorStream.h"
 #include "cn24/util/ListTensorStream.h"
+#include "cn24/util/TensorStreamBuilder.h"
+#include "cn24/util/ClassColorTable.h"
 #include "cn24/util/PNGUtil.h"
 #include "cn24/util/JPGUtil.h"
+#include "cn24/util/ImageUtil.h"
 #include "cn24/util/Log.h"
 #include "cn24/util/KITTIData.h"
 #include "cn24/util/Init.h"
@@ -36,6 +42,8 @@
 #include "cn24/util/CSVStatSink.h"
 
 #include "cn24/math/TensorMath.h"
+#include "cn24/math/BilinearUpsampling.h"
+#include "cn24/math/Int8Math.h"
 
 #include "cn24/net/Layer.h"
 #include "cn24/net/InputLayer.h"
@@ -47,9 +55,16 @@
 #include "cn24/net/ConvolutionLayer.h"
 #include "cn24/net/MaxPoolingLayer.h"
 #include "cn24/net/AdvancedMaxPoolingLayer.h"
+#include "cn24/net/AveragePoolingLayer.h"
+#include "cn24/net/GlobalAveragePoolingLayer.h"
 #include "cn24/net/InputDownSamplingLayer.h"
 #include "cn24/net/LocalResponseNormalizationLayer.h"
+#include "cn24/net/BatchNormalizationLayer.h"
 #include "cn24/net/UpscaleLayer.h"
+#include "cn24/net/ShiftLayer.h"
+#include "cn24/net/StitchLayer.h"
+#include "cn24/net/UpsamplingErrorLayer.h"
+#include "cn24/net/TransposedConvolutionLayer.h"
 #include "cn24/net/LossFunctionLayer.h"
 #include "cn24/net/ErrorLayer.h"
 #include "cn24/net/StatLayer.h"
@@ -60,6 +75,7 @@
 #include "cn24/net/GradientAccumulationLayer.h"
 #include "cn24/net/SumLayer.h"
 #include "cn24/net/Trainer.h"
+#include "cn24/net/Checkpointer.h"
 #include "cn24/net/NetGraph.h"
 #include "cn24/net/NetGraphNode.h"
 #include "cn24/net/NetStatus.h"
@@ -67,5 +83,6 @@
 #include "cn24/net/HMaxActivationFunction.h"
 
 #include "cn24/factory/ConfigurableFactory.h"
+#include "cn24/factory/ModelFile.h"
 
 #endif
@@ -16,9 +16,13 @@
 #define CONV_CONFIGURABLEFACTORY_H
 
 #include <iostream>
+#include <vector>
+#include <utility>
 
 #include "../net/NetGraph.h"
 #include "../net/Trainer.h"
+#include "../net/UpscaleLayer.h"
+#include "../net/NonLinearityLayer.h"
 #include "../util/Dataset.h"
 #include "../util/Log.h"
 
@@ -70,6 +74,16 @@ public:
 	*/
   virtual int patchsizey() { return receptive_field_y_; }
 
+  /**
+	* @returns The horizontal factor between input and output resolution
+	*/
+  int downsamplingx() const { return factorx; }
+
+  /**
+	* @returns The vertical factor between input and output resolution
+	*/
+  int downsamplingy() const { return factory; }
+
   /**
 	* @brief Create a loss layer for this configuration
 	*
@@ -96,6 +110,8 @@ public:
   Method method() const { return method_; }
 private:
 	void WriteNode(std::ostream& graph_output, Layer* layer, int source_id, int source_port, int node_id, int outputs);
+  void AddShiftLayer(NetGraph& net, NetGraphConnection& last_connection, unsigned int factor_x, unsigned int factor_y, std::vector<std::pair<unsigned int, unsigned int>>& shifts);
+  void AddStitchLayers(NetGraph& net, NetGraphConnection& last_connection, std::vector<std::pair<unsigned int, unsigned int>>& shifts, bool is_output = false);
   Method method_;
   
   int receptive_field_x_ = 0;
@@ -109,6 +125,16 @@ private:
   int factorx = 1;
   int factory = 1;
 
+  // Upscaling of FCN outputs and whether the loss layer does it
+  UpscaleMethod upscale_method_ = UPSCALE_NEAREST;
+  bool fuse_upscaling_loss_ = false;
+
+  // Dense FCN predictions of nets trained on patches, see ShiftLayer
+  bool shift_and_stitch_ = false;
+
+  // Default evaluation of tanh and sigmoid activations
+  ActivationMode activation_mode_ = ACTIVATION_EXACT;
+
   unsigned int seed_ = 0;
   TrainerSettings optimal_settings_;
 };
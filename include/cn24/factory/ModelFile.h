@@ -0,0 +1,111 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ModelFile.h
+ * @class ModelFile
+ * @brief A single file containing everything needed to run a trained net.
+ *
+ * The file contains the net configuration, the dataset configuration for
+ *  the class names and colors and the parameters of every node, keyed by
+ *  the node's unique name. The parameters are aligned to 64 bytes and
+ *  memory mapped, so loading does not copy them and processes using the
+ *  same model share its pages.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_MODELFILE_H
+#define CONV_MODELFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../net/NetGraph.h"
+
+namespace Conv {
+
+class ModelFile {
+public:
+  ModelFile() {}
+  ~ModelFile();
+
+  /**
+   * @brief Writes a model file.
+   *
+   * @param filename Path of the model file
+   * @param net_config The net configuration the graph was built from
+   * @param dataset_config The dataset configuration with the classes
+   * @param graph The initialized graph with the trained parameters
+   * @returns True on success
+   */
+  static bool Write(const std::string& filename, std::istream& net_config,
+                    std::istream& dataset_config, NetGraph& graph);
+
+  /**
+   * @brief Checks if a file starts like a model file.
+   */
+  static bool IsModelFile(const std::string& filename);
+
+  /**
+   * @brief Opens a model file and maps its parameters into memory.
+   *
+   * @returns True on success
+   */
+  bool Open(const std::string& filename);
+
+  /**
+   * @brief Makes the parameters of a graph use the model's memory.
+   *
+   * The graph has to be initialized and built from the model's net
+   *  configuration. Writing to the parameters does not change the file.
+   *
+   * @returns False if a parameter is missing or its size does not match
+   */
+  bool MapParameters(NetGraph& graph);
+
+  /**
+   * @brief The net configuration, e.g. for a ConfigurableFactory.
+   *
+   * The stream lives as long as the ModelFile.
+   */
+  std::istream& net_config() { return net_config_; }
+
+  /**
+   * @brief The dataset configuration, e.g. for
+   *  TensorStreamDataset::CreateFromConfiguration.
+   */
+  std::istream& dataset_config() { return dataset_config_; }
+
+private:
+  struct Blob {
+    std::string node;
+    uint64_t parameter;
+    uint64_t samples;
+    uint64_t width;
+    uint64_t height;
+    uint64_t maps;
+    uint64_t offset;
+  };
+
+  void Close();
+
+  std::istringstream net_config_;
+  std::istringstream dataset_config_;
+  std::vector<Blob> blobs_;
+
+  // Contents of the file, memory mapped if possible
+  char* contents_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+}
+
+#endif
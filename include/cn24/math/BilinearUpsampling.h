@@ -0,0 +1,97 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file BilinearUpsampling.h
+ * @class BilinearUpsampling
+ * @brief Bilinear interpolation of feature maps by integer factors.
+ *
+ * The target pixel centers are mapped back onto the source map and
+ *  clamped at the borders. The interpolation is separable, so single rows
+ *  of the target map can be produced or backpropagated without
+ *  materializing the whole target map.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_BILINEARUPSAMPLING_H
+#define CONV_BILINEARUPSAMPLING_H
+
+#include <vector>
+
+#include "../util/Config.h"
+
+namespace Conv {
+
+class BilinearUpsampling {
+public:
+  BilinearUpsampling() {}
+
+  /**
+   * @brief Precalculates the interpolation coefficients.
+   *
+   * @param source_width Width of the source maps
+   * @param source_height Height of the source maps
+   * @param factor_x Horizontal upsampling factor
+   * @param factor_y Vertical upsampling factor
+   */
+  BilinearUpsampling(const unsigned int source_width, const unsigned int source_height,
+                     const unsigned int factor_x, const unsigned int factor_y);
+
+  /**
+   * @brief Interpolates a row of the target map.
+   *
+   * @param source_map The source map
+   * @param y The target row
+   * @param target_row Receives target_width() values
+   * @param buffer Space for source_width() values
+   */
+  void UpsampleRow(const datum* source_map, const unsigned int y,
+                   datum* target_row, datum* buffer) const;
+
+  /**
+   * @brief Adds the gradient of a target row to the source map.
+   *
+   * @param target_row_delta Gradient of the target row
+   * @param y The target row
+   * @param source_map_delta Gradient of the source map, accumulated
+   * @param buffer Space for source_width() values
+   */
+  void BackpropagateRow(const datum* target_row_delta, const unsigned int y,
+                        datum* source_map_delta, datum* buffer) const;
+
+  /**
+   * @brief Interpolates a complete map.
+   */
+  void UpsampleMap(const datum* source_map, datum* target_map, datum* buffer) const;
+
+  /**
+   * @brief Overwrites the source map gradient with the target map gradient.
+   */
+  void BackpropagateMap(const datum* target_map_delta, datum* source_map_delta, datum* buffer) const;
+
+  inline unsigned int source_width() const { return source_width_; }
+  inline unsigned int source_height() const { return source_height_; }
+  inline unsigned int target_width() const { return x0_.size(); }
+  inline unsigned int target_height() const { return y0_.size(); }
+
+private:
+  unsigned int source_width_ = 0;
+  unsigned int source_height_ = 0;
+
+  // Source columns and rows left of and above a target pixel, the
+  //  neighbors on the other side and the weights of these neighbors
+  std::vector<unsigned int> x0_;
+  std::vector<unsigned int> x1_;
+  std::vector<datum> ax_;
+  std::vector<unsigned int> y0_;
+  std::vector<unsigned int> y1_;
+  std::vector<datum> ay_;
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file Int8Math.h
+ * @class Int8Math
+ * @brief Matrix products of 8-bit integers for quantized inference.
+ *
+ * Weights are signed and symmetric, inputs are unsigned with a zero point.
+ *  Inputs are limited to [0, 127] so that pairwise products of AVX2's
+ *  pmaddubsw cannot saturate, which makes all code paths agree exactly.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_INT8MATH_H
+#define CONV_INT8MATH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Conv {
+
+class Int8Math {
+public:
+  /**
+   * @brief Largest quantized input value.
+   */
+  static const int INPUT_LIMIT = 127;
+
+  /**
+   * @brief Largest absolute quantized weight.
+   */
+  static const int WEIGHT_LIMIT = 127;
+
+  /**
+   * @brief Rounds a dot product length up to the length GEMM expects,
+   *  the rows have to be padded with zeros.
+   */
+  static inline std::size_t PaddedDepth(const std::size_t K) {
+    return ((K + 31) / 32) * 32;
+  }
+
+  /**
+   * @brief Calculates C = A * B^T with 32-bit accumulation.
+   *
+   * @param M Number of rows of A and C
+   * @param N Number of rows of B and columns of C
+   * @param K Padded length of the rows of A and B, see PaddedDepth
+   * @param A Row-major M x K matrix of weights
+   * @param B Row-major N x K matrix of inputs
+   * @param C Row-major M x N result
+   * @param ldC Distance between rows of C
+   */
+  static void GEMM(
+    const int M,
+    const int N,
+    const int K,
+    const int8_t* A,
+    const uint8_t* B,
+    int32_t* C,
+    const int ldC);
+
+  /**
+   * @brief Name of the instruction set used by GEMM.
+   */
+  static const char* GetImplementation();
+};
+
+}
+
+#endif
@@ -17,6 +17,8 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
+#include <cstdint>
 
 #include "SimpleLayer.h"
 
@@ -71,6 +73,15 @@ private:
   unsigned int maps_ = 0;
   
   Tensor maximum_mask_;
+
+  // Index of each maximum inside its input map (iy * input_width_ + ix)
+  std::vector<uint32_t> maximum_index_;
+
+  // Range of outputs whose regions contain an input column or row
+  std::vector<unsigned int> ox_start_;
+  std::vector<unsigned int> ox_end_;
+  std::vector<unsigned int> oy_start_;
+  std::vector<unsigned int> oy_end_;
 };
 
 }
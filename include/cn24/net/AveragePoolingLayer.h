@@ -0,0 +1,90 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */  
+/**
+ * @file AveragePoolingLayer.h
+ * @class AveragePoolingLayer
+ * @brief Layer that sends the mean of a specified region to the next.
+ *
+ * The regions may overlap. Both passes are separable: the rows of a
+ *  region are summed first, then the columns of the row sums.
+ * 
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_AVERAGEPOOLINGLAYER_H
+#define CONV_AVERAGEPOOLINGLAYER_H
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include "SimpleLayer.h"
+
+
+namespace Conv {
+  
+class AveragePoolingLayer : public SimpleLayer {
+public:
+  /**
+   * @brief Constructs an average-pooling Layer.
+   * 
+   * @param region_width Width of the pooling regions
+   * @param region_height Height of the pooling regions
+   * @param stride_width Horizontal distance between the regions
+   * @param stride_height Vertical distance between the regions
+   */
+  AveragePoolingLayer(const unsigned int region_width,
+                  const unsigned int region_height,
+                  const unsigned int stride_width,
+                  const unsigned int stride_height );
+  
+  explicit AveragePoolingLayer(std::string configuration);
+  
+  // Implementations for SimpleLayer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs, std::vector< CombinedTensor* >& outputs);
+  bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  void FeedForward();
+  void BackPropagate();
+  
+  inline unsigned int Gain() {
+    return gain / (region_width_ * region_height_);
+  }
+  
+	inline std::string GetLayerDescription() {
+		std::ostringstream ss;
+		ss << "Average-Pooling Layer (" << region_width_ << "x" << region_height_;
+		if (stride_width_ != region_width_ || stride_height_ != region_height_)
+			ss << " stride " << stride_width_ << "x" << stride_height_;
+		ss << ")";
+		return ss.str();
+	}
+
+private:
+  // Settings
+  unsigned int region_width_ = 0;
+  unsigned int region_height_ = 0;
+  unsigned int stride_width_ = 0;
+  unsigned int stride_height_ = 0;
+  
+  // Feature map dimensions
+  unsigned int input_width_ = 0;
+  unsigned int input_height_ = 0;
+  unsigned int output_width_ = 0;
+  unsigned int output_height_ = 0;
+  
+  unsigned int maps_ = 0;
+
+  // Range of outputs whose regions contain an input column or row
+  std::vector<unsigned int> ox_start_;
+  std::vector<unsigned int> ox_end_;
+  std::vector<unsigned int> oy_start_;
+  std::vector<unsigned int> oy_end_;
+};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file BatchNormalizationLayer.h
+ * @class BatchNormalizationLayer
+ * @brief Layer that normalizes every feature map to zero mean and unit
+ *   variance, followed by a learned scale and shift.
+ *
+ * During training, the statistics are taken over the batch and running
+ *  averages of them are kept for testing. The running averages are
+ *  parameters so that they are saved with the net, but they are not
+ *  trained.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_BATCHNORMALIZATIONLAYER_H
+#define CONV_BATCHNORMALIZATIONLAYER_H
+
+#include <string>
+#include <vector>
+
+#include "SimpleLayer.h"
+#include "ConvolutionLayer.h"
+
+
+namespace Conv {
+
+class BatchNormalizationLayer : public SimpleLayer {
+public:
+  /**
+   * @brief Constructs a batch normalization Layer.
+   *
+   * @param momentum Weight of the old value when updating the running averages
+   * @param epsilon Added to the variance for numerical stability
+   */
+  explicit BatchNormalizationLayer(const datum momentum = 0.9, const datum epsilon = 1e-5);
+  explicit BatchNormalizationLayer(std::string configuration);
+
+  ~BatchNormalizationLayer();
+
+  // Implementations for SimpleLayer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs, std::vector< CombinedTensor* >& outputs);
+  bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  void FeedForward();
+  void BackPropagate();
+
+  // Only the scale and shift are trained
+  bool IsParameterTrainable(const unsigned int p) { return p < 2; }
+
+  /**
+   * @brief Folds the normalization with the running averages into a
+   *   convolution that feeds this layer.
+   *
+   * Afterwards, the convolution alone computes what both layers
+   *  computed while testing.
+   */
+  bool FoldInto(ConvolutionLayer& convolution) const;
+
+	inline std::string GetLayerDescription() {
+		return "Batch Normalization Layer";
+	}
+
+private:
+  datum momentum_ = 0.9;
+  datum epsilon_ = 1e-5;
+
+  unsigned int maps_ = 0;
+  std::size_t map_size_ = 0;
+
+  CombinedTensor* scale_ = nullptr;
+  CombinedTensor* shift_ = nullptr;
+  CombinedTensor* running_mean_ = nullptr;
+  CombinedTensor* running_variance_ = nullptr;
+
+  // Statistics used by the last forward pass
+  std::vector<datum> mean_;
+  std::vector<datum> inverse_std_;
+  bool used_batch_statistics_ = true;
+};
+
+}
+
+#endif
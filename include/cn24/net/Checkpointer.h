@@ -0,0 +1,117 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file Checkpointer.h
+ * @class Checkpointer
+ * @brief Writes snapshots of a training session in the background.
+ *
+ * A snapshot is a copy of the parameters and, optionally, of the Trainer's
+ *  optimizer state and position. Copying is all that happens on the
+ *  training thread; a worker thread writes the copy to disk, syncs it
+ *  and renames it over the old file, so a checkpoint is always complete.
+ *
+ * A checkpoint file starts like a parameter file. The optimizer state
+ *  follows as one tensor of last steps and one of last gradients per
+ *  parameter set, and a last tensor holds the epoch and iteration.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_CHECKPOINTER_H
+#define CONV_CHECKPOINTER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../util/Tensor.h"
+#include "NetGraph.h"
+#include "Trainer.h"
+
+namespace Conv {
+
+class Checkpointer {
+public:
+  /**
+   * @brief Creates a Checkpointer for the Trainer's graph.
+   *
+   * @param graph The graph being trained
+   * @param trainer The Trainer of the graph
+   */
+  Checkpointer(NetGraph& graph, Trainer& trainer);
+
+  /**
+   * @brief Writes all remaining snapshots and stops the worker.
+   */
+  ~Checkpointer();
+
+  /**
+   * @brief Copies the current state and writes it in the background.
+   *
+   * If the previous snapshot is still being written, this one waits in
+   *  the second buffer. A newer snapshot of the same file replaces it,
+   *  one of another file blocks until it is written.
+   *
+   * @param filename Path of the file, replaced atomically
+   * @param optimizer_state Also save what is needed to resume training
+   * @param storage Element type of the parameters
+   */
+  void Save(const std::string& filename, bool optimizer_state = true,
+            TensorStorage storage = STORAGE_FLOAT32);
+
+  /**
+   * @brief Blocks until all snapshots are written.
+   *
+   * @returns False if writing a snapshot failed since the last call
+   */
+  bool Wait();
+
+  /**
+   * @brief Loads a checkpoint into the graph and the Trainer.
+   *
+   * The next epoch continues with the iteration after the snapshot.
+   *  Parameter files without optimizer state can be used, too.
+   *
+   * @returns True on success
+   */
+  bool Resume(const std::string& filename);
+
+private:
+  struct Snapshot {
+    std::string filename;
+    bool optimizer_state = true;
+    TensorStorage storage = STORAGE_FLOAT32;
+    unsigned int epoch = 0;
+    unsigned int iteration = 0;
+    std::vector<Tensor*> parameters;
+    std::vector<Tensor*> last_deltas;
+    std::vector<Tensor*> last_gradients;
+  };
+
+  void WriteSnapshots();
+  static bool WriteSnapshot(Snapshot& snapshot);
+
+  NetGraph& graph_;
+  Trainer& trainer_;
+
+  // Double buffer, -1 means none
+  Snapshot snapshots_[2];
+  int writing_ = -1;
+  int pending_ = -1;
+  bool failed_ = false;
+  bool stop_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread writer_;
+};
+
+}
+
+#endif
@@ -10,6 +10,7 @@
 #define CONV_CONCATENATIONLAYER_H
 
 #include <string>
+#include <vector>
 
 #include "Layer.h"
 
@@ -29,18 +30,25 @@ public:
   void BackPropagate();
 
   std::string GetLayerDescription() { return "Concatenation Layer"; }
+  bool IsConcatenatingMaps() { return true; }
+
+  /**
+   * @brief Returns true if the input already is a view of its maps in
+   *   the output, so nothing needs to be copied.
+   */
+  bool IsInputInPlace(const unsigned int input) const;
+
   void CreateBufferDescriptors(std::vector< NetGraphBuffer >& buffers) {
     NetGraphBuffer buffer;
     buffer.description = "Output";
     buffers.push_back(buffer);
   };
 private:
-  CombinedTensor* input_a_ = nullptr;
-  CombinedTensor* input_b_ = nullptr;
+  std::vector<CombinedTensor*> inputs_;
   CombinedTensor* output_ = nullptr;
   
-  unsigned int maps_a_ = 0;
-  unsigned int maps_b_ = 0;
+  // First output map of every input
+  std::vector<unsigned int> first_maps_;
   unsigned int samples_ = 0;
 };
 
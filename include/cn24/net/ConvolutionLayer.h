@@ -18,6 +18,8 @@
 #include <random>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 #include "Layer.h"
 #include "SimpleLayer.h"
@@ -59,6 +61,48 @@ public:
   void BackPropagate();
   
   void OnLayerConnect (const std::vector<Layer*> next_layer);
+
+  /**
+   * @brief Folds an affine transform of every output map into the weights
+   *
+   * @param scale Factor for every output map
+   * @param shift Offset for every output map
+   */
+  bool FoldAffineTransform (const std::vector<datum>& scale, const std::vector<datum>& shift);
+
+  /**
+   * @brief Records the range of the inputs seen by FeedForward
+   *
+   * @param calibrating Whether to record, enabling it forgets the old range
+   */
+  void SetCalibrating (bool calibrating);
+
+  /**
+   * @brief Gets the input range recorded while calibrating
+   *
+   * @returns False if nothing was recorded
+   */
+  bool GetInputRange (datum& input_min, datum& input_max) const;
+
+  /**
+   * @brief Switches the testing FeedForward to 8-bit integers
+   *
+   * The weights are quantized per output map, the inputs to the given
+   *  range. Call it again after the weights change.
+   *
+   * @param input_min Smallest expected input
+   * @param input_max Largest expected input
+   */
+  bool Quantize (const datum input_min, const datum input_max);
+
+  /**
+   * @brief Switches the testing FeedForward back to floating point
+   */
+  void Dequantize();
+
+  inline bool IsQuantized() const {
+    return quantized_;
+  }
   
   inline unsigned int Gain() {
     return kernel_width_ * kernel_height_ * input_maps_;
@@ -71,7 +115,15 @@ public:
 	}
   
   bool IsOpenCLAware();
+
+  // The output is only accessed through TensorMath::SMS
+  bool IsStridedOutputCapable() { return true; }
+
+  // IM2COL, COL2IM and SMS convert 16-bit inputs and outputs
+  bool IsHalfPrecisionCapable() { return true; }
 private:
+  void FeedForwardQuantized();
+
   Tensor im2col_ff_buffer;
   Tensor sms_ff_buffer;
   Tensor sms2_bp_buffer;
@@ -105,6 +157,23 @@ private:
   unsigned int pad_height_ = 0;
   unsigned int group_ = 0;
   datum dropout_fraction_ = 0.0;
+
+  // Calibration
+  bool calibrating_ = false;
+  bool calibrated_ = false;
+  datum input_min_ = 0.0;
+  datum input_max_ = 0.0;
+
+  // Quantized inference
+  bool quantized_ = false;
+  datum input_scale_ = 1.0;
+  int32_t input_zero_point_ = 0;
+  std::size_t quantized_depth_ = 0;
+  std::vector<int8_t> quantized_weights_;
+  std::vector<int32_t> quantized_weight_sums_;
+  std::vector<datum> quantized_scales_;
+  std::vector<uint8_t> quantized_inputs_;
+  std::vector<int32_t> quantized_outputs_;
 };
 
 }
@@ -0,0 +1,54 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */  
+/**
+ * @file GlobalAveragePoolingLayer.h
+ * @class GlobalAveragePoolingLayer
+ * @brief Layer that reduces every feature map to its mean.
+ *
+ * The output has a width and height of one, so the layer only fits
+ *  networks that are trained and tested on patches.
+ * 
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_GLOBALAVERAGEPOOLINGLAYER_H
+#define CONV_GLOBALAVERAGEPOOLINGLAYER_H
+
+#include <string>
+#include <vector>
+
+#include "SimpleLayer.h"
+
+
+namespace Conv {
+  
+class GlobalAveragePoolingLayer : public SimpleLayer {
+public:
+  GlobalAveragePoolingLayer();
+  explicit GlobalAveragePoolingLayer(std::string configuration);
+  
+  // Implementations for SimpleLayer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs, std::vector< CombinedTensor* >& outputs);
+  bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  void FeedForward();
+  void BackPropagate();
+  
+  inline unsigned int Gain() {
+    return input_size_ > 0 ? gain / input_size_ : gain;
+  }
+  
+	inline std::string GetLayerDescription() { return "Global Average-Pooling Layer"; }
+
+private:
+  // Pixels per input map
+  std::size_t input_size_ = 0;
+  unsigned int maps_ = 0;
+};
+
+}
+
+#endif
@@ -51,8 +51,6 @@ private:
   CombinedTensor* input_ = nullptr;
   
   unsigned int output_count_ = 0;
-  unsigned int samples_ = 0;
-  unsigned int elements_per_sample_ = 0;
 };
 
 }
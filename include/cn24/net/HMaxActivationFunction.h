@@ -49,9 +49,10 @@ public:
   bool IsNotGradientSafe() {
     return loss_weight_ > 0.0;
   }
+  bool IsOutputNeededForBackprop() { return true; }
   
   
-  CombinedTensor* weights_;
+  CombinedTensor* weights_ = nullptr;
   datum mu_ = 1;
   datum loss_weight_ = 0;
   
@@ -46,6 +46,18 @@ public:
 	*/
   InputLayer(Tensor& data, Tensor& label, Tensor& helper, Tensor& weight); 
 
+  /**
+	* @brief Resizes the user's Tensors and the outputs
+	*
+	* Labels and weights of the same size as the data follow the data,
+	* others only change their number of samples.
+	*
+	* @param width New width of the data
+	* @param height New height of the data
+	* @param samples New number of samples
+	*/
+  void Reshape(const unsigned int width, const unsigned int height, const unsigned int samples);
+
   // Layer implementations
   virtual bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                               std::vector< CombinedTensor* >& outputs);
@@ -62,6 +74,12 @@ private:
   CombinedTensor* label_ = nullptr;
   CombinedTensor* helper_ = nullptr;
   CombinedTensor* weight_ = nullptr;
+
+  // The user's Tensors
+  Tensor* data_source_ = nullptr;
+  Tensor* label_source_ = nullptr;
+  Tensor* helper_source_ = nullptr;
+  Tensor* weight_source_ = nullptr;
 };
 }
 
@@ -117,6 +117,57 @@ public:
    */
   virtual bool IsNotGradientSafe() { return false; }
 
+  /**
+   * @brief Returns true if the layer can use its input as its output
+   *
+   * The net will let such a layer overwrite its input when nothing
+   * else reads the input.
+   */
+  virtual bool IsInPlaceCapable() { return false; }
+
+  /**
+   * @brief Returns true if BackPropagate reads the layer's output data
+   *
+   * The output of such a layer must not be overwritten by an in-place
+   * layer.
+   */
+  virtual bool IsOutputNeededForBackprop() { return false; }
+
+  /**
+   * @brief Returns true if the layer finds the samples of its output data
+   *   and delta only through Tensor::Offset
+   *
+   * The output of such a layer can be a view into a larger Tensor.
+   */
+  virtual bool IsStridedOutputCapable() { return false; }
+
+  /**
+   * @brief Returns true if the output is the inputs stacked along the maps
+   *
+   * The net will let the inputs of such a layer write directly into
+   * the output where possible.
+   */
+  virtual bool IsConcatenatingMaps() { return false; }
+
+  /**
+   * @brief Returns true if the layer's kernels read and write 16-bit
+   *   input and output buffers
+   *
+   * The net will store buffers in 16-bit formats on request if all the
+   * layers using them can do this.
+   */
+  virtual bool IsHalfPrecisionCapable() { return false; }
+
+  /**
+   * @brief Returns false if the training should not update a parameter set
+   *
+   * Such parameters are maintained by the layer, but are saved and
+   * loaded with the others.
+   *
+   * @param p Index of the parameter set
+   */
+  virtual bool IsParameterTrainable(const unsigned int p) { UNREFERENCED_PARAMETER(p); return true; }
+
   virtual std::string GetLayerConfiguration() { return configuration_; }
 	virtual std::string GetLayerDescription() { return "Layer"; }
 	virtual void CreateBufferDescriptors(std::vector<NetGraphBuffer>& buffers) {UNREFERENCED_PARAMETER(buffers);}
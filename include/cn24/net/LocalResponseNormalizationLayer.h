@@ -18,6 +18,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "SimpleLayer.h"
 
@@ -32,6 +33,7 @@ public:
   LocalResponseNormalizationLayer(const unsigned int size,
                                   const datum alpha, const datum beta,
                                   const NormalizationMethod normalization_method);
+  explicit LocalResponseNormalizationLayer(std::string configuration);
   
   // SimpleLayer implementations
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
@@ -56,9 +58,14 @@ private:
   unsigned int input_width_ = 0;
   unsigned int input_height_ = 0;
   unsigned int maps_ = 0;
+
+  // alpha divided by the clipped region size, per pixel or per map
+  std::vector<datum> alpha_over_size_;
   
-  // Buffers
-  Tensor region_sums_;
+  // The denominators 1 + alpha/n * sum and their -beta-th powers
+  //  from the forward pass
+  Tensor denominators_;
+  Tensor scales_;
 };
 }
 
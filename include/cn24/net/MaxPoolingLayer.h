@@ -17,6 +17,8 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
+#include <cstdint>
 
 #include "SimpleLayer.h"
 
@@ -53,6 +55,7 @@ public:
 	}
 
   bool IsOpenCLAware();
+  bool IsHalfPrecisionCapable() { return true; }
 private:
   // Settings
   unsigned int region_width_ = 0;
@@ -67,8 +70,11 @@ private:
   unsigned int maps_ = 0;
   
   Tensor maximum_mask_;
-  Tensor maximum_ix_;
-  Tensor maximum_iy_;
+
+  // Position of each maximum inside its pooling region (row-major),
+  //  8 bit offsets are used if the region is small enough
+  std::vector<uint8_t> maximum_offsets8_;
+  std::vector<uint16_t> maximum_offsets16_;
 };
 
 }
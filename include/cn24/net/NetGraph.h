@@ -56,6 +56,27 @@ public:
 	void AddNode(NetGraphNode* node);
 	void Initialize();
 
+	/**
+	 * @brief Changes the input size of an initialized net
+	 *
+	 * The layers and parameters are kept, buffers are reused where they
+	 * are large enough. Output buffers must be looked up again afterwards.
+	 * Only nets with InputLayer inputs can be reshaped.
+	 */
+	bool Reshape(const unsigned int width, const unsigned int height, const unsigned int samples);
+
+	/**
+	 * @brief Stores activations and deltas of an initialized net in a
+	 *  16-bit format
+	 *
+	 * Only buffers that are neither read from outside nor shared with views
+	 * are converted, and only if all the layers using them are
+	 * half precision capable. STORAGE_FLOAT32 converts them back.
+	 *
+	 * @returns False if a buffer cannot be converted
+	 */
+	bool SetActivationStorage(TensorStorage storage);
+
 	// Node queries
 	inline std::vector<NetGraphNode*>& GetOutputNodes() { return output_nodes_; }
 	inline NetGraphNode* GetDefaultOutputNode() { return output_nodes_.size() > 0 ? output_nodes_[0] : nullptr; }
@@ -74,7 +95,7 @@ public:
 	// Parameter management
   void InitializeWeights();
   void GetParameters(std::vector<CombinedTensor*>& parameters);
-  void SerializeParameters(std::ostream& output);
+  void SerializeParameters(std::ostream& output, TensorStorage storage = STORAGE_FLOAT32);
   void DeserializeParameters(std::istream& input, unsigned int last_layer = 0);
 
 	// Output
@@ -90,6 +111,10 @@ private:
 	void FeedForward(NetGraphNode* node);
 	void BackPropagate(NetGraphNode* node);
 	void InitializeNode(NetGraphNode* node);
+	bool ReshapeNode(NetGraphNode* node);
+	void ViewInputsInOutput(NetGraphNode* node, const std::vector<CombinedTensor*>& input_tensors, CombinedTensor* output);
+	bool CanRunInPlace(NetGraphNode* node) const;
+	bool CanWriteIntoOutput(NetGraphNode* node, unsigned int input, const CombinedTensor* output) const;
   void InitializeWeights(NetGraphNode* node);
 	std::vector<NetGraphNode*> nodes_;
 
@@ -56,6 +56,8 @@ public:
 
 	// Status
 	bool initialized = false;
+	bool in_place = false;
+	unsigned int inputs_in_place = 0;
 
 	// Flags used by NetGraph functions
 	bool flag_ff_visited = false;
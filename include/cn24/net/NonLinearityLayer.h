@@ -21,6 +21,17 @@
 
 namespace Conv {
 
+/**
+ * @brief Selects how transcendental activation functions are evaluated
+ *
+ * ACTIVATION_EXACT uses the C library, ACTIVATION_FAST uses vectorized
+ * polynomial approximations that are accurate to a few ULP.
+ */
+enum ActivationMode {
+  ACTIVATION_EXACT,
+  ACTIVATION_FAST
+};
+
 // This macro is a class declaration for a typical nonlinearity layer
 #define NL_LAYER(name) class name##Layer : public NonLinearityLayer {\
 public: \
@@ -30,6 +41,7 @@ std::string GetLayerDescription() { return #name " Layer";}\
 void FeedForward(); \
 void BackPropagate(); \
 bool IsOpenCLAware(); \
+bool IsHalfPrecisionCapable(); \
 };
 
 #define NL_LAYER_NOCL(name) class name##Layer : public NonLinearityLayer {\
@@ -40,12 +52,13 @@ std::string GetLayerDescription() { return #name " Layer";}\
 void FeedForward(); \
 void BackPropagate(); \
 bool IsOpenCLAware() { return false; } \
+bool IsHalfPrecisionCapable(); \
 };
 
 
 class NonLinearityLayer : public SimpleLayer {
 public:
-  explicit NonLinearityLayer(std::string configuration) : SimpleLayer(configuration) {};
+  explicit NonLinearityLayer(std::string configuration);
   
   // Implementations for SimpleLayer
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
@@ -54,6 +67,24 @@ public:
   virtual void FeedForward() = 0;
   virtual void BackPropagate() = 0;
 
+  // All activations are elementwise and their backward passes only use
+  //  the output, which is the input when running in place
+  bool IsInPlaceCapable() { return true; }
+  bool IsOutputNeededForBackprop() { return true; }
+
+  /**
+   * @brief Parses "mode=exact" or "mode=fast" from a configuration string
+   *
+   * @param configuration The configuration string
+   * @param mode The mode to return if the string does not specify one
+   */
+  static ActivationMode ParseActivationMode(std::string configuration, ActivationMode mode);
+
+  void SetActivationMode(ActivationMode mode) { mode_ = mode; }
+  ActivationMode GetActivationMode() const { return mode_; }
+
+protected:
+  ActivationMode mode_ = ACTIVATION_EXACT;
 };
 
 NL_LAYER(Tanh)
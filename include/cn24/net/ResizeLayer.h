@@ -31,6 +31,16 @@ public:
    * @param bordery Size of the complete vertical border
    */
   ResizeLayer(const unsigned int borderx, const unsigned int bordery);
+
+  /**
+   * @brief Constructs a ResizeLayer with an uneven border.
+   * @param borderx Size of the complete horizontal border
+   * @param bordery Size of the complete vertical border
+   * @param offsetx Size of the left border
+   * @param offsety Size of the top border
+   */
+  ResizeLayer(const unsigned int borderx, const unsigned int bordery,
+              const unsigned int offsetx, const unsigned int offsety);
   
   explicit ResizeLayer(std::string configuration);
   
@@ -49,6 +59,8 @@ public:
 private:
   unsigned int borderx_;
   unsigned int bordery_;
+  unsigned int offsetx_;
+  unsigned int offsety_;
 };
 
 }
@@ -0,0 +1,60 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ShiftLayer.h
+ * @class ShiftLayer
+ * @brief Layer that makes a shifted copy of each sample for every offset
+ *   inside a pooling region (the "shift" of shift-and-stitch).
+ *
+ * Sample s of the input becomes samples s * fx * fy + dy * fx + dx of the
+ * output, where (dx, dy) is the offset of the copy. The output is smaller
+ * by fx - 1 and fy - 1 pixels so that every copy fits. A StitchLayer
+ * with the same factors interleaves the copies again after the pooling.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_SHIFTLAYER_H
+#define CONV_SHIFTLAYER_H
+
+#include <string>
+#include <sstream>
+
+#include "SimpleLayer.h"
+
+namespace Conv {
+
+class ShiftLayer : public SimpleLayer {
+public:
+  /**
+   * @brief Constructs a ShiftLayer.
+   *
+   * @param factor_x Horizontal stride of the following pooling
+   * @param factor_y Vertical stride of the following pooling
+   */
+  ShiftLayer(const unsigned int factor_x, const unsigned int factor_y);
+
+  // Implementations for SimpleLayer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs, std::vector< CombinedTensor* >& outputs);
+  bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  void FeedForward();
+  void BackPropagate();
+
+	inline std::string GetLayerDescription() {
+		std::ostringstream ss;
+		ss << "Shift Layer (" << factor_x_ << "x" << factor_y_ << ")";
+		return ss.str();
+	}
+
+private:
+  unsigned int factor_x_ = 0;
+  unsigned int factor_y_ = 0;
+};
+
+}
+
+#endif
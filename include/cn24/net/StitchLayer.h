@@ -0,0 +1,58 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file StitchLayer.h
+ * @class StitchLayer
+ * @brief Layer that interleaves the shifted copies made by a ShiftLayer
+ *   into one dense sample (the "stitch" of shift-and-stitch).
+ *
+ * Pixel (x, y) of input sample s * fx * fy + dy * fx + dx becomes pixel
+ * (x * fx + dx, y * fy + dy) of output sample s.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_STITCHLAYER_H
+#define CONV_STITCHLAYER_H
+
+#include <string>
+#include <sstream>
+
+#include "SimpleLayer.h"
+
+namespace Conv {
+
+class StitchLayer : public SimpleLayer {
+public:
+  /**
+   * @brief Constructs a StitchLayer.
+   *
+   * @param factor_x Horizontal factor of the matching ShiftLayer
+   * @param factor_y Vertical factor of the matching ShiftLayer
+   */
+  StitchLayer(const unsigned int factor_x, const unsigned int factor_y);
+
+  // Implementations for SimpleLayer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs, std::vector< CombinedTensor* >& outputs);
+  bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  void FeedForward();
+  void BackPropagate();
+
+	inline std::string GetLayerDescription() {
+		std::ostringstream ss;
+		ss << "Stitch Layer (" << factor_x_ << "x" << factor_y_ << ")";
+		return ss.str();
+	}
+
+private:
+  unsigned int factor_x_ = 0;
+  unsigned int factor_y_ = 0;
+};
+
+}
+
+#endif
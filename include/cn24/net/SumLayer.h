@@ -1,7 +1,7 @@
 /**
  * @file SumLayer.h
  * @class SumLayer
- * @brief Concatenates the inputs (used to add non-convolvable information).
+ * @brief Adds the inputs.
  *
  * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
  */
@@ -16,6 +16,7 @@
 #define CONV_TRAINER_H
 
 #include <cmath>
+#include <string>
 
 #include "../util/CombinedTensor.h"
 #include "../util/StatAggregator.h"
@@ -24,6 +25,8 @@
 
 namespace Conv {
 
+class Checkpointer;
+
 enum OPTIMIZATION_METHOD {
   GRADIENT_DESCENT,
   QUICKPROP
@@ -49,6 +52,7 @@ public:
 };
 
 class Trainer {
+  friend class Checkpointer;
 public:
   /**
 	* @brief Creates a Trainer for the specified Net
@@ -86,6 +90,8 @@ public:
       t->Clear();
     
     first_iteration = true;
+    iteration_ = 0;
+    resumed_ = false;
   }
 
   /**
@@ -108,6 +114,19 @@ public:
   
   inline void SetStatsDuringTraining(bool enable) { settings_.stats_during_training = enable; }
 
+  /**
+   * @brief Saves a checkpoint every few iterations during training
+   *
+   * @param checkpointer The Checkpointer to use, nullptr disables checkpoints
+   * @param interval Number of iterations between checkpoints
+   * @param filename The file to replace with each checkpoint
+   */
+  inline void SetCheckpointing(Checkpointer* checkpointer, unsigned int interval, const std::string& filename) {
+    checkpointer_ = interval > 0 ? checkpointer : nullptr;
+    checkpoint_interval_ = interval;
+    checkpoint_filename_ = filename;
+  }
+
 private:
   void ApplyGradients (datum lr);
   void InitializeStats();
@@ -131,8 +150,15 @@ private:
 
   // State
   unsigned int epoch_ = 0;
+  unsigned int iteration_ = 0;
+  bool resumed_ = false;
   bool first_iteration = true;
 
+  // Checkpoints
+  Checkpointer* checkpointer_ = nullptr;
+  unsigned int checkpoint_interval_ = 0;
+  std::string checkpoint_filename_;
+
   // Global state
   static bool stats_are_initialized_;
   static StatDescriptor* stat_aggloss_;
@@ -0,0 +1,120 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */  
+/**
+ * @file TransposedConvolutionLayer.h
+ * @class TransposedConvolutionLayer
+ * @brief Layer that learns to upsample its input.
+ *
+ * The forward pass is the backward pass of a ConvolutionLayer with the
+ *  same settings and vice versa: every input pixel adds a weighted kernel
+ *  to the output using TensorMath::COL2IM.
+ *  With a stride s, a kernel size of 2s and padding s/2, the output is s
+ *  times as large as the input. Setting bilinear_init makes the layer
+ *  start out as a bilinear interpolation of each map.
+ * 
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TRANSPOSEDCONVOLUTIONLAYER_H
+#define CONV_TRANSPOSEDCONVOLUTIONLAYER_H
+
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "Layer.h"
+#include "SimpleLayer.h"
+
+namespace Conv {
+
+class TransposedConvolutionLayer : public SimpleLayer {
+public:
+  /**
+   * @brief Constructs a TransposedConvolutionLayer.
+   * 
+   * @param kwidth Width of the kernels
+   * @param kheight Height of the kernels
+   * @param output_maps Number of output feature maps
+   * @param stride_width Horizontal upsampling factor
+   * @param stride_height Vertical upsampling factor
+   * @param pad_width Columns removed from each side of the output
+   * @param pad_height Rows removed from each side of the output
+   * @param seed Random seed for weight generation
+   * @param bilinear_init Initialize the kernels as bilinear interpolation
+   */
+  TransposedConvolutionLayer(const unsigned int kwidth, const unsigned int kheight,
+                   const unsigned int output_maps, const unsigned int stride_width = 1,
+                   const unsigned int stride_height = 1, const unsigned int pad_width = 0,
+                   const unsigned int pad_height = 0, const int seed = 0,
+                   const bool bilinear_init = false);
+  
+  explicit TransposedConvolutionLayer(std::string configuration);
+  
+  ~TransposedConvolutionLayer() {
+    if(weights_ != nullptr)
+      delete weights_;
+    if(bias_ != nullptr)
+      delete bias_;
+  }
+  
+  // Implementations for SimpleLayer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
+                      std::vector< CombinedTensor* >& outputs);
+  bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  void FeedForward();
+  void BackPropagate();
+  
+  void OnLayerConnect (const std::vector<Layer*> next_layer);
+  
+  inline unsigned int Gain() {
+    // Each output pixel only sees every stride-th kernel element
+    const unsigned int fan_in = (kernel_width_ * kernel_height_ * input_maps_) / (stride_width_ * stride_height_);
+    return fan_in > 0 ? fan_in : 1;
+  }
+
+	inline std::string GetLayerDescription() {
+		std::ostringstream ss;
+		ss << "Transposed Convolutional Layer (" << output_maps_ << " kernels @ " << kernel_width_ << "x" << kernel_height_
+			<< ", stride " << stride_width_ << "x" << stride_height_ << ")";
+		return ss.str();
+	}
+  
+private:
+  // Input in the layout of the GEMM (maps, samples, y, x)
+  Tensor sms_input_buffer_;
+  Tensor sms_delta_buffer_;
+  
+  // Columns of the output, see TensorMath::IM2COL
+  Tensor col_buffer_;
+  
+  unsigned int input_maps_ = 0;
+  unsigned int output_maps_ = 0;
+  
+  unsigned int kernel_width_ = 0;
+  unsigned int kernel_height_ = 0;
+  
+  unsigned int input_width_ = 0;
+  unsigned int input_height_ = 0;
+  
+  unsigned int output_width_ = 0;
+  unsigned int output_height_ = 0;
+  
+  CombinedTensor* weights_ = nullptr;
+  CombinedTensor* bias_ = nullptr;
+  
+  std::mt19937 rand_;
+
+  unsigned int stride_width_ = 0;
+  unsigned int stride_height_ = 0;
+  unsigned int pad_width_ = 0;
+  unsigned int pad_height_ = 0;
+  bool bilinear_init_ = false;
+};
+
+}
+
+#endif
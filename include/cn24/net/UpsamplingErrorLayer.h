@@ -0,0 +1,93 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file UpsamplingErrorLayer.h
+ * @class UpsamplingErrorLayer
+ * @brief Quadratic loss of an output that is smaller than its labels.
+ *
+ The loss and gradient are the same as for an UpscaleLayer followed by an
+ *  ErrorLayer, but the upscaled output and its gradient are never stored.
+ *
+ * For UPSCALE_NEAREST, the labels and weights are summed over the regions
+ *  that a pixel would be replicated to, so the loss is computed at the
+ *  resolution of the output.
+ *
+ * For UPSCALE_BILINEAR, the output is interpolated one row at a time and
+ *  compared to the labels at their full resolution.
+ *
+ * The inputs are the output, the labels and the weights, just like for
+ *  the ErrorLayer.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_UPSAMPLINGERRORLAYER_H
+#define CONV_UPSAMPLINGERRORLAYER_H
+
+#include <string>
+#include <sstream>
+
+#include "Layer.h"
+#include "LossFunctionLayer.h"
+#include "../math/BilinearUpsampling.h"
+#include "UpscaleLayer.h"
+
+namespace Conv {
+
+class UpsamplingErrorLayer : public Layer, public LossFunctionLayer {
+public:
+  /**
+   * @brief Constructs an UpsamplingErrorLayer.
+   *
+   * @param factor_x Horizontal factor between the labels and the output
+   * @param factor_y Vertical factor between the labels and the output
+   * @param method The upscaling method that the loss is fused with
+   * @param loss_weight Weight of the loss
+   */
+  UpsamplingErrorLayer(const unsigned int factor_x, const unsigned int factor_y,
+                       const UpscaleMethod method, const datum loss_weight = 1.0);
+
+  // Implementations for Layer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
+                      std::vector< CombinedTensor* >& outputs);
+  bool Connect (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* net );
+  void FeedForward();
+  void BackPropagate();
+
+  // Implementations for LossFunctionLayer
+  datum CalculateLossFunction();
+
+	std::string GetLayerDescription() {
+		std::ostringstream ss;
+		ss << "Square Loss Layer (Weight: " << loss_weight_ << ", " << factor_x_ << "x" << factor_y_
+			<< (method_ == UPSCALE_BILINEAR ? " bilinear" : "") << " upscaling)";
+		return ss.str();
+	}
+private:
+  CombinedTensor* first_ = nullptr;
+  CombinedTensor* second_ = nullptr;
+  CombinedTensor* third_ = nullptr;
+
+  unsigned int factor_x_ = 1;
+  unsigned int factor_y_ = 1;
+  UpscaleMethod method_ = UPSCALE_NEAREST;
+	datum loss_weight_ = 1.0;
+
+  BilinearUpsampling bilinear_;
+
+  // Sums of the weights in the regions of the output pixels
+  Tensor weight_sums_;
+
+  // Loss of the last forward pass
+  long double loss_ = 0;
+};
+
+}
+
+#endif
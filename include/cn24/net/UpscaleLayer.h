@@ -9,6 +9,8 @@
  * @file UpscaleLayer.h
  * @class UpscaleLayer
  * @brief Layer that scales samples up after MaxPooling downscaled them.
+ *
+ * The pixels are either replicated or interpolated bilinearly.
  * 
  * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
  */
@@ -21,8 +23,14 @@
 #include <sstream>
 
 #include "SimpleLayer.h"
+#include "../math/BilinearUpsampling.h"
 
 namespace Conv {
+
+enum UpscaleMethod {
+  UPSCALE_NEAREST,
+  UPSCALE_BILINEAR
+};
   
 class UpscaleLayer : public SimpleLayer {
 public:
@@ -31,9 +39,11 @@ public:
 	*
 	* @param region_width The horizontal border size
 	* @param region_height The vertical border size
+	* @param method Replicate or interpolate the pixels
 	*/
   UpscaleLayer(const unsigned int region_width,
-	       const unsigned int region_height);
+	       const unsigned int region_height,
+	       const UpscaleMethod method = UPSCALE_NEAREST);
   
   // Implementations for SimpleLayer
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs, std::vector< CombinedTensor* >& outputs);
@@ -41,11 +51,14 @@ public:
   void FeedForward();
   void BackPropagate();
   
-  bool IsOpenCLAware() { return true; }
+  bool IsOpenCLAware() { return method_ == UPSCALE_NEAREST; }
   
 	inline std::string GetLayerDescription() {
 		std::ostringstream ss;
-		ss << "Upscale Layer (" << region_width_ << "x" << region_height_ << ")";
+		ss << "Upscale Layer (" << region_width_ << "x" << region_height_;
+		if (method_ == UPSCALE_BILINEAR)
+			ss << ", bilinear";
+		ss << ")";
 		return ss.str();
 	}
 
@@ -53,6 +66,9 @@ private:
   // Settings
   unsigned int region_width_ = 0;
   unsigned int region_height_ = 0;
+  UpscaleMethod method_ = UPSCALE_NEAREST;
+  
+  BilinearUpsampling bilinear_;
   
   // Feature map dimensions
   unsigned int input_width_ = 0;
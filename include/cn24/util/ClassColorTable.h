@@ -0,0 +1,61 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ClassColorTable.h
+ * @class ClassColorTable
+ * @brief Maps the colors of label images to class indices.
+ *
+ * The table is built once from the class colors of a Dataset. A lookup
+ * is a single hash table access instead of a search over all classes.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_CLASSCOLORTABLE_H
+#define CONV_CLASSCOLORTABLE_H
+
+#include <vector>
+#include <unordered_map>
+
+#include "Config.h"
+#include "Tensor.h"
+
+namespace Conv {
+
+class ClassColorTable {
+public:
+  /**
+   * @brief Builds the table.
+   *
+   * @param class_colors The colors of the classes in the format 0x00RRGGBB
+   */
+  explicit ClassColorTable (const std::vector<unsigned int>& class_colors);
+
+  /**
+   * @brief Converts a label image into one class index per pixel.
+   *
+   * Pixels that don't match any class color exactly get the index
+   * classes(), which means "no class".
+   *
+   * @param rgb_tensor The label image, 1 or 3 maps
+   * @param indices Receives samples * width * height class indices
+   * @returns False if the channel count is not supported
+   */
+  bool ToClassIndices (const Tensor& rgb_tensor, std::vector<unsigned int>& indices) const;
+
+  inline unsigned int classes() const {
+    return classes_;
+  }
+
+private:
+  std::unordered_map<unsigned int, unsigned int> table_;
+  unsigned int classes_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file CompactTensor.h
+ * @class CompactTensor
+ * @brief Stores a Tensor in a compact, type-tagged on-disk representation.
+ *
+ * Label tensors are stored as one class index per pixel instead of one
+ * datum per class and pixel. They are expanded to one-hot maps only when
+ * copied into a target Tensor. Images are stored as one byte per value
+ * together with a scale and an offset and converted to datum on copy.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_COMPACTTENSOR_H
+#define CONV_COMPACTTENSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Log.h"
+#include "Config.h"
+
+#include "Tensor.h"
+
+namespace Conv {
+
+/**
+ * @brief Storage types of a CompactTensor. Don't change the values,
+ *   they are part of the file format.
+ */
+enum CompactTensorType {
+  COMPACT_FLOAT = 0,
+  COMPACT_CLASS_INDEX = 1,
+  COMPACT_UCHAR = 2
+};
+
+class CompactTensor;
+/**
+ * @brief Prints size to the ostream, may be helpful.
+ */
+std::ostream& operator<< (std::ostream& output, const CompactTensor& tensor);
+
+class CompactTensor {
+public:
+  /**
+   * @brief Constructs an empty CompactTensor of zero size.
+   */
+  CompactTensor ();
+
+  ~CompactTensor ();
+
+  /**
+   * @brief Stores a Tensor without any conversion.
+   *
+   * @param tensor The Tensor to store
+   */
+  void FromTensor (Tensor& tensor);
+
+  /**
+   * @brief Stores a one-hot label Tensor as one class index per pixel.
+   *
+   * Pixels where all maps are zero are stored as "no class" and expand
+   * to all zeros again.
+   *
+   * @param tensor The label Tensor, one map per class
+   * @returns False if the Tensor is not one-hot, nothing is stored then
+   */
+  bool FromClassTensor (Tensor& tensor);
+
+  /**
+   * @brief Stores class indices, e.g. from a ClassColorTable.
+   *
+   * @param indices samples * width * height class indices, indices
+   *   greater or equal to classes mean "no class"
+   * @param samples Number of samples
+   * @param width Width of each label map
+   * @param height Height of each label map
+   * @param classes Number of classes, this is the number of maps after expansion
+   * @returns False if there are too many classes, nothing is stored then
+   */
+  bool FromClassIndices (const std::vector<unsigned int>& indices,
+                         const std::size_t samples, const std::size_t width,
+                         const std::size_t height, const std::size_t classes);
+
+  /**
+   * @brief Stores an image Tensor as one byte per value.
+   *
+   * A value v is stored as the byte b with v = offset + scale * b.
+   * By default, this only succeeds if every value can be reproduced
+   * exactly with DATUM_FROM_UCHAR, which is the case for all 8-bit images.
+   *
+   * @param tensor The image Tensor
+   * @param lossy Set to true to quantize between minimum and maximum
+   *   of the Tensor if the conversion would not be exact
+   * @returns False if the Tensor is not representable, nothing is stored then
+   */
+  bool FromImageTensor (Tensor& tensor, bool lossy = false);
+
+  /**
+   * @brief Expands a sample into a sample of the target Tensor.
+   *
+   * The target may be larger than this CompactTensor, the remaining
+   * area is zeroed.
+   *
+   * @param source_sample The sample in this CompactTensor
+   * @param target The target Tensor
+   * @param target_sample The sample in the target Tensor
+   * @returns True on success
+   */
+  bool CopySample (const std::size_t source_sample, Tensor& target,
+                   const std::size_t target_sample) const;
+
+  /**
+   * @brief Serializes the CompactTensor to the stream.
+   *
+   * @param output The output stream
+   */
+  void Serialize (std::ostream& output);
+
+  /**
+   * @brief Deserializes from the stream.
+   *
+   * @param input The input stream
+   * @param head_only Set to true to only read the dimensions
+   * @param try_mmap Set to true to attempt to memory map the file
+   * @param fd File descriptor for the SAME file as input's underlying
+   */
+  void Deserialize (std::istream& input, bool head_only = false, bool try_mmap = false, int fd = 0);
+
+  /**
+   * @brief Deallocates the memory if data_ptr is not a nullptr.
+   */
+  void DeleteIfPossible();
+
+  // Accessors for the size information
+  inline CompactTensorType type() const {
+    return type_;
+  }
+  inline std::size_t samples() const {
+    return samples_;
+  }
+  inline std::size_t maps() const {
+    return maps_;
+  }
+  inline std::size_t height() const {
+    return height_;
+  }
+  inline std::size_t width() const {
+    return width_;
+  }
+  inline std::size_t elements() const {
+    return samples_ * maps_ * width_ * height_;
+  }
+  inline std::size_t element_size() const {
+    return element_size_;
+  }
+  inline std::size_t data_length() const {
+    return data_length_;
+  }
+  inline datum scale() const {
+    return scale_;
+  }
+  inline datum offset() const {
+    return offset_;
+  }
+
+private:
+  /**
+   * @brief Allocates the data buffer and sets the size information.
+   */
+  void Resize (const CompactTensorType type, const std::size_t samples,
+               const std::size_t width, const std::size_t height,
+               const std::size_t maps, const std::size_t element_size);
+
+  // Pointer to the actual data
+  unsigned char* data_ptr_ = nullptr;
+
+  CompactTensorType type_ = COMPACT_FLOAT;
+
+  // Sizes
+  std::size_t samples_ = 0;
+  std::size_t maps_ = 0;
+  std::size_t height_ = 0;
+  std::size_t width_ = 0;
+  std::size_t element_size_ = 0;
+  std::size_t data_length_ = 0;
+
+  // Quantization parameters for COMPACT_UCHAR
+  datum scale_ = 0;
+  datum offset_ = 0;
+
+  /**
+   * @brief If this is true, the CompactTensor was memory mapped
+   */
+  bool mmapped_ = false;
+  void* original_mmap_ = nullptr;
+  std::size_t mmap_length_ = 0;
+};
+
+}
+
+#endif
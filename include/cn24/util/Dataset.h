@@ -130,7 +130,45 @@ public:
   virtual bool GetTestingSample ( Tensor& data_tensor, Tensor& label_tensor,
 				  Tensor& helper_tensor, Tensor& weight_tensor, 
 				   unsigned int sample, unsigned int index) = 0;
-				   
+
+  /**
+   * @brief Hints that the specified samples will be requested soon.
+   *
+   * Datasets that decode their samples lazily can prepare them in the
+   * background. The default implementation does nothing.
+   *
+   * @param indices The indices of the samples
+   * @param testing Set to true if the indices refer to testing samples
+   */
+  virtual void PrefetchSamples ( const std::vector<unsigned int>& indices, bool testing) {
+    UNREFERENCED_PARAMETER(indices);
+    UNREFERENCED_PARAMETER(testing);
+  }
+
+  /**
+    * @brief Fill the specified Tensors with a batch of samples.
+    *
+    * Sample i of the target Tensors receives the sample indices[i]. Datasets
+    * can load the samples in any order. The default implementation loads
+    * them one by one.
+    *
+    * @param indices The indices of the samples to load
+    * @param testing Set to true if the indices refer to testing samples
+    * @returns True on success
+    */
+  virtual bool GetSampleBatch ( Tensor& data_tensor, Tensor& label_tensor,
+				Tensor& helper_tensor, Tensor& weight_tensor,
+				const std::vector<unsigned int>& indices, bool testing) {
+    for (unsigned int sample = 0; sample < indices.size(); sample++) {
+      const bool success = testing ?
+        GetTestingSample (data_tensor, label_tensor, helper_tensor, weight_tensor, sample, indices[sample]) :
+        GetTrainingSample (data_tensor, label_tensor, helper_tensor, weight_tensor, sample, indices[sample]);
+      if (!success)
+        return false;
+    }
+    return true;
+  }
+
   /**
    * @brief Uses this Dataset's colors to colorize a net output
    */
@@ -181,10 +219,21 @@ class TensorStreamPatchDataset : public Dataset {
   virtual bool SupportsTesting() const;
   virtual bool GetTrainingSample(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index);
   virtual bool GetTestingSample(Tensor& data_tensor, Tensor& label_tensor,Tensor& helper_tensor, Tensor& weight_tensor,  unsigned int sample, unsigned int index);
-  
+  virtual bool GetSampleBatch(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, bool testing);
+
   static TensorStreamPatchDataset* CreateFromConfiguration(std::istream& file, bool dont_load, DatasetLoadSelection selection, unsigned int patchsize_x, unsigned int patchsize_y);
-  
+
 private:
+  /**
+   * @brief Finds the tensor containing a patch by binary search.
+   * @param index Index of the patch over training and testing tensors
+   * @param first_tensor Tensor to start the search at
+   * @returns The tensor index or tensors_ if there is no such patch
+   */
+  unsigned int FindTensor(unsigned int index, unsigned int first_tensor = 0) const;
+
+  void CopyPatch(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int t, unsigned int index);
+
   // Stored data
   Tensor* data_ = nullptr;
   Tensor* labels_ = nullptr;
@@ -241,6 +290,7 @@ public:
   virtual bool SupportsTesting() const;
   virtual bool GetTrainingSample(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index);
   virtual bool GetTestingSample(Tensor& data_tensor, Tensor& label_tensor,Tensor& helper_tensor, Tensor& weight_tensor,  unsigned int sample, unsigned int index);
+  virtual void PrefetchSamples(const std::vector<unsigned int>& indices, bool testing);
   
   static TensorStreamDataset* CreateFromConfiguration(std::istream& file, bool dont_load = false, DatasetLoadSelection selection = LOAD_BOTH);
   
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file HalfPrecision.h
+ * @class HalfPrecision
+ * @brief Conversions between datums and 16-bit floating point formats.
+ *
+ * IEEE half precision keeps 11 significant bits in a small range,
+ *  bfloat16 keeps the range of a float but only 8 significant bits.
+ *  Both round to the nearest value, ties to even.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_HALFPRECISION_H
+#define CONV_HALFPRECISION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Config.h"
+
+namespace Conv {
+
+/**
+ * @brief Element type of a serialized Tensor
+ */
+enum TensorStorage {
+  STORAGE_FLOAT32 = 0,
+  STORAGE_FLOAT16 = 1,
+  STORAGE_BFLOAT16 = 2
+};
+
+/**
+ * @brief Position of the storage type in a serialized Tensor's map count
+ */
+const unsigned int TENSOR_STORAGE_SHIFT = 56;
+
+class HalfPrecision {
+public:
+  /**
+   * @brief Converts datums to a 16-bit format.
+   *
+   * @param source The datums
+   * @param target Receives count 16-bit values
+   * @param count Number of values
+   * @param storage STORAGE_FLOAT16 or STORAGE_BFLOAT16
+   */
+  static void Pack(const datum* source, uint16_t* target, const std::size_t count,
+                   const TensorStorage storage);
+
+  /**
+   * @brief Converts values of a 16-bit format to datums.
+   *
+   * @param source The 16-bit values
+   * @param target Receives count datums
+   * @param count Number of values
+   * @param storage STORAGE_FLOAT16 or STORAGE_BFLOAT16
+   */
+  static void Unpack(const uint16_t* source, datum* target, const std::size_t count,
+                     const TensorStorage storage);
+
+  /**
+   * @brief Size of an element in bytes.
+   */
+  static std::size_t ElementSize(const TensorStorage storage);
+
+  /**
+   * @brief Parses fp32, fp16 or bf16.
+   *
+   * @returns False if the name is unknown
+   */
+  static bool ParseStorage(const std::string& name, TensorStorage& storage);
+
+  /**
+   * @brief Name of the instruction sets used for the conversions.
+   */
+  static const char* GetImplementation();
+};
+
+}
+
+#endif
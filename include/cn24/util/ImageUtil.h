@@ -0,0 +1,108 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ImageUtil.h
+ * @class ImageUtil
+ * @brief Loads PNG and JPG files into Tensors, optionally many at once.
+ *
+ * Images can be decoded into a sample of a preallocated batch Tensor
+ * directly. Batches of files are decoded in parallel.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_IMAGEUTIL_H
+#define CONV_IMAGEUTIL_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Tensor.h"
+
+namespace Conv {
+
+class ImageUtil {
+public:
+  /**
+   * @brief Checks if the file is a PNG or JPG file by its extension.
+   *
+   * @param file Name of the file
+   * @returns True if the file can be loaded by ImageUtil
+   */
+  static bool IsImageFile (const std::string& file);
+
+  /**
+   * @brief Reads the dimensions of an image without decoding it.
+   *
+   * @param file Name of the image file
+   * @param width Width of the image
+   * @param height Height of the image
+   * @param channels Number of channels of the image
+   * @returns True on success, false otherwise
+   */
+  static bool ReadSize (const std::string& file, std::size_t& width,
+                        std::size_t& height, std::size_t& channels);
+
+  /**
+   * @brief Loads an image into a Tensor.
+   *
+   * @param file Name of the image file
+   * @param tensor Tensor to store the data in (will be resized)
+   * @returns True on success, false otherwise
+   */
+  static bool LoadFromFile (const std::string& file, Tensor& tensor);
+
+  /**
+   * @brief Loads an image into a sample of a preallocated Tensor.
+   *
+   * The image must not be larger than the Tensor and must have as many
+   * channels as the Tensor has maps. The remaining area is zeroed.
+   *
+   * @param file Name of the image file
+   * @param tensor Tensor to store the data in
+   * @param sample The sample to store the image in
+   * @returns True on success, false otherwise
+   */
+  static bool LoadFromFile (const std::string& file, Tensor& tensor,
+                            const std::size_t sample);
+
+  /**
+   * @brief Loads many images in parallel.
+   *
+   * @param files Names of the image files
+   * @param tensors One Tensor per file (will be replaced)
+   * @returns True if all images were loaded, false otherwise
+   */
+  static bool LoadBatch (const std::vector<std::string>& files,
+                         std::vector<Tensor>& tensors);
+
+  /**
+   * @brief Loads many images in parallel into the samples of a batch Tensor.
+   *
+   * @param files Names of the image files, the i-th file goes into sample i
+   * @param tensor Preallocated batch Tensor, see LoadFromFile
+   * @returns True if all images were loaded, false otherwise
+   */
+  static bool LoadBatch (const std::vector<std::string>& files, Tensor& tensor);
+
+  /**
+   * @brief Converts a row of interleaved 8-bit pixels to planar datums.
+   *
+   * @param source width * channels interleaved bytes
+   * @param width Number of pixels
+   * @param channels Number of channels, at most 4
+   * @param targets One row pointer per channel
+   */
+  static void DeinterleaveRow (const unsigned char* source, const std::size_t width,
+                               const std::size_t channels, datum* const* targets);
+};
+
+}
+
+#endif
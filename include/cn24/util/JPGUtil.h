@@ -35,6 +35,30 @@ public:
    * @returns True on sucess, false otherwise
    */
   static bool LoadFromFile (const std::string& file, Tensor& tensor);
+
+  /**
+   * @brief Loads a JPG file into a sample of a preallocated Tensor.
+   *
+   * @param file Input file to read from
+   * @param tensor Tensor to store the data in (will not be resized, the
+   *    image must fit and the remaining area is zeroed)
+   * @param sample The sample to store the image in
+   * @returns True on sucess, false otherwise
+   */
+  static bool LoadFromFile (const std::string& file, Tensor& tensor,
+                            const std::size_t sample);
+
+  /**
+   * @brief Reads the dimensions of a JPG file.
+   *
+   * @param file Input file to read from
+   * @param width Width of the image
+   * @param height Height of the image
+   * @param channels Number of channels of the image
+   * @returns True on sucess, false otherwise
+   */
+  static bool ReadSize (const std::string& file, std::size_t& width,
+                        std::size_t& height, std::size_t& channels);
   
   /**
    * @brief Writes a Tensor to an output stream in PNG format.
@@ -12,28 +12,46 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <list>
+#include <unordered_map>
 
 #include "Log.h"
 #include "Config.h"
 
 #include "Tensor.h"
+#include "CompactTensor.h"
+#include "ClassColorTable.h"
 #include "TensorStream.h"
 
+// Memory budget for decoded images in bytes
+#define CN24_LTS_DEFAULT_CACHE_SIZE (1024UL * 1024UL * 1024UL)
+
+// Number of image/label pairs decoded in parallel while loading the lists
+#define CN24_LTS_IMPORT_BATCH_SIZE 64
+
 namespace Conv {
 	
 	struct ListTensorMetadata {
 	public:
 		ListTensorMetadata(std::string filename, std::size_t width, std::size_t height, std::size_t maps, std::size_t samples) :
-			filename(filename), width(width), height(height), maps(maps), samples(samples) {};
+			width(width), height(height), maps(maps), samples(samples), filename(filename) {};
 			
 		std::size_t width = 0, height = 0, maps = 0, samples = 0;
 		std::string filename;
 	};
+
+	struct ListTensorCacheEntry {
+		CompactTensor* tensor = nullptr;
+		std::list<unsigned int>::iterator lru_position;
+	};
   
   class ListTensorStream : public TensorStream {
   public:
-    explicit ListTensorStream(std::vector<unsigned int> class_colors) : class_colors_(class_colors) {};
+    explicit ListTensorStream(std::vector<unsigned int> class_colors, std::size_t cache_size = CN24_LTS_DEFAULT_CACHE_SIZE) :
+      class_colors_(class_colors), color_table_(class_colors), cache_size_(cache_size) {};
     ~ListTensorStream() {
+			for(std::pair<const unsigned int, ListTensorCacheEntry>& entry : cache_)
+				delete entry.second.tensor;
     }
     
     unsigned int LoadFiles(std::string imagelist_path, std::string images, std::string labellist_path, std::string labels);
@@ -46,12 +64,33 @@ namespace Conv {
     unsigned int GetTensorCount();
     unsigned int LoadFile(std::string path);
     bool CopySample(const unsigned int source_index, const std::size_t source_sample, Tensor& target, const std::size_t target_sample);
+    void Prefetch(const std::vector<unsigned int>& indices);
 		
 	private:
+		/**
+		 * @brief Loads and converts a tensor from disk. This is thread safe.
+		 */
+		CompactTensor* DecodeTensor(const unsigned int index) const;
+
+		/**
+		 * @brief Converts a decoded image or label image into its cached form.
+		 */
+		CompactTensor* ConvertTensor(Tensor& rgb_tensor, const unsigned int index) const;
+
+		CompactTensor* GetCachedTensor(const unsigned int index);
+		bool InsertCachedTensor(const unsigned int index, CompactTensor* tensor, bool allow_eviction = true);
+
 		std::vector<ListTensorMetadata> tensors_;
 		std::vector<unsigned int> class_colors_;
+		ClassColorTable color_table_;
+
+		// LRU cache of decoded tensors, most recently used at the front
+		std::unordered_map<unsigned int, ListTensorCacheEntry> cache_;
+		std::list<unsigned int> lru_;
+		std::size_t cache_size_;
+		std::size_t cache_used_ = 0;
   };
   
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -33,6 +33,31 @@ public:
    * @returns True on sucess, false otherwise
    */
   static bool LoadFromStream (std::istream& stream, Tensor& tensor); 
+
+  /**
+   * @brief Loads a PNG file from an input stream into a sample of a
+   *    preallocated Tensor.
+   *
+   * @param stream Input stream to read from
+   * @param tensor Tensor to store the data in (will not be resized, the
+   *    image must fit and the remaining area is zeroed)
+   * @param sample The sample to store the image in
+   * @returns True on sucess, false otherwise
+   */
+  static bool LoadFromStream (std::istream& stream, Tensor& tensor,
+                              const std::size_t sample);
+
+  /**
+   * @brief Reads the dimensions of a PNG file from an input stream.
+   *
+   * @param stream Input stream to read from
+   * @param width Width of the image
+   * @param height Height of the image
+   * @param channels Number of channels of the image
+   * @returns True on sucess, false otherwise
+   */
+  static bool ReadSize (std::istream& stream, std::size_t& width,
+                        std::size_t& height, std::size_t& channels);
   
   /**
    * @brief Writes a Tensor to an output stream in PNG format.
@@ -26,11 +26,13 @@
 #define CONV_TENSOR_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <iostream>
 
 #include "Log.h"
 #include "Config.h"
+#include "HalfPrecision.h"
 
 namespace Conv {
 
@@ -99,8 +101,69 @@ public:
    */
   void Shadow (Tensor& tensor);
 
+  /**
+   * @brief Uses a range of maps of another Tensor's memory.
+   *
+   * The samples of the view are as far apart as in the other Tensor, so
+   *  the view is not contiguous unless it covers all maps or there is only
+   *  one sample. Only use it with code that finds the samples through
+   *  Offset or data_ptr.
+   *
+   * @param tensor Tensor to view
+   * @param first_map First map of the range
+   * @param maps Number of maps in the range
+   */
+  bool View (Tensor& tensor, const std::size_t first_map, const std::size_t maps);
+
+  /**
+   * @brief Uses memory that does not belong to any Tensor, e.g. a
+   *  memory mapped file.
+   *
+   * The memory is not freed by this Tensor and has to outlive it.
+   *
+   * @param memory The contiguous elements
+   */
+  bool Wrap (datum* const memory, const std::size_t samples, const std::size_t width = 1,
+             const std::size_t height = 1, const std::size_t maps = 1);
+
+  /**
+   * @brief Changes the element type of the Tensor's memory, keeping the
+   *  contents.
+   *
+   * 16-bit Tensors have no datum memory, data_ptr returns a nullptr. Only
+   *  code that checks storage() can use them, e.g. through PackElements
+   *  and UnpackElements. Resizing keeps the storage type, copies are
+   *  datums. Only Tensors that own their memory can be converted and
+   *  they must not be shadowed.
+   *
+   * @param storage The new element type
+   * @returns True on success
+   */
+  bool SetStorage (const TensorStorage storage);
+
+  /**
+   * @brief Converts elements of any storage type to datums.
+   *
+   * @param first Number of the first element
+   * @param count Number of elements
+   * @param target Receives count datums
+   */
+  void UnpackElements (const std::size_t first, const std::size_t count, datum* target) const;
+
+  /**
+   * @brief Converts datums to elements of the Tensor's storage type.
+   *
+   * @param first Number of the first element
+   * @param count Number of elements
+   * @param source The datums
+   */
+  void PackElements (const std::size_t first, const std::size_t count, const datum* source);
+
   /**
    * @brief Resizes the Tensor with data loss.
+   *
+   * The memory is kept if it was allocated by this Tensor and is large
+   * enough for the new size.
    */
   void Resize (const std::size_t samples, const std::size_t width = 1,
                const std::size_t height = 1, const std::size_t maps = 1,
@@ -128,7 +191,7 @@ public:
   inline std::size_t Offset (const std::size_t x, const std::size_t y,
                              const std::size_t map, const std::size_t sample)
   const {
-    return (sample * maps_ * width_ * height_) +
+    return (sample * sample_stride_) +
            (map * width_ * height_) +
            (y * width_) +
            x;
@@ -145,13 +208,16 @@ public:
    *
    * @param output The output stream
    * @param convert Convert to byte
+   * @param storage Element type of the written data
    */
-  void Serialize (std::ostream& output, bool convert = false);
+  void Serialize (std::ostream& output, bool convert = false,
+                  TensorStorage storage = STORAGE_FLOAT32);
 
   /**
    * @brief Deserializes from the stream.
    *
    * Note that this resizes the stream if necessary and overwrites its content.
+   * Half precision data is converted back to datums and never memory mapped.
    * @param input The input stream
    * @param head_only Set to true to only read the dimensions
    * @param try_mmap Set to true to attempt to memory map the file
@@ -287,6 +353,40 @@ public:
   inline std::size_t elements() const {
     return elements_;
   }
+  inline std::size_t sample_stride() const {
+    return sample_stride_;
+  }
+  inline TensorStorage storage() const {
+    return storage_;
+  }
+
+  /**
+   * @brief Get a pointer to the elements of a 16-bit Tensor
+   */
+  inline uint16_t* half_data_ptr() const {
+    return half_data_ptr_;
+  }
+
+  /**
+   * @brief Get a const pointer to the elements of a 16-bit Tensor
+   */
+  inline const uint16_t* half_data_ptr_const() const {
+    return half_data_ptr_;
+  }
+
+  /**
+   * @brief Returns true if the elements are stored without gaps.
+   */
+  inline bool IsContiguous() const {
+    return samples_ <= 1 || sample_stride_ == maps_ * width_ * height_;
+  }
+
+  /**
+   * @brief Returns true if the memory belongs to another Tensor.
+   */
+  inline bool IsShadow() const {
+    return is_shadow_;
+  }
 
 private:
   // Pointer to the actual data
@@ -300,6 +400,14 @@ private:
   std::size_t height_ = 0;
   std::size_t width_ = 0;
   std::size_t elements_ = 0;
+  std::size_t sample_stride_ = 0;
+
+  // Number of elements that fit into our own allocation
+  std::size_t capacity_ = 0;
+
+  // Memory of 16-bit Tensors, data_ptr_ is a nullptr then
+  uint16_t* half_data_ptr_ = nullptr;
+  TensorStorage storage_ = STORAGE_FLOAT32;
   
 public:
   /**
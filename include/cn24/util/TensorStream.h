@@ -32,6 +32,14 @@ public:
                           Tensor& target, const std::size_t target_sample) = 0;
   
   virtual unsigned int GetTensorCount() = 0;
+
+  /**
+   * @brief Hints that the specified tensors will be copied soon. Streams
+   *   that load lazily can use this to load them in parallel.
+   */
+  virtual void Prefetch(const std::vector<unsigned int>& indices) {
+    UNREFERENCED_PARAMETER(indices);
+  }
   
   static TensorStream* FromFile(std::string path, std::vector<unsigned int> class_colors = {});
 };
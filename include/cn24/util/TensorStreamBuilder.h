@@ -0,0 +1,107 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file TensorStreamBuilder.h
+ * @class TensorStreamBuilder
+ * @brief Imports lists of images and labels into a TensorStream file.
+ *
+ * The file lists are processed in chunks. The pairs of a chunk are
+ * sharded across worker threads that decode the images, convert the
+ * label colors with a ClassColorTable and serialize the result into
+ * memory. The chunk is then appended to the output file in order.
+ *
+ * After each chunk, a record with the number of processed pairs and
+ * the output length is appended to an index file next to the output
+ * (output file name + ".index"). A chunk only counts as written once
+ * its record is on disk, so an interrupted build can be resumed by
+ * truncating the output to the last record and skipping the pairs.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TENSORSTREAMBUILDER_H
+#define CONV_TENSORSTREAMBUILDER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Tensor.h"
+#include "ClassColorTable.h"
+
+// Number of image/label pairs that are written together
+#define CN24_TSB_CHUNK_SIZE 256
+
+namespace Conv {
+
+/**
+ * @brief Output formats of the TensorStreamBuilder
+ */
+enum TensorStreamBuilderFormat {
+  BUILDER_FLOAT,
+  BUILDER_COMPRESSED,
+  BUILDER_COMPACT
+};
+
+class TensorStreamBuilder {
+public:
+  /**
+   * @brief Prepares a builder.
+   *
+   * @param class_colors The colors of the classes in the label images
+   * @param format The format of the output file
+   * @param direct_rgb Set to true to use the label images as they are
+   * @param threads Number of worker threads, 0 to use all cores
+   */
+  TensorStreamBuilder(const std::vector<unsigned int>& class_colors,
+                      const TensorStreamBuilderFormat format,
+                      const bool direct_rgb, unsigned int threads = 0);
+
+  /**
+   * @brief Imports the image/label pairs into the output file.
+   *
+   * Pairs with mismatching dimensions are skipped.
+   *
+   * @param image_files Full paths of the images
+   * @param label_files Full paths of the labels, one per image
+   * @param output_fname Name of the output file
+   * @param resume Set to true to continue an interrupted build with the
+   *   same lists instead of starting over
+   * @returns True on success, false otherwise
+   */
+  bool Build(const std::vector<std::string>& image_files,
+             const std::vector<std::string>& label_files,
+             const std::string& output_fname, const bool resume = false);
+
+private:
+  /**
+   * @brief Loads and converts a pair, thread-safe.
+   *
+   * @param image_file Full path of the image
+   * @param label_file Full path of the label
+   * @param output The serialized tensors, empty if the pair is skipped
+   * @returns False if the files cannot be loaded
+   */
+  bool ConvertPair(const std::string& image_file, const std::string& label_file,
+                   std::string& output) const;
+
+  /**
+   * @brief Converts label colors to a label Tensor for the float formats.
+   */
+  void ConvertLabel(const Tensor& rgb_tensor, Tensor& label_tensor) const;
+
+  std::vector<unsigned int> class_colors_;
+  ClassColorTable color_table_;
+  TensorStreamBuilderFormat format_;
+  bool direct_rgb_;
+  unsigned int threads_;
+};
+
+}
+
+#endif
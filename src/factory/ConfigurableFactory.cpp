@@ -10,13 +10,20 @@
 
 #include "ConvolutionLayer.h"
 #include "LocalResponseNormalizationLayer.h"
+#include "BatchNormalizationLayer.h"
 #include "ResizeLayer.h"
+#include "ShiftLayer.h"
+#include "StitchLayer.h"
 #include "MaxPoolingLayer.h"
 #include "AdvancedMaxPoolingLayer.h"
+#include "AveragePoolingLayer.h"
+#include "GlobalAveragePoolingLayer.h"
 #include "InputDownSamplingLayer.h"
 #include "NonLinearityLayer.h"
 #include "HMaxActivationFunction.h"
 #include "UpscaleLayer.h"
+#include "UpsamplingErrorLayer.h"
+#include "TransposedConvolutionLayer.h"
 #include "SpatialPriorLayer.h"
 #include "ConcatenationLayer.h"
 #include "SumLayer.h"
@@ -44,6 +51,13 @@ ConfigurableFactory::ConfigurableFactory (std::istream& file, const unsigned int
   
   bool ignore_layers = false;
 
+  // Nets trained on patches get dense predictions by shift-and-stitch
+  //  unless an upscaling method is requested
+  bool patch_trained = false;
+  bool explicit_upscaling = false;
+  bool stitch_requested = false;
+  bool stitch_capable = true;
+
   // Calculate patch size / receptive field size
   while (! file_.eof()) {
     std::string line;
@@ -56,12 +70,48 @@ ConfigurableFactory::ConfigurableFactory (std::istream& file, const unsigned int
     ParseStringParamIfPossible (line, "method", method);
 
     if (method.compare (0, 5, "patch") == 0) {
+      patch_trained = true;
       if (is_training_factory) {
         method_ = PATCH;
         LOGDEBUG << "Setting method to PATCH";
       }
     }
     
+    if (StartsWithIdentifier (line, "upscaling")) {
+      std::string upscaling;
+      ParseStringParamIfPossible (line, "upscaling", upscaling);
+      explicit_upscaling = true;
+      if (upscaling.compare (0, 6, "stitch") == 0) {
+        stitch_requested = true;
+      } else if (upscaling.compare (0, 8, "bilinear") == 0) {
+        upscale_method_ = UPSCALE_BILINEAR;
+        LOGDEBUG << "Using bilinear upscaling";
+      } else if (upscaling.compare (0, 7, "nearest") == 0) {
+        upscale_method_ = UPSCALE_NEAREST;
+      } else {
+        LOGWARN << "Unknown upscaling method: " << upscaling;
+      }
+    }
+
+    if (StartsWithIdentifier (line, "upscaleloss")) {
+      std::string upscale_loss;
+      ParseStringParamIfPossible (line, "upscaleloss", upscale_loss);
+      fuse_upscaling_loss_ = upscale_loss.compare (0, 5, "fused") == 0;
+    }
+
+    if (StartsWithIdentifier (line, "activations")) {
+      std::string activations;
+      ParseStringParamIfPossible (line, "activations", activations);
+      if (activations.compare (0, 4, "fast") == 0) {
+        activation_mode_ = ACTIVATION_FAST;
+        LOGDEBUG << "Using fast activation functions";
+      } else if (activations.compare (0, 5, "exact") == 0) {
+        activation_mode_ = ACTIVATION_EXACT;
+      } else {
+        LOGWARN << "Unknown activation mode: " << activations;
+      }
+    }
+    
     if (line.compare (0, 6, "manual") == 0) {
       unsigned int rfx = 0, rfy = 0, fx = 0, fy = 0;
       ParseCountIfPossible(line, "rfx", rfx);
@@ -126,6 +176,52 @@ ConfigurableFactory::ConfigurableFactory (std::istream& file, const unsigned int
         factorx *= sx;
         factory *= sy;
       }
+
+      if (StartsWithIdentifier (line, "transposedconvolutional")) {
+        unsigned int kx = 1, ky = 1, stridex = 1, stridey = 1, padx = 0, pady = 0;
+        ParseKernelSizeIfPossible (line, "size", kx, ky);
+        ParseKernelSizeIfPossible (line, "stride", stridex, stridey);
+        ParseKernelSizeIfPossible (line, "pad", padx, pady);
+
+        if (stridex == 0 || stridey == 0) {
+          FATAL ("Transposed convolution stride needs to be at least 1!");
+        }
+        if ((factorx % (int)stridex) != 0 || (factory % (int)stridey) != 0) {
+          FATAL ("Transposed convolution stride " << stridex << "x" << stridey << " does not divide the downsampling factor "
+                 << factorx << "x" << factory << "!");
+        }
+
+        // The output grows by k - s - 2p pixels at the new resolution
+        stitch_capable = false;
+        LOGDEBUG << "Adding transposed convolutional layer to receptive field (" << kx << "," << ky << "s" << stridex << "," << stridey << "p" << padx << "," << pady << ")";
+        factorx /= (int)stridex;
+        factory /= (int)stridey;
+        receptive_field_x_ -= factorx * ((int)kx - (int)stridex - (int)padx - (int)padx);
+        receptive_field_y_ -= factory * ((int)ky - (int)stridey - (int)pady - (int)pady);
+      }
+
+      if (StartsWithIdentifier (line, "avgpooling")) {
+        unsigned int kx = 1, ky = 1, sx, sy;
+        ParseKernelSizeIfPossible (line, "size", kx, ky);
+        sx = kx; sy = ky;
+        ParseKernelSizeIfPossible (line, "stride", sx, sy);
+        LOGDEBUG << "Adding avg. pooling layer to receptive field (" << kx << "," << ky << "s" << sx << "," << sy << ")";
+        receptive_field_x_ += factorx * ((int)kx - 1);
+        receptive_field_y_ += factory * ((int)ky - 1);
+        factorx *= sx;
+        factory *= sy;
+      }
+
+      if (StartsWithIdentifier (line, "globalavgpooling")) {
+        // The region is whatever is left of the input, so the receptive
+        //  field is the patch itself
+        LOGDEBUG << "Global avg. pooling layer does not change the receptive field";
+        stitch_capable = false;
+      }
+
+      if (StartsWithIdentifier (line, "upscale")) {
+        stitch_capable = false;
+      }
     }
   }
   
@@ -143,6 +239,15 @@ ConfigurableFactory::ConfigurableFactory (std::istream& file, const unsigned int
 
   patch_field_x_ = receptive_field_x_ + factorx;
   patch_field_y_ = receptive_field_y_ + factory;
+
+  if (method_ == FCN && (stitch_requested || (patch_trained && !explicit_upscaling))) {
+    if (stitch_capable) {
+      shift_and_stitch_ = true;
+      LOGDEBUG << "Using shift-and-stitch for dense predictions";
+    } else if (stitch_requested) {
+      LOGWARN << "Shift-and-stitch does not support transposed convolutions, upscaling or global pooling!";
+    }
+  }
 }
 
 Layer* ConfigurableFactory::CreateLossLayer (const unsigned int output_classes, const datum loss_weight) {
@@ -164,7 +269,20 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 
 	bool already_upscaled = (factorx == 1) && (factory == 1);
 
-  if (method_ == FCN && (receptive_field_x_ > 0) && (receptive_field_y_ > 0)) {
+  // Factors of the shifts that still need to be stitched together
+  std::vector<std::pair<unsigned int, unsigned int>> shifts;
+
+  if (method_ == FCN && shift_and_stitch_) {
+    // Output pixel (x,y) is the patch centered on (x,y). The shifts
+    //  need factor - 1 additional pixels.
+		ResizeLayer* rl = new ResizeLayer(patch_field_x_ - 1, patch_field_y_ - 1, patch_field_x_ / 2, patch_field_y_ / 2);
+		NetGraphNode* node = new NetGraphNode(rl, last_connection);
+		net.AddNode(node);
+
+		last_connection.node = node;
+		last_connection.buffer = 0;
+		last_connection.backprop = false;
+  } else if (method_ == FCN && (receptive_field_x_ > 0) && (receptive_field_y_ > 0)) {
 		ResizeLayer* rl = new ResizeLayer(receptive_field_x_, receptive_field_y_);
 		NetGraphNode* node = new NetGraphNode(rl, last_connection);
 		net.AddNode(node);
@@ -257,6 +375,9 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         ParseDatumParamIfPossible (line, "llr", llr);
         LOGDEBUG << "Parsed dropout fraction: " << dropout_fraction;
 
+        if (!already_upscaled)
+          AddShiftLayer (net, last_connection, stridex, stridey, shifts);
+
         ConvolutionLayer* cl = new ConvolutionLayer (kx, ky, k, stridex, stridey, padx, pady, group, rand(), dropout_fraction);
 				cl->SetLocalLearningRate (llr);
 
@@ -267,6 +388,37 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 				last_connection.backprop = true;
       }
       
+      if (StartsWithIdentifier (line, "transposedconvolutional")) {
+        unsigned int kx = 1, ky = 1, k = 1, stridex = 1, stridey = 1, padx = 0, pady = 0;
+        datum llr = 1;
+        std::string init;
+        ParseKernelSizeIfPossible (line, "size", kx, ky);
+        ParseKernelSizeIfPossible (line, "stride", stridex, stridey);
+        ParseKernelSizeIfPossible (line, "pad", padx, pady);
+        ParseCountIfPossible (line, "kernels", k);
+        ParseDatumParamIfPossible (line, "llr", llr);
+        ParseStringParamIfPossible (line, "init", init);
+
+        TransposedConvolutionLayer* tcl = new TransposedConvolutionLayer (kx, ky, k, stridex, stridey, padx, pady, rand(),
+            init.compare ("bilinear") == 0);
+        tcl->SetLocalLearningRate (llr);
+
+        NetGraphNode* node = new NetGraphNode(tcl, last_connection);
+        net.AddNode(node);
+        last_connection.buffer = 0;
+        last_connection.node = node;
+        last_connection.backprop = true;
+      }
+      
+      if (StartsWithIdentifier (line, "batchnorm")) {
+        BatchNormalizationLayer* bn = new BatchNormalizationLayer(line);
+        NetGraphNode* node = new NetGraphNode(bn, last_connection);
+        net.AddNode(node);
+        last_connection.buffer = 0;
+        last_connection.node = node;
+        last_connection.backprop = true;
+      }
+
       if (StartsWithIdentifier (line, "lrn")) {
         LocalResponseNormalizationLayer::NormalizationMethod normalization_method;
         std::string method_string;
@@ -297,6 +449,9 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         unsigned int kx = 1, ky = 1;
         ParseKernelSizeIfPossible (line, "size", kx, ky);
 
+        if (!already_upscaled)
+          AddShiftLayer (net, last_connection, kx, ky, shifts);
+
         MaxPoolingLayer* mp = new MaxPoolingLayer (kx, ky);
 
 				NetGraphNode* node = new NetGraphNode(mp, last_connection);
@@ -310,6 +465,9 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         unsigned int kx = 1, ky = 1;
         ParseKernelSizeIfPossible (line, "size", kx, ky);
 
+        if (!already_upscaled)
+          AddShiftLayer (net, last_connection, kx, ky, shifts);
+
         InputDownSamplingLayer* mp = new InputDownSamplingLayer (kx, ky);
 
         NetGraphNode* node = new NetGraphNode(mp, last_connection);
@@ -325,6 +483,9 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         sx = kx; sy = ky;
         ParseKernelSizeIfPossible (line, "stride", sx, sy);
 
+        if (!already_upscaled)
+          AddShiftLayer (net, last_connection, sx, sy, shifts);
+
         AdvancedMaxPoolingLayer* mp = new AdvancedMaxPoolingLayer (kx, ky, sx, sy);
 
         NetGraphNode* node = new NetGraphNode(mp, last_connection);
@@ -334,8 +495,37 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         last_connection.backprop = true;
       }
 
+      if (StartsWithIdentifier (line, "avgpooling")) {
+        unsigned int kx = 1, ky = 1, sx, sy;
+        ParseKernelSizeIfPossible (line, "size", kx, ky);
+        sx = kx; sy = ky;
+        ParseKernelSizeIfPossible (line, "stride", sx, sy);
+
+        if (!already_upscaled)
+          AddShiftLayer (net, last_connection, sx, sy, shifts);
+
+        AveragePoolingLayer* ap = new AveragePoolingLayer (kx, ky, sx, sy);
+
+        NetGraphNode* node = new NetGraphNode(ap, last_connection);
+        net.AddNode(node);
+        last_connection.buffer = 0;
+        last_connection.node = node;
+        last_connection.backprop = true;
+      }
+
+      if (StartsWithIdentifier (line, "globalavgpooling")) {
+        GlobalAveragePoolingLayer* ap = new GlobalAveragePoolingLayer();
+
+        NetGraphNode* node = new NetGraphNode(ap, last_connection);
+        net.AddNode(node);
+        last_connection.buffer = 0;
+        last_connection.node = node;
+        last_connection.backprop = true;
+      }
+
       if (StartsWithIdentifier (line, "sigm")) {
         SigmoidLayer* l = new SigmoidLayer();
+        l->SetActivationMode (NonLinearityLayer::ParseActivationMode (line, activation_mode_));
 				NetGraphNode* node = new NetGraphNode(l, last_connection);
 				node->is_output = is_output && (method_ == PATCH || already_upscaled);
 				net.AddNode(node);
@@ -371,6 +561,7 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 
       if (StartsWithIdentifier (line, "tanh")) {
         TanhLayer* l = new TanhLayer();
+        l->SetActivationMode (NonLinearityLayer::ParseActivationMode (line, activation_mode_));
 				NetGraphNode* node = new NetGraphNode(l, last_connection);
 				node->is_output = is_output && (method_ == PATCH || already_upscaled);
 				net.AddNode(node);
@@ -380,8 +571,12 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
       }
 
       if (StartsWithIdentifier (line, "spatialprior")) {
-				if (!already_upscaled && method_ == FCN) {
-					UpscaleLayer* l = new UpscaleLayer(factorx, factory);
+				if (!already_upscaled && method_ == FCN && shift_and_stitch_ && !shifts.empty()) {
+					AddStitchLayers(net, last_connection, shifts);
+					LOGDEBUG << "Stitched shifts for FCN (spatial prior)";
+					already_upscaled = true;
+				} else if (!already_upscaled && method_ == FCN) {
+					UpscaleLayer* l = new UpscaleLayer(factorx, factory, upscale_method_);
 					NetGraphNode* node = new NetGraphNode(l, last_connection);
 					net.AddNode(node);
 					last_connection.buffer = 0;
@@ -451,9 +646,11 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
       if (StartsWithIdentifier(line, "upscale")){
         unsigned int ufx = 1, ufy = 1;
         unsigned int o = 0;
+        std::string upscaling;
         ParseKernelSizeIfPossible(line, "factor", ufx, ufy);
         ParseCountIfPossible(line, "is_output", o);
-        UpscaleLayer* l = new UpscaleLayer(ufx, ufy);
+        ParseStringParamIfPossible(line, "method", upscaling);
+        UpscaleLayer* l = new UpscaleLayer(ufx, ufy, upscaling.compare(0, 8, "bilinear") == 0 ? UPSCALE_BILINEAR : upscale_method_);
         NetGraphNode* node = new NetGraphNode(l, last_connection);
         node->is_output = (o == 1);
         net.AddNode(node);
@@ -464,10 +661,23 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         already_upscaled = true;
       }
 
-			if (is_output && !already_upscaled && method_ == FCN && (factorx != 1 || factory != 1)) {
-				UpscaleLayer* l = new UpscaleLayer(factorx, factory);
+			bool fused_upscaling = false;
+			NetGraphConnection fused_connection;
+			if (is_output && !already_upscaled && method_ == FCN && shift_and_stitch_ && !shifts.empty()) {
+				AddStitchLayers(net, last_connection, shifts, true);
+				LOGDEBUG << "Stitched shifts for FCN";
+			} else if (is_output && !already_upscaled && method_ == FCN && (factorx != 1 || factory != 1)) {
+				UpscaleLayer* l = new UpscaleLayer(factorx, factory, upscale_method_);
 				NetGraphNode* node = new NetGraphNode(l, last_connection);
 				node->is_output = true;
+
+				if (add_loss_layer && fuse_upscaling_loss_) {
+					// The loss layer computes the gradient of the small output itself
+					fused_upscaling = true;
+					fused_connection = last_connection;
+					node->input_connections[0].backprop = false;
+				}
+
 				net.AddNode(node);
 				last_connection.buffer = 0;
 				last_connection.node = node;
@@ -486,9 +696,11 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 				NetGraphConnection weight_connection = data_layer_connection;
 				weight_connection.buffer = 3;
 
-				Layer* loss_layer = CreateLossLayer(output_classes, loss_weight);
+				Layer* loss_layer = fused_upscaling ?
+					new UpsamplingErrorLayer(factorx, factory, upscale_method_, loss_weight) :
+					CreateLossLayer(output_classes, loss_weight);
 				NetGraphNode* node = new NetGraphNode(loss_layer);
-				node->input_connections.push_back(NetGraphConnection(output_node));
+				node->input_connections.push_back(fused_upscaling ? fused_connection : NetGraphConnection(output_node));
 				node->input_connections.push_back(label_connection);
 				node->input_connections.push_back(weight_connection);
 
@@ -501,6 +713,35 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 	return net.IsComplete();
 }
 
+void ConfigurableFactory::AddShiftLayer(NetGraph& net, NetGraphConnection& last_connection, unsigned int factor_x, unsigned int factor_y, std::vector<std::pair<unsigned int, unsigned int>>& shifts) {
+  if (method_ != FCN || !shift_and_stitch_ || (factor_x == 1 && factor_y == 1))
+    return;
+
+  ShiftLayer* l = new ShiftLayer(factor_x, factor_y);
+  NetGraphNode* node = new NetGraphNode(l, last_connection);
+  net.AddNode(node);
+  last_connection.buffer = 0;
+  last_connection.node = node;
+  last_connection.backprop = true;
+
+  shifts.push_back(std::make_pair(factor_x, factor_y));
+}
+
+void ConfigurableFactory::AddStitchLayers(NetGraph& net, NetGraphConnection& last_connection, std::vector<std::pair<unsigned int, unsigned int>>& shifts, bool is_output) {
+  // The last shift is the innermost, so it is stitched first
+  while (!shifts.empty()) {
+    StitchLayer* l = new StitchLayer(shifts.back().first, shifts.back().second);
+    NetGraphNode* node = new NetGraphNode(l, last_connection);
+    node->is_output = is_output && shifts.size() == 1;
+    net.AddNode(node);
+    last_connection.buffer = 0;
+    last_connection.node = node;
+    last_connection.backprop = true;
+
+    shifts.pop_back();
+  }
+}
+
 void ConfigurableFactory::InitOptimalSettings() {
   file_.clear();
   file_.seekg (0, std::ios::beg);
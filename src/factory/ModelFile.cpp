@@ -0,0 +1,296 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include "Log.h"
+#include "NetGraphNode.h"
+
+#include "ModelFile.h"
+
+namespace Conv {
+
+static const char MODEL_MAGIC[8] = {'C', 'N', '2', '4', 'M', 'O', 'D', 'L'};
+static const uint64_t MODEL_VERSION = 1;
+static const uint64_t MODEL_ALIGNMENT = 64;
+
+static void WriteNumber(std::ostream& output, const uint64_t value) {
+  output.write((const char*)&value, sizeof(uint64_t) / sizeof(char));
+}
+
+static void WriteString(std::ostream& output, const std::string& value) {
+  WriteNumber(output, value.length());
+  output.write(value.c_str(), value.length());
+}
+
+static std::string ReadConfiguration(std::istream& input) {
+  input.clear();
+  input.seekg(0, std::ios::beg);
+  std::stringstream ss;
+  ss << input.rdbuf();
+  return ss.str();
+}
+
+ModelFile::~ModelFile() {
+  Close();
+}
+
+bool ModelFile::Write(const std::string& filename, std::istream& net_config,
+                      std::istream& dataset_config, NetGraph& graph) {
+  const std::string net_config_text = ReadConfiguration(net_config);
+  const std::string dataset_config_text = ReadConfiguration(dataset_config);
+
+  // The header comes first, so its size tells us where the blobs start
+  std::vector<Blob> blobs;
+  std::vector<Tensor*> tensors;
+  uint64_t position = sizeof(MODEL_MAGIC) + 4 * sizeof(uint64_t) + net_config_text.length() + dataset_config_text.length();
+  for (NetGraphNode* node : graph.GetNodes()) {
+    for (unsigned int p = 0; p < node->layer->parameters().size(); p++) {
+      Tensor& tensor = node->layer->parameters()[p]->data;
+      blobs.push_back({node->unique_name, p, tensor.samples(), tensor.width(), tensor.height(), tensor.maps(), 0});
+      tensors.push_back(&tensor);
+      position += 7 * sizeof(uint64_t) + node->unique_name.length();
+    }
+  }
+  for (Blob& blob : blobs) {
+    blob.offset = ((position + MODEL_ALIGNMENT - 1) / MODEL_ALIGNMENT) * MODEL_ALIGNMENT;
+    position = blob.offset + blob.samples * blob.width * blob.height * blob.maps * sizeof(datum);
+  }
+
+  // Processes may have mapped the old file, it must not change under them
+  const std::string temporary_filename = filename + ".tmp";
+  std::ofstream output(temporary_filename, std::ios::out | std::ios::binary);
+  if (!output.good()) {
+    LOGERROR << "Cannot open " << temporary_filename;
+    return false;
+  }
+
+  output.write(MODEL_MAGIC, sizeof(MODEL_MAGIC));
+  WriteNumber(output, MODEL_VERSION);
+  WriteString(output, net_config_text);
+  WriteString(output, dataset_config_text);
+  WriteNumber(output, blobs.size());
+  for (const Blob& blob : blobs) {
+    WriteString(output, blob.node);
+    WriteNumber(output, blob.parameter);
+    WriteNumber(output, blob.samples);
+    WriteNumber(output, blob.width);
+    WriteNumber(output, blob.height);
+    WriteNumber(output, blob.maps);
+    WriteNumber(output, blob.offset);
+  }
+
+  const char padding[MODEL_ALIGNMENT] = {0};
+  for (unsigned int b = 0; b < blobs.size(); b++) {
+    output.write(padding, blobs[b].offset - (uint64_t)output.tellp());
+#ifdef BUILD_OPENCL
+    tensors[b]->MoveToCPU();
+#endif
+    if (!tensors[b]->IsContiguous()) {
+      LOGERROR << "Parameters of node " << blobs[b].node << " are not contiguous!";
+      return false;
+    }
+    output.write((const char*)tensors[b]->data_ptr_const(), (tensors[b]->elements() * sizeof(datum)) / sizeof(char));
+  }
+
+  output.close();
+  if (output.fail()) {
+    LOGERROR << "Cannot write " << temporary_filename;
+    return false;
+  }
+  if (std::rename(temporary_filename.c_str(), filename.c_str()) != 0) {
+    LOGERROR << "Cannot rename " << temporary_filename << " to " << filename;
+    return false;
+  }
+
+  LOGDEBUG << "Written " << blobs.size() << " parameter tensors to " << filename;
+  return true;
+}
+
+bool ModelFile::IsModelFile(const std::string& filename) {
+  std::ifstream input(filename, std::ios::in | std::ios::binary);
+  char magic[sizeof(MODEL_MAGIC)];
+  input.read(magic, sizeof(magic));
+  return input.good() && std::memcmp(magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0;
+}
+
+bool ModelFile::Open(const std::string& filename) {
+  Close();
+
+#ifdef BUILD_POSIX
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOGERROR << "Cannot open " << filename << ": " << errno;
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    LOGERROR << "Cannot determine the size of " << filename;
+    close(fd);
+    return false;
+  }
+  size_ = file_stat.st_size;
+
+  // Private writable pages are shared until someone changes a parameter
+  void* mapping = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    LOGERROR << "Memory map failed: " << errno;
+    size_ = 0;
+    return false;
+  }
+  contents_ = (char*)mapping;
+#else
+  std::ifstream input(filename, std::ios::in | std::ios::binary);
+  if (!input.good()) {
+    LOGERROR << "Cannot open " << filename;
+    return false;
+  }
+  input.seekg(0, std::ios::end);
+  size_ = input.tellg();
+  input.seekg(0, std::ios::beg);
+
+  // Allocated as datums to keep the blobs aligned
+  contents_ = (char*)new datum[(size_ + sizeof(datum) - 1) / sizeof(datum)];
+  input.read(contents_, size_);
+  if (!input.good()) {
+    LOGERROR << "Cannot read " << filename;
+    Close();
+    return false;
+  }
+#endif
+
+  std::size_t position = 0;
+  auto read_number = [&](uint64_t& value) -> bool {
+    if (position + sizeof(uint64_t) > size_)
+      return false;
+    std::memcpy(&value, contents_ + position, sizeof(uint64_t));
+    position += sizeof(uint64_t);
+    return true;
+  };
+  auto read_string = [&](std::string& value) -> bool {
+    uint64_t length = 0;
+    if (!read_number(length) || length > size_ - position)
+      return false;
+    value.assign(contents_ + position, length);
+    position += length;
+    return true;
+  };
+
+  uint64_t version = 0, blob_count = 0;
+  std::string net_config_text, dataset_config_text;
+  if (size_ < sizeof(MODEL_MAGIC) || std::memcmp(contents_, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0) {
+    LOGERROR << filename << " is not a model file!";
+    Close();
+    return false;
+  }
+  position = sizeof(MODEL_MAGIC);
+  if (!read_number(version) || version != MODEL_VERSION) {
+    LOGERROR << "Unsupported model file version " << version;
+    Close();
+    return false;
+  }
+
+  bool valid = read_string(net_config_text) && read_string(dataset_config_text) && read_number(blob_count);
+  for (uint64_t b = 0; valid && b < blob_count; b++) {
+    Blob blob = Blob();
+    valid = read_string(blob.node) && read_number(blob.parameter) && read_number(blob.samples) &&
+      read_number(blob.width) && read_number(blob.height) && read_number(blob.maps) && read_number(blob.offset);
+    const uint64_t bytes = blob.samples * blob.width * blob.height * blob.maps * sizeof(datum);
+    if (valid && (blob.offset % MODEL_ALIGNMENT != 0 || blob.offset > size_ || bytes > size_ - blob.offset)) {
+      LOGERROR << "Parameters of node " << blob.node << " are outside of the file!";
+      valid = false;
+    }
+    blobs_.push_back(blob);
+  }
+  if (!valid) {
+    LOGERROR << "Model file " << filename << " is damaged!";
+    Close();
+    return false;
+  }
+
+  net_config_.str(net_config_text);
+  dataset_config_.str(dataset_config_text);
+  LOGDEBUG << "Opened " << filename << " with " << blobs_.size() << " parameter tensors";
+  return true;
+}
+
+bool ModelFile::MapParameters(NetGraph& graph) {
+  if (contents_ == nullptr) {
+    LOGERROR << "No model file opened!";
+    return false;
+  }
+
+  // Every parameter set has to match before any of them is mapped
+  std::vector<const Blob*> matches;
+  for (NetGraphNode* node : graph.GetNodes()) {
+    for (unsigned int p = 0; p < node->layer->parameters().size(); p++) {
+      const Tensor& tensor = node->layer->parameters()[p]->data;
+      const Blob* match = nullptr;
+      for (const Blob& blob : blobs_) {
+        if (blob.node.compare(node->unique_name) == 0 && blob.parameter == p) {
+          match = &blob;
+          break;
+        }
+      }
+
+      if (match == nullptr) {
+        LOGERROR << "Model file has no parameter set " << p << " for node " << node->unique_name;
+        return false;
+      }
+      if (match->samples != tensor.samples() || match->width != tensor.width() ||
+          match->height != tensor.height() || match->maps != tensor.maps()) {
+        LOGERROR << "Parameter set " << p << " of node " << node->unique_name << " has a different size: " << tensor;
+        return false;
+      }
+      matches.push_back(match);
+    }
+  }
+
+  unsigned int mapped = 0;
+  for (NetGraphNode* node : graph.GetNodes()) {
+    for (unsigned int p = 0; p < node->layer->parameters().size(); p++) {
+      Tensor& tensor = node->layer->parameters()[p]->data;
+      const Blob* match = matches[mapped];
+      datum* const memory = (datum*)(contents_ + match->offset);
+      if (!tensor.Wrap(memory, match->samples, match->width, match->height, match->maps)) {
+        // Fall back to a copy
+        std::memcpy(tensor.data_ptr(), memory, tensor.elements() * sizeof(datum));
+      }
+      LOGDEBUG << "Mapped parameters for node " << node->unique_name << " parameter set " << p << ": " << tensor;
+      mapped++;
+    }
+  }
+
+  LOGINFO << "Mapped " << mapped << " parameter tensors";
+  return true;
+}
+
+void ModelFile::Close() {
+  if (contents_ != nullptr) {
+#ifdef BUILD_POSIX
+    munmap(contents_, size_);
+#else
+    delete[] (datum*)contents_;
+#endif
+  }
+  contents_ = nullptr;
+  size_ = 0;
+  blobs_.clear();
+}
+
+}
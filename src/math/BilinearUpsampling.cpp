@@ -0,0 +1,127 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
+
+#include "BilinearUpsampling.h"
+
+namespace Conv {
+
+/*
+ * Maps the target pixel centers onto the source axis
+ */
+static void CalculateCoefficients(const unsigned int source_size, const unsigned int factor,
+                                  std::vector<unsigned int>& first, std::vector<unsigned int>& second,
+                                  std::vector<datum>& weight) {
+  const unsigned int target_size = source_size * factor;
+  first.resize(target_size);
+  second.resize(target_size);
+  weight.resize(target_size);
+
+  for(unsigned int t = 0; t < target_size; t++) {
+    const double position = ((double)t + 0.5) / (double)factor - 0.5;
+    if(position <= 0) {
+      first[t] = 0;
+      second[t] = 0;
+      weight[t] = 0;
+    } else {
+      first[t] = std::min((unsigned int)std::floor(position), source_size - 1);
+      second[t] = std::min(first[t] + 1, source_size - 1);
+      weight[t] = first[t] == second[t] ? 0 : (datum)(position - (double)first[t]);
+    }
+  }
+}
+
+/*
+ * Computes a + w * (b - a) for a row
+ */
+static inline void BlendRows(const datum* a, const datum* b, const datum w,
+                             datum* target, const unsigned int width) {
+  unsigned int x = 0;
+#ifdef __SSE2__
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 upsampling needs float datum");
+  const __m128 w4 = _mm_set1_ps(w);
+  for(; x + 4 <= width; x += 4) {
+    const __m128 a4 = _mm_loadu_ps(&a[x]);
+    _mm_storeu_ps(&target[x], _mm_add_ps(a4, _mm_mul_ps(w4, _mm_sub_ps(_mm_loadu_ps(&b[x]), a4))));
+  }
+#endif
+  for(; x < width; x++)
+    target[x] = a[x] + w * (b[x] - a[x]);
+}
+
+/*
+ * Adds w times a row to another
+ */
+static inline void AddScaledRow(const datum* source, const datum w,
+                                datum* target, const unsigned int width) {
+  unsigned int x = 0;
+#ifdef __SSE2__
+  const __m128 w4 = _mm_set1_ps(w);
+  for(; x + 4 <= width; x += 4)
+    _mm_storeu_ps(&target[x], _mm_add_ps(_mm_loadu_ps(&target[x]), _mm_mul_ps(w4, _mm_loadu_ps(&source[x]))));
+#endif
+  for(; x < width; x++)
+    target[x] += w * source[x];
+}
+
+BilinearUpsampling::BilinearUpsampling(const unsigned int source_width, const unsigned int source_height,
+                                       const unsigned int factor_x, const unsigned int factor_y) :
+  source_width_(source_width), source_height_(source_height) {
+  CalculateCoefficients(source_width, factor_x, x0_, x1_, ax_);
+  CalculateCoefficients(source_height, factor_y, y0_, y1_, ay_);
+}
+
+void BilinearUpsampling::UpsampleRow(const datum* source_map, const unsigned int y,
+                                     datum* target_row, datum* buffer) const {
+  // Interpolate vertically first, then pick the columns
+  BlendRows(&source_map[y0_[y] * source_width_], &source_map[y1_[y] * source_width_], ay_[y],
+            buffer, source_width_);
+
+  const unsigned int target_width = x0_.size();
+  for(unsigned int x = 0; x < target_width; x++) {
+    const datum left = buffer[x0_[x]];
+    target_row[x] = left + ax_[x] * (buffer[x1_[x]] - left);
+  }
+}
+
+void BilinearUpsampling::BackpropagateRow(const datum* target_row_delta, const unsigned int y,
+                                          datum* source_map_delta, datum* buffer) const {
+  std::fill(buffer, buffer + source_width_, 0);
+
+  const unsigned int target_width = x0_.size();
+  for(unsigned int x = 0; x < target_width; x++) {
+    const datum delta = target_row_delta[x];
+    buffer[x0_[x]] += delta - ax_[x] * delta;
+    buffer[x1_[x]] += ax_[x] * delta;
+  }
+
+  AddScaledRow(buffer, 1 - ay_[y], &source_map_delta[y0_[y] * source_width_], source_width_);
+  AddScaledRow(buffer, ay_[y], &source_map_delta[y1_[y] * source_width_], source_width_);
+}
+
+void BilinearUpsampling::UpsampleMap(const datum* source_map, datum* target_map, datum* buffer) const {
+  const unsigned int target_width = x0_.size();
+  const unsigned int target_height = y0_.size();
+  for(unsigned int y = 0; y < target_height; y++)
+    UpsampleRow(source_map, y, &target_map[y * target_width], buffer);
+}
+
+void BilinearUpsampling::BackpropagateMap(const datum* target_map_delta, datum* source_map_delta,
+                                          datum* buffer) const {
+  const unsigned int target_width = x0_.size();
+  const unsigned int target_height = y0_.size();
+  std::fill(source_map_delta, source_map_delta + source_width_ * source_height_, 0);
+  for(unsigned int y = 0; y < target_height; y++)
+    BackpropagateRow(&target_map_delta[y * target_width], y, source_map_delta, buffer);
+}
+
+}
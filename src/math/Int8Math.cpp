@@ -0,0 +1,124 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "Int8Math.h"
+
+namespace Conv {
+
+// Rows of A that share the loads of a row of B
+static const int ROW_BLOCK = 4;
+
+/*
+ * Dot products of up to ROW_BLOCK rows of A with one row of B
+ */
+#if defined(__AVX2__)
+static inline int32_t HorizontalSum(const __m256i value) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+static inline void DotProducts(const int8_t* A, const int rows, const int K, const uint8_t* b, int32_t* results) {
+  __m256i accumulators[ROW_BLOCK];
+  for(int r = 0; r < rows; r++)
+    accumulators[r] = _mm256_setzero_si256();
+#if !(defined(__AVX512VNNI__) && defined(__AVX512VL__))
+  const __m256i ones = _mm256_set1_epi16(1);
+#endif
+
+  for(int k = 0; k < K; k += 32) {
+    const __m256i inputs = _mm256_loadu_si256((const __m256i*)(b + k));
+    for(int r = 0; r < rows; r++) {
+      const __m256i weights = _mm256_loadu_si256((const __m256i*)(A + (std::size_t)r * K + k));
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+      accumulators[r] = _mm256_dpbusd_epi32(accumulators[r], inputs, weights);
+#else
+      // Pairs of u8 * s8 products, at most 2 * 127 * 127 so no saturation
+      const __m256i pairs = _mm256_maddubs_epi16(inputs, weights);
+      accumulators[r] = _mm256_add_epi32(accumulators[r], _mm256_madd_epi16(pairs, ones));
+#endif
+    }
+  }
+
+  for(int r = 0; r < rows; r++)
+    results[r] = HorizontalSum(accumulators[r]);
+}
+#elif defined(__SSE2__)
+static inline int32_t HorizontalSum(const __m128i value) {
+  __m128i sum = _mm_add_epi32(value, _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+static inline void DotProducts(const int8_t* A, const int rows, const int K, const uint8_t* b, int32_t* results) {
+  __m128i accumulators[ROW_BLOCK];
+  for(int r = 0; r < rows; r++)
+    accumulators[r] = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+
+  for(int k = 0; k < K; k += 16) {
+    // Widen to 16 bits: inputs with zeros, weights with their sign
+    const __m128i inputs = _mm_loadu_si128((const __m128i*)(b + k));
+    const __m128i inputs_low = _mm_unpacklo_epi8(inputs, zero);
+    const __m128i inputs_high = _mm_unpackhi_epi8(inputs, zero);
+    for(int r = 0; r < rows; r++) {
+      const __m128i weights = _mm_loadu_si128((const __m128i*)(A + (std::size_t)r * K + k));
+      const __m128i sign = _mm_cmpgt_epi8(zero, weights);
+      const __m128i weights_low = _mm_unpacklo_epi8(weights, sign);
+      const __m128i weights_high = _mm_unpackhi_epi8(weights, sign);
+      accumulators[r] = _mm_add_epi32(accumulators[r], _mm_madd_epi16(inputs_low, weights_low));
+      accumulators[r] = _mm_add_epi32(accumulators[r], _mm_madd_epi16(inputs_high, weights_high));
+    }
+  }
+
+  for(int r = 0; r < rows; r++)
+    results[r] = HorizontalSum(accumulators[r]);
+}
+#else
+static inline void DotProducts(const int8_t* A, const int rows, const int K, const uint8_t* b, int32_t* results) {
+  for(int r = 0; r < rows; r++) {
+    const int8_t* a = A + (std::size_t)r * K;
+    int32_t sum = 0;
+    for(int k = 0; k < K; k++)
+      sum += (int32_t)a[k] * (int32_t)b[k];
+    results[r] = sum;
+  }
+}
+#endif
+
+void Int8Math::GEMM(const int M, const int N, const int K, const int8_t* A, const uint8_t* B,
+                    int32_t* C, const int ldC) {
+#pragma omp parallel for default(shared)
+  for(int n = 0; n < N; n++) {
+    const uint8_t* b = B + (std::size_t)n * K;
+    int32_t results[ROW_BLOCK];
+    for(int m = 0; m < M; m += ROW_BLOCK) {
+      const int rows = M - m < ROW_BLOCK ? M - m : ROW_BLOCK;
+      DotProducts(A + (std::size_t)m * K, rows, K, b, results);
+      for(int r = 0; r < rows; r++)
+        C[(std::size_t)(m + r) * ldC + n] = results[r];
+    }
+  }
+}
+
+const char* Int8Math::GetImplementation() {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+  return "AVX-512 VNNI";
+#elif defined(__AVX2__)
+  return "AVX2";
+#elif defined(__SSE2__)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+
+}
@@ -9,10 +9,30 @@
 #include "CLHelper.h"
 
 #include <cstring>
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
 
 #include "TensorMath.h"
 
 namespace Conv {
+
+/*
+ * Adds two arrays, target may be one of the sources
+ */
+static inline void AddArrays(const datum* source_a, const datum* source_b, datum* target, const std::size_t elements) {
+  std::size_t element = 0;
+#ifdef __SSE2__
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 addition needs float datum");
+  for(; element + 4 <= elements; element += 4)
+    _mm_storeu_ps(&target[element], _mm_add_ps(_mm_loadu_ps(&source_a[element]), _mm_loadu_ps(&source_b[element])));
+#endif
+  for(; element < elements; element++)
+    target[element] = source_a[element] + source_b[element];
+}
   
 void TensorMath::GEMM(const bool is_row_major, const bool transpose_A, const bool transpose_B, const int M, const int N, const int K, const datum alpha, const Conv::Tensor &A, const int smA, const int ldA, const Conv::Tensor &B, const int smB, const int ldB, const datum beta, Conv::Tensor &C, const int smC, const int ldC)
 {
@@ -221,14 +241,25 @@ void TensorMath::IM2COL(const Tensor& source, const int source_width, const int
       FATAL("Target size wrong!");
     
     
+    const bool convert = source.storage() != STORAGE_FLOAT32;
+    
     #pragma omp parallel for default(shared)
     for(int sample = 0; sample < samples; sample++) {
-      const datum* source_ptr = source.data_ptr_const(0, 0, 0, sample);
+      // 16-bit sources are converted one map at a time
+      std::vector<datum> converted_map(convert ? source_width * source_height : 0);
       for(int target_map = 0; target_map < target_maps; target_map++) {
         datum* target_ptr = target.data_ptr(0, 0, 0, target_map); 
         int kx = target_map % kernel_width;
         int ky = (target_map / kernel_width) % kernel_height;
         int imap = target_map / (kernel_width * kernel_height);
+        const datum* source_ptr;
+        if(convert) {
+          if(target_map % (kernel_width * kernel_height) == 0)
+            source.UnpackElements(source.Offset(0, 0, imap, sample), source_width * source_height, converted_map.data());
+          source_ptr = converted_map.data();
+        } else {
+          source_ptr = source.data_ptr_const(0, 0, imap, sample);
+        }
         for(int oy = 0; oy < target_height; oy++) {
           int iy = oy * stride_height - pad_height + ky;
           if(iy >= 0 && iy < source_height) {
@@ -236,7 +267,7 @@ void TensorMath::IM2COL(const Tensor& source, const int source_width, const int
               int ix = ox * stride_width - pad_width + kx;
               if(ix >= 0 && ix < source_width) {
                 target_ptr[(sample * target_height + oy) * target_width + ox] =
-                  source_ptr[(imap * source_height + iy) * source_width + ix];
+                  source_ptr[iy * source_width + ix];
               } else {
                 target_ptr[(sample * target_height + oy) * target_width + ox] = 0;
               }
@@ -308,7 +339,11 @@ void TensorMath::COL2IM(Tensor& source, const int source_width, const int source
     ((Tensor&)target).MoveToCPU();
     source.MoveToCPU(true);
 #endif    
-    SETSAMPLE(source, -1, 0.0);
+    // 16-bit targets are summed up one map at a time and converted
+    const bool convert = source.storage() != STORAGE_FLOAT32;
+    std::vector<datum> converted_map(convert ? source_width * source_height : 0);
+    if(!convert)
+      SETSAMPLE(source, -1, 0.0);
     
     const int target_width = (2 * pad_width + source_width - kernel_width) / stride_width + 1;
     const int target_height = (2 * pad_height + source_height - kernel_height) / stride_height + 1;
@@ -321,24 +356,28 @@ void TensorMath::COL2IM(Tensor& source, const int source_width, const int source
       FATAL("Target size wrong!");
     
     for(int sample = 0; sample < samples; sample++) {
-      datum* source_ptr = source.data_ptr(0, 0, 0, sample);
       for(int target_map = 0; target_map < target_maps; target_map++) {
         const datum* target_ptr = target.data_ptr_const(0, 0, 0, target_map);
         int kx = target_map % kernel_width;
         int ky = (target_map / kernel_width) % kernel_height;
         int imap = target_map / (kernel_width * kernel_height);
+        datum* source_ptr = convert ? converted_map.data() : source.data_ptr(0, 0, imap, sample);
+        if(convert && target_map % (kernel_width * kernel_height) == 0)
+          std::fill(converted_map.begin(), converted_map.end(), 0);
         for(int oy = 0; oy < target_height; oy++) {
           int iy = oy * stride_height - pad_height + ky;
           if(iy >= 0 && iy < source_height) {
             for(int ox = 0; ox < target_width; ox++) {
               int ix = ox * stride_width - pad_width + kx;
-              if(ix >= 0 && iy < source_width) {
-                source_ptr[(imap * source_height + iy) * source_width + ix] +=
+              if(ix >= 0 && ix < source_width) {
+                source_ptr[iy * source_width + ix] +=
                   target_ptr[(sample * target_height + oy) * target_width + ox];
               } 
             }
           }
         }
+        if(convert && (target_map + 1) % (kernel_width * kernel_height) == 0)
+          source.PackElements(source.Offset(0, 0, imap, sample), source_width * source_height, converted_map.data());
       }
     }
   
@@ -434,11 +473,22 @@ void TensorMath::SMS(const Tensor& source, Tensor& target)
     const int height = target.height();
     const int maps = target.maps();
     const int samples = target.samples();
+    
+    // 16-bit tensors are converted while copying
+    const bool convert = source.storage() != STORAGE_FLOAT32 && target.storage() != STORAGE_FLOAT32;
+    std::vector<datum> converted_map(convert ? width * height : 0);
     for(int sample = 0; sample < samples; sample++) {
       for(int map = 0; map < maps; map++) {
-        const datum* src = source.data_ptr_const(0, 0, sample, map);
-        datum* tgt = target.data_ptr(0, 0, map, sample);
-        std::memcpy(tgt, src, sizeof(datum) * width * height);
+        const std::size_t src = source.Offset(0, 0, sample, map);
+        const std::size_t tgt = target.Offset(0, 0, map, sample);
+        if(target.storage() == STORAGE_FLOAT32) {
+          source.UnpackElements(src, width * height, target.data_ptr() + tgt);
+        } else if(!convert) {
+          target.PackElements(tgt, width * height, source.data_ptr_const() + src);
+        } else {
+          source.UnpackElements(src, width * height, converted_map.data());
+          target.PackElements(tgt, width * height, converted_map.data());
+        }
       }
     }
   
@@ -607,13 +657,24 @@ void TensorMath::ADD(const Tensor& source_a, const Tensor& source_b, Tensor& tar
     FATAL("Dimensions don't match!");
   }
   
-  #pragma omp parallel for default(shared)
-  for(unsigned int element = 0; element < source_a.elements(); element++) {
-    const datum* source_a_ptr = &(source_a.data_ptr_const()[element]);
-    const datum* source_b_ptr = &(source_b.data_ptr_const()[element]);
-    datum* target_ptr = &(target.data_ptr()[element]);
-    
-    *target_ptr = *source_a_ptr + *source_b_ptr;
+  if(source_a.IsContiguous() && source_b.IsContiguous() && target.IsContiguous()) {
+    // Split into blocks that are large enough to be worth a thread
+    const std::size_t block_size = 16384;
+    const std::size_t blocks = (source_a.elements() + block_size - 1) / block_size;
+    #pragma omp parallel for default(shared)
+    for(std::size_t block = 0; block < blocks; block++) {
+      const std::size_t first_element = block * block_size;
+      const std::size_t elements = std::min(block_size, source_a.elements() - first_element);
+      AddArrays(source_a.data_ptr_const() + first_element, source_b.data_ptr_const() + first_element,
+                target.data_ptr() + first_element, elements);
+    }
+  } else {
+    // Views have gaps between the samples
+    const std::size_t sample_elements = source_a.elements() / source_a.samples();
+    #pragma omp parallel for default(shared)
+    for(std::size_t sample = 0; sample < source_a.samples(); sample++)
+      AddArrays(source_a.data_ptr_const(0, 0, 0, sample), source_b.data_ptr_const(0, 0, 0, sample),
+                target.data_ptr(0, 0, 0, sample), sample_elements);
   }
   
   target.hint_ignore_content_ = false;
@@ -14,13 +14,135 @@
 */
 
 #include <cmath>
+#include <algorithm>
 
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
 
 #include "CLHelper.h"
 #include "NonLinearityLayer.h"
 
 namespace Conv {
 
+#ifdef __SSE2__
+static_assert(sizeof(datum) == sizeof(float), "SSE2 activation functions need float datum");
+
+/*
+ * Calculates e^x for four floats. The argument is split into n*ln(2) + r
+ *  with |r| <= ln(2)/2, e^r is a degree 7 polynomial and 2^n is put
+ *  into the exponent bits directly. The relative error is below 2 ULP.
+ */
+static inline __m128 ExpPS (__m128 x) {
+  // Clamp so that 2^n stays a normal number
+  x = _mm_min_ps (x, _mm_set1_ps (88.0f));
+  x = _mm_max_ps (x, _mm_set1_ps (-87.0f));
+
+  const __m128i n = _mm_cvtps_epi32 (_mm_mul_ps (x, _mm_set1_ps (1.44269504088896341f)));
+  const __m128 fn = _mm_cvtepi32_ps (n);
+
+  // ln(2) is split in two so that n*ln(2) is exact in the first part
+  __m128 r = _mm_sub_ps (x, _mm_mul_ps (fn, _mm_set1_ps (0.693359375f)));
+  r = _mm_sub_ps (r, _mm_mul_ps (fn, _mm_set1_ps (-2.12194440e-4f)));
+
+  __m128 p = _mm_set1_ps (1.9875691500E-4f);
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (1.3981999507E-3f));
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (8.3334519073E-3f));
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (4.1665795894E-2f));
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (1.6666665459E-1f));
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (5.0000001201E-1f));
+  p = _mm_add_ps (_mm_mul_ps (p, _mm_mul_ps (r, r)), _mm_add_ps (r, _mm_set1_ps (1.0f)));
+
+  const __m128i exponent = _mm_slli_epi32 (_mm_add_epi32 (n, _mm_set1_epi32 (127)), 23);
+  return _mm_mul_ps (p, _mm_castsi128_ps (exponent));
+}
+
+/*
+ * Calculates sigm(x) = 1 / (1 + e^-x) for four floats
+ */
+static inline __m128 SigmoidPS (const __m128 x) {
+  const __m128 one = _mm_set1_ps (1.0f);
+  return _mm_div_ps (one, _mm_add_ps (one, ExpPS (_mm_sub_ps (_mm_setzero_ps(), x))));
+}
+
+/*
+ * Calculates tanh(x) for four floats. 1 - 2 / (e^2x + 1) cancels badly
+ *  near zero, so small arguments use an odd polynomial instead.
+ */
+static inline __m128 TanhPS (const __m128 x) {
+  const __m128 sign_mask = _mm_set1_ps (-0.0f);
+  const __m128 one = _mm_set1_ps (1.0f);
+  const __m128 sign = _mm_and_ps (x, sign_mask);
+  const __m128 abs_x = _mm_andnot_ps (sign_mask, x);
+
+  // |x| < 0.625: x + x^3 * P(x^2)
+  const __m128 z = _mm_mul_ps (x, x);
+  __m128 p = _mm_set1_ps (-5.70498872745E-3f);
+  p = _mm_add_ps (_mm_mul_ps (p, z), _mm_set1_ps (2.06390887954E-2f));
+  p = _mm_add_ps (_mm_mul_ps (p, z), _mm_set1_ps (-5.37397155531E-2f));
+  p = _mm_add_ps (_mm_mul_ps (p, z), _mm_set1_ps (1.33314422036E-1f));
+  p = _mm_add_ps (_mm_mul_ps (p, z), _mm_set1_ps (-3.33332819422E-1f));
+  const __m128 small = _mm_add_ps (x, _mm_mul_ps (_mm_mul_ps (x, z), p));
+
+  // Otherwise, tanh(|x|) is 1 in float precision for |x| > 9
+  const __m128 clamped = _mm_min_ps (abs_x, _mm_set1_ps (9.0f));
+  const __m128 e = ExpPS (_mm_add_ps (clamped, clamped));
+  const __m128 large = _mm_or_ps (sign, _mm_sub_ps (one, _mm_div_ps (_mm_set1_ps (2.0f), _mm_add_ps (e, one))));
+
+  const __m128 use_small = _mm_cmplt_ps (abs_x, _mm_set1_ps (0.625f));
+  return _mm_or_ps (_mm_and_ps (use_small, small), _mm_andnot_ps (use_small, large));
+}
+
+/*
+ * Applies a vectorized function to an array. The remainder goes through
+ *  the same function so that the result does not depend on the position.
+ */
+template <__m128 Function (const __m128)>
+static void ApplyPS (const datum* input, datum* output, const std::size_t elements) {
+  const std::size_t blocks = elements / 4;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t block = 0; block < blocks; block++)
+    _mm_storeu_ps (&output[4 * block], Function (_mm_loadu_ps (&input[4 * block])));
+
+  if (blocks * 4 < elements) {
+    float remainder[4] = {0, 0, 0, 0};
+    std::copy (&input[4 * blocks], &input[elements], remainder);
+    _mm_storeu_ps (remainder, Function (_mm_loadu_ps (remainder)));
+    std::copy (remainder, &remainder[elements - 4 * blocks], &output[4 * blocks]);
+  }
+}
+#endif
+
+/*
+ * Applies an elementwise kernel to buffers of any storage type. Blocks of
+ *  the operands are converted to datums and back, so a 16-bit buffer is
+ *  never expanded as a whole. The second operand is optional.
+ */
+template <typename Kernel>
+static void ApplyConverted (const Tensor& first, const Tensor* second, Tensor& target, Kernel kernel) {
+  const std::size_t BLOCK = 1024;
+  const std::size_t elements = target.elements();
+  const std::size_t blocks = (elements + BLOCK - 1) / BLOCK;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t block = 0; block < blocks; block++) {
+    datum first_block[BLOCK], second_block[BLOCK], target_block[BLOCK];
+    const std::size_t begin = block * BLOCK;
+    const std::size_t count = std::min (BLOCK, elements - begin);
+    first.UnpackElements (begin, count, first_block);
+    if (second != nullptr)
+      second->UnpackElements (begin, count, second_block);
+    kernel (first_block, second_block, target_block, count);
+    target.PackElements (begin, count, target_block);
+  }
+}
+
+static inline bool IsHalfPrecision (const Tensor& tensor) {
+  return tensor.storage() != STORAGE_FLOAT32;
+}
+
 bool SigmoidLayer::IsOpenCLAware() {
 #ifdef BUILD_OPENCL
   return true;
@@ -37,6 +159,22 @@ bool TanhLayer::IsOpenCLAware() {
 #endif
 }
 
+bool SigmoidLayer::IsHalfPrecisionCapable() {
+  return true;
+}
+
+bool TanhLayer::IsHalfPrecisionCapable() {
+  return true;
+}
+
+bool ReLULayer::IsHalfPrecisionCapable() {
+  return true;
+}
+
+bool SoftmaxLayer::IsHalfPrecisionCapable() {
+  return false;
+}
+
 void SigmoidLayer::FeedForward () {
 #ifdef BUILD_OPENCL
   cl_uint error = 0;
@@ -66,6 +204,28 @@ void SigmoidLayer::FeedForward () {
 #endif
 
 #else
+  if (IsHalfPrecision (input_->data) || IsHalfPrecision (output_->data)) {
+    ApplyConverted (input_->data, nullptr, output_->data,
+      [this] (const datum* input, const datum*, datum* output, const std::size_t elements) {
+#ifdef __SSE2__
+      if (mode_ == ACTIVATION_FAST) {
+        ApplyPS<SigmoidPS> (input, output, elements);
+        return;
+      }
+#endif
+      for (std::size_t element = 0; element < elements; element++)
+        output[element] = 1.0 / (1.0 + exp (-input[element]));
+    });
+    return;
+  }
+
+#ifdef __SSE2__
+  if (mode_ == ACTIVATION_FAST) {
+    ApplyPS<SigmoidPS> (input_->data.data_ptr_const(), output_->data.data_ptr(), input_->data.elements());
+    return;
+  }
+#endif
+
 #pragma omp parallel for default(shared)
   for (std::size_t element = 0; element < input_->data.elements(); element++) {
     const datum input_data = input_->data.data_ptr_const() [element];
@@ -111,8 +271,33 @@ void SigmoidLayer::BackPropagate () {
  
   
 #else
+  if (IsHalfPrecision (output_->delta) || IsHalfPrecision (output_->data) || IsHalfPrecision (input_->delta)) {
+    ApplyConverted (output_->delta, &output_->data, input_->delta,
+      [] (const datum* output_delta, const datum* output_data, datum* input_delta, const std::size_t elements) {
+      for (std::size_t element = 0; element < elements; element++)
+        input_delta[element] = output_delta[element] * output_data[element] * (1.0 - output_data[element]);
+    });
+    return;
+  }
+
+  const std::size_t elements = input_->data.elements ();
+  std::size_t remainder_start = 0;
+#ifdef __SSE2__
+  const std::size_t blocks = elements / 4;
+  const __m128 one = _mm_set1_ps (1.0f);
+
 #pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements (); element++) {
+  for (std::size_t block = 0; block < blocks; block++) {
+    const __m128 output_delta = _mm_loadu_ps (&output_->delta.data_ptr_const ()[4 * block]);
+    const __m128 output_data = _mm_loadu_ps (&output_->data.data_ptr_const ()[4 * block]);
+    _mm_storeu_ps (&input_->delta.data_ptr ()[4 * block],
+      _mm_mul_ps (_mm_mul_ps (output_delta, output_data), _mm_sub_ps (one, output_data)));
+  }
+  remainder_start = 4 * blocks;
+#endif
+
+#pragma omp parallel for default(shared)
+  for (std::size_t element = remainder_start; element < elements; element++) {
     const datum output_delta = output_->delta.data_ptr_const ()[element];
     const datum output_data = output_->data.data_ptr_const ()[element];
 
@@ -158,6 +343,28 @@ void TanhLayer::FeedForward () {
 #endif
 
 #else
+  if (IsHalfPrecision (input_->data) || IsHalfPrecision (output_->data)) {
+    ApplyConverted (input_->data, nullptr, output_->data,
+      [this] (const datum* input, const datum*, datum* output, const std::size_t elements) {
+#ifdef __SSE2__
+      if (mode_ == ACTIVATION_FAST) {
+        ApplyPS<TanhPS> (input, output, elements);
+        return;
+      }
+#endif
+      for (std::size_t element = 0; element < elements; element++)
+        output[element] = 1.0 - 2.0 / (exp (2.0 * input[element]) + 1.0);
+    });
+    return;
+  }
+
+#ifdef __SSE2__
+  if (mode_ == ACTIVATION_FAST) {
+    ApplyPS<TanhPS> (input_->data.data_ptr_const(), output_->data.data_ptr(), input_->data.elements());
+    return;
+  }
+#endif
+
 #pragma omp parallel for default(shared)
   for (std::size_t element = 0; element < input_->data.elements(); element++) {
     const datum input_data = input_->data.data_ptr_const() [element];
@@ -202,8 +409,33 @@ void TanhLayer::BackPropagate () {
 
   
 #else
+  if (IsHalfPrecision (output_->delta) || IsHalfPrecision (output_->data) || IsHalfPrecision (input_->delta)) {
+    ApplyConverted (output_->delta, &output_->data, input_->delta,
+      [] (const datum* output_delta, const datum* output_data, datum* input_delta, const std::size_t elements) {
+      for (std::size_t element = 0; element < elements; element++)
+        input_delta[element] = output_delta[element] * (1.0 - output_data[element] * output_data[element]);
+    });
+    return;
+  }
+
+  const std::size_t elements = input_->data.elements ();
+  std::size_t remainder_start = 0;
+#ifdef __SSE2__
+  const std::size_t blocks = elements / 4;
+  const __m128 one = _mm_set1_ps (1.0f);
+
 #pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements (); element++) {
+  for (std::size_t block = 0; block < blocks; block++) {
+    const __m128 output_delta = _mm_loadu_ps (&output_->delta.data_ptr_const ()[4 * block]);
+    const __m128 output_data = _mm_loadu_ps (&output_->data.data_ptr_const ()[4 * block]);
+    _mm_storeu_ps (&input_->delta.data_ptr ()[4 * block],
+      _mm_mul_ps (output_delta, _mm_sub_ps (one, _mm_mul_ps (output_data, output_data))));
+  }
+  remainder_start = 4 * blocks;
+#endif
+
+#pragma omp parallel for default(shared)
+  for (std::size_t element = remainder_start; element < elements; element++) {
     const datum output_delta = output_->delta.data_ptr_const ()[element];
     const datum output_data = output_->data.data_ptr_const ()[element];
 
@@ -218,6 +450,15 @@ void TanhLayer::BackPropagate () {
 }
 
 void ReLULayer::FeedForward () {
+  if (IsHalfPrecision (input_->data) || IsHalfPrecision (output_->data)) {
+    ApplyConverted (input_->data, nullptr, output_->data,
+      [] (const datum* input, const datum*, datum* output, const std::size_t elements) {
+      for (std::size_t element = 0; element < elements; element++)
+        output[element] = input[element] > 0 ? input[element] : 0;
+    });
+    return;
+  }
+
 #pragma omp parallel for default(shared)
   for (std::size_t element = 0; element < input_->data.elements (); element++) {
     const datum input_data = input_->data.data_ptr_const ()[element];
@@ -229,6 +470,15 @@ void ReLULayer::FeedForward () {
 }
 
 void ReLULayer::BackPropagate () {
+  if (IsHalfPrecision (output_->delta) || IsHalfPrecision (input_->data) || IsHalfPrecision (input_->delta)) {
+    ApplyConverted (output_->delta, &input_->data, input_->delta,
+      [] (const datum* output_delta, const datum* input_data, datum* input_delta, const std::size_t elements) {
+      for (std::size_t element = 0; element < elements; element++)
+        input_delta[element] = input_data[element] > 0 ? output_delta[element] : 0;
+    });
+    return;
+  }
+
 #pragma omp parallel for default(shared)
   for (std::size_t element = 0; element < input_->data.elements (); element++) {
     const datum output_delta = output_->delta.data_ptr_const ()[element];
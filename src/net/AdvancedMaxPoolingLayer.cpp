@@ -5,6 +5,13 @@
  * For licensing information, see the LICENSE file included with this project.
  */  
 #include <limits>
+#include <algorithm>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
 
 #include "Log.h"
 #include "CLHelper.h"
@@ -91,8 +98,31 @@ bool AdvancedMaxPoolingLayer::Connect (const CombinedTensor* input,
 
   maps_ = input->data.maps();
 
+#ifdef BUILD_OPENCL_MAX
   maximum_mask_.Resize (input->data.samples(), output_width_,
 			output_height_, maps_);
+#else
+  if ((std::size_t)input_width_ * input_height_ > std::numeric_limits<uint32_t>::max()) {
+    LOGERROR << "Input maps are too large!";
+    return false;
+  }
+  maximum_index_.resize (output->data.elements());
+
+  // Precalculate which outputs an input pixel contributes to
+  ox_start_.resize (input_width_);
+  ox_end_.resize (input_width_);
+  for (unsigned int ix = 0; ix < input_width_; ix++) {
+    ox_start_[ix] = (ix < region_width_) ? 0 : (ix - region_width_) / stride_width_ + 1;
+    ox_end_[ix] = std::min (ix / stride_width_ + 1, output_width_);
+  }
+
+  oy_start_.resize (input_height_);
+  oy_end_.resize (input_height_);
+  for (unsigned int iy = 0; iy < input_height_; iy++) {
+    oy_start_[iy] = (iy < region_height_) ? 0 : (iy - region_height_) / stride_height_ + 1;
+    oy_end_[iy] = std::min (iy / stride_height_ + 1, output_height_);
+  }
+#endif
 
   return true;
 }
@@ -136,35 +166,69 @@ void AdvancedMaxPoolingLayer::FeedForward() {
 #endif
 
 #else
+  const std::size_t planes = input_->data.samples() * maps_;
+  const std::size_t input_size = (std::size_t)input_width_ * input_height_;
+  const std::size_t output_size = (std::size_t)output_width_ * output_height_;
+  const datum* input = input_->data.data_ptr_const();
+  datum* output = output_->data.data_ptr();
+  uint32_t* maximum_index = maximum_index_.data();
+
 #pragma omp parallel for default(shared)
-  for (std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ox = 0; ox < output_width_; ox++) {
-        for (unsigned int oy = 0; oy < output_height_; oy++) {
-          // Find maximum in region
-          datum maximum = std::numeric_limits<datum>::lowest();
-          unsigned int mix = 0;
-          unsigned int miy = 0;
-          for (unsigned int iy = oy * stride_height_;
-                iy < (oy * stride_height_) + region_height_; iy++) {
-            for (unsigned int ix = ox * stride_width_;
-                ix < (ox * stride_width_) + region_width_; ix++) {
-              const datum ival =
-                *input_->data.data_ptr_const (ix, iy, map, sample);
-              if (ival > maximum) {
-                maximum = ival;
-                mix = ix;
-                miy = iy;
-              }
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    const datum* input_plane = &input[plane * input_size];
+    for (unsigned int oy = 0; oy < output_height_; oy++) {
+      unsigned int ox = 0;
+
+#ifdef __SSE2__
+      static_assert(sizeof(datum) == sizeof(float), "SSE2 pooling needs float datum");
+      // Four neighbouring regions at once, lane i belongs to output ox + i
+      for (; ox + 4 <= output_width_; ox += 4) {
+        const uint32_t region_start = oy * stride_height_ * input_width_ + ox * stride_width_;
+        const __m128i lane_offsets = _mm_setr_epi32 (0, stride_width_, 2 * stride_width_, 3 * stride_width_);
+        __m128 maximum = _mm_set1_ps (std::numeric_limits<datum>::lowest());
+        __m128i index = _mm_add_epi32 (_mm_set1_epi32 (region_start), lane_offsets);
+        for (unsigned int ry = 0; ry < region_height_; ry++) {
+          const uint32_t row_start = region_start + ry * input_width_;
+          const datum* row = &input_plane[row_start];
+          for (unsigned int rx = 0; rx < region_width_; rx++) {
+            const __m128 values = stride_width_ == 1 ? _mm_loadu_ps (&row[rx]) :
+              _mm_setr_ps (row[rx], row[rx + stride_width_], row[rx + 2 * stride_width_], row[rx + 3 * stride_width_]);
+            const __m128 greater = _mm_cmpgt_ps (values, maximum);
+            const __m128i greater_mask = _mm_castps_si128 (greater);
+            const __m128i candidate = _mm_add_epi32 (_mm_set1_epi32 (row_start + rx), lane_offsets);
+            maximum = _mm_or_ps (_mm_and_ps (greater, values), _mm_andnot_ps (greater, maximum));
+            index = _mm_or_si128 (_mm_and_si128 (greater_mask, candidate), _mm_andnot_si128 (greater_mask, index));
+          }
+        }
+
+        const std::size_t output_index = plane * output_size + oy * output_width_ + ox;
+        _mm_storeu_ps (&output[output_index], maximum);
+        _mm_storeu_si128 ((__m128i*)&maximum_index[output_index], index);
+      }
+#endif
+
+      for (; ox < output_width_; ox++) {
+        // Find maximum in region
+        const uint32_t region_start = oy * stride_height_ * input_width_ + ox * stride_width_;
+        datum maximum = std::numeric_limits<datum>::lowest();
+        uint32_t index = region_start;
+        for (unsigned int ry = 0; ry < region_height_; ry++) {
+          const uint32_t row_start = region_start + ry * input_width_;
+          for (unsigned int rx = 0; rx < region_width_; rx++) {
+            const datum ival = input_plane[row_start + rx];
+            if (ival > maximum) {
+              maximum = ival;
+              index = row_start + rx;
             }
           }
-          
-          // Found maximum, save
-          *maximum_mask_.data_ptr(ox, oy, map, sample) = input_width_ * miy + mix;
-          
-          // Feed forward
-          *output_->data.data_ptr(ox, oy, map, sample) = maximum;
         }
+
+        // Found maximum, save
+        const std::size_t output_index = plane * output_size + oy * output_width_ + ox;
+        maximum_index[output_index] = index;
+
+        // Feed forward
+        output[output_index] = maximum;
       }
     }
   }
@@ -210,32 +274,58 @@ void AdvancedMaxPoolingLayer::BackPropagate() {
 #endif
 
 #else
-  
-#define MP_HELPER_MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
-  
+  // Every input pixel gathers the deltas of the regions that selected it,
+  //  so there are no conflicting writes even if the regions overlap
+  const std::size_t planes = input_->data.samples() * maps_;
+  const std::size_t input_size = (std::size_t)input_width_ * input_height_;
+  const std::size_t output_size = (std::size_t)output_width_ * output_height_;
+  datum* input_delta = input_->delta.data_ptr();
+  const datum* output_delta = output_->delta.data_ptr_const();
+  const uint32_t* maximum_index = maximum_index_.data();
+
 #pragma omp parallel for default(shared)
-  for(std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ix = 0; ix < input_width_; ix++) {
-        for(unsigned int iy = 0; iy < input_height_; iy++) {
-          const unsigned int mask_index = ix + input_width_ * iy;
-          const unsigned int oxstart = (ix < region_width_) ? 
-            0 : (ix - region_width_) / stride_width_+ 1;
-          const unsigned int oxend = MP_HELPER_MIN(ix / stride_width_ + 1, output_width_);
-          
-          const unsigned int oystart = (iy < region_height_) ? 
-            0 : (iy - region_height_) / stride_height_ + 1;
-          const unsigned int oyend = MP_HELPER_MIN(iy / stride_height_ + 1, output_height_);
-          
-          datum sum = 0.0;
-          for (unsigned int oy = oystart; oy < oyend; oy++) {
-            for (unsigned int ox = oxstart; ox < oxend; ox++) {
-              if(*maximum_mask_.data_ptr_const(ox, oy, map, sample) == mask_index)
-                sum += *output_->delta.data_ptr_const(ox, oy, map, sample);
-            }
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    datum* input_delta_plane = &input_delta[plane * input_size];
+    const datum* output_delta_plane = &output_delta[plane * output_size];
+    const uint32_t* maximum_index_plane = &maximum_index[plane * output_size];
+
+    for (unsigned int iy = 0; iy < input_height_; iy++) {
+      const unsigned int oystart = oy_start_[iy];
+      const unsigned int oyend = oy_end_[iy];
+      unsigned int ix = 0;
+
+#ifdef __SSE2__
+      // Four neighbouring pixels at once. Every lane checks all regions
+      //  covering any of them; an argmax never lies outside its region,
+      //  so the others contribute zero like in the scalar loop.
+      for (; ix + 4 <= input_width_; ix += 4) {
+        const uint32_t index = iy * input_width_ + ix;
+        const __m128i lane_index = _mm_add_epi32 (_mm_set1_epi32 (index), _mm_setr_epi32 (0, 1, 2, 3));
+        const unsigned int oxstart = ox_start_[ix];
+        const unsigned int oxend = ox_end_[ix + 3];
+        __m128 sum = _mm_setzero_ps();
+        for (unsigned int oy = oystart; oy < oyend; oy++) {
+          for (unsigned int ox = oxstart; ox < oxend; ox++) {
+            const unsigned int output_index = oy * output_width_ + ox;
+            const __m128 selected = _mm_castsi128_ps (
+              _mm_cmpeq_epi32 (_mm_set1_epi32 (maximum_index_plane[output_index]), lane_index));
+            sum = _mm_add_ps (sum, _mm_and_ps (selected, _mm_set1_ps (output_delta_plane[output_index])));
+          }
+        }
+        _mm_storeu_ps (&input_delta_plane[index], sum);
+      }
+#endif
+
+      for (; ix < input_width_; ix++) {
+        const uint32_t index = iy * input_width_ + ix;
+        datum sum = 0.0;
+        for (unsigned int oy = oystart; oy < oyend; oy++) {
+          for (unsigned int ox = ox_start_[ix]; ox < ox_end_[ix]; ox++) {
+            const unsigned int output_index = oy * output_width_ + ox;
+            sum += (maximum_index_plane[output_index] == index) ? output_delta_plane[output_index] : 0;
           }
-          *(input_->delta.data_ptr(ix, iy, map, sample)) = sum;
         }
+        input_delta_plane[index] = sum;
       }
     }
   }
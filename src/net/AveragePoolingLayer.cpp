@@ -0,0 +1,241 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+#include "Log.h"
+#include "AveragePoolingLayer.h"
+#include "ConfigParsing.h"
+
+namespace Conv {
+
+/*
+ * Adds a row of values to another
+ */
+static inline void AddRow (datum* target, const datum* source, const unsigned int width) {
+  unsigned int x = 0;
+#ifdef __SSE2__
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 pooling needs float datum");
+  for (; x + 4 <= width; x += 4)
+    _mm_storeu_ps (&target[x], _mm_add_ps (_mm_loadu_ps (&target[x]), _mm_loadu_ps (&source[x])));
+#endif
+  for (; x < width; x++)
+    target[x] += source[x];
+}
+
+AveragePoolingLayer::AveragePoolingLayer (const unsigned int region_width,
+                                  const unsigned int region_height,
+                                  const unsigned int stride_width,
+                                  const unsigned int stride_height ) :
+  SimpleLayer(""),
+  region_width_ (region_width), region_height_ (region_height),
+  stride_width_ (stride_width), stride_height_ (stride_height){
+  LOGDEBUG << "Instance created: " << region_width_ << "x" << region_height_ <<
+           " average pooling.";
+}
+
+AveragePoolingLayer::AveragePoolingLayer(std::string configuration) : SimpleLayer(configuration) {
+  region_width_ = 1;
+  region_height_ = 1;
+
+  ParseKernelSizeIfPossible(configuration, "size", region_width_, region_height_);
+  stride_width_ = region_width_;
+  stride_height_ = region_height_;
+
+  ParseKernelSizeIfPossible(configuration, "stride", stride_width_, stride_height_);
+}
+
+bool AveragePoolingLayer::CreateOutputs (
+  const std::vector< CombinedTensor* >& inputs,
+  std::vector< CombinedTensor* >& outputs) {
+  // This is a simple layer, only one input
+  if (inputs.size() != 1) {
+    LOGERROR << "Only one input supported!";
+    return false;
+  }
+
+  // Save input node pointer
+  CombinedTensor* input = inputs[0];
+
+  // Check if input node pointer is null
+  if (input == nullptr) {
+    LOGERROR << "Null pointer input node!";
+    return false;
+  }
+
+  if (region_width_ == 0 || region_height_ == 0 || stride_width_ == 0 || stride_height_ == 0 ||
+      input->data.width() < region_width_ || input->data.height() < region_height_) {
+    LOGERROR << "Cannot pool " << input->data << " with " << region_width_ << "x" << region_height_
+      << " regions and stride " << stride_width_ << "x" << stride_height_;
+    return false;
+  }
+
+  const unsigned int output_width = (input->data.width() - region_width_) / stride_width_ + 1;
+  const unsigned int output_height = (input->data.height() - region_height_) / stride_height_ + 1;
+
+  // Create output
+  CombinedTensor* output = new CombinedTensor (input->data.samples(),
+      output_width, output_height,
+      input->data.maps());
+
+  // Tell network about the output
+  outputs.push_back (output);
+
+  return true;
+}
+
+bool AveragePoolingLayer::Connect (const CombinedTensor* input,
+                               CombinedTensor* output) {
+  // Check dimensions
+  bool valid = region_width_ > 0 && region_height_ > 0 &&
+    stride_width_ > 0 && stride_height_ > 0 &&
+    input->data.width() >= region_width_ && input->data.height() >= region_height_ &&
+    output->data.width() == (input->data.width() - region_width_) / stride_width_ + 1 &&
+    output->data.height() == (input->data.height() - region_height_) / stride_height_ + 1 &&
+    output->data.maps() == input->data.maps() &&
+    output->data.samples() == input->data.samples();
+
+  if (!valid) {
+    LOGERROR << "Invalid dimensions!";
+    return false;
+  }
+
+  // Save dimensions
+  input_width_ = input->data.width();
+  input_height_ = input->data.height();
+  output_width_ = output->data.width();
+  output_height_ = output->data.height();
+
+  maps_ = input->data.maps();
+
+  // Precalculate which outputs an input pixel contributes to
+  ox_start_.resize (input_width_);
+  ox_end_.resize (input_width_);
+  for (unsigned int ix = 0; ix < input_width_; ix++) {
+    ox_start_[ix] = (ix < region_width_) ? 0 : (ix - region_width_) / stride_width_ + 1;
+    ox_end_[ix] = std::max (ox_start_[ix], std::min (ix / stride_width_ + 1, output_width_));
+  }
+
+  oy_start_.resize (input_height_);
+  oy_end_.resize (input_height_);
+  for (unsigned int iy = 0; iy < input_height_; iy++) {
+    oy_start_[iy] = (iy < region_height_) ? 0 : (iy - region_height_) / stride_height_ + 1;
+    oy_end_[iy] = std::max (oy_start_[iy], std::min (iy / stride_height_ + 1, output_height_));
+  }
+
+  return true;
+}
+
+void AveragePoolingLayer::FeedForward() {
+  const std::size_t planes = input_->data.samples() * maps_;
+  const std::size_t input_size = (std::size_t)input_width_ * input_height_;
+  const std::size_t output_size = (std::size_t)output_width_ * output_height_;
+  const datum* input = input_->data.data_ptr_const();
+  datum* output = output_->data.data_ptr();
+
+  const datum scale = (datum)1.0 / (datum)(region_width_ * region_height_);
+
+  // Only these columns are covered by a region
+  const unsigned int used_width = (output_width_ - 1) * stride_width_ + region_width_;
+
+#pragma omp parallel default(shared)
+  {
+    std::vector<datum> row_sum (used_width);
+
+#pragma omp for
+    for (std::size_t plane = 0; plane < planes; plane++) {
+      const datum* input_plane = &input[plane * input_size];
+      datum* output_plane = &output[plane * output_size];
+
+      for (unsigned int oy = 0; oy < output_height_; oy++) {
+        // Sum the rows of the regions
+        const datum* region_row = &input_plane[oy * stride_height_ * input_width_];
+        std::copy (region_row, region_row + used_width, row_sum.begin());
+        for (unsigned int ry = 1; ry < region_height_; ry++)
+          AddRow (row_sum.data(), &region_row[ry * input_width_], used_width);
+
+        // Sum the columns of the row sums
+        datum* output_row = &output_plane[oy * output_width_];
+        unsigned int ox = 0;
+#ifdef __SSE2__
+        if (region_width_ == 2 && stride_width_ == 2) {
+          const __m128 scale4 = _mm_set1_ps (scale);
+          for (; ox + 4 <= output_width_; ox += 4) {
+            const __m128 a = _mm_loadu_ps (&row_sum[2 * ox]);
+            const __m128 b = _mm_loadu_ps (&row_sum[2 * ox + 4]);
+            const __m128 even = _mm_shuffle_ps (a, b, _MM_SHUFFLE (2, 0, 2, 0));
+            const __m128 odd = _mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 1, 3, 1));
+            _mm_storeu_ps (&output_row[ox], _mm_mul_ps (scale4, _mm_add_ps (even, odd)));
+          }
+        }
+#endif
+        for (; ox < output_width_; ox++) {
+          const datum* region_sum = &row_sum[ox * stride_width_];
+          datum sum = 0;
+          for (unsigned int rx = 0; rx < region_width_; rx++)
+            sum += region_sum[rx];
+          output_row[ox] = scale * sum;
+        }
+      }
+    }
+  }
+}
+
+void AveragePoolingLayer::BackPropagate() {
+  // Every input pixel gathers the deltas of the regions that contain it,
+  //  so there are no conflicting writes even if the regions overlap
+  const std::size_t planes = input_->data.samples() * maps_;
+  const std::size_t input_size = (std::size_t)input_width_ * input_height_;
+  const std::size_t output_size = (std::size_t)output_width_ * output_height_;
+  datum* input_delta = input_->delta.data_ptr();
+  const datum* output_delta = output_->delta.data_ptr_const();
+
+  const datum scale = (datum)1.0 / (datum)(region_width_ * region_height_);
+
+#pragma omp parallel default(shared)
+  {
+    std::vector<datum> row_sum (output_width_);
+
+#pragma omp for
+    for (std::size_t plane = 0; plane < planes; plane++) {
+      datum* input_delta_plane = &input_delta[plane * input_size];
+      const datum* output_delta_plane = &output_delta[plane * output_size];
+
+      for (unsigned int iy = 0; iy < input_height_; iy++) {
+        datum* input_delta_row = &input_delta_plane[iy * input_width_];
+        const unsigned int oystart = oy_start_[iy];
+        const unsigned int oyend = oy_end_[iy];
+
+        // Rows inside the same regions receive the same deltas
+        if (iy > 0 && oy_start_[iy - 1] == oystart && oy_end_[iy - 1] == oyend) {
+          std::memcpy (input_delta_row, input_delta_row - input_width_, sizeof(datum) * input_width_);
+          continue;
+        }
+
+        // Sum the output rows of the regions containing this input row
+        std::fill (row_sum.begin(), row_sum.end(), 0);
+        for (unsigned int oy = oystart; oy < oyend; oy++)
+          AddRow (row_sum.data(), &output_delta_plane[oy * output_width_], output_width_);
+
+        for (unsigned int ix = 0; ix < input_width_; ix++) {
+          datum sum = 0;
+          for (unsigned int ox = ox_start_[ix]; ox < ox_end_[ix]; ox++)
+            sum += row_sum[ox];
+          input_delta_row[ix] = scale * sum;
+        }
+      }
+    }
+  }
+}
+
+}
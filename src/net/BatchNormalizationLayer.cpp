@@ -0,0 +1,336 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cmath>
+#include <vector>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
+
+#include "Log.h"
+#include "BatchNormalizationLayer.h"
+#include "ConfigParsing.h"
+
+namespace Conv {
+
+/*
+ * Count, mean and sum of squared deviations of a set of values
+ */
+struct Moments {
+  double count = 0;
+  double mean = 0;
+  double m2 = 0;
+
+  // Chan et al.'s formula for combining two sets
+  void Merge(const double other_count, const double other_mean, const double other_m2) {
+    if (other_count == 0)
+      return;
+    const double total = count + other_count;
+    const double delta = other_mean - mean;
+    mean += delta * other_count / total;
+    m2 += other_m2 + delta * delta * count * other_count / total;
+    count = total;
+  }
+};
+
+/*
+ * Welford's single pass algorithm on four interleaved subsets
+ */
+static Moments MapMoments (const datum* map, const std::size_t size) {
+  Moments moments;
+  std::size_t i = 0;
+#ifdef __SSE2__
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 normalization needs float datum");
+  const std::size_t blocks = size / 4;
+  if (blocks > 0) {
+    __m128 mean = _mm_setzero_ps();
+    __m128 m2 = _mm_setzero_ps();
+    for (std::size_t b = 0; b < blocks; b++) {
+      const __m128 x = _mm_loadu_ps (&map[4 * b]);
+      const __m128 delta = _mm_sub_ps (x, mean);
+      mean = _mm_add_ps (mean, _mm_mul_ps (delta, _mm_set1_ps (1.0f / (float)(b + 1))));
+      m2 = _mm_add_ps (m2, _mm_mul_ps (delta, _mm_sub_ps (x, mean)));
+    }
+    float lane_means[4], lane_m2s[4];
+    _mm_storeu_ps (lane_means, mean);
+    _mm_storeu_ps (lane_m2s, m2);
+    for (unsigned int lane = 0; lane < 4; lane++)
+      moments.Merge ((double)blocks, lane_means[lane], lane_m2s[lane]);
+    i = 4 * blocks;
+  }
+#endif
+  for (; i < size; i++)
+    moments.Merge (1, map[i], 0);
+  return moments;
+}
+
+/*
+ * Calculates a * x + b for a map
+ */
+static inline void ScaleShiftMap (const datum* source, datum* target, const std::size_t size,
+                                  const datum a, const datum b) {
+  std::size_t i = 0;
+#ifdef __SSE2__
+  const __m128 a4 = _mm_set1_ps (a);
+  const __m128 b4 = _mm_set1_ps (b);
+  for (; i + 4 <= size; i += 4)
+    _mm_storeu_ps (&target[i], _mm_add_ps (_mm_mul_ps (a4, _mm_loadu_ps (&source[i])), b4));
+#endif
+  for (; i < size; i++)
+    target[i] = a * source[i] + b;
+}
+
+/*
+ * Calculates the sum of d and the sum of d * (x - mean) for a map
+ */
+static inline void DeltaSums (const datum* delta, const datum* x, const std::size_t size,
+                              const datum mean, double& delta_sum, double& delta_x_sum) {
+  std::size_t i = 0;
+  datum partial_delta_sum = 0, partial_delta_x_sum = 0;
+#ifdef __SSE2__
+  const __m128 mean4 = _mm_set1_ps (mean);
+  __m128 delta_sum4 = _mm_setzero_ps();
+  __m128 delta_x_sum4 = _mm_setzero_ps();
+  for (; i + 4 <= size; i += 4) {
+    const __m128 d = _mm_loadu_ps (&delta[i]);
+    delta_sum4 = _mm_add_ps (delta_sum4, d);
+    delta_x_sum4 = _mm_add_ps (delta_x_sum4, _mm_mul_ps (d, _mm_sub_ps (_mm_loadu_ps (&x[i]), mean4)));
+  }
+  float sums[4], x_sums[4];
+  _mm_storeu_ps (sums, delta_sum4);
+  _mm_storeu_ps (x_sums, delta_x_sum4);
+  partial_delta_sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+  partial_delta_x_sum = (x_sums[0] + x_sums[1]) + (x_sums[2] + x_sums[3]);
+#endif
+  for (; i < size; i++) {
+    partial_delta_sum += delta[i];
+    partial_delta_x_sum += delta[i] * (x[i] - mean);
+  }
+  delta_sum = partial_delta_sum;
+  delta_x_sum = partial_delta_x_sum;
+}
+
+/*
+ * Calculates a * d + b * x + c for a map
+ */
+static inline void CombineMap (const datum* delta, const datum* x, datum* target, const std::size_t size,
+                               const datum a, const datum b, const datum c) {
+  std::size_t i = 0;
+#ifdef __SSE2__
+  const __m128 a4 = _mm_set1_ps (a);
+  const __m128 b4 = _mm_set1_ps (b);
+  const __m128 c4 = _mm_set1_ps (c);
+  for (; i + 4 <= size; i += 4)
+    _mm_storeu_ps (&target[i], _mm_add_ps (_mm_add_ps (_mm_mul_ps (a4, _mm_loadu_ps (&delta[i])),
+      _mm_mul_ps (b4, _mm_loadu_ps (&x[i]))), c4));
+#endif
+  for (; i < size; i++)
+    target[i] = a * delta[i] + b * x[i] + c;
+}
+
+BatchNormalizationLayer::BatchNormalizationLayer(const datum momentum, const datum epsilon) :
+  SimpleLayer(""), momentum_(momentum), epsilon_(epsilon) {
+  LOGDEBUG << "Instance created, momentum: " << momentum_ << ", epsilon: " << epsilon_;
+}
+
+BatchNormalizationLayer::BatchNormalizationLayer(std::string configuration) :
+  SimpleLayer(configuration) {
+  ParseDatumParamIfPossible(configuration, "momentum", momentum_);
+  ParseDatumParamIfPossible(configuration, "epsilon", epsilon_);
+  LOGDEBUG << "Instance created, momentum: " << momentum_ << ", epsilon: " << epsilon_;
+}
+
+BatchNormalizationLayer::~BatchNormalizationLayer() {
+  for (CombinedTensor* parameter : parameters_)
+    delete parameter;
+}
+
+bool BatchNormalizationLayer::CreateOutputs (
+  const std::vector< CombinedTensor* >& inputs,
+  std::vector< CombinedTensor* >& outputs) {
+  // This is a simple layer, only one input
+  if (inputs.size() != 1) {
+    LOGERROR << "Only one input supported!";
+    return false;
+  }
+
+  // Save input node pointer
+  CombinedTensor* input = inputs[0];
+
+  // Check if input node pointer is null
+  if (input == nullptr) {
+    LOGERROR << "Null pointer input node!";
+    return false;
+  }
+
+  // Create output
+  CombinedTensor* output = new CombinedTensor (input->data.samples(),
+      input->data.width(), input->data.height(), input->data.maps());
+
+  // Tell network about the output
+  outputs.push_back (output);
+
+  return true;
+}
+
+bool BatchNormalizationLayer::Connect (const CombinedTensor* input,
+                                       CombinedTensor* output) {
+  // Check dimensions
+  bool valid = input->data.samples() == output->data.samples() &&
+    input->data.width() == output->data.width() &&
+    input->data.height() == output->data.height() &&
+    input->data.maps() == output->data.maps();
+
+  if (!valid) {
+    LOGERROR << "Invalid dimensions!";
+    return false;
+  }
+
+  maps_ = input->data.maps();
+  map_size_ = input->data.width() * input->data.height();
+  mean_.resize(maps_);
+  inverse_std_.resize(maps_);
+
+  // Keep the parameters when the net is reshaped
+  if (scale_ != nullptr)
+    return true;
+
+  // Start with the identity
+  scale_ = new CombinedTensor (1, maps_);
+  shift_ = new CombinedTensor (1, maps_);
+  running_mean_ = new CombinedTensor (1, maps_);
+  running_variance_ = new CombinedTensor (1, maps_);
+
+  scale_->data.Clear(1.0);
+  shift_->data.Clear();
+  running_mean_->data.Clear();
+  running_variance_->data.Clear(1.0);
+  running_mean_->delta.Clear();
+  running_variance_->delta.Clear();
+
+  // Tell the net about our parameters
+  parameters_.push_back (scale_);
+  parameters_.push_back (shift_);
+  parameters_.push_back (running_mean_);
+  parameters_.push_back (running_variance_);
+
+  return true;
+}
+
+void BatchNormalizationLayer::FeedForward() {
+  const unsigned int samples = input_->data.samples();
+  const datum* input = input_->data.data_ptr_const();
+  datum* output = output_->data.data_ptr();
+
+  used_batch_statistics_ = !net_->IsTesting();
+  if (used_batch_statistics_) {
+    // Combine the moments of every map of every sample
+    std::vector<Moments> map_moments(samples * maps_);
+    #pragma omp parallel for default(shared)
+    for (std::size_t plane = 0; plane < samples * maps_; plane++)
+      map_moments[plane] = MapMoments(&input[plane * map_size_], map_size_);
+
+    for (unsigned int map = 0; map < maps_; map++) {
+      Moments moments;
+      for (unsigned int sample = 0; sample < samples; sample++) {
+        const Moments& other = map_moments[sample * maps_ + map];
+        moments.Merge(other.count, other.mean, other.m2);
+      }
+
+      const double variance = moments.m2 / moments.count;
+      mean_[map] = (datum)moments.mean;
+      inverse_std_[map] = (datum)(1.0 / std::sqrt(variance + epsilon_));
+
+      // The running variance is an unbiased estimate
+      const double unbiased_variance = moments.count > 1 ? moments.m2 / (moments.count - 1.0) : variance;
+      running_mean_->data[map] = momentum_ * running_mean_->data[map] + (1.0 - momentum_) * moments.mean;
+      running_variance_->data[map] = momentum_ * running_variance_->data[map] + (1.0 - momentum_) * unbiased_variance;
+    }
+  } else {
+    for (unsigned int map = 0; map < maps_; map++) {
+      mean_[map] = running_mean_->data[map];
+      inverse_std_[map] = (datum)(1.0 / std::sqrt(running_variance_->data[map] + epsilon_));
+    }
+  }
+
+  // y = scale * (x - mean) / std + shift
+  #pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < samples * maps_; plane++) {
+    const unsigned int map = plane % maps_;
+    const datum a = scale_->data[map] * inverse_std_[map];
+    const datum b = shift_->data[map] - mean_[map] * a;
+    ScaleShiftMap(&input[plane * map_size_], &output[plane * map_size_], map_size_, a, b);
+  }
+}
+
+void BatchNormalizationLayer::BackPropagate() {
+  const unsigned int samples = input_->data.samples();
+  const datum* input = input_->data.data_ptr_const();
+  const datum* output_delta = output_->delta.data_ptr_const();
+  datum* input_delta = input_->delta.data_ptr();
+
+  std::vector<double> delta_sums(samples * maps_), delta_x_sums(samples * maps_);
+  #pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < samples * maps_; plane++)
+    DeltaSums(&output_delta[plane * map_size_], &input[plane * map_size_], map_size_,
+              mean_[plane % maps_], delta_sums[plane], delta_x_sums[plane]);
+
+  // Gradients of the shift and scale, the latter with respect to the
+  //  normalized input
+  for (unsigned int map = 0; map < maps_; map++) {
+    double delta_sum = 0, delta_x_sum = 0;
+    for (unsigned int sample = 0; sample < samples; sample++) {
+      delta_sum += delta_sums[sample * maps_ + map];
+      delta_x_sum += delta_x_sums[sample * maps_ + map];
+    }
+    shift_->delta[map] = (datum)delta_sum;
+    scale_->delta[map] = (datum)(delta_x_sum * inverse_std_[map]);
+  }
+
+  if (!backprop_enabled_)
+    return;
+
+  // With batch statistics, the mean and variance depend on the input too:
+  //  dx = a * (dy - mean(dy) - x_hat * mean(dy * x_hat)), a = scale / std
+  const datum count = (datum)(samples * map_size_);
+  #pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < samples * maps_; plane++) {
+    const unsigned int map = plane % maps_;
+    const datum a = scale_->data[map] * inverse_std_[map];
+    datum b = 0, c = 0;
+    if (used_batch_statistics_) {
+      const datum delta_mean = shift_->delta[map] / count;
+      const datum delta_x_hat_mean = scale_->delta[map] / count;
+      b = -a * delta_x_hat_mean * inverse_std_[map];
+      c = -a * delta_mean - b * mean_[map];
+    }
+    CombineMap(&output_delta[plane * map_size_], &input[plane * map_size_], &input_delta[plane * map_size_],
+               map_size_, a, b, c);
+  }
+}
+
+bool BatchNormalizationLayer::FoldInto(ConvolutionLayer& convolution) const {
+  if (maps_ == 0)
+    return false;
+
+#ifdef BUILD_OPENCL
+  scale_->data.MoveToCPU();
+  shift_->data.MoveToCPU();
+  running_mean_->data.MoveToCPU();
+  running_variance_->data.MoveToCPU();
+#endif
+
+  std::vector<datum> scale(maps_), shift(maps_);
+  for (unsigned int map = 0; map < maps_; map++) {
+    scale[map] = scale_->data[map] / std::sqrt(running_variance_->data[map] + epsilon_);
+    shift[map] = shift_->data[map] - running_mean_->data[map] * scale[map];
+  }
+
+  return convolution.FoldAffineTransform(scale, shift);
+}
+
+}
@@ -0,0 +1,236 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Log.h"
+
+#include "Checkpointer.h"
+
+namespace Conv {
+
+#ifdef BUILD_POSIX
+static bool SyncFile(const std::string& filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  const bool success = fsync(fd) == 0;
+  close(fd);
+  return success;
+}
+#endif
+
+Checkpointer::Checkpointer(NetGraph& graph, Trainer& trainer) :
+  graph_(graph), trainer_(trainer) {
+  for (Snapshot& snapshot : snapshots_) {
+    for (unsigned int p = 0; p < trainer_.parameters_.size(); p++) {
+      snapshot.parameters.push_back(new Tensor(trainer_.parameters_[p]->data, true));
+      snapshot.last_deltas.push_back(new Tensor(*(trainer_.last_deltas_[p]), true));
+      snapshot.last_gradients.push_back(new Tensor(*(trainer_.last_gradients_[p]), true));
+    }
+  }
+
+  writer_ = std::thread([this] { WriteSnapshots(); });
+}
+
+Checkpointer::~Checkpointer() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  writer_.join();
+
+  for (Snapshot& snapshot : snapshots_) {
+    for (unsigned int p = 0; p < snapshot.parameters.size(); p++) {
+      delete snapshot.parameters[p];
+      delete snapshot.last_deltas[p];
+      delete snapshot.last_gradients[p];
+    }
+  }
+}
+
+void Checkpointer::Save(const std::string& filename, bool optimizer_state, TensorStorage storage) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // Newer snapshots replace unwritten ones of the same file, others wait
+  condition_.wait(lock, [this, &filename] {
+    return pending_ == -1 || snapshots_[pending_].filename.compare(filename) == 0;
+  });
+  if (pending_ != -1) {
+    LOGDEBUG << "Replacing unwritten snapshot " << filename;
+  }
+
+  // The buffer that is not being written takes the copy
+  const int target = writing_ == 0 ? 1 : 0;
+  Snapshot& snapshot = snapshots_[target];
+  snapshot.filename = filename;
+  snapshot.optimizer_state = optimizer_state;
+  snapshot.storage = storage;
+  snapshot.epoch = trainer_.epoch_;
+  snapshot.iteration = trainer_.iteration_;
+
+  for (unsigned int p = 0; p < trainer_.parameters_.size(); p++) {
+    Tensor& parameter = trainer_.parameters_[p]->data;
+#ifdef BUILD_OPENCL
+    parameter.MoveToCPU();
+#endif
+    snapshot.parameters[p]->Resize(parameter);
+    std::memcpy(snapshot.parameters[p]->data_ptr(), parameter.data_ptr_const(), parameter.elements() * sizeof(datum));
+
+    if (optimizer_state) {
+      std::memcpy(snapshot.last_deltas[p]->data_ptr(), trainer_.last_deltas_[p]->data_ptr_const(),
+                  trainer_.last_deltas_[p]->elements() * sizeof(datum));
+      std::memcpy(snapshot.last_gradients[p]->data_ptr(), trainer_.last_gradients_[p]->data_ptr_const(),
+                  trainer_.last_gradients_[p]->elements() * sizeof(datum));
+    }
+  }
+
+  pending_ = target;
+  lock.unlock();
+  condition_.notify_all();
+}
+
+bool Checkpointer::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait(lock, [this] { return pending_ == -1 && writing_ == -1; });
+  const bool success = !failed_;
+  failed_ = false;
+  return success;
+}
+
+bool Checkpointer::Resume(const std::string& filename) {
+  // The file could be one of our own snapshots
+  Wait();
+
+  std::ifstream input(filename, std::ios::in | std::ios::binary);
+  if (!input.good()) {
+    LOGERROR << "Cannot open " << filename;
+    return false;
+  }
+
+  graph_.DeserializeParameters(input);
+  if (!input.good() || input.eof()) {
+    LOGWARN << filename << " has no optimizer state, starting epoch " << trainer_.epoch_ << " from scratch";
+    trainer_.SetEpoch(trainer_.epoch_);
+    return true;
+  }
+
+  // Read everything first, so a damaged file leaves the Trainer alone
+  std::vector<Tensor> last_deltas(trainer_.parameters_.size());
+  std::vector<Tensor> last_gradients(trainer_.parameters_.size());
+  for (Tensor& last_delta : last_deltas)
+    last_delta.Deserialize(input);
+  for (Tensor& last_gradient : last_gradients)
+    last_gradient.Deserialize(input);
+  Tensor position;
+  position.Deserialize(input);
+
+  if (input.fail() || position.elements() != 2) {
+    LOGERROR << "Optimizer state in " << filename << " is damaged!";
+    return false;
+  }
+  for (unsigned int p = 0; p < trainer_.parameters_.size(); p++) {
+    if (last_deltas[p].elements() != trainer_.last_deltas_[p]->elements() ||
+        last_gradients[p].elements() != trainer_.last_gradients_[p]->elements()) {
+      LOGERROR << "Optimizer state for parameter set " << p << " has a different size: " << last_deltas[p];
+      return false;
+    }
+  }
+
+  for (unsigned int p = 0; p < trainer_.parameters_.size(); p++) {
+    std::memcpy(trainer_.last_deltas_[p]->data_ptr(), last_deltas[p].data_ptr_const(),
+                last_deltas[p].elements() * sizeof(datum));
+    std::memcpy(trainer_.last_gradients_[p]->data_ptr(), last_gradients[p].data_ptr_const(),
+                last_gradients[p].elements() * sizeof(datum));
+  }
+  trainer_.epoch_ = (unsigned int)position[0];
+  trainer_.iteration_ = (unsigned int)position[1];
+  trainer_.resumed_ = true;
+  trainer_.first_iteration = false;
+
+  LOGINFO << "Resuming epoch " << trainer_.epoch_ << " at iteration " << trainer_.iteration_ << " from " << filename;
+  return true;
+}
+
+void Checkpointer::WriteSnapshots() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Pending snapshots are written before stopping
+    condition_.wait(lock, [this] { return pending_ != -1 || stop_; });
+    if (pending_ == -1)
+      return;
+
+    writing_ = pending_;
+    pending_ = -1;
+    lock.unlock();
+    const bool success = WriteSnapshot(snapshots_[writing_]);
+    lock.lock();
+
+    failed_ |= !success;
+    writing_ = -1;
+    condition_.notify_all();
+  }
+}
+
+bool Checkpointer::WriteSnapshot(Snapshot& snapshot) {
+  const std::string temporary_filename = snapshot.filename + ".tmp";
+  std::ofstream output(temporary_filename, std::ios::out | std::ios::binary);
+  if (!output.good()) {
+    LOGERROR << "Cannot open " << temporary_filename;
+    return false;
+  }
+
+  for (Tensor* parameter : snapshot.parameters)
+    parameter->Serialize(output, false, snapshot.storage);
+
+  // The optimizer state is always saved at full precision
+  if (snapshot.optimizer_state) {
+    for (Tensor* last_delta : snapshot.last_deltas)
+      last_delta->Serialize(output);
+    for (Tensor* last_gradient : snapshot.last_gradients)
+      last_gradient->Serialize(output);
+    Tensor position(1, 2);
+    position[0] = (datum)snapshot.epoch;
+    position[1] = (datum)snapshot.iteration;
+    position.Serialize(output);
+  }
+
+  output.close();
+  if (output.fail()) {
+    LOGERROR << "Cannot write " << temporary_filename;
+    return false;
+  }
+
+#ifdef BUILD_POSIX
+  // The contents have to be on disk before the rename can be
+  if (!SyncFile(temporary_filename)) {
+    LOGERROR << "Cannot sync " << temporary_filename;
+    return false;
+  }
+#endif
+  if (std::rename(temporary_filename.c_str(), snapshot.filename.c_str()) != 0) {
+    LOGERROR << "Cannot rename " << temporary_filename << " to " << snapshot.filename;
+    return false;
+  }
+#ifdef BUILD_POSIX
+  const std::size_t separator = snapshot.filename.rfind('/');
+  SyncFile(separator == std::string::npos ? "." : snapshot.filename.substr(0, separator + 1));
+#endif
+
+  LOGDEBUG << "Written snapshot of epoch " << snapshot.epoch << ", iteration " << snapshot.iteration
+           << " to " << snapshot.filename;
+  return true;
+}
+
+}
@@ -18,34 +18,35 @@ ConcatenationLayer::ConcatenationLayer() : Layer("") {
 
 bool ConcatenationLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                                  std::vector< CombinedTensor* >& outputs) {
-  if(inputs.size() != 2) {
-    LOGERROR << "Needs two inputs!";
+  if(inputs.size() < 2) {
+    LOGERROR << "Needs at least two inputs!";
     return false;
   }
   
-  CombinedTensor* input_a = inputs[0];
-  CombinedTensor* input_b = inputs[1];
-  
-  if(input_a == nullptr || input_b == nullptr) {
-    LOGERROR << "Null pointer supplied";
-    return false;
-  }
-  
-  if(input_a->data.width() != input_b->data.width()
-    && input_a->data.height() != input_b->data.height()) {
-    LOGERROR << "Dimensions don't match!";
-  }
-  
-  if(input_a->data.samples() != input_b->data.samples()) {
-    LOGERROR << "Sample count doesn't match!";
-    return false;
+  unsigned int maps = 0;
+  for(CombinedTensor* input : inputs) {
+    if(input == nullptr) {
+      LOGERROR << "Null pointer supplied";
+      return false;
+    }
+
+    if(input->data.width() != inputs[0]->data.width()
+      || input->data.height() != inputs[0]->data.height()) {
+      LOGERROR << "Dimensions don't match!";
+      return false;
+    }
+
+    if(input->data.samples() != inputs[0]->data.samples()) {
+      LOGERROR << "Sample count doesn't match!";
+      return false;
+    }
+
+    maps += input->data.maps();
   }
   
-  unsigned int maps_a = input_a->data.maps();
-  unsigned int maps_b = input_b->data.maps();
-  unsigned int samples = input_a->data.samples();
-  CombinedTensor* output = new CombinedTensor(samples, input_a->data.width(),
-    input_b->data.height(), maps_a + maps_b);
+  unsigned int samples = inputs[0]->data.samples();
+  CombinedTensor* output = new CombinedTensor(samples, inputs[0]->data.width(),
+    inputs[0]->data.height(), maps);
   
   outputs.push_back(output);
   return true;
@@ -55,8 +56,8 @@ bool ConcatenationLayer::Connect (const std::vector< CombinedTensor* >& inputs,
                            const std::vector< CombinedTensor* >& outputs,
                            const NetStatus* status ) {
   UNREFERENCED_PARAMETER(status);
-  if(inputs.size() != 2) {
-    LOGERROR << "Needs two inputs!";
+  if(inputs.size() < 2) {
+    LOGERROR << "Needs at least two inputs!";
     return false;
   }
   
@@ -65,55 +66,79 @@ bool ConcatenationLayer::Connect (const std::vector< CombinedTensor* >& inputs,
     return false;
   }
   
-  CombinedTensor* input_a = inputs[0];
-  CombinedTensor* input_b = inputs[1];
   CombinedTensor* output = outputs[0];
-  
-  if(input_a == nullptr || input_b == nullptr || output == nullptr) {
+  if(output == nullptr) {
     LOGERROR << "Null pointer supplied";
     return false;
   }
   
-  if(input_a->data.samples() != input_b->data.samples()) {
-    LOGERROR << "Sample count doesn't match!";
-    return false;
+  first_maps_.clear();
+  unsigned int maps = 0;
+  for(CombinedTensor* input : inputs) {
+    if(input == nullptr) {
+      LOGERROR << "Null pointer supplied";
+      return false;
+    }
+
+    if(input->data.samples() != output->data.samples()) {
+      LOGERROR << "Sample count doesn't match!";
+      return false;
+    }
+
+    if(input->data.width() != output->data.width()
+      || input->data.height() != output->data.height()) {
+      LOGERROR << "Dimensions don't match!";
+      return false;
+    }
+
+    first_maps_.push_back(maps);
+    maps += input->data.maps();
   }
   
-  if(output->data.elements() != (input_a->data.elements() + input_b->data.elements())) {
+  if(output->data.maps() != maps) {
     LOGERROR << "Wrong output dimensions!";
     return false;
   }
   
-  maps_a_ = input_a->data.maps();
-  maps_b_ = input_b->data.maps();
-  samples_ = input_a->data.samples();
+  samples_ = output->data.samples();
   
-  input_a_ = input_a;
-  input_b_ = input_b;
+  inputs_ = inputs;
   output_ = output;
   
   return true;
 }
 
+bool ConcatenationLayer::IsInputInPlace(const unsigned int input) const {
+  return inputs_[input]->data.data_ptr_const() == output_->data.data_ptr_const(0, 0, first_maps_[input], 0) &&
+    inputs_[input]->delta.data_ptr_const() == output_->delta.data_ptr_const(0, 0, first_maps_[input], 0);
+}
+
 void ConcatenationLayer::FeedForward() {
+  for(unsigned int i = 0; i < inputs_.size(); i++) {
+    // Inputs that are views of the output wrote their maps already
+    if(IsInputInPlace(i))
+      continue;
+
+    const Tensor& input = inputs_[i]->data;
 #pragma omp parallel for default(shared)
-  for(unsigned int s = 0; s < samples_; s++) {
-    for(unsigned int m = 0; m < maps_a_; m++)
-      Tensor::CopyMap(input_a_->data, s, m ,output_->data, s, m);
-    
-    for(unsigned int m = 0; m < maps_b_; m++)
-      Tensor::CopyMap(input_b_->data, s, m, output_->data, s, maps_a_ + m);
+    for(unsigned int s = 0; s < samples_; s++) {
+      for(unsigned int m = 0; m < input.maps(); m++)
+        Tensor::CopyMap(input, s, m, output_->data, s, first_maps_[i] + m);
+    }
   }
 }
 
 void ConcatenationLayer::BackPropagate() {
+  for(unsigned int i = 0; i < inputs_.size(); i++) {
+    if(IsInputInPlace(i))
+      continue;
+
+    Tensor& input_delta = inputs_[i]->delta;
 #pragma omp parallel for default(shared)
-  for(unsigned int s = 0; s < samples_; s++) {
-    for(unsigned int m = 0; m < maps_a_; m++)
-      Tensor::CopyMap(output_->delta, s, m, input_a_->delta, s, m);
-    
-    for(unsigned int m = 0; m < maps_b_; m++)
-      Tensor::CopyMap(output_->delta, s, maps_a_ + m, input_b_->delta, s, m);
+    for(unsigned int s = 0; s < samples_; s++) {
+      for(unsigned int m = 0; m < input_delta.maps(); m++)
+        Tensor::CopyMap(output_->delta, s, first_maps_[i] + m, input_delta, s, m);
+    }
   }
 }
 
@@ -173,10 +173,13 @@ bool ConfusionMatrixLayer::Connect
     second_ = second;
     third_ = third;
 
-    matrix_ = new long double[classes_ * classes_];
-    per_class_ = new long double[classes_];
+    // Keep the counts when the net is reshaped
+    if ( matrix_ == nullptr ) {
+      matrix_ = new long double[classes_ * classes_];
+      per_class_ = new long double[classes_];
 
-    Reset();
+      Reset();
+    }
   }
 
   return valid;
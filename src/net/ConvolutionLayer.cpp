@@ -5,7 +5,9 @@
  * For licensing information, see the LICENSE file included with this project.
  */
 #include <cstring>
+#include <cmath>
 #include <algorithm>
+#include <vector>
 
 #ifdef BUILD_OPENCL
 #define BUILD_OPENCL_CONV
@@ -19,6 +21,7 @@
 #include "Log.h"
 #include "CLHelper.h"
 #include "TensorMath.h"
+#include "Int8Math.h"
 #include "ConfigParsing.h"
 
 #include "TensorViewer.h"
@@ -181,6 +184,13 @@ bool ConvolutionLayer::Connect (const CombinedTensor* input,
     ones_[i] = 1;
   }
 
+  // Initialize the dropout mask tensor
+  dropout_mask_.Resize(input->data.samples(),output_maps_);
+
+  // Keep the parameters when the net is reshaped
+  if (weights_ != nullptr)
+    return true;
+
   // Create kernels
   weights_ = new CombinedTensor (output_maps_, kernel_width_, kernel_height_, input_maps_ / group_);
   bias_ = new CombinedTensor (1, output_maps_);
@@ -189,9 +199,6 @@ bool ConvolutionLayer::Connect (const CombinedTensor* input,
   // is not called. Random memory junk may work but is certainly not optimal.
   bias_->data.Clear();
   weights_->data.Clear();
-  
-  // Initialize the dropout mask tensor
-  dropout_mask_.Resize(input->data.samples(),output_maps_);
 
   // Tell the net about our parameters
   parameters_.push_back (weights_);
@@ -201,6 +208,29 @@ bool ConvolutionLayer::Connect (const CombinedTensor* input,
 }
 
 void ConvolutionLayer::FeedForward() {
+  if (calibrating_) {
+#ifdef BUILD_OPENCL
+    input_->data.MoveToCPU();
+#endif
+    // 16-bit inputs are converted, calibration only runs on a few batches
+    std::vector<datum> converted;
+    const datum* input = input_->data.data_ptr_const();
+    if (input_->data.storage() != STORAGE_FLOAT32) {
+      converted.resize (input_->data.elements());
+      input_->data.UnpackElements (0, converted.size(), converted.data());
+      input = converted.data();
+    }
+    const auto range = std::minmax_element (input, input + input_->data.elements());
+    input_min_ = calibrated_ ? std::min (input_min_, *range.first) : *range.first;
+    input_max_ = calibrated_ ? std::max (input_max_, *range.second) : *range.second;
+    calibrated_ = true;
+  }
+
+  if (quantized_ && net_->IsTesting()) {
+    FeedForwardQuantized();
+    return;
+  }
+
   const datum p = net_->IsTesting() ? 0.0 : dropout_fraction_;
   const datum w = net_->IsTesting() ? (1.0 - dropout_fraction_) : 1.0;
   
@@ -347,6 +377,174 @@ void ConvolutionLayer::OnLayerConnect (const std::vector<Layer*> next_layers) {
            << next_layer_gain;
 }
 
+bool ConvolutionLayer::FoldAffineTransform (const std::vector<datum>& scale, const std::vector<datum>& shift) {
+  if (scale.size() != output_maps_ || shift.size() != output_maps_) {
+    LOGERROR << "Need a scale and shift for each of the " << output_maps_ << " output maps!";
+    return false;
+  }
+
+  // The testing output is scaled down by the dropout fraction
+  const datum w = 1.0 - dropout_fraction_;
+  if (w == 0) {
+    LOGERROR << "Cannot fold into a layer that drops everything!";
+    return false;
+  }
+
+#ifdef BUILD_OPENCL
+  weights_->data.MoveToCPU();
+  bias_->data.MoveToCPU();
+#endif
+
+  // Each output map has its own sample in the weights
+  const std::size_t kernel_size = weights_->data.elements() / output_maps_;
+  for (unsigned int map = 0; map < output_maps_; map++) {
+    datum* kernel = weights_->data.data_ptr (0, 0, 0, map);
+    for (std::size_t e = 0; e < kernel_size; e++)
+      kernel[e] *= scale[map];
+    bias_->data[map] = scale[map] * bias_->data[map] + shift[map] / w;
+  }
+
+  return true;
+}
+
+void ConvolutionLayer::FeedForwardQuantized() {
+  const datum w = 1.0 - dropout_fraction_;
+  const unsigned int N = output_width_ * output_height_ * input_->data.samples();
+  const unsigned int depth = (kernel_width_ * kernel_height_ * input_maps_) / group_;
+  const unsigned int group_maps = output_maps_ / group_;
+
+  im2col_ff_buffer.hint_ignore_content_ = true;
+  output_->data.hint_ignore_content_ = true;
+  sms_ff_buffer.hint_ignore_content_ = true;
+
+  TensorMath::IM2COL(input_->data, input_width_, input_height_, input_maps_, input_->data.samples(),
+        kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_, im2col_ff_buffer);
+
+#ifdef BUILD_OPENCL
+  im2col_ff_buffer.MoveToCPU();
+  sms_ff_buffer.MoveToCPU(true);
+  bias_->data.MoveToCPU();
+#endif
+
+  quantized_inputs_.resize ((std::size_t)group_ * N * quantized_depth_);
+  quantized_outputs_.resize ((std::size_t)output_maps_ * N);
+
+  // Every column becomes a zero-padded row of quantized inputs
+  const datum inverse_scale = 1.0 / input_scale_;
+  const datum* const columns = im2col_ff_buffer.data_ptr_const();
+  const unsigned int BLOCK = 64;
+#pragma omp parallel for default(shared)
+  for (unsigned int first = 0; first < N; first += BLOCK) {
+    const unsigned int last = std::min (first + BLOCK, N);
+    for (unsigned int g = 0; g < group_; g++) {
+      uint8_t* const rows = &quantized_inputs_[(std::size_t)g * N * quantized_depth_];
+      for (unsigned int k = 0; k < depth; k++) {
+        const datum* const column = columns + (std::size_t)(g * depth + k) * N;
+        for (unsigned int n = first; n < last; n++) {
+          const long value = std::lround (column[n] * inverse_scale) + input_zero_point_;
+          rows[(std::size_t)n * quantized_depth_ + k] = (uint8_t)std::min (std::max (value, 0L), (long)Int8Math::INPUT_LIMIT);
+        }
+      }
+      for (unsigned int n = first; n < last; n++)
+        std::fill (rows + (std::size_t)n * quantized_depth_ + depth, rows + (std::size_t)(n + 1) * quantized_depth_, 0);
+    }
+  }
+
+  for (unsigned int g = 0; g < group_; g++) {
+    Int8Math::GEMM (group_maps, N, quantized_depth_,
+                    &quantized_weights_[(std::size_t)g * group_maps * quantized_depth_],
+                    &quantized_inputs_[(std::size_t)g * N * quantized_depth_],
+                    &quantized_outputs_[(std::size_t)g * group_maps * N], N);
+  }
+
+  // Remove the zero point and scale back, the bias stays in floating point
+#pragma omp parallel for default(shared)
+  for (unsigned int map = 0; map < output_maps_; map++) {
+    const datum scale = w * quantized_scales_[map];
+    const int32_t offset = input_zero_point_ * quantized_weight_sums_[map];
+    const datum bias = w * bias_->data[map];
+    const int32_t* const accumulators = &quantized_outputs_[(std::size_t)map * N];
+    datum* const target = sms_ff_buffer.data_ptr() + (std::size_t)map * N;
+    for (unsigned int n = 0; n < N; n++)
+      target[n] = scale * (datum)(accumulators[n] - offset) + bias;
+  }
+
+  TensorMath::SMS(sms_ff_buffer, output_->data);
+}
+
+void ConvolutionLayer::SetCalibrating (bool calibrating) {
+  if (calibrating && !calibrating_)
+    calibrated_ = false;
+  calibrating_ = calibrating;
+}
+
+bool ConvolutionLayer::GetInputRange (datum& input_min, datum& input_max) const {
+  input_min = input_min_;
+  input_max = input_max_;
+  return calibrated_;
+}
+
+bool ConvolutionLayer::Quantize (const datum input_min, const datum input_max) {
+  if (weights_ == nullptr) {
+    LOGERROR << "Cannot quantize before the layer is connected!";
+    return false;
+  }
+
+  if (!(input_min <= input_max)) {
+    LOGERROR << "Invalid input range: " << input_min << " to " << input_max;
+    return false;
+  }
+
+  // Zero has to be exact because of the padding
+  const datum range_min = std::min ((datum)0, input_min), range_max = std::max ((datum)0, input_max);
+  input_scale_ = range_max > range_min ? (range_max - range_min) / (datum)Int8Math::INPUT_LIMIT : 1.0;
+  input_zero_point_ = (int32_t)std::lround (-range_min / input_scale_);
+
+#ifdef BUILD_OPENCL
+  weights_->data.MoveToCPU();
+#endif
+
+  // Each output map has its own sample in the weights and its own scale
+  const std::size_t depth = (kernel_width_ * kernel_height_ * input_maps_) / group_;
+  if (weights_->data.elements() != output_maps_ * depth) {
+    LOGERROR << "Weights do not match the layer: " << weights_->data;
+    return false;
+  }
+  quantized_depth_ = Int8Math::PaddedDepth (depth);
+  quantized_weights_.assign (output_maps_ * quantized_depth_, 0);
+  quantized_weight_sums_.resize (output_maps_);
+  quantized_scales_.resize (output_maps_);
+
+  for (unsigned int map = 0; map < output_maps_; map++) {
+    const datum* kernel = weights_->data.data_ptr_const (0, 0, 0, map);
+    datum max_weight = 0;
+    for (std::size_t e = 0; e < depth; e++)
+      max_weight = std::max (max_weight, (datum)std::fabs (kernel[e]));
+    const datum weight_scale = max_weight > 0 ? max_weight / (datum)Int8Math::WEIGHT_LIMIT : 1.0;
+
+    int32_t sum = 0;
+    int8_t* quantized_kernel = &quantized_weights_[map * quantized_depth_];
+    for (std::size_t e = 0; e < depth; e++) {
+      const long value = std::lround (kernel[e] / weight_scale);
+      quantized_kernel[e] = (int8_t)std::min (std::max (value, (long)-Int8Math::WEIGHT_LIMIT), (long)Int8Math::WEIGHT_LIMIT);
+      sum += quantized_kernel[e];
+    }
+    quantized_weight_sums_[map] = sum;
+    quantized_scales_[map] = weight_scale * input_scale_;
+  }
+
+  quantized_ = true;
+  LOGDEBUG << "Quantized inputs from " << range_min << " to " << range_max << ", zero point: " << input_zero_point_;
+  return true;
+}
+
+void ConvolutionLayer::Dequantize() {
+  quantized_ = false;
+  quantized_weights_.clear();
+  quantized_inputs_.clear();
+  quantized_outputs_.clear();
+}
+
 bool ConvolutionLayer::IsOpenCLAware() {
 #ifdef BUILD_OPENCL_CONV
   return true;
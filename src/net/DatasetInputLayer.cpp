@@ -146,14 +146,28 @@ void DatasetInputLayer::FeedForward() {
   localized_error_output_->data.MoveToCPU (true);
 #endif
 
+  // Let the dataset prepare the samples of this batch in parallel
+  std::vector<unsigned int> upcoming_elements;
+  if (testing_) {
+    for (unsigned int element = current_element_testing_; element < elements_testing_ && upcoming_elements.size() < batch_size_; element++)
+      upcoming_elements.push_back(element);
+  } else {
+    for (std::size_t element = current_element_; element < perm_.size() && upcoming_elements.size() < batch_size_; element++)
+      upcoming_elements.push_back(perm_[element]);
+  }
+  dataset_.PrefetchSamples(upcoming_elements, testing_);
+
+  // Select the samples of this batch
+  std::vector<unsigned int> selected_elements (batch_size_);
+  std::vector<bool> force_no_weight (batch_size_, false);
+
   for (std::size_t sample = 0; sample < batch_size_; sample++) {
-    unsigned int selected_element = 0;
-    bool force_no_weight = false;
+    unsigned int& selected_element = selected_elements[sample];
 
     if (testing_) {
       // The testing samples are not randomized
       if (current_element_testing_ >= elements_testing_) {
-        force_no_weight = true;
+        force_no_weight[sample] = true;
         selected_element = 0;
       } else {
         selected_element = current_element_testing_++;
@@ -174,20 +188,15 @@ void DatasetInputLayer::FeedForward() {
         RedoPermutation();
       }
     }
+  }
 
-    // Copy image and label
-    bool success;
-
-    if (testing_)
-      success = dataset_.GetTestingSample (data_output_->data, label_output_->data, helper_output_->data, localized_error_output_->data, sample, selected_element);
-    else
-      success = dataset_.GetTrainingSample (data_output_->data, label_output_->data, helper_output_->data, localized_error_output_->data, sample, selected_element);
-
-    if (!success) {
-      FATAL ("Cannot load samples from Dataset!");
-    }
+  // Copy images and labels
+  if (!dataset_.GetSampleBatch (data_output_->data, label_output_->data, helper_output_->data, localized_error_output_->data, selected_elements, testing_)) {
+    FATAL ("Cannot load samples from Dataset!");
+  }
 
-    if (!testing_ && !force_no_weight && dataset_.GetMethod() == FCN) {
+  for (std::size_t sample = 0; sample < batch_size_; sample++) {
+    if (!testing_ && !force_no_weight[sample] && dataset_.GetMethod() == FCN) {
       // Perform loss sampling
       const unsigned int block_size = 12;
 
@@ -205,7 +214,7 @@ void DatasetInputLayer::FeedForward() {
     }
 
     // Copy localized error
-    if (force_no_weight)
+    if (force_no_weight[sample])
       localized_error_output_->data.Clear (0.0, sample);
   }
 }
@@ -0,0 +1,119 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
+
+#include "Log.h"
+#include "GlobalAveragePoolingLayer.h"
+
+namespace Conv {
+
+/*
+ * Sums a map with four independent accumulators
+ */
+static inline datum SumMap (const datum* map, const std::size_t size) {
+  std::size_t i = 0;
+  datum sum = 0;
+#ifdef __SSE2__
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 pooling needs float datum");
+  __m128 sum4 = _mm_setzero_ps();
+  for (; i + 4 <= size; i += 4)
+    sum4 = _mm_add_ps (sum4, _mm_loadu_ps (&map[i]));
+  float partial_sums[4];
+  _mm_storeu_ps (partial_sums, sum4);
+  sum = (partial_sums[0] + partial_sums[1]) + (partial_sums[2] + partial_sums[3]);
+#endif
+  for (; i < size; i++)
+    sum += map[i];
+  return sum;
+}
+
+GlobalAveragePoolingLayer::GlobalAveragePoolingLayer() : SimpleLayer("") {
+  LOGDEBUG << "Instance created.";
+}
+
+GlobalAveragePoolingLayer::GlobalAveragePoolingLayer(std::string configuration) :
+  SimpleLayer(configuration) {
+  LOGDEBUG << "Instance created.";
+}
+
+bool GlobalAveragePoolingLayer::CreateOutputs (
+  const std::vector< CombinedTensor* >& inputs,
+  std::vector< CombinedTensor* >& outputs) {
+  // This is a simple layer, only one input
+  if (inputs.size() != 1) {
+    LOGERROR << "Only one input supported!";
+    return false;
+  }
+
+  // Save input node pointer
+  CombinedTensor* input = inputs[0];
+
+  // Check if input node pointer is null
+  if (input == nullptr) {
+    LOGERROR << "Null pointer input node!";
+    return false;
+  }
+
+  // Create output
+  CombinedTensor* output = new CombinedTensor (input->data.samples(), 1, 1,
+      input->data.maps());
+
+  // Tell network about the output
+  outputs.push_back (output);
+
+  return true;
+}
+
+bool GlobalAveragePoolingLayer::Connect (const CombinedTensor* input,
+                               CombinedTensor* output) {
+  // Check dimensions
+  bool valid = input->data.width() > 0 && input->data.height() > 0 &&
+    output->data.width() == 1 && output->data.height() == 1 &&
+    output->data.maps() == input->data.maps() &&
+    output->data.samples() == input->data.samples();
+
+  if (!valid) {
+    LOGERROR << "Invalid dimensions!";
+    return false;
+  }
+
+  input_size_ = input->data.width() * input->data.height();
+  maps_ = input->data.maps();
+
+  return true;
+}
+
+void GlobalAveragePoolingLayer::FeedForward() {
+  const std::size_t planes = input_->data.samples() * maps_;
+  const datum* input = input_->data.data_ptr_const();
+  datum* output = output_->data.data_ptr();
+  const datum scale = (datum)1.0 / (datum)input_size_;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    output[plane] = scale * SumMap (&input[plane * input_size_], input_size_);
+  }
+}
+
+void GlobalAveragePoolingLayer::BackPropagate() {
+  const std::size_t planes = input_->data.samples() * maps_;
+  datum* input_delta = input_->delta.data_ptr();
+  const datum* output_delta = output_->delta.data_ptr_const();
+  const datum scale = (datum)1.0 / (datum)input_size_;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    datum* input_delta_plane = &input_delta[plane * input_size_];
+    std::fill (input_delta_plane, input_delta_plane + input_size_, scale * output_delta[plane]);
+  }
+}
+
+}
@@ -9,6 +9,7 @@
 
 #include "Config.h"
 #include "ConfigParsing.h"
+#include "TensorMath.h"
 #include "GradientAccumulationLayer.h"
 
 
@@ -35,11 +36,14 @@ bool GradientAccumulationLayer::CreateOutputs (const std::vector< CombinedTensor
   
   CombinedTensor* input = inputs[0];
   for(unsigned int i = 0; i < output_count_; i++) {
-    CombinedTensor* output = new CombinedTensor(input->data.samples(),
-                                                input->data.width(),
-                                                input->data.height(),
-                                                input->data.maps());
+    // All outputs read the input data. The first output's gradient is
+    //  written directly into the input's, the others are added to it.
+    CombinedTensor* output = new CombinedTensor(0);
     output->data.Shadow(input->data);
+    if(i == 0)
+      output->delta.Shadow(input->delta);
+    else
+      output->delta.Resize(input->delta);
     outputs.push_back(output);
   }
 
@@ -67,6 +71,7 @@ bool GradientAccumulationLayer::Connect (const std::vector< CombinedTensor* >& i
     return false;
   }
   
+  outputs_.clear();
   for(unsigned int i = 0; i < output_count_; i++) {
     if(outputs[i] == nullptr) {
       LOGERROR << "Null pointer supplied";
@@ -82,8 +87,6 @@ bool GradientAccumulationLayer::Connect (const std::vector< CombinedTensor* >& i
     outputs_.push_back(outputs[i]);
   }
   
-  samples_ = input->data.samples();
-  elements_per_sample_ = input->data.width() * input->data.height() * input->data.maps();
   input_ = input;
   
   return true;
@@ -94,16 +97,9 @@ void GradientAccumulationLayer::FeedForward() {
 }
 
 void GradientAccumulationLayer::BackPropagate() {
-  input_->delta.Clear();
-#pragma omp parallel for default(shared)
-  for(unsigned int s = 0; s < samples_; s++) {
-    unsigned int start_element = s * elements_per_sample_;
-    for(unsigned int e = 0; e < elements_per_sample_; e++) {
-      for(unsigned int i = 0; i < output_count_; i++) {
-        input_->delta[start_element + e] += outputs_[i]->delta[start_element + e];
-      }
-    }
-  }
+  // The first output's gradient is already there
+  for(unsigned int i = 1; i < output_count_; i++)
+    TensorMath::ADD(input_->delta, outputs_[i]->delta, input_->delta);
 }
 
 }
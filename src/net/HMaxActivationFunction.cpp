@@ -104,6 +104,10 @@ bool HMaxActivationFunction::Connect (const CombinedTensor* input,
   if(!valid)
     return false;
   
+  // Keep the parameters when the net is reshaped
+  if(weights_ != nullptr)
+    return true;
+  
   weights_ = new CombinedTensor(1, 2, 1, 1);
   weights_->data.Clear(1.0);
   weights_->delta.Clear();
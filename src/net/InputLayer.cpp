@@ -33,6 +33,9 @@ InputLayer::InputLayer ( Tensor& data ) : InputLayer ( data,
   data_->data.Shadow ( data );
   helper_->data.Shadow ( helper );
 
+  data_source_ = &data;
+  helper_source_ = &helper;
+
   LOGDEBUG << "Instance created.";
 }
 
@@ -73,9 +76,38 @@ InputLayer::InputLayer ( Tensor& data, Tensor& label, Tensor& helper,
   helper_->data.Shadow ( helper );
   weight_->data.Shadow ( weight );
 
+  data_source_ = &data;
+  label_source_ = &label;
+  helper_source_ = &helper;
+  weight_source_ = &weight;
   LOGDEBUG << "Instance created.";
 }
 
+void InputLayer::Reshape ( const unsigned int width, const unsigned int height,
+                           const unsigned int samples ) {
+  const std::size_t old_width = data_source_->width(), old_height = data_source_->height();
+  for ( Tensor* source : {data_source_, label_source_, helper_source_, weight_source_} ) {
+    if ( source == nullptr )
+      continue;
+
+    if ( source->width() == old_width && source->height() == old_height )
+      source->Resize ( samples, width, height, source->maps() );
+    else
+      source->Resize ( samples, source->width(), source->height(), source->maps() );
+  }
+
+  // Shadow the resized Tensors again
+  CombinedTensor* outputs[] = {data_, label_, helper_, weight_};
+  Tensor* sources[] = {data_source_, label_source_, helper_source_, weight_source_};
+  for ( unsigned int o = 0; o < 4; o++ ) {
+    if ( outputs[o] == nullptr )
+      continue;
+
+    outputs[o]->data.Shadow ( *sources[o] );
+    outputs[o]->delta.Resize ( *sources[o] );
+  }
+}
+
 bool InputLayer::Connect ( const std::vector< CombinedTensor* >& inputs,
                            const std::vector< CombinedTensor* >& outputs,
                            const NetStatus* net ) {
@@ -15,9 +15,14 @@
 #endif
 
 #include "ConvolutionLayer.h"
+#include "TransposedConvolutionLayer.h"
 #include "NonLinearityLayer.h"
 #include "MaxPoolingLayer.h"
 #include "AdvancedMaxPoolingLayer.h"
+#include "AveragePoolingLayer.h"
+#include "GlobalAveragePoolingLayer.h"
+#include "LocalResponseNormalizationLayer.h"
+#include "BatchNormalizationLayer.h"
 #include "GradientAccumulationLayer.h"
 #include "ResizeLayer.h"
 #include "HMaxActivationFunction.h"
@@ -87,8 +92,13 @@ Layer* LayerFactory::ConstructLayer(std::string descriptor) {
     // Leave layer a nullptr
   }
   CONV_LAYER_TYPE("convolution", ConvolutionLayer)
+  CONV_LAYER_TYPE("transposedconvolution", TransposedConvolutionLayer)
   CONV_LAYER_TYPE("maxpooling", MaxPoolingLayer)
   CONV_LAYER_TYPE("amaxpooling", AdvancedMaxPoolingLayer)
+  CONV_LAYER_TYPE("avgpooling", AveragePoolingLayer)
+  CONV_LAYER_TYPE("globalavgpooling", GlobalAveragePoolingLayer)
+  CONV_LAYER_TYPE("lrn", LocalResponseNormalizationLayer)
+  CONV_LAYER_TYPE("batchnorm", BatchNormalizationLayer)
   CONV_LAYER_TYPE("tanh", TanhLayer)
   CONV_LAYER_TYPE("sigm", SigmoidLayer)
   CONV_LAYER_TYPE("relu", ReLULayer)
@@ -3,190 +3,332 @@
  * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
  *
  * For licensing information, see the LICENSE file included with this project.
- */  
+ */
 #include <limits>
 #include <cmath>
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
 
 #include "Log.h"
 #include "LocalResponseNormalizationLayer.h"
-#include "TensorMath.h"
+#include "ConfigParsing.h"
 
 namespace Conv {
 
+/*
+ * Adds (sign = 1) or subtracts (sign = -1) a row of values to another
+ */
+static inline void AddRow (datum* target, const datum* source, const unsigned int width, const datum sign) {
+  unsigned int x = 0;
+#ifdef __SSE2__
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 normalization needs float datum");
+  const __m128 sign4 = _mm_set1_ps (sign);
+  for (; x + 4 <= width; x += 4)
+    _mm_storeu_ps (&target[x], _mm_add_ps (_mm_loadu_ps (&target[x]), _mm_mul_ps (sign4, _mm_loadu_ps (&source[x]))));
+#endif
+  for (; x < width; x++)
+    target[x] += sign * source[x];
+}
+
+/*
+ * For every row y, sums the rows y - before to y + after that exist.
+ *  The window moves by adding one row and removing another.
+ */
+static void SlidingRowSum (const datum* source, datum* target, const unsigned int width,
+                           const unsigned int height, const int before, const int after, datum* window) {
+  std::fill (window, window + width, 0);
+  for (int y = 0; y < (int)height && y <= after; y++)
+    AddRow (window, &source[y * width], width, 1);
+
+  for (int y = 0; y < (int)height; y++) {
+    std::copy (window, window + width, &target[y * width]);
+    if (y + 1 + after < (int)height)
+      AddRow (window, &source[(y + 1 + after) * width], width, 1);
+    if (y - before >= 0)
+      AddRow (window, &source[(y - before) * width], width, -1);
+  }
+}
+
+/*
+ * Replaces every value of a row by the sum of the values x - before to
+ *  x + after that exist
+ */
+static void SlidingSum (datum* row, const unsigned int width, const int before, const int after, datum* buffer) {
+  std::copy (row, row + width, buffer);
+  double window = 0;
+  for (int x = 0; x < (int)width && x <= after; x++)
+    window += buffer[x];
+
+  for (int x = 0; x < (int)width; x++) {
+    row[x] = (datum)window;
+    if (x + 1 + after < (int)width)
+      window += buffer[x + 1 + after];
+    if (x - before >= 0)
+      window -= buffer[x - before];
+  }
+}
+
+/*
+ * Number of positions between i - before and i + after that exist
+ */
+static inline unsigned int ClippedSize (const int i, const int length, const int before, const int after) {
+  return std::min (i + after, length - 1) - std::max (i - before, 0) + 1;
+}
+
+/*
+ * Calculates the denominators 1 + factor * sum, their -beta-th powers and the
+ *  normalized output for a row. Common exponents are done without pow.
+ */
+static inline void NormalizeRow (const datum* input, const datum* sums, const datum* factors,
+                                 const bool constant_factor, const datum beta, const unsigned int width,
+                                 datum* denominators, datum* scales, datum* output) {
+  unsigned int x = 0;
+#ifdef __SSE2__
+  const __m128 one = _mm_set1_ps (1.0f);
+  if (beta == (datum)0.75 || beta == (datum)0.5 || beta == (datum)1.0) {
+    for (; x + 4 <= width; x += 4) {
+      const __m128 factor = constant_factor ? _mm_set1_ps (factors[0]) : _mm_loadu_ps (&factors[x]);
+      const __m128 denominator = _mm_add_ps (one, _mm_mul_ps (factor, _mm_max_ps (_mm_loadu_ps (&sums[x]), _mm_setzero_ps())));
+      __m128 scale;
+      if (beta == (datum)0.75)
+        scale = _mm_div_ps (one, _mm_sqrt_ps (_mm_mul_ps (denominator, _mm_sqrt_ps (denominator))));
+      else if (beta == (datum)0.5)
+        scale = _mm_div_ps (one, _mm_sqrt_ps (denominator));
+      else
+        scale = _mm_div_ps (one, denominator);
+      _mm_storeu_ps (&denominators[x], denominator);
+      _mm_storeu_ps (&scales[x], scale);
+      _mm_storeu_ps (&output[x], _mm_mul_ps (scale, _mm_loadu_ps (&input[x])));
+    }
+  }
+#endif
+  for (; x < width; x++) {
+    // Sliding sums can drift slightly below zero
+    const datum denominator = (datum)1.0 + factors[constant_factor ? 0 : x] * std::max (sums[x], (datum)0);
+    const datum scale = std::pow (denominator, -beta);
+    denominators[x] = denominator;
+    scales[x] = scale;
+    output[x] = scale * input[x];
+  }
+}
+
 LocalResponseNormalizationLayer::
   LocalResponseNormalizationLayer(const unsigned int size,
     const datum alpha, const datum beta,
     const LocalResponseNormalizationLayer::NormalizationMethod normalization_method) :
   SimpleLayer(""),
   size_(size), alpha_(alpha), beta_(beta), normalization_method_(normalization_method) {
-  LOGDEBUG << "Instance created, size: " << size_ << ", alpha: " << alpha_ 
+  LOGDEBUG << "Instance created, size: " << size_ << ", alpha: " << alpha_
   << ", beta: " << beta_ << ", method: " << ((normalization_method_ == ACROSS_CHANNELS) ? "across" : "within");
 
 }
 
+LocalResponseNormalizationLayer::LocalResponseNormalizationLayer(std::string configuration) :
+  SimpleLayer(configuration) {
+  size_ = 1;
+  alpha_ = 1;
+  beta_ = 1;
+  normalization_method_ = ACROSS_CHANNELS;
+
+  std::string method_string;
+  ParseStringParamIfPossible(configuration, "method", method_string);
+  if(method_string.compare(0,6,"within") == 0)
+    normalization_method_ = WITHIN_CHANNELS;
+
+  ParseCountIfPossible(configuration, "size", size_);
+  ParseDatumParamIfPossible(configuration, "alpha", alpha_);
+  ParseDatumParamIfPossible(configuration, "beta", beta_);
+
+  LOGDEBUG << "Instance created, size: " << size_ << ", alpha: " << alpha_
+  << ", beta: " << beta_ << ", method: " << ((normalization_method_ == ACROSS_CHANNELS) ? "across" : "within");
+}
+
 bool LocalResponseNormalizationLayer::
   CreateOutputs(const std::vector< CombinedTensor* >& inputs,
   std::vector< CombinedTensor* >& outputs) {
-  // This is a simple layer, only one input  
+  // This is a simple layer, only one input
   if (inputs.size() != 1) {
     LOGERROR << "Only one input supported!";
     return false;
   }
-  
+
   // Save input node pointer
   CombinedTensor* input = inputs[0];
-  
+
   // Check if input node pointer is null
   if (input == nullptr) {
     LOGERROR << "Null pointer input node!";
     return false;
   }
-  
+
   // Create ouput
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
     input->data.width(), input->data.height(), input->data.maps());
-  
+
   // Tell network about the output
   outputs.push_back(output);
-  
+
   return true;
 }
 
 bool LocalResponseNormalizationLayer::
   Connect(const CombinedTensor* input, CombinedTensor* output) {
-  UNREFERENCED_PARAMETER(output);
-  // TODO Validate dimensions
-  bool valid = true;
+  bool valid = size_ > 0 &&
+    input->data.samples() == output->data.samples() &&
+    input->data.width() == output->data.width() &&
+    input->data.height() == output->data.height() &&
+    input->data.maps() == output->data.maps();
 
   if (!valid) {
     LOGERROR << "Invalid dimensions!";
     return false;
   }
-    
+
   // Save dimensions
   input_width_ = input->data.width();
   input_height_ = input->data.height();
   maps_ = input->data.maps();
-  
-  
-  // Resize region sum buffer
-  region_sums_.Resize(input->data.samples(), input_width_, input_height_, maps_);
-  
+
+  // The regions are clipped at the borders, so their sizes vary
+  const int sub = (size_-1)/2;
+  const int add = (size_)/2;
+  if(normalization_method_ == WITHIN_CHANNELS) {
+    alpha_over_size_.resize(input_width_ * input_height_);
+    for(unsigned int y = 0; y < input_height_; y++)
+      for(unsigned int x = 0; x < input_width_; x++)
+        alpha_over_size_[y * input_width_ + x] = alpha_ / (datum)(ClippedSize(x, input_width_, sub, add) * ClippedSize(y, input_height_, sub, add));
+  } else {
+    alpha_over_size_.resize(maps_);
+    for(unsigned int map = 0; map < maps_; map++)
+      alpha_over_size_[map] = alpha_ / (datum)ClippedSize(map, maps_, sub, add);
+  }
+
+  denominators_.Resize(input->data.samples(), input_width_, input_height_, maps_);
+  scales_.Resize(input->data.samples(), input_width_, input_height_, maps_);
+
   return true;
 }
 
 void LocalResponseNormalizationLayer::FeedForward() {
   const int sub = (size_-1)/2;
   const int add = (size_)/2;
+  const std::size_t plane_size = (std::size_t)input_width_ * input_height_;
+  const std::size_t planes = (std::size_t)input_->data.samples() * maps_;
+  const datum* input = input_->data.data_ptr_const();
+  datum* output = output_->data.data_ptr();
+  datum* denominators = denominators_.data_ptr();
+  datum* scales = scales_.data_ptr();
+
+  // Squares go into the scales until they are replaced
   #pragma omp parallel for default(shared)
-  for(unsigned int sample = 0; sample < input_->data.samples(); sample++) {
-    if(normalization_method_ == WITHIN_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = 0;
-            unsigned int region_size = 0;
-            for(unsigned int iy = (((int)y-sub) > 0 ? (int)y-sub : 0); (iy < input_height_) && (iy <= ((int)y+add)); iy++) {
-              for(unsigned int ix = (((int)x-sub) > 0 ? (int)x-sub : 0); (ix < input_width_) && (ix <= ((int)x+add)); ix++) {
-                const datum input_value = (*input_->data.data_ptr_const(ix,iy,map,sample));
-                region_sum += input_value * input_value;
-                region_size++;
-              }
-            }
-            
-            (*region_sums_.data_ptr(x,y,map,sample)) = region_sum;
-            datum divisor = pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            (*output_->data.data_ptr(x,y,map,sample)) = (*input_->data.data_ptr_const(x,y,map,sample)) / divisor;
-          }
-        }
+  for(std::size_t plane = 0; plane < planes; plane++) {
+    for(std::size_t e = plane * plane_size; e < (plane + 1) * plane_size; e++)
+      scales[e] = input[e] * input[e];
+  }
+
+  // Region sums go into the denominators
+  if(normalization_method_ == WITHIN_CHANNELS) {
+    #pragma omp parallel default(shared)
+    {
+      std::vector<datum> window(input_width_);
+      std::vector<datum> row(input_width_);
+      #pragma omp for
+      for(std::size_t plane = 0; plane < planes; plane++) {
+        datum* sums = &denominators[plane * plane_size];
+        SlidingRowSum(&scales[plane * plane_size], sums, input_width_, input_height_, sub, add, window.data());
+        for(unsigned int y = 0; y < input_height_; y++)
+          SlidingSum(&sums[y * input_width_], input_width_, sub, add, row.data());
       }
-    } else if(normalization_method_ == ACROSS_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = 0;
-            unsigned int region_size = 0;
-            for(unsigned int imap = (((int)map-sub) > 0 ? (int)map-sub : 0); (imap < maps_) && (imap <= ((int)map+add)); imap++) {
-              const datum input_value = (*input_->data.data_ptr_const(x,y,imap,sample));
-              region_sum += input_value * input_value;
-              region_size++;
-            }
-            
-            (*region_sums_.data_ptr(x,y,map,sample)) = region_sum;
-            datum divisor = pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            (*output_->data.data_ptr(x,y,map,sample)) = (*input_->data.data_ptr_const(x,y,map,sample)) / divisor;
-          }
-        }
+    }
+  } else if(normalization_method_ == ACROSS_CHANNELS) {
+    #pragma omp parallel default(shared)
+    {
+      std::vector<datum> window(plane_size);
+      #pragma omp for
+      for(unsigned int sample = 0; sample < input_->data.samples(); sample++) {
+        const std::size_t offset = (std::size_t)sample * maps_ * plane_size;
+        SlidingRowSum(&scales[offset], &denominators[offset], plane_size, maps_, sub, add, window.data());
       }
-    } else {
-      FATAL("Unknown normalization method");
+    }
+  } else {
+    FATAL("Unknown normalization method");
+  }
+
+  // Normalize row by row
+  #pragma omp parallel for default(shared)
+  for(std::size_t plane = 0; plane < planes; plane++) {
+    const unsigned int map = plane % maps_;
+    for(unsigned int y = 0; y < input_height_; y++) {
+      const std::size_t offset = plane * plane_size + (std::size_t)y * input_width_;
+      const datum* factors = normalization_method_ == WITHIN_CHANNELS ?
+        &alpha_over_size_[y * input_width_] : &alpha_over_size_[map];
+      NormalizeRow(&input[offset], &denominators[offset], factors, normalization_method_ == ACROSS_CHANNELS,
+                   beta_, input_width_, &denominators[offset], &scales[offset], &output[offset]);
     }
   }
 }
 
 void LocalResponseNormalizationLayer::BackPropagate() {
-  TensorMath::SETSAMPLE(input_->delta, -1, 0);
-  
-  
+  // d/dx_j = dy_j * scale_j - x_j * sum over the regions i containing j of
+  //  dy_i * x_i * 2 * beta * alpha/n_i * scale_i / denominator_i.
+  //  The regions containing j form the mirrored window around j.
   const int sub = (size_-1)/2;
   const int add = (size_)/2;
+  const std::size_t plane_size = (std::size_t)input_width_ * input_height_;
+  const std::size_t planes = (std::size_t)input_->data.samples() * maps_;
+  const datum* input = input_->data.data_ptr_const();
+  const datum* output_delta = output_->delta.data_ptr_const();
+  const datum* denominators = denominators_.data_ptr_const();
+  const datum* scales = scales_.data_ptr_const();
+  datum* input_delta = input_->delta.data_ptr();
+
+  // The coefficients go into the input deltas until they are replaced
   #pragma omp parallel for default(shared)
-  for(unsigned int sample = 0; sample < input_->data.samples(); sample++) {
-    if(normalization_method_ == WITHIN_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = (*region_sums_.data_ptr_const(x,y,map,sample));
-            unsigned int region_size = 0;
-            for(unsigned int iy = (((int)y-sub) > 0 ? (int)y-sub : 0); (iy < input_height_) && (iy <= ((int)y+add)); iy++) {
-              for(unsigned int ix = (((int)x-sub) > 0 ? (int)x-sub : 0); (ix < input_width_) && (ix <= ((int)x+add)); ix++) {
-                region_size++;
-              }
-            }
-            
-            datum divisor = pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            datum divisor2 = divisor * divisor;
-            const datum xi = *input_->data.data_ptr_const(x,y,map,sample);
-            const datum dxi = *output_->delta.data_ptr_const(x,y,map,sample);
-            
-            for(unsigned int iy = (((int)y-sub) > 0 ? (int)y-sub : 0); (iy < input_height_) && (iy <= ((int)y+add)); iy++) {
-              for(unsigned int ix = (((int)x-sub) > 0 ? (int)x-sub : 0); (ix < input_width_) && (ix <= ((int)x+add)); ix++) {
-                const datum xj = *input_->data.data_ptr_const(ix,iy,map,sample);
-                (*input_->delta.data_ptr(ix,iy,map,sample)) -= (dxi * xi * (datum)2.0 * beta_ * (alpha_ / (datum)region_size) * xj *
-                  (datum)pow((datum)1.0 + (alpha_ / (datum)region_size) * region_sum, beta_ - (datum)1.0)) / divisor2;
-              }
-            }
-            (*input_->delta.data_ptr(x,y,map,sample)) += dxi / divisor;
-          }
+  for(std::size_t plane = 0; plane < planes; plane++) {
+    const unsigned int map = plane % maps_;
+    for(std::size_t p = 0; p < plane_size; p++) {
+      const std::size_t e = plane * plane_size + p;
+      const datum factor = alpha_over_size_[normalization_method_ == WITHIN_CHANNELS ? p : map];
+      input_delta[e] = (datum)2.0 * beta_ * factor * output_delta[e] * input[e] * scales[e] / denominators[e];
+    }
+  }
+
+  if(normalization_method_ == WITHIN_CHANNELS) {
+    #pragma omp parallel default(shared)
+    {
+      std::vector<datum> window(input_width_);
+      std::vector<datum> row(input_width_);
+      std::vector<datum> sums(plane_size);
+      #pragma omp for
+      for(std::size_t plane = 0; plane < planes; plane++) {
+        SlidingRowSum(&input_delta[plane * plane_size], sums.data(), input_width_, input_height_, add, sub, window.data());
+        for(unsigned int y = 0; y < input_height_; y++)
+          SlidingSum(&sums[y * input_width_], input_width_, add, sub, row.data());
+        for(std::size_t p = 0; p < plane_size; p++) {
+          const std::size_t e = plane * plane_size + p;
+          input_delta[e] = output_delta[e] * scales[e] - input[e] * sums[p];
         }
       }
-    } else if(normalization_method_ == ACROSS_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = (*region_sums_.data_ptr_const(x,y,map,sample));
-            unsigned int region_size = 0;
-            for(unsigned int imap = (((int)map-sub) > 0 ? (int)map-sub : 0); (imap < maps_) && (imap <= ((int)map+add)); imap++) {
-              region_size++;
-            }
-            
-            datum divisor = pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            datum divisor2 = divisor * divisor;
-            const datum xi = *input_->data.data_ptr_const(x,y,map,sample);
-            const datum dxi = *output_->delta.data_ptr_const(x,y,map,sample);
-            
-            for(unsigned int imap = (((int)map-sub) > 0 ? (int)map-sub : 0); (imap < maps_) && (imap <= ((int)map+add)); imap++) {
-                const datum xj = *input_->data.data_ptr_const(x,y,imap,sample);
-                (*input_->delta.data_ptr(x,y,imap,sample)) -= (dxi * xi * (datum)2.0 * beta_ * (alpha_ / (datum)region_size) * xj *
-                  (datum)pow((datum)1.0 + (alpha_ / (datum)region_size) * region_sum, beta_ - (datum)1.0)) / divisor2;
-            }
-            (*input_->delta.data_ptr(x,y,map,sample)) += dxi / divisor;
-          }
-        }
+    }
+  } else if(normalization_method_ == ACROSS_CHANNELS) {
+    #pragma omp parallel default(shared)
+    {
+      std::vector<datum> window(plane_size);
+      std::vector<datum> sums(maps_ * plane_size);
+      #pragma omp for
+      for(unsigned int sample = 0; sample < input_->data.samples(); sample++) {
+        const std::size_t offset = (std::size_t)sample * maps_ * plane_size;
+        SlidingRowSum(&input_delta[offset], sums.data(), plane_size, maps_, add, sub, window.data());
+        for(std::size_t p = 0; p < maps_ * plane_size; p++)
+          input_delta[offset + p] = output_delta[offset + p] * scales[offset + p] - input[offset + p] * sums[p];
       }
-    } else {
-      FATAL("Unknown normalization method");
     }
+  } else {
+    FATAL("Unknown normalization method");
   }
 }
 
@@ -5,6 +5,13 @@
  * For licensing information, see the LICENSE file included with this project.
  */  
 #include <limits>
+#include <cstdint>
+#include <vector>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
 
 #include "Log.h"
 #include "CLHelper.h"
@@ -17,6 +24,208 @@
 
 namespace Conv {
 
+/*
+ * Finds the maximum of each pooling region and its row-major offset inside
+ * the region. RW and RH are the region size if it is known at compile time,
+ * zero otherwise.
+ */
+template <typename IndexType, unsigned int RW, unsigned int RH>
+static void MaxPoolingForward (const datum* input, datum* output, IndexType* offsets,
+                               const std::size_t planes, const unsigned int input_width,
+                               const unsigned int input_height, const unsigned int output_width,
+                               const unsigned int output_height, const unsigned int rw,
+                               const unsigned int rh) {
+  const unsigned int region_width = RW > 0 ? RW : rw;
+  const unsigned int region_height = RH > 0 ? RH : rh;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    const datum* input_plane = &input[plane * input_width * input_height];
+    datum* output_plane = &output[plane * output_width * output_height];
+    IndexType* offset_plane = &offsets[plane * output_width * output_height];
+
+    for (unsigned int oy = 0; oy < output_height; oy++) {
+      const datum* input_row = &input_plane[oy * region_height * input_width];
+      datum* output_row = &output_plane[oy * output_width];
+      IndexType* offset_row = &offset_plane[oy * output_width];
+      unsigned int ox = 0;
+
+#ifdef __SSE2__
+      static_assert(sizeof(datum) == sizeof(float), "SSE2 pooling needs float datum");
+      if (RW == 2 || RW == 4) {
+        // Four regions at once, values[rx] holds element rx of each region
+        for (; ox + 4 <= output_width; ox += 4) {
+          __m128 maximum = _mm_set1_ps (std::numeric_limits<datum>::lowest());
+          __m128i offset = _mm_setzero_si128();
+
+          for (unsigned int ry = 0; ry < region_height; ry++) {
+            const datum* region_row = &input_row[ry * input_width + ox * region_width];
+            __m128 values[4];
+            if (RW == 2) {
+              const __m128 a = _mm_loadu_ps (region_row);
+              const __m128 b = _mm_loadu_ps (region_row + 4);
+              values[0] = _mm_shuffle_ps (a, b, _MM_SHUFFLE (2, 0, 2, 0));
+              values[1] = _mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 1, 3, 1));
+            } else {
+              values[0] = _mm_loadu_ps (region_row);
+              values[1] = _mm_loadu_ps (region_row + 4);
+              values[2] = _mm_loadu_ps (region_row + 8);
+              values[3] = _mm_loadu_ps (region_row + 12);
+              _MM_TRANSPOSE4_PS (values[0], values[1], values[2], values[3]);
+            }
+
+            for (unsigned int rx = 0; rx < region_width; rx++) {
+              const __m128 greater = _mm_cmpgt_ps (values[rx], maximum);
+              const __m128i greater_mask = _mm_castps_si128 (greater);
+              maximum = _mm_or_ps (_mm_and_ps (greater, values[rx]), _mm_andnot_ps (greater, maximum));
+              offset = _mm_or_si128 (_mm_and_si128 (greater_mask, _mm_set1_epi32 (ry * region_width + rx)),
+                                     _mm_andnot_si128 (greater_mask, offset));
+            }
+          }
+
+          _mm_storeu_ps (&output_row[ox], maximum);
+          int32_t packed_offsets[4];
+          _mm_storeu_si128 ((__m128i*)packed_offsets, offset);
+          for (unsigned int i = 0; i < 4; i++)
+            offset_row[ox + i] = (IndexType)packed_offsets[i];
+        }
+      }
+#endif
+
+      for (; ox < output_width; ox++) {
+        datum maximum = std::numeric_limits<datum>::lowest();
+        unsigned int offset = 0;
+        for (unsigned int ry = 0; ry < region_height; ry++) {
+          const datum* region_row = &input_row[ry * input_width + ox * region_width];
+          for (unsigned int rx = 0; rx < region_width; rx++) {
+            if (region_row[rx] > maximum) {
+              maximum = region_row[rx];
+              offset = ry * region_width + rx;
+            }
+          }
+        }
+        output_row[ox] = maximum;
+        offset_row[ox] = (IndexType)offset;
+      }
+    }
+  }
+}
+
+/*
+ * Writes each output delta to the position of its maximum and zeros the rest
+ * of the region, so the input delta doesn't need to be cleared first.
+ */
+template <typename IndexType, unsigned int RW, unsigned int RH>
+static void MaxPoolingBackward (datum* input_delta, const datum* output_delta,
+                                const IndexType* offsets, const std::size_t planes,
+                                const unsigned int input_width, const unsigned int input_height,
+                                const unsigned int output_width, const unsigned int output_height,
+                                const unsigned int rw, const unsigned int rh) {
+  const unsigned int region_width = RW > 0 ? RW : rw;
+  const unsigned int region_height = RH > 0 ? RH : rh;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    datum* input_plane = &input_delta[plane * input_width * input_height];
+    const datum* output_plane = &output_delta[plane * output_width * output_height];
+    const IndexType* offset_plane = &offsets[plane * output_width * output_height];
+
+    for (unsigned int oy = 0; oy < output_height; oy++) {
+      datum* input_row = &input_plane[oy * region_height * input_width];
+      const datum* output_row = &output_plane[oy * output_width];
+      const IndexType* offset_row = &offset_plane[oy * output_width];
+
+      for (unsigned int ry = 0; ry < region_height; ry++) {
+        datum* region_row = &input_row[ry * input_width];
+        for (unsigned int ox = 0; ox < output_width; ox++) {
+          const unsigned int offset = offset_row[ox];
+          for (unsigned int rx = 0; rx < region_width; rx++) {
+            region_row[ox * region_width + rx] =
+              (offset == ry * region_width + rx) ? output_row[ox] : 0;
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Picks the kernel specialized for the region size
+ */
+template <typename IndexType>
+static void MaxPoolingForwardDispatch (const datum* input, datum* output, IndexType* offsets,
+                                       const std::size_t planes, const unsigned int input_width,
+                                       const unsigned int input_height, const unsigned int output_width,
+                                       const unsigned int output_height, const unsigned int rw,
+                                       const unsigned int rh) {
+  if (rw == 2 && rh == 2)
+    MaxPoolingForward<IndexType, 2, 2> (input, output, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+  else if (rw == 3 && rh == 3)
+    MaxPoolingForward<IndexType, 3, 3> (input, output, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+  else if (rw == 4 && rh == 4)
+    MaxPoolingForward<IndexType, 4, 4> (input, output, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+  else
+    MaxPoolingForward<IndexType, 0, 0> (input, output, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+}
+
+template <typename IndexType>
+static void MaxPoolingBackwardDispatch (datum* input_delta, const datum* output_delta,
+                                        const IndexType* offsets, const std::size_t planes,
+                                        const unsigned int input_width, const unsigned int input_height,
+                                        const unsigned int output_width, const unsigned int output_height,
+                                        const unsigned int rw, const unsigned int rh) {
+  if (rw == 2 && rh == 2)
+    MaxPoolingBackward<IndexType, 2, 2> (input_delta, output_delta, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+  else if (rw == 3 && rh == 3)
+    MaxPoolingBackward<IndexType, 3, 3> (input_delta, output_delta, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+  else if (rw == 4 && rh == 4)
+    MaxPoolingBackward<IndexType, 4, 4> (input_delta, output_delta, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+  else
+    MaxPoolingBackward<IndexType, 0, 0> (input_delta, output_delta, offsets, planes, input_width, input_height, output_width, output_height, rw, rh);
+}
+
+/*
+ * Runs the kernels on 16-bit buffers one plane at a time, converting the
+ * planes to datums and back
+ */
+template <typename IndexType>
+static void MaxPoolingForwardConverted (const Tensor& input, Tensor& output, IndexType* offsets,
+                                        const std::size_t planes, const unsigned int input_width,
+                                        const unsigned int input_height, const unsigned int output_width,
+                                        const unsigned int output_height, const unsigned int rw,
+                                        const unsigned int rh) {
+  const std::size_t input_plane_size = input_width * input_height;
+  const std::size_t output_plane_size = output_width * output_height;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    std::vector<datum> input_plane (input_plane_size), output_plane (output_plane_size);
+    input.UnpackElements (plane * input_plane_size, input_plane_size, input_plane.data());
+    MaxPoolingForwardDispatch<IndexType> (input_plane.data(), output_plane.data(),
+      &offsets[plane * output_plane_size], 1, input_width, input_height, output_width, output_height, rw, rh);
+    output.PackElements (plane * output_plane_size, output_plane_size, output_plane.data());
+  }
+}
+
+template <typename IndexType>
+static void MaxPoolingBackwardConverted (Tensor& input_delta, const Tensor& output_delta,
+                                         const IndexType* offsets, const std::size_t planes,
+                                         const unsigned int input_width, const unsigned int input_height,
+                                         const unsigned int output_width, const unsigned int output_height,
+                                         const unsigned int rw, const unsigned int rh) {
+  const std::size_t input_plane_size = input_width * input_height;
+  const std::size_t output_plane_size = output_width * output_height;
+
+#pragma omp parallel for default(shared)
+  for (std::size_t plane = 0; plane < planes; plane++) {
+    std::vector<datum> input_plane (input_plane_size), output_plane (output_plane_size);
+    output_delta.UnpackElements (plane * output_plane_size, output_plane_size, output_plane.data());
+    MaxPoolingBackwardDispatch<IndexType> (input_plane.data(), output_plane.data(),
+      &offsets[plane * output_plane_size], 1, input_width, input_height, output_width, output_height, rw, rh);
+    input_delta.PackElements (plane * input_plane_size, input_plane_size, input_plane.data());
+  }
+}
+
 MaxPoolingLayer::MaxPoolingLayer (const unsigned int region_width,
                                   const unsigned int region_height) :
   SimpleLayer(""),
@@ -91,11 +300,19 @@ bool MaxPoolingLayer::Connect (const CombinedTensor* input,
   maximum_mask_.Resize (input->data.samples(), input_width_,
 			input_height_, maps_);
 #else
-  // Create maximum Tensor
-  maximum_ix_.Resize (input->data.samples(), output_width_,
-                      output_height_, maps_);
-  maximum_iy_.Resize (input->data.samples(), output_width_,
-                      output_height_, maps_);
+  // Store the position of each maximum inside its region
+  const std::size_t region_size = region_width_ * region_height_;
+  const std::size_t output_elements = output->data.elements();
+  maximum_offsets8_.clear();
+  maximum_offsets16_.clear();
+  if (region_size <= 256) {
+    maximum_offsets8_.resize (output_elements);
+  } else if (region_size <= 65536) {
+    maximum_offsets16_.resize (output_elements);
+  } else {
+    LOGERROR << "Pooling regions are too large!";
+    return false;
+  }
 #endif
 
   return true;
@@ -138,41 +355,25 @@ void MaxPoolingLayer::FeedForward() {
 #endif
 
 #else
-#pragma omp parallel for default(shared)
-  for (std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ox = 0; ox < output_width_; ox++) {
-        for (unsigned int oy = 0; oy < output_height_; oy++) {
-          // Find maximum in region
-          datum maximum = std::numeric_limits<datum>::lowest();
-          unsigned int mix = 0;
-          unsigned int miy = 0;
-          for (unsigned int ix = ox * region_width_;
-               ix < (ox + 1) * region_width_; ix++) {
-            for (unsigned int iy = oy * region_height_;
-                 iy < (oy + 1) *region_height_; iy++) {
-              const datum ival =
-                *input_->data.data_ptr_const (ix, iy, map, sample);
-              if (ival > maximum) {
-                maximum = ival;
-                mix = ix;
-                miy = iy;
-		// mix = ox * region_width_;
-		// miy = oy * region_height_;
-              }
-            }
-          }
-          
-          // Found maximum, save
-          *maximum_ix_.data_ptr(ox, oy, map, sample) = mix;
-          *maximum_iy_.data_ptr(ox, oy, map, sample) = miy;
-          
-          // Feed forward
-          *output_->data.data_ptr(ox, oy, map, sample) = maximum;
-        }
-      }
-    }
+  const std::size_t planes = input_->data.samples() * maps_;
+  if (input_->data.storage() != STORAGE_FLOAT32 || output_->data.storage() != STORAGE_FLOAT32) {
+    if (maximum_offsets8_.size() > 0)
+      MaxPoolingForwardConverted<uint8_t> (input_->data, output_->data, maximum_offsets8_.data(), planes,
+        input_width_, input_height_, output_width_, output_height_, region_width_, region_height_);
+    else
+      MaxPoolingForwardConverted<uint16_t> (input_->data, output_->data, maximum_offsets16_.data(), planes,
+        input_width_, input_height_, output_width_, output_height_, region_width_, region_height_);
+    return;
   }
+
+  if (maximum_offsets8_.size() > 0)
+    MaxPoolingForwardDispatch<uint8_t> (input_->data.data_ptr_const(), output_->data.data_ptr(),
+      maximum_offsets8_.data(), planes, input_width_, input_height_, output_width_, output_height_,
+      region_width_, region_height_);
+  else
+    MaxPoolingForwardDispatch<uint16_t> (input_->data.data_ptr_const(), output_->data.data_ptr(),
+      maximum_offsets16_.data(), planes, input_width_, input_height_, output_width_, output_height_,
+      region_width_, region_height_);
 #endif
 }
 
@@ -213,24 +414,25 @@ void MaxPoolingLayer::BackPropagate() {
 #endif
 
 #else
-  input_->delta.Clear();
-  
-#pragma omp parallel for default(shared)
-  for(std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ox = 0; ox < output_width_; ox++) {
-        for (unsigned int oy = 0; oy < output_height_; oy++) {
-          unsigned int ix = *maximum_ix_.data_ptr_const(ox, oy, map, sample);
-          unsigned int iy = *maximum_iy_.data_ptr_const(ox, oy, map, sample);
-          *(input_->delta.data_ptr(ix, iy, map, sample)) = 
-             *output_->delta.data_ptr_const(ox, oy, map, sample);
-        }
-      }
-    }
+  const std::size_t planes = input_->data.samples() * maps_;
+  if (input_->delta.storage() != STORAGE_FLOAT32 || output_->delta.storage() != STORAGE_FLOAT32) {
+    if (maximum_offsets8_.size() > 0)
+      MaxPoolingBackwardConverted<uint8_t> (input_->delta, output_->delta, maximum_offsets8_.data(), planes,
+        input_width_, input_height_, output_width_, output_height_, region_width_, region_height_);
+    else
+      MaxPoolingBackwardConverted<uint16_t> (input_->delta, output_->delta, maximum_offsets16_.data(), planes,
+        input_width_, input_height_, output_width_, output_height_, region_width_, region_height_);
+    return;
   }
-  
-  return;
-  
+
+  if (maximum_offsets8_.size() > 0)
+    MaxPoolingBackwardDispatch<uint8_t> (input_->delta.data_ptr(), output_->delta.data_ptr_const(),
+      maximum_offsets8_.data(), planes, input_width_, input_height_, output_width_, output_height_,
+      region_width_, region_height_);
+  else
+    MaxPoolingBackwardDispatch<uint16_t> (input_->delta.data_ptr(), output_->delta.data_ptr_const(),
+      maximum_offsets16_.data(), planes, input_width_, input_height_, output_width_, output_height_,
+      region_width_, region_height_);
 #endif
 }
 
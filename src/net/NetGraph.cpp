@@ -13,6 +13,7 @@
 #include "TrainingLayer.h"
 #include "GradientAccumulationLayer.h"
 #include "StatLayer.h"
+#include "InputLayer.h"
 
 #include "NetGraph.h"
 #include "NetGraphNode.h"
@@ -169,6 +170,10 @@ void NetGraph::PrintGraph(std::ostream& graph_output) {
 			
 		node_output << " label=\""
 			<< "{ <i> " << node->unique_name << ": " << node->layer->GetLayerDescription();
+		if (node->in_place)
+			node_output << " (in place)";
+		if (node->inputs_in_place > 0)
+			node_output << " (" << node->inputs_in_place << " of " << node->input_connections.size() << " inputs in place)";
 		if (node->output_buffers.size() > 1) {
 			node_output << "| {";
 			for (unsigned int i = 0; i < node->output_buffers.size(); i++) {
@@ -270,6 +275,18 @@ void NetGraph::InitializeNode(NetGraphNode* node) {
 			FATAL("Layer will not create outputs: " << node->layer->GetLayerDescription() << ", input0: " << input_tensors[0]->data);
     }
 
+		// Let the layer overwrite its input if no one else needs it
+		if (CanRunInPlace(node) && output_tensors.size() == 1) {
+			delete output_tensors[0];
+			output_tensors[0] = input_tensors[0];
+			node->in_place = true;
+			LOGDEBUG << "Running in place: " << node->layer->GetLayerDescription();
+		}
+
+		// Let the inputs write their maps directly into the output
+		if (node->layer->IsConcatenatingMaps() && output_tensors.size() == 1)
+			ViewInputsInOutput(node, input_tensors, output_tensors[0]);
+
 		// Verify output buffer count
 		if (output_tensors.size() != node->output_buffers.size())
 			FATAL("Node created wrong number of output buffers!");
@@ -289,6 +306,217 @@ void NetGraph::InitializeNode(NetGraphNode* node) {
 	}
 }
 
+bool NetGraph::Reshape(const unsigned int width, const unsigned int height, const unsigned int samples) {
+	if (width == 0 || height == 0 || samples == 0) {
+		LOGERROR << "Cannot reshape to " << samples << "s@" << width << "x" << height;
+		return false;
+	}
+
+	// The user's tensors change their size first
+	for (NetGraphNode* node : input_nodes_) {
+		InputLayer* input_layer = dynamic_cast<InputLayer*>(node->layer);
+		if (input_layer == nullptr) {
+			LOGERROR << "Cannot reshape input: " << node->layer->GetLayerDescription();
+			return false;
+		}
+		input_layer->Reshape(width, height, samples);
+	}
+
+	for (NetGraphNode* node : nodes_)
+		node->initialized = false;
+
+	for (NetGraphNode* node : nodes_) {
+		if (!ReshapeNode(node))
+			return false;
+	}
+
+	return true;
+}
+
+bool NetGraph::ReshapeNode(NetGraphNode* node) {
+	if (node->initialized)
+		return true;
+
+	std::vector<CombinedTensor*> input_tensors;
+	for (NetGraphConnection connection : node->input_connections) {
+		if (!ReshapeNode(connection.node))
+			return false;
+		input_tensors.push_back(connection.node->output_buffers[connection.buffer].combined_tensor);
+	}
+
+	// The layer tells us the new sizes
+	std::vector<CombinedTensor*> output_tensors;
+	if (!node->layer->CreateOutputs(input_tensors, output_tensors) ||
+		output_tensors.size() != node->output_buffers.size()) {
+		LOGERROR << "Layer will not create outputs: " << node->layer->GetLayerDescription() << ", input0: " << input_tensors[0]->data;
+		return false;
+	}
+
+	for (unsigned int b = 0; b < output_tensors.size(); b++) {
+		CombinedTensor* existing = node->output_buffers[b].combined_tensor;
+		CombinedTensor* created = output_tensors[b];
+		if (created == existing)
+			continue;
+
+		if (node->in_place) {
+			delete created;
+			output_tensors[b] = input_tensors[0];
+		} else if (existing->data.IsShadow() || existing->delta.IsShadow() ||
+			created->data.IsShadow() || created->delta.IsShadow()) {
+			// Shadows and views own no memory worth keeping
+			delete existing;
+		} else {
+			// Keep the existing memory where it is large enough
+			existing->data.Resize(created->data);
+			existing->delta.Resize(created->delta);
+			delete created;
+			output_tensors[b] = existing;
+		}
+		node->output_buffers[b].combined_tensor = output_tensors[b];
+	}
+
+	if (node->layer->IsConcatenatingMaps() && output_tensors.size() == 1) {
+		node->inputs_in_place = 0;
+		ViewInputsInOutput(node, input_tensors, output_tensors[0]);
+	}
+
+	if (!node->layer->Connect(input_tensors, output_tensors, this)) {
+		LOGERROR << "Layer will not connect: " << node->layer->GetLayerDescription();
+		return false;
+	}
+
+	node->initialized = true;
+	return true;
+}
+
+bool NetGraph::SetActivationStorage(TensorStorage storage) {
+#ifdef BUILD_OPENCL
+	UNREFERENCED_PARAMETER(storage);
+	LOGERROR << "16-bit activations are not supported with OpenCL!";
+	return false;
+#else
+	// A buffer is excluded if a layer that uses it cannot convert it or
+	//  if it is read from outside the net
+	std::vector<CombinedTensor*> candidates, excluded;
+	for (NetGraphNode* node : nodes_) {
+		const bool capable = node->layer->IsHalfPrecisionCapable();
+		for (NetGraphBuffer& buffer : node->output_buffers)
+			(capable && !node->is_input && !node->is_output ? candidates : excluded).push_back(buffer.combined_tensor);
+		if (!capable)
+			for (NetGraphConnection& connection : node->input_connections)
+				excluded.push_back(connection.node->output_buffers[connection.buffer].combined_tensor);
+	}
+
+	std::size_t buffers = 0, bytes = 0;
+	for (CombinedTensor* buffer : candidates) {
+		if (std::find(excluded.begin(), excluded.end(), buffer) != excluded.end() ||
+			buffer->data.IsShadow() || buffer->delta.IsShadow() || buffer->data.storage() == storage)
+			continue;
+		if (!buffer->data.SetStorage(storage) || !buffer->delta.SetStorage(storage))
+			return false;
+		buffers++;
+		bytes += (buffer->data.elements() + buffer->delta.elements()) * HalfPrecision::ElementSize(storage);
+	}
+
+	LOGDEBUG << "Stored " << buffers << " activation buffers in " << bytes << " bytes";
+	return true;
+#endif
+}
+
+void NetGraph::ViewInputsInOutput(NetGraphNode* node, const std::vector<CombinedTensor*>& input_tensors, CombinedTensor* output) {
+	unsigned int first_map = 0;
+	for (unsigned int i = 0; i < input_tensors.size(); i++) {
+		const unsigned int maps = input_tensors[i]->data.maps();
+		if (CanWriteIntoOutput(node, i, output) &&
+			input_tensors[i]->data.View(output->data, first_map, maps) &&
+			input_tensors[i]->delta.View(output->delta, first_map, maps)) {
+			node->inputs_in_place++;
+			LOGDEBUG << "Input " << i << " writes into the output of " << node->layer->GetLayerDescription();
+		}
+		first_map += maps;
+	}
+}
+
+bool NetGraph::CanRunInPlace(NetGraphNode* node) const {
+	if (!node->layer->IsInPlaceCapable() || node->input_connections.size() != 1)
+		return false;
+
+	// The input has to be expendable. Inputs and outputs of the net are read
+	//  from outside and some layers need their output for backpropagation.
+	const NetGraphConnection& connection = node->input_connections[0];
+	NetGraphNode* source = connection.node;
+	if (source->is_input || source->is_output || source->layer->IsOutputNeededForBackprop())
+		return false;
+
+	// Shadowed data is read through other buffers too
+	if (source->output_buffers[connection.buffer].combined_tensor->data.IsShadow())
+		return false;
+
+	// The same goes for inputs that wrote directly into the source's output
+	if (source->inputs_in_place > 0)
+		for (const NetGraphConnection& source_connection : source->input_connections)
+			if (source_connection.node->layer->IsOutputNeededForBackprop())
+				return false;
+
+	// This node has to be the only consumer of the buffer
+	for (NetGraphNode* other_node : nodes_) {
+		if (other_node == node)
+			continue;
+		for (const NetGraphConnection& other_connection : other_node->input_connections)
+			if (other_connection.node == source && other_connection.buffer == connection.buffer)
+				return false;
+	}
+
+	return true;
+}
+
+bool NetGraph::CanWriteIntoOutput(NetGraphNode* node, unsigned int input, const CombinedTensor* output) const {
+#ifdef BUILD_OPENCL
+	UNREFERENCED_PARAMETER(node);
+	UNREFERENCED_PARAMETER(input);
+	UNREFERENCED_PARAMETER(output);
+	return false;
+#else
+	const NetGraphConnection& connection = node->input_connections[input];
+	NetGraphNode* source = connection.node;
+	const CombinedTensor* buffer = source->output_buffers[connection.buffer].combined_tensor;
+
+	// The buffer has to belong to the source and has to be read from
+	//  nowhere else. Views of views would lose their memory.
+	if (source->is_input || source->is_output || source->layer->IsConcatenatingMaps())
+		return false;
+	if (buffer->data.IsShadow() || buffer->delta.IsShadow())
+		return false;
+	if (buffer->data.width() != output->data.width() || buffer->data.height() != output->data.height())
+		return false;
+
+	for (NetGraphNode* other_node : nodes_) {
+		for (unsigned int c = 0; c < other_node->input_connections.size(); c++) {
+			const NetGraphConnection& other_connection = other_node->input_connections[c];
+			if ((other_node != node || c != input) && other_connection.node == source
+				&& other_connection.buffer == connection.buffer)
+				return false;
+		}
+	}
+
+	// With more than one sample, the view has gaps between the samples.
+	//  Every layer writing the buffer, including the ones it runs in place
+	//  on, has to support that.
+	if (output->data.samples() > 1 && output->data.maps() != buffer->data.maps()) {
+		NetGraphNode* writer = source;
+		while (true) {
+			if (!writer->layer->IsStridedOutputCapable())
+				return false;
+			if (!writer->in_place)
+				break;
+			writer = writer->input_connections[0].node;
+		}
+	}
+
+	return true;
+#endif
+}
+
 void NetGraph::FeedForward() {
 	FeedForward(nodes_, true);
 }
@@ -317,14 +545,22 @@ void NetGraph::FeedForward(NetGraphNode* node) {
 		node->layer->FeedForward();
     if(layerview_enabled_)
       for(NetGraphBuffer buffer: node->output_buffers) {
-        for(unsigned int sample = 0; sample < buffer.combined_tensor->data.samples(); sample++) {
-          for(unsigned int map = 0; map < buffer.combined_tensor->data.maps(); map++) {
+        // 16-bit buffers are shown through a copy
+        Tensor* data = &(buffer.combined_tensor->data);
+        Tensor converted;
+        if (data->storage() != STORAGE_FLOAT32) {
+          converted.Resize(*data);
+          data->UnpackElements(0, data->elements(), converted.data_ptr());
+          data = &converted;
+        }
+        for(unsigned int sample = 0; sample < data->samples(); sample++) {
+          for(unsigned int map = 0; map < data->maps(); map++) {
             std::stringstream ss;
             ss << node->unique_name << ": " << node->layer->GetLayerDescription() << ", buffer " << buffer.description;
   #ifdef BUILD_OPENCL
-            buffer.combined_tensor->data.MoveToCPU();
+            data->MoveToCPU();
   #endif
-            viewer.show(&(buffer.combined_tensor->data), ss.str(), false, map, sample);
+            viewer.show(data, ss.str(), false, map, sample);
           }
         }
       }
@@ -389,12 +625,12 @@ void NetGraph::GetParameters (std::vector< CombinedTensor* >& parameters) {
   }
 }
 
-void NetGraph::SerializeParameters(std::ostream& output) {
+void NetGraph::SerializeParameters(std::ostream& output, TensorStorage storage) {
 	// TODO use unique layer ids
 	for (unsigned int l = 0; l < nodes_.size(); l++) {
 		Layer* layer = nodes_[l]->layer;
 		for (unsigned int p = 0; p < layer->parameters().size(); p++) {
-			layer->parameters()[p]->data.Serialize(output);
+			layer->parameters()[p]->data.Serialize(output, false, storage);
 		}
 	}
 }
@@ -8,10 +8,32 @@
 
 #include "CombinedTensor.h"
 #include "Log.h"
+#include "ConfigParsing.h"
 
 #include "NonLinearityLayer.h"
 
 namespace Conv {
+
+NonLinearityLayer::NonLinearityLayer(std::string configuration) :
+  SimpleLayer(configuration) {
+  mode_ = ParseActivationMode(configuration, ACTIVATION_EXACT);
+}
+
+ActivationMode NonLinearityLayer::ParseActivationMode(std::string configuration,
+                                                      ActivationMode mode) {
+  std::string mode_string;
+  ParseStringParamIfPossible(configuration, "mode", mode_string);
+
+  if (mode_string.compare(0, 4, "fast") == 0)
+    return ACTIVATION_FAST;
+  else if (mode_string.compare(0, 5, "exact") == 0)
+    return ACTIVATION_EXACT;
+  else if (mode_string.length() > 0) {
+    LOGWARN << "Unknown activation mode: " << mode_string;
+  }
+
+  return mode;
+}
   
 bool NonLinearityLayer::CreateOutputs (
   const std::vector< CombinedTensor* >& inputs,
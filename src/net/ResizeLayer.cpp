@@ -21,10 +21,20 @@ namespace Conv {
 
 ResizeLayer::ResizeLayer (const unsigned int borderx,
 			  const unsigned int bordery) :
+  ResizeLayer(borderx, bordery, borderx / 2, bordery / 2) {
+}
+
+ResizeLayer::ResizeLayer (const unsigned int borderx,
+			  const unsigned int bordery,
+			  const unsigned int offsetx,
+			  const unsigned int offsety) :
   SimpleLayer(""),
-  borderx_(borderx), bordery_(bordery) {
+  borderx_(borderx), bordery_(bordery), offsetx_(offsetx), offsety_(offsety) {
+  if (offsetx_ > borderx_ || offsety_ > bordery_) {
+    FATAL ("Offset larger than border!");
+  }
   LOGDEBUG << "Instance created, border size: (" << borderx << ", "
-  << bordery << ")";
+  << bordery << "), offset: (" << offsetx << ", " << offsety << ")";
 }
 
 ResizeLayer::ResizeLayer (std::string configuration)
@@ -32,6 +42,8 @@ ResizeLayer::ResizeLayer (std::string configuration)
   borderx_ = 0;
   bordery_ = 0;
   ParseKernelSizeIfPossible(configuration, "border", borderx_, bordery_);
+  offsetx_ = borderx_ / 2;
+  offsety_ = bordery_ / 2;
 }
   
 bool ResizeLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
@@ -94,7 +106,7 @@ void ResizeLayer::FeedForward() {
 	const datum* const source =
 	  input_->data.data_ptr_const(0, y, map, sample);
 	datum* const target =
-	  output_->data.data_ptr(borderx_ / 2, y + (bordery_ / 2), map, sample);
+	  output_->data.data_ptr(offsetx_, y + offsety_, map, sample);
 	  
 	std::memcpy(target, source, sizeof(datum) * input_->data.width());
       }
@@ -118,7 +130,7 @@ void ResizeLayer::BackPropagate() {
   	datum* const target =
   	  input_->delta.data_ptr(0, y, map, sample);
   	const datum* const source =
-  	  output_->delta.data_ptr_const(borderx_ / 2, y + (bordery_ / 2), map, sample);
+  	  output_->delta.data_ptr_const(offsetx_, y + offsety_, map, sample);
   	  
   	std::memcpy(target, source, sizeof(datum) * input_->delta.width());
         }
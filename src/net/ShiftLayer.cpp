@@ -0,0 +1,122 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include "Log.h"
+
+#include <cstring>
+
+#include "ShiftLayer.h"
+
+namespace Conv {
+
+ShiftLayer::ShiftLayer (const unsigned int factor_x, const unsigned int factor_y) :
+  SimpleLayer(""), factor_x_ (factor_x), factor_y_ (factor_y) {
+  LOGDEBUG << "Instance created: " << factor_x_ << "x" << factor_y_ << " shifts.";
+}
+
+bool ShiftLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
+                                std::vector< CombinedTensor* >& outputs) {
+  // This is a simple layer, only one input
+  if (inputs.size() != 1) {
+    LOGERROR << "Only one input supported!";
+    return false;
+  }
+
+  // Save input node pointer
+  CombinedTensor* input = inputs[0];
+
+  // Check if input node pointer is null
+  if (input == nullptr) {
+    LOGERROR << "Null pointer input node!";
+    return false;
+  }
+
+  if (factor_x_ == 0 || factor_y_ == 0 ||
+      input->data.width() < factor_x_ || input->data.height() < factor_y_) {
+    LOGERROR << "Input too small for " << factor_x_ << "x" << factor_y_ << " shifts!";
+    return false;
+  }
+
+  // Create output
+  CombinedTensor* output = new CombinedTensor (input->data.samples() * factor_x_ * factor_y_,
+      input->data.width() - (factor_x_ - 1), input->data.height() - (factor_y_ - 1),
+      input->data.maps());
+
+  // Tell network about the output
+  outputs.push_back (output);
+
+  return true;
+}
+
+bool ShiftLayer::Connect (const CombinedTensor* input, CombinedTensor* output) {
+  bool valid = output->data.samples() == input->data.samples() * factor_x_ * factor_y_ &&
+               output->data.width() + factor_x_ - 1 == input->data.width() &&
+               output->data.height() + factor_y_ - 1 == input->data.height() &&
+               output->data.maps() == input->data.maps();
+
+  if (!valid) {
+    LOGERROR << "Invalid dimensions!";
+    return false;
+  }
+
+  return true;
+}
+
+void ShiftLayer::FeedForward() {
+#ifdef BUILD_OPENCL
+  output_->data.MoveToCPU(true);
+  input_->data.MoveToCPU();
+#endif
+
+  const unsigned int shifts = factor_x_ * factor_y_;
+
+#pragma omp parallel for default(shared)
+  for (unsigned int target_sample = 0; target_sample < output_->data.samples(); target_sample++) {
+    const unsigned int sample = target_sample / shifts;
+    const unsigned int shift = target_sample % shifts;
+    const unsigned int dx = shift % factor_x_;
+    const unsigned int dy = shift / factor_x_;
+    for (unsigned int map = 0; map < output_->data.maps(); map++) {
+      for (unsigned int y = 0; y < output_->data.height(); y++) {
+        const datum* const source = input_->data.data_ptr_const (dx, y + dy, map, sample);
+        datum* const target = output_->data.data_ptr (0, y, map, target_sample);
+        std::memcpy (target, source, sizeof(datum) * output_->data.width());
+      }
+    }
+  }
+}
+
+void ShiftLayer::BackPropagate() {
+  if (!backprop_enabled_)
+    return;
+
+#ifdef BUILD_OPENCL
+  input_->delta.MoveToCPU(true);
+  output_->delta.MoveToCPU();
+#endif
+
+  const unsigned int shifts = factor_x_ * factor_y_;
+  input_->delta.Clear(0.0);
+
+  // Every input sample collects the gradients of its own copies
+#pragma omp parallel for default(shared)
+  for (unsigned int sample = 0; sample < input_->delta.samples(); sample++) {
+    for (unsigned int shift = 0; shift < shifts; shift++) {
+      const unsigned int dx = shift % factor_x_;
+      const unsigned int dy = shift / factor_x_;
+      for (unsigned int map = 0; map < output_->delta.maps(); map++) {
+        for (unsigned int y = 0; y < output_->delta.height(); y++) {
+          const datum* const source = output_->delta.data_ptr_const (0, y, map, sample * shifts + shift);
+          datum* const target = input_->delta.data_ptr (dx, y + dy, map, sample);
+          for (unsigned int x = 0; x < output_->delta.width(); x++)
+            target[x] += source[x];
+        }
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,119 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include "Log.h"
+
+#include "StitchLayer.h"
+
+namespace Conv {
+
+StitchLayer::StitchLayer (const unsigned int factor_x, const unsigned int factor_y) :
+  SimpleLayer(""), factor_x_ (factor_x), factor_y_ (factor_y) {
+  LOGDEBUG << "Instance created: " << factor_x_ << "x" << factor_y_ << " stitching.";
+}
+
+bool StitchLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
+                                 std::vector< CombinedTensor* >& outputs) {
+  // This is a simple layer, only one input
+  if (inputs.size() != 1) {
+    LOGERROR << "Only one input supported!";
+    return false;
+  }
+
+  // Save input node pointer
+  CombinedTensor* input = inputs[0];
+
+  // Check if input node pointer is null
+  if (input == nullptr) {
+    LOGERROR << "Null pointer input node!";
+    return false;
+  }
+
+  if (factor_x_ == 0 || factor_y_ == 0 ||
+      (input->data.samples() % (factor_x_ * factor_y_)) != 0) {
+    LOGERROR << "Sample count not divisible by " << factor_x_ << "x" << factor_y_ << " shifts!";
+    return false;
+  }
+
+  // Create output
+  CombinedTensor* output = new CombinedTensor (input->data.samples() / (factor_x_ * factor_y_),
+      input->data.width() * factor_x_, input->data.height() * factor_y_,
+      input->data.maps());
+
+  // Tell network about the output
+  outputs.push_back (output);
+
+  return true;
+}
+
+bool StitchLayer::Connect (const CombinedTensor* input, CombinedTensor* output) {
+  bool valid = output->data.samples() * factor_x_ * factor_y_ == input->data.samples() &&
+               output->data.width() == input->data.width() * factor_x_ &&
+               output->data.height() == input->data.height() * factor_y_ &&
+               output->data.maps() == input->data.maps();
+
+  if (!valid) {
+    LOGERROR << "Invalid dimensions!";
+    return false;
+  }
+
+  return true;
+}
+
+void StitchLayer::FeedForward() {
+#ifdef BUILD_OPENCL
+  output_->data.MoveToCPU(true);
+  input_->data.MoveToCPU();
+#endif
+
+  const unsigned int shifts = factor_x_ * factor_y_;
+
+#pragma omp parallel for default(shared)
+  for (unsigned int source_sample = 0; source_sample < input_->data.samples(); source_sample++) {
+    const unsigned int sample = source_sample / shifts;
+    const unsigned int shift = source_sample % shifts;
+    const unsigned int dx = shift % factor_x_;
+    const unsigned int dy = shift / factor_x_;
+    for (unsigned int map = 0; map < input_->data.maps(); map++) {
+      for (unsigned int y = 0; y < input_->data.height(); y++) {
+        const datum* const source = input_->data.data_ptr_const (0, y, map, source_sample);
+        datum* const target = output_->data.data_ptr (dx, y * factor_y_ + dy, map, sample);
+        for (unsigned int x = 0; x < input_->data.width(); x++)
+          target[x * factor_x_] = source[x];
+      }
+    }
+  }
+}
+
+void StitchLayer::BackPropagate() {
+  if (!backprop_enabled_)
+    return;
+
+#ifdef BUILD_OPENCL
+  input_->delta.MoveToCPU(true);
+  output_->delta.MoveToCPU();
+#endif
+
+  const unsigned int shifts = factor_x_ * factor_y_;
+
+#pragma omp parallel for default(shared)
+  for (unsigned int source_sample = 0; source_sample < input_->delta.samples(); source_sample++) {
+    const unsigned int sample = source_sample / shifts;
+    const unsigned int shift = source_sample % shifts;
+    const unsigned int dx = shift % factor_x_;
+    const unsigned int dy = shift / factor_x_;
+    for (unsigned int map = 0; map < input_->delta.maps(); map++) {
+      for (unsigned int y = 0; y < input_->delta.height(); y++) {
+        datum* const target = input_->delta.data_ptr (0, y, map, source_sample);
+        const datum* const source = output_->delta.data_ptr_const (dx, y * factor_y_ + dy, map, sample);
+        for (unsigned int x = 0; x < input_->delta.width(); x++)
+          target[x] = source[x * factor_x_];
+      }
+    }
+  }
+}
+
+}
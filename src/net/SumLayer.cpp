@@ -51,8 +51,11 @@ bool SumLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
   }
   
   unsigned int samples = input_a->data.samples();
-  CombinedTensor* output = new CombinedTensor(samples, input_a->data.width(),
-    input_b->data.height(), maps_a);
+  CombinedTensor* output = new CombinedTensor(0);
+  output->data.Resize(samples, input_a->data.width(), input_b->data.height(), maps_a);
+
+  // Both inputs get the output's gradient, the first one without a copy
+  output->delta.Shadow(input_a->delta);
   
   outputs.push_back(output);
   return true;
@@ -87,7 +90,7 @@ bool SumLayer::Connect (const std::vector< CombinedTensor* >& inputs,
   }
   
   if((output->data.elements() != input_a->data.elements())
-    && (output_->data.elements() != input_b->data.elements())) {
+    || (output->data.elements() != input_b->data.elements())) {
     LOGERROR << "Wrong output dimensions!";
     return false;
   }
@@ -107,8 +110,8 @@ void SumLayer::FeedForward() {
 }
 
 void SumLayer::BackPropagate() {
+  // The output's gradient is the first input's
   for(unsigned int sample = 0; sample < samples_; sample++) {
-    Tensor::CopySample(output_->delta, sample, input_a_->delta, sample);
     Tensor::CopySample(output_->delta, sample, input_b_->delta, sample);
   }
 }
@@ -16,6 +16,7 @@
 #include "CLHelper.h"
 #include "StatAggregator.h"
 #include "Init.h"
+#include "Checkpointer.h"
 
 #include "Trainer.h"
 
@@ -327,6 +328,12 @@ void Trainer::Epoch() {
   iterations = (unsigned int) ( ( (datum) iterations) *
                                 settings_.epoch_training_ratio);
 
+  // A resumed epoch starts where its checkpoint was taken
+  const unsigned int first_iteration_in_epoch = iteration_ < iterations ? iteration_ : 0;
+  const unsigned int trained_iterations = iterations - first_iteration_in_epoch;
+  const bool resumed = resumed_;
+  resumed_ = false;
+
   unsigned int fiftieth = 0;
   unsigned int tenth = 0;
 
@@ -335,9 +342,18 @@ void Trainer::Epoch() {
 
   LOGINFO << "Epoch: " << epoch_ << ", it: " << iterations <<
            ", bsize: " << first_training_layer_->GetBatchSize() * settings_.sbatchsize << ", current lr: " <<
-           CalculateLR (epoch_ * iterations) << std::endl;
+           CalculateLR (epoch_ * iterations + first_iteration_in_epoch) << std::endl;
+
+  for (unsigned int i = first_iteration_in_epoch; i < iterations; i++) {
+    // Checkpoints are taken before an iteration and resume with it,
+    //  so the one just resumed from is not written again
+    const unsigned int global_iteration = epoch_ * iterations + i;
+    if (checkpointer_ != nullptr && global_iteration > 0 && global_iteration % checkpoint_interval_ == 0 &&
+        !(resumed && i == first_iteration_in_epoch)) {
+      iteration_ = i;
+      checkpointer_->Save (checkpoint_filename_);
+    }
 
-  for (unsigned int i = 0; i < iterations; i++) {
     if ( (50 * i / iterations) > fiftieth) {
       fiftieth = 50 * i / iterations;
       std::cout << "." << std::flush;
@@ -403,12 +419,12 @@ void Trainer::Epoch() {
   }
 
   // Submit performance statistics
-  System::stat_aggregator->Update(stat_sps_->stat_id, (double)sample_count_ * (double)iterations * (double)(settings_.sbatchsize));
-  System::stat_aggregator->Update(stat_fps_->stat_id, (double)(first_training_layer_->GetBatchSize()) * (double)iterations * (double)(settings_.sbatchsize));
+  System::stat_aggregator->Update(stat_sps_->stat_id, (double)sample_count_ * (double)trained_iterations * (double)(settings_.sbatchsize));
+  System::stat_aggregator->Update(stat_fps_->stat_id, (double)(first_training_layer_->GetBatchSize()) * (double)trained_iterations * (double)(settings_.sbatchsize));
   
   // Display training epoch_error
 	for (unsigned int n = 0; n < graph_.GetLossNodes().size(); n++) {
-		LOGINFO << "Training (Epoch " << epoch_ << ", node " << n << ") " << graph_.GetLossNodes()[n]->layer->GetLayerDescription() <<  " lps: " << loss_sums[n] / (datum)(iterations * sample_count_ * settings_.sbatchsize * first_training_layer_->GetLossSamplingProbability());
+		LOGINFO << "Training (Epoch " << epoch_ << ", node " << n << ") " << graph_.GetLossNodes()[n]->layer->GetLayerDescription() <<  " lps: " << loss_sums[n] / (datum)(trained_iterations * sample_count_ * settings_.sbatchsize * first_training_layer_->GetLossSamplingProbability());
 	}
 
   if(settings_.stats_during_training) {
@@ -422,6 +438,7 @@ void Trainer::Epoch() {
   }
 
   delete[] loss_sums;
+  iteration_ = 0;
   epoch_++;
 }
 
@@ -443,6 +460,10 @@ void Trainer::ApplyGradients (datum lr) {
 
     for (unsigned int p = 0; p < layer->parameters().size(); p++) {
       CombinedTensor* const param = layer->parameters_[p];
+      if (!layer->IsParameterTrainable(p)) {
+        dp++;
+        continue;
+      }
 #ifdef BUILD_OPENCL
       param->data.MoveToCPU();
 #endif
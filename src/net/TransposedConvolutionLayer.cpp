@@ -0,0 +1,284 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cmath>
+#include <algorithm>
+
+#include "Config.h"
+#include "Log.h"
+#include "TensorMath.h"
+#include "ConfigParsing.h"
+
+#include "TransposedConvolutionLayer.h"
+
+namespace Conv {
+
+TransposedConvolutionLayer::TransposedConvolutionLayer (const unsigned int kwidth,
+                                    const unsigned int kheight,
+                                    const unsigned int output_maps,
+                                    const unsigned int stride_width,
+                                    const unsigned int stride_height,
+                                    const unsigned int pad_width,
+                                    const unsigned int pad_height,
+                                    const int seed, const bool bilinear_init) :
+  SimpleLayer(""),
+  output_maps_ (output_maps), kernel_width_ (kwidth), kernel_height_ (kheight),
+  rand_ (seed), stride_width_(stride_width), stride_height_(stride_height),
+  pad_width_(pad_width), pad_height_(pad_height), bilinear_init_(bilinear_init) {
+  if (kernel_width_ == 0 || kernel_height_ == 0) {
+    FATAL ("Kernels cannot have zero dimensions");
+  }
+
+  if(stride_width_ == 0 || stride_height_ == 0) {
+    FATAL("Stride needs to be at least 1!");
+  }
+
+  if (seed == 0 && !bilinear_init_) {
+    LOGWARN << "Random seed is zero";
+  }
+
+  LOGDEBUG << "Instance created. " << output_maps_ << " output maps with " <<
+           kernel_width_ << "x" << kernel_height_ << " kernels, stride: "<<  stride_width_ << "x" << stride_height_ <<
+           ", padding: " << pad_width_ << "x" << pad_height_ << (bilinear_init_ ? ", bilinear." : ".");
+}
+
+TransposedConvolutionLayer::TransposedConvolutionLayer(std::string configuration) :
+  SimpleLayer(configuration) {
+  unsigned int seed = 0;
+  kernel_width_ = 0;
+  kernel_height_ = 0;
+  output_maps_ = 0;
+  stride_width_ = 1;
+  stride_height_ = 1;
+  pad_width_ = 0;
+  pad_height_ = 0;
+  datum local_lr = 1.0;
+  std::string init;
+
+  ParseKernelSizeIfPossible(configuration, "size", kernel_width_ , kernel_height_);
+  ParseKernelSizeIfPossible (configuration, "stride", stride_width_, stride_height_);
+  ParseKernelSizeIfPossible (configuration, "pad", pad_width_, pad_height_);
+  ParseCountIfPossible (configuration, "kernels", output_maps_);
+  ParseDatumParamIfPossible (configuration, "llr", local_lr);
+  ParseCountIfPossible(configuration, "seed", seed);
+  ParseStringParamIfPossible(configuration, "init", init);
+
+  bilinear_init_ = init.compare("bilinear") == 0;
+  rand_.seed(seed);
+  SetLocalLearningRate(local_lr);
+}
+
+bool TransposedConvolutionLayer::CreateOutputs (
+  const std::vector< CombinedTensor* >& inputs,
+  std::vector< CombinedTensor* >& outputs) {
+  // This is a simple layer, only one input
+  if (inputs.size() != 1) {
+    LOGERROR << "Only one input supported!";
+    return false;
+  }
+
+  // Save input node pointer
+  CombinedTensor* input = inputs[0];
+
+  // Check if input node pointer is null
+  if (input == nullptr) {
+    LOGERROR << "Null pointer input node!";
+    return false;
+  }
+
+  // The input would be the output of a convolution over our output
+  const int output_width = ((int)input->data.width() - 1) * (int)stride_width_ + (int)kernel_width_ - (int)pad_width_ - (int)pad_width_;
+  const int output_height = ((int)input->data.height() - 1) * (int)stride_height_ + (int)kernel_height_ - (int)pad_height_ - (int)pad_height_;
+
+  if (output_width <= 0 || output_height <= 0 || output_maps_ == 0) {
+    LOGERROR << "Unsupported input dimensions " << input->data;
+    return false;
+  }
+
+  // Create output
+  CombinedTensor* output = new CombinedTensor (input->data.samples(),
+      output_width, output_height, output_maps_);
+
+  // Tell network about the output
+  outputs.push_back (output);
+
+  return true;
+}
+
+bool TransposedConvolutionLayer::Connect (const CombinedTensor* input,
+                                CombinedTensor* output) {
+  bool valid =
+    output->data.maps() == output_maps_ &&
+    output->data.samples() == input->data.samples() &&
+    (pad_width_ + pad_width_ + output->data.width() - kernel_width_) / stride_width_ + 1 == input->data.width() &&
+    (pad_height_ + pad_height_ + output->data.height() - kernel_height_) / stride_height_ + 1 == input->data.height();
+
+  if (!valid) {
+    return false;
+  }
+
+  // Save parameters
+  input_maps_ = input->data.maps();
+  input_width_ = input->data.width();
+  input_height_ = input->data.height();
+  output_width_ = output->data.width();
+  output_height_ = output->data.height();
+
+  if (bilinear_init_ && input_maps_ != output_maps_) {
+    LOGERROR << "Bilinear initialization needs as many input maps as output maps!";
+    return false;
+  }
+
+  LOGDEBUG << "Local learning rate is now " << local_lr_;
+
+  sms_input_buffer_.Resize (input_maps_, input_width_, input_height_, input->data.samples());
+  sms_delta_buffer_.Resize (input_maps_, input_width_, input_height_, input->data.samples());
+  col_buffer_.Resize (kernel_width_ * kernel_height_ * output_maps_, input_width_,
+                      input_height_, input->data.samples());
+
+  // Keep the parameters when the net is reshaped
+  if (weights_ != nullptr)
+    return true;
+
+  // Create kernels
+  weights_ = new CombinedTensor (input_maps_, kernel_width_, kernel_height_, output_maps_);
+  bias_ = new CombinedTensor (1, output_maps_);
+
+  bias_->data.Clear();
+  weights_->data.Clear();
+
+  // Tell the net about our parameters
+  parameters_.push_back (weights_);
+  parameters_.push_back (bias_);
+
+  return true;
+}
+
+void TransposedConvolutionLayer::FeedForward() {
+  const unsigned int samples = input_->data.samples();
+  const int columns = input_width_ * input_height_ * samples;
+  const int kernel_size = kernel_width_ * kernel_height_ * output_maps_;
+
+  sms_input_buffer_.hint_ignore_content_ = true;
+  col_buffer_.hint_ignore_content_ = true;
+  output_->data.hint_ignore_content_ = true;
+
+  TensorMath::SMS(input_->data, sms_input_buffer_);
+
+  // Every input pixel weights the kernels...
+  TensorMath::GEMM(true, true, false, kernel_size, columns, input_maps_,
+        1.0, weights_->data, 0, kernel_size,
+        sms_input_buffer_, 0, columns,
+        0.0, col_buffer_, 0, columns);
+
+  // ...which overlap in the output
+  TensorMath::COL2IM(output_->data, output_width_, output_height_, output_maps_, samples,
+        kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_, col_buffer_);
+
+  // Add bias
+  const std::size_t map_size = (std::size_t)output_width_ * output_height_;
+  #pragma omp parallel for default(shared)
+  for (unsigned int plane = 0; plane < samples * output_maps_; plane++) {
+    datum* output_map = output_->data.data_ptr(0, 0, plane % output_maps_, plane / output_maps_);
+    const datum bias = bias_->data[plane % output_maps_];
+    for (std::size_t e = 0; e < map_size; e++)
+      output_map[e] += bias;
+  }
+}
+
+void TransposedConvolutionLayer::BackPropagate() {
+  const unsigned int samples = input_->data.samples();
+  const int columns = input_width_ * input_height_ * samples;
+  const int kernel_size = kernel_width_ * kernel_height_ * output_maps_;
+
+  col_buffer_.hint_ignore_content_ = true;
+  sms_delta_buffer_.hint_ignore_content_ = true;
+  weights_->delta.hint_ignore_content_ = true;
+  bias_->delta.hint_ignore_content_ = true;
+  input_->delta.hint_ignore_content_ = true;
+
+  // Collect the output gradient that each input pixel contributed to
+  TensorMath::IM2COL(output_->delta, output_width_, output_height_, output_maps_, samples,
+        kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_, col_buffer_);
+
+  /*
+   * 1. Weight gradient calculation
+   */
+  TensorMath::GEMM(true, false, true, input_maps_, kernel_size, columns,
+        1.0, sms_input_buffer_, 0, columns,
+        col_buffer_, 0, columns,
+        0.0, weights_->delta, 0, kernel_size);
+
+  /*
+   * 2. Bias gradient calculation
+   */
+  const std::size_t map_size = (std::size_t)output_width_ * output_height_;
+  for (unsigned int map = 0; map < output_maps_; map++) {
+    datum sum = 0;
+    for (unsigned int sample = 0; sample < samples; sample++) {
+      const datum* output_delta_map = output_->delta.data_ptr_const(0, 0, map, sample);
+      for (std::size_t e = 0; e < map_size; e++)
+        sum += output_delta_map[e];
+    }
+    bias_->delta[map] = sum;
+  }
+
+  /*
+   * 3. Backpropagation
+   */
+  if (backprop_enabled_) {
+    TensorMath::GEMM(true, false, false, input_maps_, columns, kernel_size,
+          1.0, weights_->data, 0, kernel_size,
+          col_buffer_, 0, columns,
+          0.0, sms_delta_buffer_, 0, columns);
+    TensorMath::SMS(sms_delta_buffer_, input_->delta);
+  }
+}
+
+void TransposedConvolutionLayer::OnLayerConnect (const std::vector<Layer*> next_layers) {
+#ifdef BUILD_OPENCL
+  weights_->data.MoveToCPU();
+#endif
+
+  if (bilinear_init_) {
+    // Every map is interpolated from the same map of the input
+    weights_->data.Clear();
+    const datum factor_x = (datum)((kernel_width_ + 1) / 2);
+    const datum factor_y = (datum)((kernel_height_ + 1) / 2);
+    const datum center_x = (kernel_width_ % 2 == 1) ? factor_x - 1 : factor_x - 0.5;
+    const datum center_y = (kernel_height_ % 2 == 1) ? factor_y - 1 : factor_y - 0.5;
+    for (unsigned int map = 0; map < output_maps_; map++) {
+      for (unsigned int y = 0; y < kernel_height_; y++) {
+        for (unsigned int x = 0; x < kernel_width_; x++) {
+          *weights_->data.data_ptr(x, y, map, map) =
+            (1 - std::fabs((datum)x - center_x) / factor_x) *
+            (1 - std::fabs((datum)y - center_y) / factor_y);
+        }
+      }
+    }
+    LOGDEBUG << "Initialized bilinear kernels";
+    return;
+  }
+
+	unsigned int next_layer_gain = 0;
+	for (Layer* next_layer: next_layers)
+		next_layer_gain += next_layer->Gain();
+
+  unsigned int this_layer_gain = Gain();
+
+  const datum range = sqrt (6) / sqrt (next_layer_gain + this_layer_gain);
+
+  std::uniform_real_distribution<datum> dist_weights (-range , range);
+
+  for (std::size_t i = 0; i < weights_->data.elements(); i++) {
+    weights_->data[i] = dist_weights (rand_);
+  }
+
+  LOGDEBUG << "Updating weights: " << this_layer_gain << " -> "
+           << next_layer_gain;
+}
+
+}
@@ -0,0 +1,217 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <vector>
+#include <algorithm>
+
+#include "Log.h"
+#include "CombinedTensor.h"
+
+#include "UpsamplingErrorLayer.h"
+
+namespace Conv {
+
+UpsamplingErrorLayer::UpsamplingErrorLayer(const unsigned int factor_x, const unsigned int factor_y,
+                                           const UpscaleMethod method, const datum loss_weight)
+ : Layer(""), factor_x_(factor_x), factor_y_(factor_y), method_(method), loss_weight_(loss_weight) {
+  LOGDEBUG << "Instance created: " << factor_x_ << "x" << factor_y_ <<
+           (method_ == UPSCALE_BILINEAR ? " bilinear" : "") << " upscaling.";
+#ifdef ERROR_LAYER_IGNORE_WEIGHTS
+  LOGINFO << "Weights are being ignored!";
+#endif
+}
+
+bool UpsamplingErrorLayer::CreateOutputs ( const std::vector< CombinedTensor* >& inputs,
+                                 std::vector< CombinedTensor* >& outputs ) {
+  UNREFERENCED_PARAMETER(outputs);
+  // Validate input node count
+  if ( inputs.size() != 3 ) {
+    LOGERROR << "Need exactly 3 inputs to calculate loss function!";
+    return false;
+  }
+
+  CombinedTensor* first = inputs[0];
+  CombinedTensor* second = inputs[1];
+  CombinedTensor* third = inputs[2];
+
+  // Check for null pointers
+  if ( first == nullptr || second == nullptr || third == nullptr ) {
+    LOGERROR << "Null pointer node supplied";
+    return false;
+  }
+
+  if ( first->data.samples() != second->data.samples() ||
+       first->data.samples() != third->data.samples() ) {
+    LOGERROR << "Inputs need the same number of samples!";
+    return false;
+  }
+
+  if ( first->data.width() * factor_x_ != second->data.width() ||
+       first->data.height() * factor_y_ != second->data.height() ||
+       first->data.maps() != second->data.maps() ) {
+    LOGERROR << "Cannot upscale " << first->data << " to " << second->data;
+    return false;
+  }
+
+  if ( second->data.width() != third->data.width() ||
+       second->data.height() != third->data.height() ) {
+    LOGERROR << "Labels and weights need the same size!";
+    return false;
+  }
+
+  // Needs no outputs
+  return true;
+}
+
+bool UpsamplingErrorLayer::Connect ( const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* net ) {
+  UNREFERENCED_PARAMETER(net);
+  if ( inputs.size() != 3 )
+    return false;
+
+  CombinedTensor* first = inputs[0];
+  CombinedTensor* second = inputs[1];
+  CombinedTensor* third = inputs[2];
+  bool valid = first != nullptr && second != nullptr && third != nullptr &&
+               first->data.samples() == second->data.samples() &&
+               first->data.samples() == third->data.samples() &&
+               first->data.width() * factor_x_ == second->data.width() &&
+               first->data.height() * factor_y_ == second->data.height() &&
+               first->data.maps() == second->data.maps() &&
+               second->data.width() == third->data.width() &&
+               second->data.height() == third->data.height() &&
+               outputs.size() == 0;
+
+  if ( valid ) {
+    first_ = first;
+    second_ = second;
+    third_ = third;
+
+    if ( method_ == UPSCALE_BILINEAR )
+      bilinear_ = BilinearUpsampling ( first->data.width(), first->data.height(), factor_x_, factor_y_ );
+    else
+      weight_sums_.Resize ( first->data.samples(), first->data.width(), first->data.height() );
+  }
+
+  return valid;
+}
+
+void UpsamplingErrorLayer::FeedForward() {
+  // Like the ErrorLayer, we write the deltas at this point. Because the
+  //  loss comes out of the same pass, it is stored as well.
+  const unsigned int samples = first_->data.samples();
+  const unsigned int maps = first_->data.maps();
+  const unsigned int width = first_->data.width();
+  const unsigned int height = first_->data.height();
+  const unsigned int label_width = second_->data.width();
+  const unsigned int label_height = second_->data.height();
+  long double loss = 0;
+
+  if ( method_ == UPSCALE_NEAREST ) {
+    // Each output pixel would be replicated to a region of labels, so
+    //  the gradient is the output times the sum of the weights minus
+    //  the weighted sum of the labels
+    #pragma omp parallel for default(shared)
+    for ( unsigned int sample = 0; sample < samples; sample++ ) {
+      for ( unsigned int y = 0; y < height; y++ ) {
+        for ( unsigned int x = 0; x < width; x++ ) {
+          datum weight_sum = 0;
+          for ( unsigned int ry = 0; ry < factor_y_; ry++ ) {
+#ifdef ERROR_LAYER_IGNORE_WEIGHTS
+            weight_sum += factor_x_;
+#else
+            const datum* weights = third_->data.data_ptr_const ( x * factor_x_, y * factor_y_ + ry, 0, sample );
+            for ( unsigned int rx = 0; rx < factor_x_; rx++ )
+              weight_sum += weights[rx];
+#endif
+          }
+          *weight_sums_.data_ptr ( x, y, 0, sample ) = weight_sum;
+        }
+      }
+    }
+
+    #pragma omp parallel for default(shared) reduction(+:loss)
+    for ( unsigned int plane = 0; plane < samples * maps; plane++ ) {
+      const unsigned int sample = plane / maps;
+      const unsigned int map = plane % maps;
+      for ( unsigned int y = 0; y < height; y++ ) {
+        for ( unsigned int x = 0; x < width; x++ ) {
+          const datum output = *first_->data.data_ptr_const ( x, y, map, sample );
+          const datum weight_sum = *weight_sums_.data_ptr_const ( x, y, 0, sample );
+          datum weighted_label_sum = 0;
+          long double weighted_square_sum = 0;
+          for ( unsigned int ry = 0; ry < factor_y_; ry++ ) {
+            const datum* labels = second_->data.data_ptr_const ( x * factor_x_, y * factor_y_ + ry, map, sample );
+#ifndef ERROR_LAYER_IGNORE_WEIGHTS
+            const datum* weights = third_->data.data_ptr_const ( x * factor_x_, y * factor_y_ + ry, 0, sample );
+#endif
+            for ( unsigned int rx = 0; rx < factor_x_; rx++ ) {
+#ifdef ERROR_LAYER_IGNORE_WEIGHTS
+              const datum weight = 1.0;
+#else
+              const datum weight = weights[rx];
+#endif
+              const datum diff = output - labels[rx];
+              weighted_label_sum += weight * labels[rx];
+              weighted_square_sum += ( ( long double ) diff ) * ( ( long double ) diff ) * ( ( long double ) weight );
+            }
+          }
+          *first_->delta.data_ptr ( x, y, map, sample ) = ( output * weight_sum - weighted_label_sum ) * loss_weight_;
+          loss += weighted_square_sum;
+        }
+      }
+    }
+  } else {
+    #pragma omp parallel default(shared) reduction(+:loss)
+    {
+      std::vector<datum> buffer ( width );
+      std::vector<datum> row ( label_width );
+
+      #pragma omp for
+      for ( unsigned int plane = 0; plane < samples * maps; plane++ ) {
+        const unsigned int sample = plane / maps;
+        const unsigned int map = plane % maps;
+        const datum* output = first_->data.data_ptr_const ( 0, 0, map, sample );
+        datum* output_delta = first_->delta.data_ptr ( 0, 0, map, sample );
+        std::fill ( output_delta, output_delta + width * height, 0 );
+
+        for ( unsigned int y = 0; y < label_height; y++ ) {
+          bilinear_.UpsampleRow ( output, y, row.data(), buffer.data() );
+          const datum* labels = second_->data.data_ptr_const ( 0, y, map, sample );
+#ifndef ERROR_LAYER_IGNORE_WEIGHTS
+          const datum* weights = third_->data.data_ptr_const ( 0, y, 0, sample );
+#endif
+          // Replace the row by its gradient
+          for ( unsigned int x = 0; x < label_width; x++ ) {
+#ifdef ERROR_LAYER_IGNORE_WEIGHTS
+            const datum weight = 1.0;
+#else
+            const datum weight = weights[x];
+#endif
+            const datum diff = row[x] - labels[x];
+            loss += ( ( long double ) diff ) * ( ( long double ) diff ) * ( ( long double ) weight );
+            row[x] = diff * weight * loss_weight_;
+          }
+          bilinear_.BackpropagateRow ( row.data(), y, output_delta, buffer.data() );
+        }
+      }
+    }
+  }
+
+  loss_ = loss * ( long double ) loss_weight_;
+}
+
+void UpsamplingErrorLayer::BackPropagate() {
+  // The deltas are already written in to the input CombinedTensors, so
+  // there is nothing to do now.
+}
+
+datum UpsamplingErrorLayer::CalculateLossFunction() {
+  return loss_ / 2.0;
+}
+
+}
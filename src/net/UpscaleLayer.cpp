@@ -5,6 +5,7 @@
  * For licensing information, see the LICENSE file included with this project.
  */  
 #include <limits>
+#include <vector>
 
 #include "Log.h"
 #include "Init.h"
@@ -14,10 +15,11 @@
 
 namespace Conv {
 
-UpscaleLayer::UpscaleLayer ( const unsigned int region_width, const unsigned int region_height )
-  : SimpleLayer(""), region_width_ ( region_width ), region_height_ ( region_height ) {
+UpscaleLayer::UpscaleLayer ( const unsigned int region_width, const unsigned int region_height,
+                             const UpscaleMethod method )
+  : SimpleLayer(""), region_width_ ( region_width ), region_height_ ( region_height ), method_ ( method ) {
   LOGDEBUG << "Instance created: " << region_width_ << "x" << region_height_ <<
-           " upscaling.";
+           ( method_ == UPSCALE_BILINEAR ? " bilinear" : "" ) << " upscaling.";
 }
 
 bool UpscaleLayer::CreateOutputs (
@@ -51,8 +53,10 @@ bool UpscaleLayer::CreateOutputs (
 
 bool UpscaleLayer::Connect ( const CombinedTensor* input,
                              CombinedTensor* output ) {
-  // TODO Validate dimensions
-  bool valid = true;
+  bool valid = output->data.width() == input->data.width() * region_width_ &&
+               output->data.height() == input->data.height() * region_height_ &&
+               output->data.maps() == input->data.maps() &&
+               output->data.samples() == input->data.samples();
 
   if ( !valid ) {
     LOGERROR << "Invalid dimensions!";
@@ -67,15 +71,59 @@ bool UpscaleLayer::Connect ( const CombinedTensor* input,
 
   maps_ = input->data.maps();
 
+  if ( method_ == UPSCALE_BILINEAR )
+    bilinear_ = BilinearUpsampling ( input_width_, input_height_, region_width_, region_height_ );
+
   return true;
 }
 
 void UpscaleLayer::FeedForward() {
- TensorMath::UP(input_->data, output_->data, region_width_, region_height_, 1.0f);
+  if ( method_ == UPSCALE_NEAREST ) {
+    TensorMath::UP(input_->data, output_->data, region_width_, region_height_, 1.0f);
+    return;
+  }
+
+  const std::size_t planes = input_->data.samples() * maps_;
+  const std::size_t input_size = ( std::size_t ) input_width_ * input_height_;
+  const std::size_t output_size = ( std::size_t ) output_width_ * output_height_;
+  const datum* input = input_->data.data_ptr_const();
+  datum* output = output_->data.data_ptr();
+
+#pragma omp parallel default(shared)
+  {
+    std::vector<datum> buffer ( input_width_ );
+
+#pragma omp for
+    for ( std::size_t plane = 0; plane < planes; plane++ )
+      bilinear_.UpsampleMap ( &input[plane * input_size], &output[plane * output_size], buffer.data() );
+  }
 }
 
 void UpscaleLayer::BackPropagate() {
-  TensorMath::DOWN(output_->delta, input_->delta, region_width_, region_height_, 1.0f);
+  // The loss may be computed from the input directly, e.g. by
+  //  an UpsamplingErrorLayer
+  if ( !backprop_enabled_ )
+    return;
+
+  if ( method_ == UPSCALE_NEAREST ) {
+    TensorMath::DOWN(output_->delta, input_->delta, region_width_, region_height_, 1.0f);
+    return;
+  }
+
+  const std::size_t planes = input_->data.samples() * maps_;
+  const std::size_t input_size = ( std::size_t ) input_width_ * input_height_;
+  const std::size_t output_size = ( std::size_t ) output_width_ * output_height_;
+  datum* input_delta = input_->delta.data_ptr();
+  const datum* output_delta = output_->delta.data_ptr_const();
+
+#pragma omp parallel default(shared)
+  {
+    std::vector<datum> buffer ( input_width_ );
+
+#pragma omp for
+    for ( std::size_t plane = 0; plane < planes; plane++ )
+      bilinear_.BackpropagateMap ( &output_delta[plane * output_size], &input_delta[plane * input_size], buffer.data() );
+  }
 }
 
 }
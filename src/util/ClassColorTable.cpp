@@ -0,0 +1,71 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include "Log.h"
+#include "ClassColorTable.h"
+
+namespace Conv {
+
+/*
+ * Recovers the byte a datum was created from with DATUM_FROM_UCHAR.
+ * Returns a value > 255 if there is no such byte, so that the comparison
+ * stays as exact as comparing the datum values directly.
+ */
+static inline unsigned int ByteFromDatum(const datum value) {
+  const datum scaled = 255.0f * value + 0.5f;
+  if(!(scaled >= 0.0f && scaled < 256.0f))
+    return 0x100;
+  const unsigned int byte = (unsigned int)scaled;
+  return DATUM_FROM_UCHAR(byte) == value ? byte : 0x100;
+}
+
+ClassColorTable::ClassColorTable(const std::vector<unsigned int>& class_colors) :
+  classes_((unsigned int)class_colors.size()) {
+  // If two classes share a color, the first one wins, like in the old search
+  for(unsigned int c = classes_; c > 0; c--)
+    table_[class_colors[c - 1] & 0xFFFFFF] = c - 1;
+}
+
+bool ClassColorTable::ToClassIndices(const Tensor& rgb_tensor, std::vector<unsigned int>& indices) const {
+  if(rgb_tensor.maps() != 3 && rgb_tensor.maps() != 1) {
+    LOGERROR << "Unsupported input channel count!";
+    return false;
+  }
+
+  const std::size_t map_size = rgb_tensor.width() * rgb_tensor.height();
+  indices.resize(rgb_tensor.samples() * map_size);
+
+  for(std::size_t sample = 0; sample < rgb_tensor.samples(); sample++) {
+    const datum* r = rgb_tensor.data_ptr_const(0, 0, 0, sample);
+    const datum* g = rgb_tensor.maps() == 3 ? rgb_tensor.data_ptr_const(0, 0, 1, sample) : r;
+    const datum* b = rgb_tensor.maps() == 3 ? rgb_tensor.data_ptr_const(0, 0, 2, sample) : r;
+    unsigned int* target = &indices[sample * map_size];
+
+    // Label images consist of large areas of the same color
+    unsigned int last_color = 0xFFFFFFFF;
+    unsigned int last_class = classes_;
+
+    for(std::size_t i = 0; i < map_size; i++) {
+      const unsigned int br = ByteFromDatum(r[i]), bg = ByteFromDatum(g[i]), bb = ByteFromDatum(b[i]);
+      if(br > 0xFF || bg > 0xFF || bb > 0xFF) {
+        target[i] = classes_;
+        continue;
+      }
+
+      const unsigned int color = (br << 16) | (bg << 8) | bb;
+      if(color != last_color) {
+        std::unordered_map<unsigned int, unsigned int>::const_iterator it = table_.find(color);
+        last_color = color;
+        last_class = it != table_.end() ? it->second : classes_;
+      }
+      target[i] = last_class;
+    }
+  }
+  return true;
+}
+
+}
@@ -16,6 +16,7 @@
 #endif
 
 #include <limits>
+#include <vector>
 
 namespace Conv {
 
@@ -24,8 +25,10 @@ void Dataset::Colorize(Tensor& net_output_tensor, Tensor& target_tensor) {
   net_output_tensor.MoveToCPU();
   target_tensor.MoveToCPU();
 #endif
+  // Copied once, not for every pixel
+  const std::vector<unsigned int> class_colors = GetClassColors();
   if(GetClasses() == 1) {
-    const unsigned int foreground_color = GetClassColors()[0];
+    const unsigned int foreground_color = class_colors[0];
     const datum r = DATUM_FROM_UCHAR((foreground_color >> 16) & 0xFF),
     g = DATUM_FROM_UCHAR((foreground_color >> 8) & 0xFF),
     b = DATUM_FROM_UCHAR(foreground_color & 0xFF);
@@ -58,7 +61,7 @@ void Dataset::Colorize(Tensor& net_output_tensor, Tensor& target_tensor) {
 	    }
 	  }
 	  
-	  const unsigned int foreground_color = GetClassColors()[maxclass];
+	  const unsigned int foreground_color = class_colors[maxclass];
 	  const datum r = DATUM_FROM_UCHAR((foreground_color >> 16) & 0xFF),
 	  g = DATUM_FROM_UCHAR((foreground_color >> 8) & 0xFF),
 	  b = DATUM_FROM_UCHAR(foreground_color & 0xFF);
@@ -0,0 +1,465 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef BUILD_POSIX
+#include <sys/mman.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+#include "CompactTensor.h"
+
+namespace Conv {
+
+/*
+ * Every entry in a compact stream is padded to this many bytes so that
+ * memory mapped float data stays aligned.
+ */
+const std::size_t compact_alignment = 8;
+
+/*
+ * Gets the number of bytes per class index, zero if there are too many
+ * classes. The largest index value is reserved for "no class".
+ */
+static std::size_t ClassIndexSize(const std::size_t classes) {
+  if(classes < 0xFF)
+    return 1;
+  else if(classes < 0xFFFF)
+    return 2;
+  else
+    return 0;
+}
+
+template <typename index_t>
+static void ExpandClassIndices(const index_t* source, const std::size_t width,
+                               const std::size_t height, const std::size_t maps,
+                               datum* target, const std::size_t target_width,
+                               const std::size_t target_height) {
+  const std::size_t target_map_size = target_width * target_height;
+  std::memset(target, 0, sizeof(datum) * target_map_size * maps / sizeof(char));
+
+  for(std::size_t y = 0; y < height; y++) {
+    const index_t* source_row = &source[y * width];
+    datum* target_row = &target[y * target_width];
+    for(std::size_t x = 0; x < width; x++) {
+      const std::size_t class_index = source_row[x];
+      // Everything out of range is "no class" and stays zero
+      if(class_index < maps)
+        target_row[class_index * target_map_size + x] = 1.0;
+    }
+  }
+}
+
+template <typename index_t>
+static bool ExtractClassIndices(const Tensor& tensor, index_t* target) {
+  const std::size_t map_size = tensor.width() * tensor.height();
+  const index_t no_class = (index_t)~((index_t)0);
+
+  for(std::size_t sample = 0; sample < tensor.samples(); sample++) {
+    const datum* sample_ptr = tensor.data_ptr_const(0, 0, 0, sample);
+    index_t* target_ptr = &target[sample * map_size];
+    for(std::size_t i = 0; i < map_size; i++) {
+      index_t class_index = no_class;
+      for(std::size_t map = 0; map < tensor.maps(); map++) {
+        const datum value = sample_ptr[map * map_size + i];
+        if(value == 1.0 && class_index == no_class)
+          class_index = (index_t)map;
+        else if(value != 0.0)
+          return false;
+      }
+      target_ptr[i] = class_index;
+    }
+  }
+  return true;
+}
+
+static void ConvertUChar(const unsigned char* source, const std::size_t count,
+                         const datum scale, const datum offset, datum* target) {
+  std::size_t i = 0;
+#ifdef __SSE2__
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 conversion needs float datum");
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 voffset = _mm_set1_ps(offset);
+  for(; i + 16 <= count; i += 16) {
+    const __m128i bytes = _mm_loadu_si128((const __m128i*)&source[i]);
+    const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+    const __m128i words[4] = {
+      _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+      _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+    };
+    for(unsigned int w = 0; w < 4; w++) {
+      const __m128 values = _mm_cvtepi32_ps(words[w]);
+      _mm_storeu_ps(&target[i + 4 * w], _mm_add_ps(voffset, _mm_mul_ps(vscale, values)));
+    }
+  }
+#endif
+  for(; i < count; i++)
+    target[i] = offset + scale * (datum)source[i];
+}
+
+CompactTensor::CompactTensor() {
+
+}
+
+CompactTensor::~CompactTensor() {
+  DeleteIfPossible();
+}
+
+void CompactTensor::FromTensor(Tensor& tensor) {
+#ifdef BUILD_OPENCL
+  tensor.MoveToCPU();
+#endif
+  Resize(COMPACT_FLOAT, tensor.samples(), tensor.width(), tensor.height(),
+         tensor.maps(), sizeof(datum) / sizeof(char));
+  if(data_length_ > 0)
+    std::memcpy(data_ptr_, tensor.data_ptr_const(), data_length_);
+}
+
+bool CompactTensor::FromClassTensor(Tensor& tensor) {
+#ifdef BUILD_OPENCL
+  tensor.MoveToCPU();
+#endif
+  const std::size_t element_size = ClassIndexSize(tensor.maps());
+  if(element_size == 0)
+    return false;
+
+  Resize(COMPACT_CLASS_INDEX, tensor.samples(), tensor.width(), tensor.height(),
+         tensor.maps(), element_size);
+
+  bool success = element_size == 1 ?
+    ExtractClassIndices<uint8_t>(tensor, (uint8_t*)data_ptr_) :
+    ExtractClassIndices<uint16_t>(tensor, (uint16_t*)data_ptr_);
+
+  if(!success)
+    DeleteIfPossible();
+
+  return success;
+}
+
+bool CompactTensor::FromClassIndices(const std::vector<unsigned int>& indices,
+                                     const std::size_t samples, const std::size_t width,
+                                     const std::size_t height, const std::size_t classes) {
+  const std::size_t element_size = ClassIndexSize(classes);
+  if(element_size == 0)
+    return false;
+
+  const std::size_t count = samples * width * height;
+  if(indices.size() < count)
+    return false;
+
+  Resize(COMPACT_CLASS_INDEX, samples, width, height, classes, element_size);
+
+  if(element_size == 1) {
+    for(std::size_t i = 0; i < count; i++)
+      data_ptr_[i] = indices[i] < classes ? (uint8_t)indices[i] : (uint8_t)0xFF;
+  } else {
+    uint16_t* target = (uint16_t*)data_ptr_;
+    for(std::size_t i = 0; i < count; i++)
+      target[i] = indices[i] < classes ? (uint16_t)indices[i] : (uint16_t)0xFFFF;
+  }
+  return true;
+}
+
+bool CompactTensor::FromImageTensor(Tensor& tensor, bool lossy) {
+#ifdef BUILD_OPENCL
+  tensor.MoveToCPU();
+#endif
+  const datum* source = tensor.data_ptr_const();
+  const std::size_t elements = tensor.elements();
+
+  // Try the default 8-bit mapping first, this is exact for 8-bit images
+  datum scale = DATUM_FROM_UCHAR(1);
+  datum offset = 0;
+  bool exact = true;
+  for(std::size_t e = 0; e < elements && exact; e++) {
+    const long quantized = std::lround(source[e] / scale);
+    exact = quantized >= 0 && quantized <= 255 &&
+      (offset + scale * (datum)quantized) == source[e];
+  }
+
+  if(!exact) {
+    if(!lossy)
+      return false;
+
+    datum min = std::numeric_limits<datum>::max();
+    datum max = std::numeric_limits<datum>::lowest();
+    for(std::size_t e = 0; e < elements; e++) {
+      if(source[e] < min) min = source[e];
+      if(source[e] > max) max = source[e];
+    }
+    offset = min;
+    scale = max > min ? (max - min) / (datum)255 : (datum)1;
+  }
+
+  Resize(COMPACT_UCHAR, tensor.samples(), tensor.width(), tensor.height(),
+         tensor.maps(), 1);
+  scale_ = scale;
+  offset_ = offset;
+
+  for(std::size_t e = 0; e < elements; e++) {
+    const long quantized = std::lround((source[e] - offset) / scale);
+    data_ptr_[e] = (unsigned char)(quantized < 0 ? 0 : (quantized > 255 ? 255 : quantized));
+  }
+  return true;
+}
+
+bool CompactTensor::CopySample(const std::size_t source_sample, Tensor& target,
+                               const std::size_t target_sample) const {
+  if(source_sample >= samples_ || target_sample >= target.samples())
+    return false;
+
+  if(target.maps() != maps_ || target.width() < width_ || target.height() < height_)
+    return false;
+
+#ifdef BUILD_OPENCL
+  target.MoveToCPU();
+#endif
+
+  const std::size_t map_size = width_ * height_;
+  datum* target_ptr = target.data_ptr(0, 0, 0, target_sample);
+
+  switch(type_) {
+    case COMPACT_CLASS_INDEX:
+      if(element_size_ == 1)
+        ExpandClassIndices<uint8_t>(&((const uint8_t*)data_ptr_)[source_sample * map_size],
+                                    width_, height_, maps_, target_ptr, target.width(), target.height());
+      else
+        ExpandClassIndices<uint16_t>(&((const uint16_t*)data_ptr_)[source_sample * map_size],
+                                     width_, height_, maps_, target_ptr, target.width(), target.height());
+      return true;
+    case COMPACT_UCHAR: {
+      const unsigned char* source_ptr = &data_ptr_[source_sample * map_size * maps_];
+      if(target.width() == width_ && target.height() == height_) {
+        ConvertUChar(source_ptr, map_size * maps_, scale_, offset_, target_ptr);
+        return true;
+      }
+
+      // Source image is smaller, pad with zeros
+      const std::size_t target_map_size = target.width() * target.height();
+      std::memset(target_ptr, 0, sizeof(datum) * target_map_size * maps_ / sizeof(char));
+      for(std::size_t map = 0; map < maps_; map++) {
+        for(std::size_t y = 0; y < height_; y++) {
+          ConvertUChar(&source_ptr[map * map_size + y * width_], width_, scale_, offset_,
+                       &target_ptr[map * target_map_size + y * target.width()]);
+        }
+      }
+      return true;
+    }
+    case COMPACT_FLOAT: {
+      const datum* source_ptr = &((const datum*)data_ptr_)[source_sample * map_size * maps_];
+      if(target.width() == width_ && target.height() == height_) {
+        std::memcpy(target_ptr, source_ptr, sizeof(datum) * map_size * maps_ / sizeof(char));
+        return true;
+      }
+
+      // Source image is smaller, pad with zeros
+      const std::size_t target_map_size = target.width() * target.height();
+      std::memset(target_ptr, 0, sizeof(datum) * target_map_size * maps_ / sizeof(char));
+      for(std::size_t map = 0; map < maps_; map++) {
+        for(std::size_t y = 0; y < height_; y++) {
+          std::memcpy(&target_ptr[map * target_map_size + y * target.width()],
+                      &source_ptr[map * map_size + y * width_],
+                      sizeof(datum) * width_ / sizeof(char));
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+void CompactTensor::Serialize(std::ostream& output) {
+  uint64_t type = type_;
+  uint64_t samples = samples_;
+  uint64_t width = width_;
+  uint64_t height = height_;
+  uint64_t maps = maps_;
+  uint64_t element_size = element_size_;
+
+  output.write ( ( const char* ) &type, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &samples, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &width, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &height, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &maps, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &element_size, sizeof ( uint64_t ) / sizeof ( char ) );
+
+  if(type_ == COMPACT_UCHAR) {
+    float scale = scale_;
+    float offset = offset_;
+    output.write ( ( const char* ) &scale, sizeof ( float ) / sizeof ( char ) );
+    output.write ( ( const char* ) &offset, sizeof ( float ) / sizeof ( char ) );
+  }
+
+  if(data_length_ > 0) {
+    output.write ( ( const char* ) data_ptr_, data_length_ );
+    const char padding[compact_alignment] = {0};
+    output.write ( padding, (compact_alignment - (data_length_ % compact_alignment)) % compact_alignment );
+  }
+}
+
+void CompactTensor::Deserialize(std::istream& input, bool head_only, bool try_mmap, int fd) {
+  uint64_t type = 0;
+  uint64_t samples = 0;
+  uint64_t width = 0;
+  uint64_t height = 0;
+  uint64_t maps = 0;
+  uint64_t element_size = 0;
+
+  if ( !input.good() )
+    LOGERROR << "Cannot deserialize from this stream!";
+
+  input.read ( ( char* ) &type, sizeof ( uint64_t ) / sizeof ( char ) );
+  input.read ( ( char* ) &samples, sizeof ( uint64_t ) / sizeof ( char ) );
+  input.read ( ( char* ) &width, sizeof ( uint64_t ) / sizeof ( char ) );
+  input.read ( ( char* ) &height, sizeof ( uint64_t ) / sizeof ( char ) );
+  input.read ( ( char* ) &maps, sizeof ( uint64_t ) / sizeof ( char ) );
+  input.read ( ( char* ) &element_size, sizeof ( uint64_t ) / sizeof ( char ) );
+
+  if(!input.good()) {
+    DeleteIfPossible();
+    return;
+  }
+
+  if(type != COMPACT_FLOAT && type != COMPACT_CLASS_INDEX && type != COMPACT_UCHAR) {
+    FATAL("Unknown compact tensor type: " << type);
+  }
+
+  float scale = 0;
+  float offset = 0;
+  if(type == COMPACT_UCHAR) {
+    input.read ( ( char* ) &scale, sizeof ( float ) / sizeof ( char ) );
+    input.read ( ( char* ) &offset, sizeof ( float ) / sizeof ( char ) );
+  }
+
+  const std::size_t values_per_element = type == COMPACT_CLASS_INDEX ? 1 : maps;
+  const std::size_t data_length = samples * width * height * values_per_element * element_size;
+  const std::size_t padded_length = data_length +
+    (compact_alignment - (data_length % compact_alignment)) % compact_alignment;
+
+  if(head_only || data_length == 0) {
+    DeleteIfPossible();
+    type_ = (CompactTensorType)type;
+    samples_ = samples; width_ = width; height_ = height; maps_ = maps;
+    element_size_ = element_size;
+    scale_ = scale; offset_ = offset;
+    input.seekg(padded_length, std::ios::cur);
+    return;
+  }
+
+#ifdef BUILD_POSIX
+  if(try_mmap && fd != 0) {
+    DeleteIfPossible();
+    // Get page size
+    long int page_size = sysconf(_SC_PAGESIZE);
+    long int current_position = input.tellg();
+    long int offset_in_page = current_position % page_size;
+#ifdef BUILD_LINUX
+    void* target_mmap = mmap64(NULL, data_length + offset_in_page, PROT_READ, MAP_PRIVATE, fd, current_position - offset_in_page);
+#elif defined(BUILD_OSX)
+    // OS X is 64-bit by default
+    void* target_mmap = mmap(NULL, data_length + offset_in_page, PROT_READ, MAP_PRIVATE, fd, current_position - offset_in_page);
+#endif
+    if(target_mmap == MAP_FAILED) {
+      FATAL("Memory map failed: " << errno);
+    }
+    original_mmap_ = target_mmap;
+    mmap_length_ = data_length + offset_in_page;
+    mmapped_ = true;
+
+    data_ptr_ = (unsigned char*)(((long)target_mmap) + offset_in_page);
+    type_ = (CompactTensorType)type;
+    samples_ = samples; width_ = width; height_ = height; maps_ = maps;
+    element_size_ = element_size;
+    scale_ = scale; offset_ = offset;
+    data_length_ = data_length;
+    input.seekg(padded_length, std::ios::cur);
+    return;
+  }
+#else
+  UNREFERENCED_PARAMETER(try_mmap);
+  UNREFERENCED_PARAMETER(fd);
+#endif
+
+  Resize((CompactTensorType)type, samples, width, height, maps, element_size);
+  scale_ = scale; offset_ = offset;
+  input.read ( ( char* ) data_ptr_, data_length_ );
+  input.seekg(padded_length - data_length, std::ios::cur);
+}
+
+void CompactTensor::Resize(const CompactTensorType type, const std::size_t samples,
+                           const std::size_t width, const std::size_t height,
+                           const std::size_t maps, const std::size_t element_size) {
+  DeleteIfPossible();
+
+  const std::size_t values_per_element = type == COMPACT_CLASS_INDEX ? 1 : maps;
+  const std::size_t data_length = samples * width * height * values_per_element * element_size;
+
+  if(data_length > 0)
+    data_ptr_ = new unsigned char[data_length];
+
+  type_ = type;
+  samples_ = samples;
+  width_ = width;
+  height_ = height;
+  maps_ = maps;
+  element_size_ = element_size;
+  data_length_ = data_length;
+}
+
+void CompactTensor::DeleteIfPossible() {
+  if(data_ptr_ != nullptr) {
+#ifdef BUILD_POSIX
+    if(mmapped_) {
+      munmap(original_mmap_, mmap_length_);
+      original_mmap_ = nullptr;
+      mmap_length_ = 0;
+      mmapped_ = false;
+    } else {
+#endif
+      delete[] data_ptr_;
+#ifdef BUILD_POSIX
+    }
+#endif
+    data_ptr_ = nullptr;
+  }
+
+  type_ = COMPACT_FLOAT;
+  samples_ = 0;
+  width_ = 0;
+  height_ = 0;
+  maps_ = 0;
+  element_size_ = 0;
+  data_length_ = 0;
+  scale_ = 0;
+  offset_ = 0;
+}
+
+std::ostream& operator<< ( std::ostream& output, const CompactTensor& tensor ) {
+  const char* prefix = tensor.type() == COMPACT_CLASS_INDEX ? "I(" :
+    (tensor.type() == COMPACT_UCHAR ? "B(" : "F(");
+  return output << prefix <<
+         tensor.samples() << "s@" << tensor.width() <<
+         "x" << tensor.height() << "x" << tensor.maps() << "m)";
+}
+
+}
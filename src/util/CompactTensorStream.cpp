@@ -0,0 +1,74 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <iostream>
+#include <fstream>
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+#include "CompactTensorStream.h"
+
+namespace Conv {
+  
+unsigned int CompactTensorStream::LoadFile(std::string path)
+{
+  std::ifstream input_stream(path, std::ios::binary | std::ios::in);
+  if(!input_stream.good()) {
+    FATAL("Cannot open file: " << path);
+  }
+#ifdef BUILD_POSIX
+  int input_fd = open(path.c_str(), O_RDONLY);
+  if(input_fd < 0) {
+    FATAL("Cannot open file: " << path);
+  }
+#endif
+
+  uint64_t magic = 0;
+  input_stream.read((char*)&magic, sizeof(uint64_t)/sizeof(char));
+  
+  if(magic != CN24_KTS_MAGIC) {
+    FATAL("Wrong magic at start of stream!");
+  }
+
+  // Go through file
+  std::cout << std::endl << std::flush;
+  
+  while (!input_stream.eof()) {
+    CompactTensor* tensor = new CompactTensor();
+#ifdef BUILD_POSIX
+    tensor->Deserialize (input_stream, false, true, input_fd);
+#else
+    tensor->Deserialize (input_stream, false);
+#endif
+
+    if (tensor->elements() == 0) {
+      delete tensor;
+      break;
+    }
+
+    tensors_.push_back(tensor);
+    std::cout << "." << std::flush;
+    input_stream.peek();
+  }
+  
+  return 0;
+}
+
+bool CompactTensorStream::CopySample(const unsigned int source, const std::size_t source_sample,
+                                   Conv::Tensor& target, const std::size_t target_sample)
+{
+  if(source < tensors_.size()) {
+    return tensors_[source]->CopySample(source_sample, target, target_sample);
+  } else
+    return false;
+}
+
+}
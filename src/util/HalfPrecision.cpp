@@ -0,0 +1,197 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cstring>
+
+#if defined(__F16C__) || defined(__AVX512BF16__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Log.h"
+#include "HalfPrecision.h"
+
+namespace Conv {
+
+static inline uint32_t BitsOf(const float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline float FloatOf(const uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static inline uint16_t RoundToHalf(const uint32_t dropped_bits, uint32_t half, const uint32_t remainder) {
+  const uint32_t halfway = 1u << (dropped_bits - 1);
+  if(remainder > halfway || (remainder == halfway && (half & 1)))
+    half++;
+  return (uint16_t)half;
+}
+
+static inline uint16_t FloatToHalf(const float value) {
+  const uint32_t bits = BitsOf(value);
+  const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+  const int exponent = (int)((bits >> 23) & 0xFF);
+  const uint32_t mantissa = bits & 0x7FFFFF;
+
+  // Infinity and NaN, NaNs stay quiet
+  if(exponent == 0xFF)
+    return sign | 0x7C00 | (mantissa != 0 ? 0x200 | (mantissa >> 13) : 0);
+
+  const int half_exponent = exponent - 127 + 15;
+  if(half_exponent >= 31)
+    return sign | 0x7C00;
+
+  // Subnormal halfs, a carry makes them normal
+  if(half_exponent <= 0) {
+    if(half_exponent < -10)
+      return sign;
+    const uint32_t significand = mantissa | 0x800000;
+    const uint32_t dropped_bits = 14 - half_exponent;
+    return sign | RoundToHalf(dropped_bits, significand >> dropped_bits,
+                              significand & ((1u << dropped_bits) - 1));
+  }
+
+  // A carry out of the mantissa increments the exponent, up to infinity
+  return sign | RoundToHalf(13, ((uint32_t)half_exponent << 10) | (mantissa >> 13), mantissa & 0x1FFF);
+}
+
+static inline float HalfToFloat(const uint16_t half) {
+  const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+
+  // NaNs are made quiet like F16C does
+  if(exponent == 0x1F)
+    return FloatOf(sign | 0x7F800000 | (mantissa != 0 ? (0x200 | mantissa) << 13 : 0));
+  if(exponent != 0)
+    return FloatOf(sign | ((exponent + 112) << 23) | (mantissa << 13));
+  if(mantissa == 0)
+    return FloatOf(sign);
+
+  // Subnormal halfs are normal floats
+  uint32_t float_exponent = 113;
+  while((mantissa & 0x400) == 0) {
+    mantissa <<= 1;
+    float_exponent--;
+  }
+  return FloatOf(sign | (float_exponent << 23) | ((mantissa & 0x3FF) << 13));
+}
+
+static inline uint16_t FloatToBFloat16(const float value) {
+  const uint32_t bits = BitsOf(value);
+  if((bits & 0x7FFFFFFF) > 0x7F800000)
+    return (uint16_t)((bits | 0x400000) >> 16);
+  return (uint16_t)((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+static inline float BFloat16ToFloat(const uint16_t value) {
+  return FloatOf((uint32_t)value << 16);
+}
+
+void HalfPrecision::Pack(const datum* source, uint16_t* target, const std::size_t count,
+                         const TensorStorage storage) {
+  std::size_t e = 0;
+  if(storage == STORAGE_FLOAT16) {
+#ifdef __F16C__
+    for(; e + 8 <= count; e += 8)
+      _mm_storeu_si128((__m128i*)(target + e), _mm256_cvtps_ph(_mm256_loadu_ps(source + e), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for(; e < count; e++)
+      target[e] = FloatToHalf(source[e]);
+  } else if(storage == STORAGE_BFLOAT16) {
+#if defined(__AVX512BF16__)
+    // Note that the instruction flushes subnormal floats to zero
+    for(; e + 16 <= count; e += 16)
+      _mm256_storeu_si256((__m256i*)(target + e), (__m256i)_mm512_cvtneps_pbh(_mm512_loadu_ps(source + e)));
+#elif defined(__SSE2__)
+    const __m128i rounding = _mm_set1_epi32(0x7FFF);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i magnitude = _mm_set1_epi32(0x7FFFFFFF);
+    const __m128i infinity = _mm_set1_epi32(0x7F800000);
+    const __m128i quiet = _mm_set1_epi32(0x400000);
+    for(; e + 8 <= count; e += 8) {
+      __m128i halves[2];
+      for(unsigned int h = 0; h < 2; h++) {
+        const __m128i bits = _mm_castps_si128(_mm_loadu_ps(source + e + 4 * h));
+        const __m128i lsb = _mm_and_si128(_mm_srli_epi32(bits, 16), one);
+        const __m128i rounded = _mm_add_epi32(bits, _mm_add_epi32(rounding, lsb));
+        const __m128i is_nan = _mm_cmpgt_epi32(_mm_and_si128(bits, magnitude), infinity);
+        const __m128i result = _mm_or_si128(_mm_and_si128(is_nan, _mm_or_si128(bits, quiet)),
+                                            _mm_andnot_si128(is_nan, rounded));
+        // Sign extension keeps the saturating pack exact
+        halves[h] = _mm_srai_epi32(result, 16);
+      }
+      _mm_storeu_si128((__m128i*)(target + e), _mm_packs_epi32(halves[0], halves[1]));
+    }
+#endif
+    for(; e < count; e++)
+      target[e] = FloatToBFloat16(source[e]);
+  } else {
+    FATAL("Cannot pack into storage type " << storage);
+  }
+}
+
+void HalfPrecision::Unpack(const uint16_t* source, datum* target, const std::size_t count,
+                           const TensorStorage storage) {
+  std::size_t e = 0;
+  if(storage == STORAGE_FLOAT16) {
+#ifdef __F16C__
+    for(; e + 8 <= count; e += 8)
+      _mm256_storeu_ps(target + e, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(source + e))));
+#endif
+    for(; e < count; e++)
+      target[e] = HalfToFloat(source[e]);
+  } else if(storage == STORAGE_BFLOAT16) {
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for(; e + 8 <= count; e += 8) {
+      const __m128i values = _mm_loadu_si128((const __m128i*)(source + e));
+      _mm_storeu_ps(target + e, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, values)));
+      _mm_storeu_ps(target + e + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, values)));
+    }
+#endif
+    for(; e < count; e++)
+      target[e] = BFloat16ToFloat(source[e]);
+  } else {
+    FATAL("Cannot unpack from storage type " << storage);
+  }
+}
+
+std::size_t HalfPrecision::ElementSize(const TensorStorage storage) {
+  return storage == STORAGE_FLOAT32 ? sizeof(datum) : sizeof(uint16_t);
+}
+
+bool HalfPrecision::ParseStorage(const std::string& name, TensorStorage& storage) {
+  if(name.compare("fp32") == 0)
+    storage = STORAGE_FLOAT32;
+  else if(name.compare("fp16") == 0)
+    storage = STORAGE_FLOAT16;
+  else if(name.compare("bf16") == 0)
+    storage = STORAGE_BFLOAT16;
+  else
+    return false;
+  return true;
+}
+
+const char* HalfPrecision::GetImplementation() {
+#if defined(__F16C__) && defined(__AVX512BF16__)
+  return "F16C, AVX-512 BF16";
+#elif defined(__F16C__)
+  return "F16C, SSE2";
+#elif defined(__SSE2__)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+
+}
@@ -0,0 +1,216 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+#include "Tensor.h"
+#include "PNGUtil.h"
+#include "JPGUtil.h"
+#include "ImageUtil.h"
+
+namespace Conv {
+
+enum ImageFormat {
+  IMAGE_UNKNOWN,
+  IMAGE_PNG,
+  IMAGE_JPG
+};
+
+static ImageFormat FormatOf(const std::string& file) {
+  const std::size_t dot = file.find_last_of('.');
+  if(dot == std::string::npos)
+    return IMAGE_UNKNOWN;
+
+  std::string extension = file.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+  if(extension == "png")
+    return IMAGE_PNG;
+  if(extension == "jpg" || extension == "jpeg")
+    return IMAGE_JPG;
+  return IMAGE_UNKNOWN;
+}
+
+#ifdef __SSE2__
+/*
+ * Converts 16 bytes to 16 datums with DATUM_FROM_UCHAR
+ */
+static inline void StoreBytes(const __m128i bytes, datum* target) {
+  static_assert(sizeof(datum) == sizeof(float), "SSE2 conversion needs float datum");
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(DATUM_FROM_UCHAR(1));
+  const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+  const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+  _mm_storeu_ps(&target[0], _mm_mul_ps(scale, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero))));
+  _mm_storeu_ps(&target[4], _mm_mul_ps(scale, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero))));
+  _mm_storeu_ps(&target[8], _mm_mul_ps(scale, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero))));
+  _mm_storeu_ps(&target[12], _mm_mul_ps(scale, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero))));
+}
+#endif
+
+void ImageUtil::DeinterleaveRow(const unsigned char* source, const std::size_t width,
+                                const std::size_t channels, datum* const* targets) {
+  std::size_t x = 0;
+#ifdef __SSE2__
+  if(channels == 1) {
+    for(; x + 16 <= width; x += 16)
+      StoreBytes(_mm_loadu_si128((const __m128i*)&source[x]), &targets[0][x]);
+  }
+#ifdef __SSSE3__
+  else if(channels == 3) {
+    // Shuffle masks for 16 RGB pixels spread over three registers
+    const __m128i ra = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i rb = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i rc = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i ga = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i gb = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i gc = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i ba = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i bb = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i bc = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+    for(; x + 16 <= width; x += 16) {
+      const __m128i a = _mm_loadu_si128((const __m128i*)&source[3 * x]);
+      const __m128i b = _mm_loadu_si128((const __m128i*)&source[3 * x + 16]);
+      const __m128i c = _mm_loadu_si128((const __m128i*)&source[3 * x + 32]);
+      StoreBytes(_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, ra), _mm_shuffle_epi8(b, rb)),
+                              _mm_shuffle_epi8(c, rc)), &targets[0][x]);
+      StoreBytes(_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, ga), _mm_shuffle_epi8(b, gb)),
+                              _mm_shuffle_epi8(c, gc)), &targets[1][x]);
+      StoreBytes(_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, ba), _mm_shuffle_epi8(b, bb)),
+                              _mm_shuffle_epi8(c, bc)), &targets[2][x]);
+    }
+  }
+#endif
+  else if(channels <= 4) {
+    // Gather 16 pixels per channel, then convert them together
+    unsigned char planes[4][16];
+    for(; x + 16 <= width; x += 16) {
+      for(std::size_t i = 0; i < 16; i++) {
+        for(std::size_t channel = 0; channel < channels; channel++)
+          planes[channel][i] = source[channels * (x + i) + channel];
+      }
+      for(std::size_t channel = 0; channel < channels; channel++)
+        StoreBytes(_mm_loadu_si128((const __m128i*)planes[channel]), &targets[channel][x]);
+    }
+  }
+#endif
+  for(; x < width; x++) {
+    for(std::size_t channel = 0; channel < channels; channel++)
+      targets[channel][x] = DATUM_FROM_UCHAR(source[channels * x + channel]);
+  }
+}
+
+bool ImageUtil::IsImageFile(const std::string& file) {
+  return FormatOf(file) != IMAGE_UNKNOWN;
+}
+
+bool ImageUtil::ReadSize(const std::string& file, std::size_t& width,
+                         std::size_t& height, std::size_t& channels) {
+  switch(FormatOf(file)) {
+    case IMAGE_PNG: {
+      std::ifstream input_image_file(file, std::ios::in | std::ios::binary);
+      if(!input_image_file.good()) {
+        LOGERROR << "Cannot open " << file;
+        return false;
+      }
+      return PNGUtil::ReadSize(input_image_file, width, height, channels);
+    }
+    case IMAGE_JPG:
+      return JPGUtil::ReadSize(file, width, height, channels);
+    default:
+      LOGERROR << "File format not supported: " << file;
+      return false;
+  }
+}
+
+bool ImageUtil::LoadFromFile(const std::string& file, Tensor& tensor) {
+  switch(FormatOf(file)) {
+    case IMAGE_PNG: {
+      std::ifstream input_image_file(file, std::ios::in | std::ios::binary);
+      if(!input_image_file.good()) {
+        LOGERROR << "Cannot open " << file;
+        return false;
+      }
+      return PNGUtil::LoadFromStream(input_image_file, tensor);
+    }
+    case IMAGE_JPG:
+      return JPGUtil::LoadFromFile(file, tensor);
+    default:
+      LOGERROR << "File format not supported: " << file;
+      return false;
+  }
+}
+
+bool ImageUtil::LoadFromFile(const std::string& file, Tensor& tensor, const std::size_t sample) {
+  if(sample >= tensor.samples()) {
+    LOGERROR << "Sample " << sample << " out of bounds for " << tensor;
+    return false;
+  }
+
+  switch(FormatOf(file)) {
+    case IMAGE_PNG: {
+      std::ifstream input_image_file(file, std::ios::in | std::ios::binary);
+      if(!input_image_file.good()) {
+        LOGERROR << "Cannot open " << file;
+        return false;
+      }
+      return PNGUtil::LoadFromStream(input_image_file, tensor, sample);
+    }
+    case IMAGE_JPG:
+      return JPGUtil::LoadFromFile(file, tensor, sample);
+    default:
+      LOGERROR << "File format not supported: " << file;
+      return false;
+  }
+}
+
+bool ImageUtil::LoadBatch(const std::vector<std::string>& files, std::vector<Tensor>& tensors) {
+  std::vector<Tensor> decoded_tensors(files.size());
+  bool success = true;
+
+  #pragma omp parallel for default(shared) schedule(dynamic) reduction(&&:success)
+  for(std::size_t i = 0; i < files.size(); i++) {
+    success = LoadFromFile(files[i], decoded_tensors[i]) && success;
+  }
+
+  tensors.swap(decoded_tensors);
+  return success;
+}
+
+bool ImageUtil::LoadBatch(const std::vector<std::string>& files, Tensor& tensor) {
+#ifdef BUILD_OPENCL
+  tensor.MoveToCPU();
+#endif
+  if(files.size() > tensor.samples()) {
+    LOGERROR << "Cannot load " << files.size() << " images into " << tensor;
+    return false;
+  }
+
+  bool success = true;
+
+  #pragma omp parallel for default(shared) schedule(dynamic) reduction(&&:success)
+  for(std::size_t i = 0; i < files.size(); i++) {
+    success = LoadFromFile(files[i], tensor, i) && success;
+  }
+
+  return success;
+}
+
+}
@@ -17,29 +17,71 @@
 #include "Log.h"
 #include "Tensor.h"
 #include "JPGUtil.h"
+#include "ImageUtil.h"
 
 namespace Conv {
 
+/**
+ * @brief Decodes a JPG into the sample of the Tensor, resizing it if requested.
+ */
+static bool LoadJPG (const std::string& file, Tensor& tensor, const std::size_t sample,
+                     const bool resize, const bool head_only = false,
+                     std::size_t* width = nullptr, std::size_t* height = nullptr,
+                     std::size_t* channels = nullptr);
+
 bool JPGUtil::LoadFromFile (const std::string& file, Tensor& tensor) {
+  return LoadJPG(file, tensor, 0, true);
+}
+
+bool JPGUtil::LoadFromFile (const std::string& file, Tensor& tensor, const std::size_t sample) {
+  return LoadJPG(file, tensor, sample, false);
+}
+
+bool JPGUtil::ReadSize (const std::string& file, std::size_t& width,
+                        std::size_t& height, std::size_t& channels) {
+  Tensor dummy;
+  return LoadJPG(file, dummy, 0, false, true, &width, &height, &channels);
+}
+
+static bool LoadJPG (const std::string& file, Tensor& tensor, const std::size_t sample,
+                     const bool resize, const bool head_only,
+                     std::size_t* width, std::size_t* height, std::size_t* channels) {
 #ifndef BUILD_JPG
+  UNREFERENCED_PARAMETER(file);
+  UNREFERENCED_PARAMETER(tensor);
+  UNREFERENCED_PARAMETER(sample);
+  UNREFERENCED_PARAMETER(resize);
+  UNREFERENCED_PARAMETER(head_only);
+  UNREFERENCED_PARAMETER(width);
+  UNREFERENCED_PARAMETER(height);
+  UNREFERENCED_PARAMETER(channels);
   LOGERROR << "JPG is not supported by this build!";
   return false;
 #else
   
-  // Create decompression object
-  jpeg_decompress_struct cinfo;
-  jpeg_error_mgr jerr;
-  cinfo.err = jpeg_std_error(&jerr);
-  jpeg_create_decompress(&cinfo);
-  
   FILE* in_file = fopen(file.c_str(), "rb");
   if(in_file == NULL) {
     LOGERROR << "Cannot open " << file;
     return false;
   }
   
+  // Create decompression object
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  
   jpeg_stdio_src(&cinfo, in_file);
   jpeg_read_header(&cinfo, true);
+
+  if(head_only) {
+    *width = cinfo.image_width;
+    *height = cinfo.image_height;
+    *channels = cinfo.num_components;
+    jpeg_destroy_decompress(&cinfo);
+    fclose(in_file);
+    return true;
+  }
   
   jpeg_start_decompress(&cinfo);
 
@@ -47,23 +89,44 @@ bool JPGUtil::LoadFromFile (const std::string& file, Tensor& tensor) {
   unsigned int image_height = cinfo.output_height;
   unsigned int image_channels = cinfo.output_components;
 
+  bool fits = image_channels <= 4;
+  if(!fits) {
+    LOGERROR << "Unsupported channel count: " << image_channels;
+  } else if(resize) {
+    tensor.Resize(1, image_width, image_height, image_channels);
+  } else if(image_width > tensor.width() || image_height > tensor.height() ||
+            image_channels != tensor.maps()) {
+    LOGERROR << "Image (" << image_width << "x" << image_height << "x"
+             << image_channels << ") does not fit into " << tensor;
+    fits = false;
+  } else {
+#ifdef BUILD_OPENCL
+    tensor.MoveToCPU();
+#endif
+    if(image_width < tensor.width() || image_height < tensor.height())
+      tensor.Clear(0.0, sample);
+  }
+
+  if(!fits) {
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(in_file);
+    return false;
+  }
+
   JSAMPARRAY samples = (cinfo.mem->alloc_sarray)
   ((j_common_ptr)&cinfo, JPOOL_IMAGE, image_width * image_channels, 1);
   
-  tensor.Resize(1, image_width, image_height, image_channels);
-  
-  unsigned int current_line = 0;
+  // One row pointer per channel into the planar target
+  datum* targets[4];
+
   while(cinfo.output_scanline < cinfo.output_height) {
-    const unsigned int addition = jpeg_read_scanlines(&cinfo, samples, 1);
-    for(unsigned int c = 0; c < image_channels; c++) {
-      for(unsigned int x = 0; x < image_width; x++) {
-        datum* target = tensor.data_ptr(x, current_line, c);
-        JSAMPLE samp = samples[0][(x * image_channels) + c];
-        const datum val = DATUM_FROM_UCHAR(samp);
-        *target = val;
-      }
-    }
-    current_line += addition;
+    const unsigned int current_line = cinfo.output_scanline;
+    jpeg_read_scanlines(&cinfo, samples, 1);
+    for(unsigned int c = 0; c < image_channels; c++)
+      targets[c] = tensor.data_ptr(0, current_line, c, sample);
+
+    ImageUtil::DeinterleaveRow(samples[0], image_width, image_channels, targets);
   }
   
   jpeg_finish_decompress(&cinfo);
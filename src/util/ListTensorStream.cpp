@@ -14,7 +14,9 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
 
+#include "ImageUtil.h"
 #include "ListTensorStream.h"
 
 namespace Conv {
@@ -75,96 +77,146 @@ namespace Conv {
   
   bool ListTensorStream::CopySample(const unsigned int source_index, const std::size_t source_sample, Conv::Tensor &target, const std::size_t target_sample) {
 		if(source_index < tensors_.size()) {
-			// Load tensor by filename
-			Tensor rgb_tensor(tensors_[source_index].filename);
-			
-			// TODO Consider validation vs. performance
-			
-			if(source_index % 2) {
-				// Tensor has a label in it, colors need to be transformed
-				unsigned int number_of_classes = class_colors_.size();
-				
-				// arrays to store class colors in an easy to index way
-				Conv::datum* cr = new Conv::datum[number_of_classes];
-				Conv::datum* cg = new Conv::datum[number_of_classes];
-				Conv::datum* cb = new Conv::datum[number_of_classes];
-
-				for ( unsigned int c = 0; c < number_of_classes; c++ ) {
-					const unsigned int class_color = class_colors_[c];
-					cr[c] = DATUM_FROM_UCHAR ( ( class_color >> 16 ) & 0xFF );
-					cg[c] = DATUM_FROM_UCHAR ( ( class_color >> 8 ) & 0xFF );
-					cb[c] = DATUM_FROM_UCHAR ( class_color & 0xFF );
-				}
-				
+			CompactTensor* tensor = GetCachedTensor(source_index);
+			if(tensor != nullptr)
+				return tensor->CopySample(source_sample, target, target_sample);
+
+			tensor = DecodeTensor(source_index);
+			if(tensor == nullptr)
+				return false;
+
+			bool success = tensor->CopySample(source_sample, target, target_sample);
+			if(!InsertCachedTensor(source_index, tensor))
+				delete tensor;
+			return success;
+		} else {
+			return false;
+		}
+  }
+
+	void ListTensorStream::Prefetch(const std::vector<unsigned int>& indices) {
+		std::vector<unsigned int> missing_indices;
+		for(unsigned int index : indices) {
+			if(index < tensors_.size() && cache_.find(index) == cache_.end() &&
+				std::find(missing_indices.begin(), missing_indices.end(), index) == missing_indices.end())
+				missing_indices.push_back(index);
+		}
+
+		// Decode in parallel, the cache is only touched afterwards
+		std::vector<CompactTensor*> decoded_tensors(missing_indices.size(), nullptr);
+
+		#pragma omp parallel for default(shared) schedule(dynamic)
+		for(unsigned int i = 0; i < missing_indices.size(); i++) {
+			decoded_tensors[i] = DecodeTensor(missing_indices[i]);
+		}
+
+		for(unsigned int i = 0; i < missing_indices.size(); i++) {
+			if(decoded_tensors[i] != nullptr && !InsertCachedTensor(missing_indices[i], decoded_tensors[i]))
+				delete decoded_tensors[i];
+		}
+	}
+
+	CompactTensor* ListTensorStream::DecodeTensor(const unsigned int index) const {
+		// Load tensor by filename
+		Tensor rgb_tensor;
+		if(!ImageUtil::LoadFromFile(tensors_[index].filename, rgb_tensor)) {
+			LOGERROR << "Cannot load " << tensors_[index].filename;
+			return nullptr;
+		}
+		return ConvertTensor(rgb_tensor, index);
+	}
+
+	CompactTensor* ListTensorStream::ConvertTensor(Tensor& rgb_tensor, const unsigned int index) const {
+		CompactTensor* tensor = new CompactTensor();
+
+		if(index % 2) {
+			// Tensor has a label in it, colors need to be transformed
+			unsigned int number_of_classes = class_colors_.size();
+
+			if(number_of_classes == 1) {
+				// 1 class - convert RGB images into multi-channel label tensors
 				Conv::Tensor label_tensor ( 1, rgb_tensor.width(), rgb_tensor.height(), number_of_classes);
+				const unsigned int foreground_color = class_colors_[0];
+				const Conv::datum fr = DATUM_FROM_UCHAR ( ( foreground_color >> 16 ) & 0xFF ),
+													fg = DATUM_FROM_UCHAR ( ( foreground_color >> 8 ) & 0xFF ),
+													fb = DATUM_FROM_UCHAR ( foreground_color & 0xFF );
 
-				if(number_of_classes == 1) {
-					// 1 class - convert RGB images into multi-channel label tensors
-					const unsigned int foreground_color = class_colors_[0];
-					const Conv::datum fr = DATUM_FROM_UCHAR ( ( foreground_color >> 16 ) & 0xFF ),
-														fg = DATUM_FROM_UCHAR ( ( foreground_color >> 8 ) & 0xFF ),
-														fb = DATUM_FROM_UCHAR ( foreground_color & 0xFF );
-
-					for ( unsigned int y = 0; y < rgb_tensor.height(); y++ ) {
-						for ( unsigned int x = 0; x < rgb_tensor.width(); x++ ) {
-							Conv::datum lr, lg, lb;
-
-							if ( rgb_tensor.maps() == 3 ) {
-								lr = *rgb_tensor.data_ptr_const ( x,y,0,0 );
-								lg = *rgb_tensor.data_ptr_const ( x,y,1,0 );
-								lb = *rgb_tensor.data_ptr_const ( x,y,2,0 );
-							} else if ( rgb_tensor.maps() == 1 ) {
-								lr = *rgb_tensor.data_ptr_const ( x,y,0,0 );
-								lg = lr;
-								lb = lr;
-							} else {
-								FATAL ( "Unsupported input channel count!" );
-							}
-
-							const Conv::datum class1_diff = std::sqrt ( ( lr - fr ) * ( lr - fr )
-																							+ ( lg - fg ) * ( lg - fg )
-																							+ ( lb - fb ) * ( lb - fb ) ) / std::sqrt ( 3.0 );
-							const Conv::datum val = 1.0 - 2.0 * class1_diff;
-							*label_tensor.data_ptr ( x,y,0,0 ) = val;
-						}
-					}
-				} else {
-					// any number of other classes      
-					label_tensor.Clear ( 0.0 );
-
-					for ( unsigned int y = 0; y < rgb_tensor.height(); y++ ) {
-						for ( unsigned int x = 0; x < rgb_tensor.width(); x++ ) {
-							Conv::datum lr, lg, lb;
-
-							if ( rgb_tensor.maps() == 3 ) {
-								lr = *rgb_tensor.data_ptr_const ( x,y,0,0 );
-								lg = *rgb_tensor.data_ptr_const ( x,y,1,0 );
-								lb = *rgb_tensor.data_ptr_const ( x,y,2,0 );
-							} else if ( rgb_tensor.maps() == 1 ) {
-								lr = *rgb_tensor.data_ptr_const ( x,y,0,0 );
-								lg = lr;
-								lb = lr;
-							} else {
-								FATAL ( "Unsupported input channel count!" );
-							}
-
-							for ( unsigned int c = 0; c < number_of_classes; c++ ) {
-								if(lr == cr[c] && lg == cg[c] && lb == cb[c])
-									*label_tensor.data_ptr ( x,y,c,0 ) = 1.0;
-							}
+				for ( unsigned int y = 0; y < rgb_tensor.height(); y++ ) {
+					for ( unsigned int x = 0; x < rgb_tensor.width(); x++ ) {
+						Conv::datum lr, lg, lb;
+
+						if ( rgb_tensor.maps() == 3 ) {
+							lr = *rgb_tensor.data_ptr_const ( x,y,0,0 );
+							lg = *rgb_tensor.data_ptr_const ( x,y,1,0 );
+							lb = *rgb_tensor.data_ptr_const ( x,y,2,0 );
+						} else if ( rgb_tensor.maps() == 1 ) {
+							lr = *rgb_tensor.data_ptr_const ( x,y,0,0 );
+							lg = lr;
+							lb = lr;
+						} else {
+							FATAL ( "Unsupported input channel count!" );
 						}
+
+						const Conv::datum class1_diff = std::sqrt ( ( lr - fr ) * ( lr - fr )
+																						+ ( lg - fg ) * ( lg - fg )
+																						+ ( lb - fb ) * ( lb - fb ) ) / std::sqrt ( 3.0 );
+						const Conv::datum val = 1.0 - 2.0 * class1_diff;
+						*label_tensor.data_ptr ( x,y,0,0 ) = val;
 					}
-				} // end if
-				Tensor::CopySample(label_tensor, source_sample, target, target_sample);
-				
+				}
+				tensor->FromTensor(label_tensor);
 			} else {
-				// Tensor has an image in it, no transform needed
-				Tensor::CopySample(rgb_tensor, source_sample, target, target_sample);
+				// any number of other classes, look up the class of each color
+				std::vector<unsigned int> class_indices;
+				if(!color_table_.ToClassIndices(rgb_tensor, class_indices) ||
+					!tensor->FromClassIndices(class_indices, 1, rgb_tensor.width(), rgb_tensor.height(), number_of_classes)) {
+					FATAL ( "Cannot convert label image " << tensors_[index].filename );
+				}
 			}
 		} else {
+			// Tensor has an image in it, no transform needed
+			if(!tensor->FromImageTensor(rgb_tensor))
+				tensor->FromTensor(rgb_tensor);
+		}
+
+		return tensor;
+	}
+
+	CompactTensor* ListTensorStream::GetCachedTensor(const unsigned int index) {
+		std::unordered_map<unsigned int, ListTensorCacheEntry>::iterator it = cache_.find(index);
+		if(it == cache_.end())
+			return nullptr;
+
+		// Move to the front of the LRU list
+		lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+		return it->second.tensor;
+	}
+
+	bool ListTensorStream::InsertCachedTensor(const unsigned int index, CompactTensor* tensor, bool allow_eviction) {
+		const std::size_t size = tensor->data_length();
+		if(size > cache_size_ || cache_.find(index) != cache_.end())
+			return false;
+
+		if(!allow_eviction && cache_used_ + size > cache_size_)
 			return false;
+
+		// Evict least recently used tensors until the new one fits
+		while(cache_used_ + size > cache_size_ && !lru_.empty()) {
+			const unsigned int evicted_index = lru_.back();
+			lru_.pop_back();
+			std::unordered_map<unsigned int, ListTensorCacheEntry>::iterator it = cache_.find(evicted_index);
+			cache_used_ -= it->second.tensor->data_length();
+			delete it->second.tensor;
+			cache_.erase(it);
 		}
-  }
+
+		lru_.push_front(index);
+		ListTensorCacheEntry& entry = cache_[index];
+		entry.tensor = tensor;
+		entry.lru_position = lru_.begin();
+		cache_used_ += size;
+		return true;
+	}
   
 	unsigned int ListTensorStream::LoadFiles(std::string image_list_fname, std::string image_directory, std::string label_list_fname, std::string label_directory) {
 		unsigned int number_of_classes = class_colors_.size();
@@ -188,9 +240,8 @@ namespace Conv {
 			FATAL ( "Cannot open label list file: " << label_list_fname );
 		}
 		
-		unsigned int tensor_count = 0;
-		
-		// Iterate through lists of images and labels
+		// Read lists of images and labels
+		std::vector<std::string> files;
 		while ( !image_list_file.eof() ) {
 			std::string image_fname;
 			std::string label_fname;
@@ -200,25 +251,70 @@ namespace Conv {
 			if ( image_fname.length() < 5 || label_fname.length() < 5 )
 				break;
 
-			LOGDEBUG << "Importing files " << image_fname << " and " << label_fname << "...";
-			Conv::Tensor image_tensor ( image_directory + image_fname );
-			Conv::Tensor label_rgb_tensor ( label_directory + label_fname );
+			files.push_back(image_directory + image_fname);
+			files.push_back(label_directory + label_fname);
+		}
+
+		unsigned int tensor_count = 0;
+
+		// Import the files in batches, decoding them in parallel
+		for(std::size_t batch_start = 0; batch_start < files.size(); batch_start += 2 * CN24_LTS_IMPORT_BATCH_SIZE) {
+			const std::size_t batch_end = std::min(files.size(), batch_start + 2 * CN24_LTS_IMPORT_BATCH_SIZE);
+			const std::vector<std::string> batch_files(files.begin() + batch_start, files.begin() + batch_end);
+			std::vector<Tensor> batch_tensors;
 
-			if ( image_tensor.width() != label_rgb_tensor.width() ||
-					image_tensor.height() != label_rgb_tensor.height() ) {
-				LOGERROR << "Dimensions don't match, skipping file!";
-				continue;
+			// The images are decoded anyway if they fit into the cache,
+			//  otherwise reading the sizes is enough
+			const bool decode = cache_used_ < cache_size_;
+			std::vector<std::size_t> widths(batch_files.size()), heights(batch_files.size()), maps(batch_files.size());
+			if(decode) {
+				if(!ImageUtil::LoadBatch(batch_files, batch_tensors))
+					FATAL("Cannot load images from list");
+				for(std::size_t i = 0; i < batch_files.size(); i++) {
+					widths[i] = batch_tensors[i].width();
+					heights[i] = batch_tensors[i].height();
+					maps[i] = batch_tensors[i].maps();
+				}
+			} else {
+				for(std::size_t i = 0; i < batch_files.size(); i++) {
+					if(!ImageUtil::ReadSize(batch_files[i], widths[i], heights[i], maps[i]))
+						FATAL("Cannot load " << batch_files[i]);
+				}
+			}
+
+			std::vector<std::size_t> imported;
+			for(std::size_t i = 0; i < batch_files.size(); i += 2) {
+				LOGDEBUG << "Importing files " << batch_files[i] << " and " << batch_files[i + 1] << "...";
+				if ( widths[i] != widths[i + 1] || heights[i] != heights[i + 1] ) {
+					LOGERROR << "Dimensions don't match, skipping file!";
+					continue;
+				}
+
+				ListTensorMetadata image_md(batch_files[i], widths[i], heights[i], maps[i], 1);
+				ListTensorMetadata label_md(batch_files[i + 1], widths[i + 1], heights[i + 1], number_of_classes, 1);
+
+				tensors_.push_back(image_md);
+				tensors_.push_back(label_md);
+				imported.push_back(i);
+
+				tensor_count += 2;
+			}
+
+			if(decode) {
+				// Keep the decoded images while there is room
+				const unsigned int first_index = tensors_.size() - 2 * imported.size();
+				std::vector<CompactTensor*> converted_tensors(2 * imported.size(), nullptr);
+
+				#pragma omp parallel for default(shared) schedule(dynamic)
+				for(std::size_t i = 0; i < converted_tensors.size(); i++) {
+					converted_tensors[i] = ConvertTensor(batch_tensors[imported[i / 2] + (i % 2)], first_index + i);
+				}
+
+				for(std::size_t i = 0; i < converted_tensors.size(); i++) {
+					if(!InsertCachedTensor(first_index + i, converted_tensors[i], false))
+						delete converted_tensors[i];
+				}
 			}
-	
-			int label_tensor_width = number_of_classes; 
-			
-			ListTensorMetadata image_md(image_directory + image_fname, image_tensor.width(), image_tensor.height(), image_tensor.maps(), image_tensor.samples());
-			ListTensorMetadata label_md(label_directory + label_fname, label_rgb_tensor.width(), label_rgb_tensor.height(), number_of_classes, label_rgb_tensor.samples());
-			
-			tensors_.push_back(image_md);
-			tensors_.push_back(label_md);
-			
-			tensor_count += 2;
 		}
 		
 		return tensor_count;
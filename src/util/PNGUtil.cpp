@@ -14,6 +14,7 @@
 #include "Log.h"
 #include "Tensor.h"
 #include "PNGUtil.h"
+#include "ImageUtil.h"
 
 namespace Conv {
 
@@ -44,8 +45,42 @@ void PNGReadFromStream (png_structp png_handle, png_bytep data,
 void PNGWriteToStream (png_structp png_handle, png_bytep data, png_size_t length);
 #endif
 
+/**
+ * @brief Decodes a PNG into the sample of the Tensor, resizing it if requested.
+ */
+static bool LoadPNG ( std::istream& stream, Tensor& tensor, const std::size_t sample,
+                      const bool resize, const bool head_only = false,
+                      std::size_t* width = nullptr, std::size_t* height = nullptr,
+                      std::size_t* channels = nullptr );
+
 bool PNGUtil::LoadFromStream ( std::istream& stream, Tensor& tensor ) {
+  return LoadPNG ( stream, tensor, 0, true );
+}
+
+bool PNGUtil::LoadFromStream ( std::istream& stream, Tensor& tensor,
+                               const std::size_t sample ) {
+  return LoadPNG ( stream, tensor, sample, false );
+}
+
+bool PNGUtil::ReadSize ( std::istream& stream, std::size_t& width,
+                         std::size_t& height, std::size_t& channels ) {
+  Tensor dummy;
+  return LoadPNG ( stream, dummy, 0, false, true, &width, &height, &channels );
+}
+
+static bool LoadPNG ( std::istream& stream, Tensor& tensor, const std::size_t sample,
+                      const bool resize, const bool head_only,
+                      std::size_t* width, std::size_t* height,
+                      std::size_t* channels ) {
 #ifndef BUILD_PNG
+  UNREFERENCED_PARAMETER(stream);
+  UNREFERENCED_PARAMETER(tensor);
+  UNREFERENCED_PARAMETER(sample);
+  UNREFERENCED_PARAMETER(resize);
+  UNREFERENCED_PARAMETER(head_only);
+  UNREFERENCED_PARAMETER(width);
+  UNREFERENCED_PARAMETER(height);
+  UNREFERENCED_PARAMETER(channels);
   LOGERROR << "PNG is not supported by this build!";
   return false;
 #else
@@ -90,6 +125,14 @@ bool PNGUtil::LoadFromStream ( std::istream& stream, Tensor& tensor ) {
   png_uint_32 image_channels = png_get_channels ( png_handle, png_info_handle );
   png_uint_32 image_colors = png_get_color_type ( png_handle, png_info_handle );
 
+  if ( head_only ) {
+    *width = image_width;
+    *height = image_height;
+    *channels = image_channels;
+    png_destroy_read_struct ( &png_handle, &png_info_handle, 0 );
+    return true;
+  }
+
   // Check header data for correct format
   if ( image_depth != 8 && image_depth != 16 ) {
     LOGERROR << "Only 8/16 bits per channel are supported! This image has "
@@ -100,9 +143,36 @@ bool PNGUtil::LoadFromStream ( std::istream& stream, Tensor& tensor ) {
 
   if ( image_colors & PNG_COLOR_MASK_PALETTE ) {
     LOGERROR << "Unsupported color type: " << image_colors;
+    png_destroy_read_struct ( &png_handle, &png_info_handle, 0 );
     return false;
   }
 
+  if ( image_channels > 4 ) {
+    LOGERROR << "Unsupported channel count: " << image_channels;
+    png_destroy_read_struct ( &png_handle, &png_info_handle, 0 );
+    return false;
+  }
+
+  // Prepare the target Tensor
+  if ( resize ) {
+    tensor.Resize ( 1, image_width, image_height, image_channels );
+  } else {
+    if ( image_width > tensor.width() || image_height > tensor.height() ||
+         image_channels != tensor.maps() ) {
+      LOGERROR << "Image (" << image_width << "x" << image_height << "x"
+               << image_channels << ") does not fit into " << tensor;
+      png_destroy_read_struct ( &png_handle, &png_info_handle, 0 );
+      return false;
+    }
+#ifdef BUILD_OPENCL
+    tensor.MoveToCPU();
+#endif
+    if ( image_width < tensor.width() || image_height < tensor.height() )
+      tensor.Clear ( 0.0, sample );
+  }
+
+  // One row pointer per channel into the planar target
+  datum* targets[4];
 
   if(image_depth == 8) {
     // Allocate memory for row pointers
@@ -124,23 +194,14 @@ bool PNGUtil::LoadFromStream ( std::istream& stream, Tensor& tensor ) {
     delete[] row_pointers;
     png_destroy_read_struct ( &png_handle, &png_info_handle, 0 );
 
-    // Read image into Tensor
-    tensor.Resize ( 1, image_width, image_height, image_channels );
-    datum* target = tensor.data_ptr();
-
     // We need to realign the color data because our tensor channels are separate
     // Also we need to convert from unsigned char to our custom datum type
-    for ( std::size_t channel = 0; channel < image_channels; channel++ ) {
-      for ( std::size_t y = 0; y < image_height; y++ ) {
-        std::size_t rc_offset = tensor.Offset ( 0, y, channel, 0 );
+    for ( std::size_t y = 0; y < image_height; y++ ) {
+      for ( std::size_t channel = 0; channel < image_channels; channel++ )
+        targets[channel] = tensor.data_ptr ( 0, y, channel, sample );
 
-        for ( std::size_t x = 0; x < image_width; x++ ) {
-          png_byte pixel = image_data[ ( image_width * image_channels * y ) +
-                                       ( image_channels * x ) + channel];
-          const datum v = DATUM_FROM_UCHAR ( pixel );
-          target[rc_offset + x] = v;
-        }
-      }
+      ImageUtil::DeinterleaveRow ( &image_data[row_stride * y], image_width,
+                                   image_channels, targets );
     }
 
     // Free image data
@@ -166,22 +227,18 @@ bool PNGUtil::LoadFromStream ( std::istream& stream, Tensor& tensor ) {
     delete[] row_pointers;
     png_destroy_read_struct ( &png_handle, &png_info_handle, 0 );
 
-    // Read image into Tensor
-    tensor.Resize ( 1, image_width, image_height, image_channels );
-    datum* target = tensor.data_ptr();
-
     // We need to realign the color data because our tensor channels are separate
     // Also we need to convert from unsigned char to our custom datum type
-    for ( std::size_t channel = 0; channel < image_channels; channel++ ) {
-      for ( std::size_t y = 0; y < image_height; y++ ) {
-        std::size_t rc_offset = tensor.Offset ( 0, y, channel, 0 );
+    for ( std::size_t y = 0; y < image_height; y++ ) {
+      for ( std::size_t channel = 0; channel < image_channels; channel++ )
+        targets[channel] = tensor.data_ptr ( 0, y, channel, sample );
 
-        for ( std::size_t x = 0; x < image_width; x++ ) {
-          png_uint_16 pixel = image_data[ ( image_width * image_channels * y ) +
+      for ( std::size_t x = 0; x < image_width; x++ ) {
+        for ( std::size_t channel = 0; channel < image_channels; channel++ ) {
+          png_uint_16 pixel = image_data[ ( row_stride * y ) +
                                        ( image_channels * x ) + channel];
           pixel = (pixel >> 8) | (pixel << 8);
-          const datum v = DATUM_FROM_USHORT ( pixel );
-          target[rc_offset + x] = v;
+          targets[channel][x] = DATUM_FROM_USHORT ( pixel );
         }
       }
     }
@@ -12,6 +12,7 @@
 #include <limits>
 #include <cmath>
 #include <string>
+#include <algorithm>
 
 
 #ifdef BUILD_POSIX
@@ -22,6 +23,7 @@
 
 #include "PNGUtil.h"
 #include "JPGUtil.h"
+#include "ImageUtil.h"
 
 #ifdef BLAS_MKL
 #include <mkl_service.h>
@@ -47,15 +49,24 @@ Tensor::Tensor ( const Tensor& tensor, bool intentional ) {
   // Match size of source Tensor
   Resize ( tensor );
 
-  // Get pointers
-  const datum* source_data = tensor.data_ptr_const();
-  datum* target_data = data_ptr();
+  if ( tensor.storage() != STORAGE_FLOAT32 ) {
+    // Copies of 16-bit Tensors are datums
+    tensor.UnpackElements ( 0, tensor.elements(), data_ptr() );
+  } else if ( tensor.IsContiguous() ) {
+    // Get pointers
+    const datum* source_data = tensor.data_ptr_const();
+    datum* target_data = data_ptr();
 
-  // Count copy size
-  std::size_t bytes_to_copy = tensor.elements() * sizeof ( datum );
+    // Count copy size
+    std::size_t bytes_to_copy = tensor.elements() * sizeof ( datum );
 
-  // Copy
-  std::memcpy ( target_data, source_data, bytes_to_copy );
+    // Copy
+    std::memcpy ( target_data, source_data, bytes_to_copy );
+  } else {
+    // Views have gaps between the samples
+    for ( std::size_t sample = 0; sample < samples_; sample++ )
+      CopySample ( tensor, sample, *this, sample );
+  }
 
   if ( !intentional ) {
     LOGDEBUG << "Tensor copied! Is this intentional?";
@@ -73,8 +84,15 @@ Tensor::Tensor ( Tensor && tensor ) {
   width_ = tensor.width_;
   height_ = tensor.height_;
   elements_ = tensor.elements_;
+  sample_stride_ = tensor.sample_stride_;
+  capacity_ = tensor.capacity_;
+  is_shadow_ = tensor.is_shadow_;
+  shadow_target_ = tensor.shadow_target_;
+  half_data_ptr_ = tensor.half_data_ptr_;
+  storage_ = tensor.storage_;
 
   tensor.data_ptr_ = nullptr;
+  tensor.half_data_ptr_ = nullptr;
   tensor.DeleteIfPossible();
 }
 
@@ -96,19 +114,32 @@ void Tensor::Clear ( const datum value, const int sample ) {
     MoveToCPU();
   }
 #endif
-  if ( sample == -1 ) {
+  if ( storage_ != STORAGE_FLOAT32 ) {
+    uint16_t packed_value;
+    HalfPrecision::Pack ( &value, &packed_value, 1, storage_ );
+    const std::size_t first = sample == -1 ? 0 : sample * sample_stride_;
+    const std::size_t count = sample == -1 ? elements_ : sample_stride_;
+    std::fill ( &half_data_ptr_[first], &half_data_ptr_[first + count], packed_value );
+  } else if ( sample == -1 && IsContiguous() ) {
     for ( std::size_t element = 0; element < elements_; element++ ) {
       data_ptr_[element] = value;
     }
   } else {
-    for ( std::size_t element = ( width_ * height_ * maps_ * sample );
-          element < ( width_* height_ * maps_ * ( sample+1 ) ); element++ ) {
-      data_ptr_[element] = value;
+    const std::size_t first_sample = sample == -1 ? 0 : sample;
+    const std::size_t last_sample = sample == -1 ? samples_ : sample + 1;
+    for ( std::size_t s = first_sample; s < last_sample; s++ ) {
+      datum* sample_ptr = data_ptr ( 0, 0, 0, s );
+      for ( std::size_t element = 0; element < width_ * height_ * maps_; element++ ) {
+        sample_ptr[element] = value;
+      }
     }
   }
 }
 
 void Tensor::Shadow ( Tensor& tensor ) {
+  if ( tensor.storage_ != STORAGE_FLOAT32 )
+    FATAL ( "Cannot shadow a 16-bit tensor!" );
+
   DeleteIfPossible();
 
   data_ptr_ = tensor.data_ptr_;
@@ -117,6 +148,7 @@ void Tensor::Shadow ( Tensor& tensor ) {
   width_ = tensor.width_;
   height_ = tensor.height_;
   elements_ = tensor.elements_;
+  sample_stride_ = tensor.sample_stride_;
 
   is_shadow_ = true;
   shadow_target_ = &tensor;
@@ -128,20 +160,130 @@ void Tensor::Shadow ( Tensor& tensor ) {
 #endif
 }
 
+bool Tensor::View ( Tensor& tensor, const std::size_t first_map, const std::size_t maps ) {
+#ifdef BUILD_OPENCL
+  // A GPU buffer cannot start in the middle of another one
+  UNREFERENCED_PARAMETER ( tensor );
+  UNREFERENCED_PARAMETER ( first_map );
+  UNREFERENCED_PARAMETER ( maps );
+  LOGERROR << "Views are not supported with OpenCL!";
+  return false;
+#else
+  if ( first_map + maps > tensor.maps_ || tensor.data_ptr_ == nullptr ) {
+    LOGERROR << "Map range out of bounds!";
+    return false;
+  }
+
+  if ( tensor.storage_ != STORAGE_FLOAT32 ) {
+    LOGERROR << "Cannot view a 16-bit tensor!";
+    return false;
+  }
+
+  DeleteIfPossible();
+
+  data_ptr_ = tensor.data_ptr ( 0, 0, first_map, 0 );
+  samples_ = tensor.samples_;
+  maps_ = maps;
+  width_ = tensor.width_;
+  height_ = tensor.height_;
+  elements_ = samples_ * maps_ * width_ * height_;
+  sample_stride_ = tensor.sample_stride_;
+
+  is_shadow_ = true;
+  shadow_target_ = &tensor;
+  return true;
+#endif
+}
+
+bool Tensor::Wrap ( datum* const memory, const std::size_t samples, const std::size_t width,
+                    const std::size_t height, const std::size_t maps ) {
+#ifdef BUILD_OPENCL
+  // There is no Tensor to keep the GPU buffer
+  UNREFERENCED_PARAMETER ( memory );
+  UNREFERENCED_PARAMETER ( samples );
+  UNREFERENCED_PARAMETER ( width );
+  UNREFERENCED_PARAMETER ( height );
+  UNREFERENCED_PARAMETER ( maps );
+  LOGERROR << "Wrapped memory is not supported with OpenCL!";
+  return false;
+#else
+  if ( memory == nullptr ) {
+    LOGERROR << "Cannot wrap null pointer!";
+    return false;
+  }
+
+  DeleteIfPossible();
+
+  data_ptr_ = memory;
+  samples_ = samples;
+  maps_ = maps;
+  width_ = width;
+  height_ = height;
+  elements_ = samples_ * maps_ * width_ * height_;
+  sample_stride_ = maps_ * width_ * height_;
+
+  // Shadows do not free their memory
+  is_shadow_ = true;
+  shadow_target_ = nullptr;
+  return true;
+#endif
+}
+
 
 void Tensor::Resize ( const std::size_t samples, const std::size_t width,
                       const std::size_t height, const std::size_t maps, datum* const preallocated_memory, bool mmapped, bool dont_delete) {
+  // 16-bit Tensors keep their storage type unless they get datum memory
+  if ( storage_ != STORAGE_FLOAT32 ) {
+    if ( preallocated_memory != nullptr ) {
+      DeleteIfPossible();
+    } else {
+      const std::size_t elements = samples * maps * width * height;
+      if ( elements > capacity_ ) {
+        delete[] half_data_ptr_;
+        half_data_ptr_ = new uint16_t[elements];
+        capacity_ = elements;
+      }
+      samples_ = samples;
+      width_ = width;
+      height_ = height;
+      maps_ = maps;
+      elements_ = elements;
+      sample_stride_ = maps * width * height;
+      return;
+    }
+  }
+
   // Check if reshaping works
   if (preallocated_memory == nullptr && Reshape ( samples, width, height, maps ) )
     return;
 
+  // Calculate memory requirement
+  std::size_t elements = samples * maps * width * height;
+
+  // Keep our own allocation if it is large enough
+  if ( preallocated_memory == nullptr && data_ptr_ != nullptr && !is_shadow_ && !mmapped_ &&
+       elements > 0 && elements <= capacity_ ) {
+#ifdef BUILD_OPENCL
+    // The GPU buffer may be too small now
+    if ( cl_data_ptr_ != 0 ) {
+      clReleaseMemObject ( (cl_mem)cl_data_ptr_ );
+      cl_data_ptr_ = 0;
+    }
+    cl_gpu_ = false;
+#endif
+    samples_ = samples;
+    width_ = width;
+    height_ = height;
+    maps_ = maps;
+    elements_ = elements;
+    sample_stride_ = maps * width * height;
+    return;
+  }
+
   // Delete the old allocation if it is different from the new one
   if(preallocated_memory != data_ptr_ && !dont_delete)
     DeleteIfPossible();
 
-  // Calculate memory requirement
-  std::size_t elements = samples * maps * width * height;
-
   // Don't need to allocate zero memory
   if ( elements == 0 )
     return;
@@ -149,7 +291,9 @@ void Tensor::Resize ( const std::size_t samples, const std::size_t width,
   if(preallocated_memory != nullptr) {
     data_ptr_ = preallocated_memory;
     mmapped_ = mmapped;
+    capacity_ = mmapped ? 0 : elements;
   } else {
+    capacity_ = elements;
     // Allocate
 #ifdef BLAS_MKL
     data_ptr_ = ( datum* ) MKL_malloc ( elements * sizeof ( datum ) / sizeof ( char ), 32 );
@@ -164,6 +308,83 @@ void Tensor::Resize ( const std::size_t samples, const std::size_t width,
   height_ = height;
   maps_ = maps;
   elements_ = elements;
+  sample_stride_ = maps * width * height;
+}
+
+bool Tensor::SetStorage ( const TensorStorage storage ) {
+  if ( storage == storage_ )
+    return true;
+
+#ifdef BUILD_OPENCL
+  LOGERROR << "16-bit tensors are not supported with OpenCL!";
+  return false;
+#else
+  if ( storage != STORAGE_FLOAT32 && storage != STORAGE_FLOAT16 && storage != STORAGE_BFLOAT16 ) {
+    LOGERROR << "Unknown tensor storage type " << ( unsigned int ) storage;
+    return false;
+  }
+
+  if ( is_shadow_ || mmapped_ ) {
+    LOGERROR << "Only tensors that own their memory can change their storage!";
+    return false;
+  }
+
+  if ( storage_ != STORAGE_FLOAT32 && storage != STORAGE_FLOAT32 ) {
+    // Between 16-bit formats, the memory can be reused
+    datum block[4096];
+    for ( std::size_t e = 0; e < elements_; e += 4096 ) {
+      const std::size_t count = std::min ( elements_ - e, ( std::size_t ) 4096 );
+      HalfPrecision::Unpack ( &half_data_ptr_[e], block, count, storage_ );
+      HalfPrecision::Pack ( block, &half_data_ptr_[e], count, storage );
+    }
+  } else if ( storage == STORAGE_FLOAT32 ) {
+    datum* memory = nullptr;
+    if ( elements_ > 0 ) {
+#ifdef BLAS_MKL
+      memory = ( datum* ) MKL_malloc ( elements_ * sizeof ( datum ) / sizeof ( char ), 32 );
+#else
+      memory = new datum[elements_];
+#endif
+      HalfPrecision::Unpack ( half_data_ptr_, memory, elements_, storage_ );
+    }
+    delete[] half_data_ptr_;
+    half_data_ptr_ = nullptr;
+    data_ptr_ = memory;
+  } else {
+    uint16_t* memory = nullptr;
+    if ( elements_ > 0 ) {
+      memory = new uint16_t[elements_];
+      HalfPrecision::Pack ( data_ptr_, memory, elements_, storage );
+    }
+    if ( data_ptr_ != nullptr ) {
+#ifdef BLAS_MKL
+      mkl_free ( data_ptr_ );
+#else
+      delete[] data_ptr_;
+#endif
+    }
+    data_ptr_ = nullptr;
+    half_data_ptr_ = memory;
+  }
+
+  capacity_ = elements_;
+  storage_ = storage;
+  return true;
+#endif
+}
+
+void Tensor::UnpackElements ( const std::size_t first, const std::size_t count, datum* target ) const {
+  if ( storage_ == STORAGE_FLOAT32 )
+    std::memcpy ( target, &data_ptr_[first], count * sizeof ( datum ) );
+  else
+    HalfPrecision::Unpack ( &half_data_ptr_[first], target, count, storage_ );
+}
+
+void Tensor::PackElements ( const std::size_t first, const std::size_t count, const datum* source ) {
+  if ( storage_ == STORAGE_FLOAT32 )
+    std::memcpy ( &data_ptr_[first], source, count * sizeof ( datum ) );
+  else
+    HalfPrecision::Pack ( source, &half_data_ptr_[first], count, storage_ );
 }
 
 void Tensor::Resize ( const Tensor& tensor ) {
@@ -174,7 +395,11 @@ void Tensor::Resize ( const Tensor& tensor ) {
 bool Tensor::Reshape ( const std::size_t samples, const std::size_t width,
                        const std::size_t height, const std::size_t maps ) {
   // Check for null pointer
-  if ( data_ptr_ == nullptr )
+  if ( data_ptr_ == nullptr && half_data_ptr_ == nullptr )
+    return false;
+
+  // Views cannot be reshaped
+  if ( !IsContiguous() )
     return false;
 
   // Check if element count matches
@@ -189,12 +414,18 @@ bool Tensor::Reshape ( const std::size_t samples, const std::size_t width,
   height_ = height;
   maps_ = maps;
   elements_ = proposed_elements;
+  sample_stride_ = maps * width * height;
 
   return true;
 }
 
 
 void Tensor::Transpose() {
+  if ( storage_ != STORAGE_FLOAT32 ) {
+    LOGERROR << "Cannot transpose a 16-bit tensor!";
+    return;
+  }
+
   if ( data_ptr_ == nullptr )
     return;
 
@@ -217,10 +448,16 @@ void Tensor::Transpose() {
 }
 
 
-void Tensor::Serialize ( std::ostream& output, bool convert ) {
+void Tensor::Serialize ( std::ostream& output, bool convert, TensorStorage storage ) {
 #ifdef BUILD_OPENCL
   MoveToCPU();
 #endif
+  if ( !IsContiguous() || storage_ != STORAGE_FLOAT32 ) {
+    // This copy _is_ intentional
+    Tensor tmp ( *this, true );
+    tmp.Serialize ( output, convert, storage );
+    return;
+  }
 
   if ( convert ) {
     if ( maps_ == 3 ) {
@@ -251,16 +488,28 @@ void Tensor::Serialize ( std::ostream& output, bool convert ) {
     uint64_t samples = samples_;
     uint64_t width = width_;
     uint64_t height = height_;
-    uint64_t maps = maps_;
+    // The storage type is kept in the otherwise unused top byte
+    uint64_t maps = maps_ | ( ( uint64_t ) storage << TENSOR_STORAGE_SHIFT );
 
     output.write ( ( const char* ) &samples, sizeof ( uint64_t ) / sizeof ( char ) );
     output.write ( ( const char* ) &width, sizeof ( uint64_t ) / sizeof ( char ) );
     output.write ( ( const char* ) &height, sizeof ( uint64_t ) / sizeof ( char ) );
     output.write ( ( const char* ) &maps, sizeof ( uint64_t ) / sizeof ( char ) );
 
-    if ( elements_ > 0 )
-      output.write ( ( const char* ) data_ptr_, ( elements_ * sizeof ( datum ) )
-                     / sizeof ( char ) );
+    if ( elements_ > 0 ) {
+      if ( storage == STORAGE_FLOAT32 ) {
+        output.write ( ( const char* ) data_ptr_, ( elements_ * sizeof ( datum ) )
+                       / sizeof ( char ) );
+      } else {
+        // Convert in chunks to avoid a second copy of large tensors
+        uint16_t packed[4096];
+        for ( std::size_t e = 0; e < elements_; e += 4096 ) {
+          const std::size_t count = std::min ( elements_ - e, ( std::size_t ) 4096 );
+          HalfPrecision::Pack ( &data_ptr_[e], packed, count, storage );
+          output.write ( ( const char* ) packed, ( count * sizeof ( uint16_t ) ) / sizeof ( char ) );
+        }
+      }
+    }
   }
 }
 
@@ -268,6 +517,10 @@ void Tensor::Deserialize ( std::istream& input , bool head_only, bool try_mmap,
 #ifdef BUILD_OPENCL
   MoveToCPU ( true );
 #endif
+  // The contents are read as datums
+  if ( storage_ != STORAGE_FLOAT32 )
+    DeleteIfPossible();
+
   uint64_t samples = 0;
   uint64_t width = 0;
   uint64_t height = 0;
@@ -281,7 +534,17 @@ void Tensor::Deserialize ( std::istream& input , bool head_only, bool try_mmap,
   input.read ( ( char* ) &height, sizeof ( uint64_t ) / sizeof ( char ) );
   input.read ( ( char* ) &maps, sizeof ( uint64_t ) / sizeof ( char ) );
 
+  const TensorStorage storage = ( TensorStorage ) ( maps >> TENSOR_STORAGE_SHIFT );
+  maps &= ( ( uint64_t ) 1 << TENSOR_STORAGE_SHIFT ) - 1;
+  if ( storage != STORAGE_FLOAT32 && storage != STORAGE_FLOAT16 && storage != STORAGE_BFLOAT16 ) {
+    LOGERROR << "Unknown tensor storage type " << ( unsigned int ) storage;
+    return;
+  }
+
+  // Only floats can be used directly from the file
 #ifdef BUILD_POSIX
+  if ( storage != STORAGE_FLOAT32 )
+    try_mmap = false;
   if(!try_mmap || fd == 0)
 #endif
     Resize ( samples, width, height, maps );
@@ -311,11 +574,20 @@ void Tensor::Deserialize ( std::istream& input , bool head_only, bool try_mmap,
       input.seekg(( elements * sizeof ( datum ) ) / sizeof ( char ) , std::ios::cur);
     } else
 #endif
+    if ( storage == STORAGE_FLOAT32 ) {
       input.read ( ( char* ) data_ptr_, ( elements * sizeof ( datum ) )
                   / sizeof ( char ) );
+    } else {
+      uint16_t packed[4096];
+      for ( std::size_t e = 0; e < elements; e += 4096 ) {
+        const std::size_t count = std::min ( elements - e, ( std::size_t ) 4096 );
+        input.read ( ( char* ) packed, ( count * sizeof ( uint16_t ) ) / sizeof ( char ) );
+        HalfPrecision::Unpack ( packed, &data_ptr_[e], count, storage );
+      }
+    }
   }
   else if(head_only)
-    input.seekg(( elements * sizeof ( datum ) ) / sizeof ( char ) , std::ios::cur);
+    input.seekg(( elements * HalfPrecision::ElementSize ( storage ) ) / sizeof ( char ) , std::ios::cur);
       
 }
 
@@ -345,6 +617,11 @@ bool Tensor::CopyMap ( const Tensor& source, const std::size_t source_sample,
                        const std::size_t source_map, Tensor& target,
                        const std::size_t target_sample,
                        const std::size_t target_map ) {
+  if ( source.storage() != STORAGE_FLOAT32 || target.storage() != STORAGE_FLOAT32 ) {
+    LOGERROR << "Cannot copy maps of 16-bit tensors!";
+    return false;
+  }
+
   // Check sample bounds
   if ( source_sample >= source.samples() || target_sample >= target.samples() )
     return false;
@@ -393,6 +670,11 @@ bool Tensor::CopyMap ( const Tensor& source, const std::size_t source_sample,
 }
 
 void Tensor::DeleteIfPossible() {
+  if ( half_data_ptr_ != nullptr ) {
+    delete[] half_data_ptr_;
+    half_data_ptr_ = nullptr;
+  }
+
   if ( data_ptr_ != nullptr ) {
     if ( !is_shadow_ ) {
 #ifdef BUILD_POSIX
@@ -428,8 +710,11 @@ void Tensor::DeleteIfPossible() {
   height_ = 0;
   maps_ = 0;
   elements_ = 0;
+  sample_stride_ = 0;
+  capacity_ = 0;
   is_shadow_ = false;
   shadow_target_ = nullptr;
+  storage_ = STORAGE_FLOAT32;
 }
 #ifdef BUILD_OPENCL
 void Tensor::MoveToGPU ( bool no_copy ) {
@@ -581,34 +866,12 @@ std::size_t Tensor::PixelMaximum ( std::size_t x, std::size_t y, std::size_t sam
 
 
 void Tensor::LoadFromFile ( const std::string& filename ) {
-#ifdef BUILD_PNG
-
-  if ( ( filename.compare ( filename.length() - 3, 3, "png" ) == 0 )
-       || ( filename.compare ( filename.length() - 3, 3, "PNG" ) == 0 )
-     ) {
-    std::ifstream input_image_file ( filename, std::ios::in | std::ios::binary );
-
-    if ( !input_image_file.good() )
+  if ( ImageUtil::IsImageFile ( filename ) ) {
+    if ( !ImageUtil::LoadFromFile ( filename, *this ) )
       FATAL ( "Cannot load " << filename );
-
-    Conv::PNGUtil::LoadFromStream ( input_image_file, *this );
     return;
   }
 
-#endif
-#ifdef BUILD_JPG
-
-  if ( ( filename.compare ( filename.length() - 3, 3, "jpg" ) == 0 )
-       || ( filename.compare ( filename.length() - 3, 3, "jpeg" ) == 0 )
-       || ( filename.compare ( filename.length() - 3, 3, "JPG" ) == 0 )
-       || ( filename.compare ( filename.length() - 3, 3, "JPEG" ) == 0 )
-     ) {
-    Conv::JPGUtil::LoadFromFile ( filename, *this );
-    return;
-  }
-
-#endif
-
   if ( filename.compare ( filename.length() - 3, 3, "Tensor" ) == 0 ) {
     std::ifstream input_image_file ( filename, std::ios::in | std::ios::binary );
 
@@ -670,6 +933,12 @@ void Tensor::PrintStats() {
 #ifdef BUILD_OPENCL
 	MoveToCPU();
 #endif
+	if (!IsContiguous() || storage_ != STORAGE_FLOAT32) {
+		// This copy _is_ intentional
+		Tensor tmp(*this, true);
+		tmp.PrintStats();
+		return;
+	}
 	datum min = std::numeric_limits<datum>::max();
 	datum max = std::numeric_limits<datum>::lowest();
 	datum sum = 0;
@@ -18,6 +18,7 @@
 #include "TensorStream.h"
 #include "FloatTensorStream.h"
 #include "CompressedTensorStream.h"
+#include "CompactTensorStream.h"
 #include "ListTensorStream.h"
 
 #ifdef BUILD_BOOST
@@ -55,6 +56,11 @@ TensorStream* TensorStream::FromFile(std::string path, std::vector<unsigned int>
     CompressedTensorStream* cts = new CompressedTensorStream();
     cts->LoadFile(path);
     return cts;
+  } else if(magic == CN24_KTS_MAGIC) {
+    LOGDEBUG << "Is compact tensor, loading...";
+    CompactTensorStream* kts = new CompactTensorStream();
+    kts->LoadFile(path);
+    return kts;
   } else {
     LOGDEBUG << "Is float tensor, loading...";
     FloatTensorStream* fts = new FloatTensorStream();
@@ -0,0 +1,324 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#ifdef BUILD_POSIX
+#include <unistd.h>
+#include <sys/types.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+#include "Tensor.h"
+#include "CompressedTensor.h"
+#include "CompactTensor.h"
+#include "CompressedTensorStream.h"
+#include "CompactTensorStream.h"
+#include "ImageUtil.h"
+#include "TensorStreamBuilder.h"
+
+namespace Conv {
+
+/*
+ * One record of the index file
+ */
+struct TensorStreamBuilderRecord {
+  uint64_t pairs;
+  uint64_t output_length;
+};
+
+/*
+ * Makes the written data durable before the index points to it
+ */
+static bool SyncFile(FILE* file) {
+  if(fflush(file) != 0)
+    return false;
+#ifdef BUILD_POSIX
+  return fsync(fileno(file)) == 0;
+#else
+  return true;
+#endif
+}
+
+TensorStreamBuilder::TensorStreamBuilder(const std::vector<unsigned int>& class_colors,
+                                         const TensorStreamBuilderFormat format,
+                                         const bool direct_rgb, unsigned int threads) :
+  class_colors_(class_colors), color_table_(class_colors), format_(format),
+  direct_rgb_(direct_rgb), threads_(threads) {
+  if(threads_ == 0)
+    threads_ = std::max(1U, std::thread::hardware_concurrency());
+}
+
+bool TensorStreamBuilder::Build(const std::vector<std::string>& image_files,
+                                const std::vector<std::string>& label_files,
+                                const std::string& output_fname, const bool resume) {
+  if(image_files.size() != label_files.size()) {
+    LOGERROR << "Need one label per image!";
+    return false;
+  }
+
+  const std::string index_fname = output_fname + ".index";
+  TensorStreamBuilderRecord last_record = {0, 0};
+
+  if(resume) {
+    // Find the last complete record
+    FILE* index_file = fopen(index_fname.c_str(), "rb");
+    if(index_file != NULL) {
+      TensorStreamBuilderRecord record;
+      while(fread(&record, sizeof(TensorStreamBuilderRecord), 1, index_file) == 1)
+        last_record = record;
+      fclose(index_file);
+    }
+
+    if(last_record.output_length > 0) {
+      std::ifstream existing_output(output_fname, std::ios::in | std::ios::binary | std::ios::ate);
+      if(!existing_output.good() || (uint64_t)existing_output.tellg() < last_record.output_length) {
+        LOGERROR << output_fname << " is shorter than its index, cannot resume!";
+        return false;
+      }
+#ifdef BUILD_POSIX
+      // Discard anything that was written after the last record
+      if(truncate(output_fname.c_str(), (off_t)last_record.output_length) != 0) {
+        LOGERROR << "Cannot truncate " << output_fname;
+        return false;
+      }
+      LOGINFO << "Resuming after " << last_record.pairs << " pairs";
+#else
+      LOGERROR << "Resuming is not supported by this build!";
+      return false;
+#endif
+    }
+  }
+
+  FILE* output_file = fopen(output_fname.c_str(), last_record.output_length > 0 ? "ab" : "wb");
+  if(output_file == NULL) {
+    LOGERROR << "Cannot open " << output_fname;
+    return false;
+  }
+
+  FILE* index_file = fopen(index_fname.c_str(), last_record.output_length > 0 ? "ab" : "wb");
+  if(index_file == NULL) {
+    LOGERROR << "Cannot open " << index_fname;
+    fclose(output_file);
+    return false;
+  }
+
+  if(last_record.output_length == 0) {
+    // Write the magic number for the stream format and the first record
+    uint64_t magic = 0;
+    if(format_ == BUILDER_COMPRESSED)
+      magic = CN24_CTS_MAGIC;
+    else if(format_ == BUILDER_COMPACT)
+      magic = CN24_KTS_MAGIC;
+
+    if(magic != 0) {
+      fwrite(&magic, sizeof(uint64_t), 1, output_file);
+      last_record.output_length = sizeof(uint64_t);
+    }
+
+    if(!SyncFile(output_file) ||
+       fwrite(&last_record, sizeof(TensorStreamBuilderRecord), 1, index_file) != 1 ||
+       !SyncFile(index_file)) {
+      LOGERROR << "Cannot write " << output_fname;
+      fclose(output_file);
+      fclose(index_file);
+      return false;
+    }
+  }
+
+  bool success = true;
+  std::vector<std::string> outputs;
+  std::vector<char> pair_success;
+
+  for(std::size_t chunk_start = last_record.pairs; success && chunk_start < image_files.size();
+      chunk_start += CN24_TSB_CHUNK_SIZE) {
+    const std::size_t chunk_size = std::min((std::size_t)CN24_TSB_CHUNK_SIZE, image_files.size() - chunk_start);
+    outputs.assign(chunk_size, std::string());
+    pair_success.assign(chunk_size, 0);
+
+    // Shard the chunk across the worker threads
+    std::vector<std::thread> workers;
+    for(unsigned int t = 0; t < threads_ && t < chunk_size; t++) {
+      workers.push_back(std::thread([this, t, chunk_start, chunk_size, &image_files, &label_files, &outputs, &pair_success]() {
+        for(std::size_t i = t; i < chunk_size; i += threads_) {
+          pair_success[i] = ConvertPair(image_files[chunk_start + i], label_files[chunk_start + i], outputs[i]);
+        }
+      }));
+    }
+    for(std::thread& worker : workers)
+      worker.join();
+
+    // Append the chunk in order
+    std::size_t written = 0;
+    for(std::size_t i = 0; i < chunk_size; i++) {
+      if(!pair_success[i]) {
+        LOGERROR << "Cannot import " << image_files[chunk_start + i] << " and " << label_files[chunk_start + i];
+        success = false;
+        break;
+      }
+
+      if(outputs[i].length() == 0) {
+        LOGERROR << "Dimensions of " << image_files[chunk_start + i] << " and " << label_files[chunk_start + i] << " don't match, skipping!";
+        continue;
+      }
+
+      if(fwrite(outputs[i].data(), 1, outputs[i].length(), output_file) != outputs[i].length()) {
+        LOGERROR << "Cannot write " << output_fname;
+        success = false;
+        break;
+      }
+      written += outputs[i].length();
+    }
+
+    if(!success)
+      break;
+
+    // The chunk only counts after its record is on disk
+    last_record.pairs = chunk_start + chunk_size;
+    last_record.output_length += written;
+    if(!SyncFile(output_file) ||
+       fwrite(&last_record, sizeof(TensorStreamBuilderRecord), 1, index_file) != 1 ||
+       !SyncFile(index_file)) {
+      LOGERROR << "Cannot write " << index_fname;
+      success = false;
+      break;
+    }
+
+    LOGINFO << "Imported " << last_record.pairs << " of " << image_files.size() << " pairs";
+  }
+
+  fclose(output_file);
+  fclose(index_file);
+  return success;
+}
+
+bool TensorStreamBuilder::ConvertPair(const std::string& image_file, const std::string& label_file,
+                                      std::string& output) const {
+  Tensor image_tensor;
+  Tensor label_rgb_tensor;
+  if(!ImageUtil::LoadFromFile(image_file, image_tensor) ||
+     !ImageUtil::LoadFromFile(label_file, label_rgb_tensor))
+    return false;
+
+  output.clear();
+  if(image_tensor.width() != label_rgb_tensor.width() ||
+     image_tensor.height() != label_rgb_tensor.height())
+    return true;
+
+  std::ostringstream stream(std::ios::out | std::ios::binary);
+
+  if(format_ == BUILDER_COMPACT) {
+    CompactTensor compact_image_tensor;
+    CompactTensor compact_label_tensor;
+
+    // Images with more than 8 bits per channel stay float
+    if(!compact_image_tensor.FromImageTensor(image_tensor))
+      compact_image_tensor.FromTensor(image_tensor);
+
+    std::vector<unsigned int> class_indices;
+    if(direct_rgb_ || class_colors_.size() == 1 ||
+       !color_table_.ToClassIndices(label_rgb_tensor, class_indices) ||
+       !compact_label_tensor.FromClassIndices(class_indices, 1, label_rgb_tensor.width(),
+                                              label_rgb_tensor.height(), class_colors_.size())) {
+      // Labels that are not class indices stay float
+      Tensor label_tensor;
+      ConvertLabel(label_rgb_tensor, label_tensor);
+      compact_label_tensor.FromTensor(label_tensor);
+    }
+
+    compact_image_tensor.Serialize(stream);
+    compact_label_tensor.Serialize(stream);
+  } else {
+    Tensor label_tensor;
+    ConvertLabel(label_rgb_tensor, label_tensor);
+
+    if(format_ == BUILDER_COMPRESSED) {
+      CompressedTensor compressed_image_tensor;
+      CompressedTensor compressed_label_tensor;
+      compressed_image_tensor.Compress(image_tensor);
+      compressed_label_tensor.Compress(label_tensor);
+
+      compressed_image_tensor.Serialize(stream);
+      compressed_label_tensor.Serialize(stream);
+    } else {
+      image_tensor.Serialize(stream);
+      label_tensor.Serialize(stream);
+    }
+  }
+
+  output = stream.str();
+  return true;
+}
+
+void TensorStreamBuilder::ConvertLabel(const Tensor& rgb_tensor, Tensor& label_tensor) const {
+  const unsigned int number_of_classes = class_colors_.size();
+
+  if(direct_rgb_) {
+    // no classes - interpret the label tensor input as the output (no class/color mapping)
+    label_tensor.Resize(1, rgb_tensor.width(), rgb_tensor.height(), 3);
+    for(unsigned int map = 0; map < 3; map++)
+      std::copy(rgb_tensor.data_ptr_const(0, 0, map, 0),
+                rgb_tensor.data_ptr_const(0, 0, map, 0) + rgb_tensor.width() * rgb_tensor.height(),
+                label_tensor.data_ptr(0, 0, map, 0));
+  } else if(number_of_classes == 1) {
+    // 1 class - convert RGB images into multi-channel label tensors
+    label_tensor.Resize(1, rgb_tensor.width(), rgb_tensor.height(), 1);
+    const unsigned int foreground_color = class_colors_[0];
+    const datum fr = DATUM_FROM_UCHAR((foreground_color >> 16) & 0xFF),
+                fg = DATUM_FROM_UCHAR((foreground_color >> 8) & 0xFF),
+                fb = DATUM_FROM_UCHAR(foreground_color & 0xFF);
+
+    for(unsigned int y = 0; y < rgb_tensor.height(); y++) {
+      for(unsigned int x = 0; x < rgb_tensor.width(); x++) {
+        datum lr, lg, lb;
+
+        if(rgb_tensor.maps() == 3) {
+          lr = *rgb_tensor.data_ptr_const(x, y, 0, 0);
+          lg = *rgb_tensor.data_ptr_const(x, y, 1, 0);
+          lb = *rgb_tensor.data_ptr_const(x, y, 2, 0);
+        } else if(rgb_tensor.maps() == 1) {
+          lr = *rgb_tensor.data_ptr_const(x, y, 0, 0);
+          lg = lr;
+          lb = lr;
+        } else {
+          FATAL("Unsupported input channel count!");
+        }
+
+        const datum class1_diff = std::sqrt((lr - fr) * (lr - fr)
+                                            + (lg - fg) * (lg - fg)
+                                            + (lb - fb) * (lb - fb)) / std::sqrt(3.0);
+        const datum val = 1.0 - 2.0 * class1_diff;
+        *label_tensor.data_ptr(x, y, 0, 0) = val;
+      }
+    }
+  } else {
+    // any number of other classes, look up the class of each color
+    label_tensor.Resize(1, rgb_tensor.width(), rgb_tensor.height(), number_of_classes);
+    label_tensor.Clear(0.0);
+
+    std::vector<unsigned int> class_indices;
+    if(!color_table_.ToClassIndices(rgb_tensor, class_indices))
+      FATAL("Unsupported input channel count!");
+
+    const std::size_t map_size = rgb_tensor.width() * rgb_tensor.height();
+    for(std::size_t i = 0; i < map_size; i++) {
+      if(class_indices[i] < number_of_classes)
+        label_tensor.data_ptr(0, 0, class_indices[i], 0)[i] = 1.0;
+    }
+  }
+}
+
+}
@@ -285,6 +285,16 @@ bool TensorStreamDataset::GetTestingSample (Tensor& data_tensor, Tensor& label_t
   } else return false;
 }
 
+void TensorStreamDataset::PrefetchSamples (const std::vector<unsigned int>& indices, bool testing) {
+  TensorStream* stream = testing ? testing_stream_ : training_stream_;
+  std::vector<unsigned int> tensor_indices;
+  for (unsigned int index : indices) {
+    tensor_indices.push_back(2 * index);
+    tensor_indices.push_back(2 * index + 1);
+  }
+  stream->Prefetch(tensor_indices);
+}
+
 TensorStreamDataset* TensorStreamDataset::CreateFromConfiguration (std::istream& file , bool dont_load, DatasetLoadSelection selection) {
   unsigned int classes = 0;
   std::vector<std::string> class_names;
@@ -12,6 +12,8 @@
 #endif
 
 #include <fstream>
+#include <algorithm>
+#include <utility>
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
@@ -209,123 +211,105 @@ bool TensorStreamPatchDataset::SupportsTesting() const {
 
 bool TensorStreamPatchDataset::GetTrainingSample (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index) {
   if (index < sample_count_training_) {
-    bool success = true;
-
-    // Find patch
-    unsigned int t = 0;
-
-    while ( (t < tensors_) && (index >= last_sample_[t]))
-      t++;
-
-    if (index >= last_sample_[t])
+    unsigned int t = FindTensor (index);
+    if (t == tensors_)
       return false;
 
-    unsigned int inner_width = data_[t].width() - (patchsize_x_ - 1);
-    unsigned int inner_height = data_[t].height() - (patchsize_y_ - 1);
-    
-    unsigned int first_sample = last_sample_[t] - inner_width * inner_height;
-    unsigned int sample_offset = index - first_sample;
-
-    // Find x and y coords
-    unsigned int row = sample_offset / (data_[t].width() - (patchsize_x_ - 1));
-    unsigned int col = sample_offset - (row * (data_[t].width() - (patchsize_x_ - 1)));
-
-    // Copy patch
-    for (unsigned int map = 0; map < input_maps_; map++) {
-      for (unsigned int y = 0; y < patchsize_y_; y++) {
-        const datum* row_ptr = data_[t].data_ptr_const (col, row + y, map, 0);
-        datum* target_row_ptr = data_tensor.data_ptr (0, y, map, sample);
-        std::memcpy (target_row_ptr, row_ptr, patchsize_x_ * sizeof(datum) / sizeof (char));
-      }
-    }
-    
-    // Copy label
-    for (unsigned int map = 0; map < label_maps_; map++) {
-      *label_tensor.data_ptr (0, 0, map, sample) =
-        *labels_[t].data_ptr_const (col + (patchsize_x_ / 2), row + (patchsize_y_ / 2), map, 0);
-    }
+    CopyPatch (data_tensor, label_tensor, helper_tensor, weight_tensor, sample, t, index);
+    return true;
+  } else return false;
+}
 
-		// Copy helper tensor
-		if (data_[t].width() > 1)
-			*helper_tensor.data_ptr(0, 0, 0, sample) = ((datum)col) / ((datum)data_[t].width() - 1);
-		else
-			*helper_tensor.data_ptr(0, 0, 0, sample) = 0;
+bool TensorStreamPatchDataset::GetTestingSample (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index) {
+  if (index < sample_count_testing_) {
+    // The testing tensors come after the training tensors
+    index += sample_count_training_;
+    unsigned int t = FindTensor (index);
+    if (t == tensors_)
+      return false;
 
-		if (data_[t].height() > 1)
-			*helper_tensor.data_ptr(0, 0, 1, sample) = ((datum)row) / ((datum)data_[t].height() - 1);
-		else
-			*helper_tensor.data_ptr(0, 0, 1, sample) = 0;
+    CopyPatch (data_tensor, label_tensor, helper_tensor, weight_tensor, sample, t, index);
+    return true;
+  } else return false;
+}
 
-		const datum class_weight = class_weights_[label_tensor.PixelMaximum(0, 0, sample)];
+bool TensorStreamPatchDataset::GetSampleBatch (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, bool testing) {
+  const unsigned int sample_count = testing ? sample_count_testing_ : sample_count_training_;
+  const unsigned int first_index = testing ? sample_count_training_ : 0;
 
-    // Copy error
-    *weight_tensor.data_ptr (0, 0, 0, sample) =
-      error_function_ (col + (patchsize_x_ / 2), row + (patchsize_y_ / 2),
-      data_[t].width(), data_[t].height()) * class_weight;
+  // Sort the patches by index so that every source image is visited once,
+  //  top to bottom, while its rows are still cached
+  std::vector<std::pair<unsigned int, unsigned int>> order;
+  order.reserve (indices.size());
+  for (unsigned int sample = 0; sample < indices.size(); sample++) {
+    if (indices[sample] >= sample_count)
+      return false;
+    order.push_back ({indices[sample] + first_index, sample});
+  }
+  std::sort (order.begin(), order.end());
+
+  unsigned int t = 0;
+  for (const std::pair<unsigned int, unsigned int>& patch : order) {
+    // The tensor can only move forward
+    if (patch.first >= last_sample_[t])
+      t = FindTensor (patch.first, t + 1);
+    if (t == tensors_)
+      return false;
 
-    return success;
-  } else return false;
+    CopyPatch (data_tensor, label_tensor, helper_tensor, weight_tensor, patch.second, t, patch.first);
+  }
+  return true;
 }
 
-bool TensorStreamPatchDataset::GetTestingSample (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index) {
-  if (index < sample_count_testing_) {
-		index += sample_count_testing_;
-    bool success = true;
+unsigned int TensorStreamPatchDataset::FindTensor (unsigned int index, unsigned int first_tensor) const {
+  // last_sample_ is sorted, the patch is in the first tensor ending after it
+  const unsigned int* last = std::upper_bound (last_sample_ + first_tensor, last_sample_ + tensors_, index);
+  return (unsigned int) (last - last_sample_);
+}
 
-    // Find patch
-    unsigned int t = 0;
+void TensorStreamPatchDataset::CopyPatch (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int t, unsigned int index) {
+  unsigned int inner_width = data_[t].width() - (patchsize_x_ - 1);
+  unsigned int inner_height = data_[t].height() - (patchsize_y_ - 1);
 
-    while ( (t < tensors_) && (index >= last_sample_[t]))
-      t++;
+  unsigned int first_sample = last_sample_[t] - inner_width * inner_height;
+  unsigned int sample_offset = index - first_sample;
 
-    if (index >= last_sample_[t])
-      return false;
+  // Find x and y coords
+  unsigned int row = sample_offset / inner_width;
+  unsigned int col = sample_offset - (row * inner_width);
 
-    unsigned int inner_width = data_[t].width() - (patchsize_x_ - 1);
-    unsigned int inner_height = data_[t].height() - (patchsize_y_ - 1);
-    
-    unsigned int first_sample = last_sample_[t] - inner_width * inner_height;
-    unsigned int sample_offset = index - first_sample;
-
-    // Find x and y coords
-    unsigned int row = sample_offset / (data_[t].width() - (patchsize_x_ - 1));
-    unsigned int col = sample_offset - (row * (data_[t].width() - (patchsize_x_ - 1)));
-
-    // Copy patch
-    for (unsigned int map = 0; map < input_maps_; map++) {
-      for (unsigned int y = 0; y < patchsize_y_; y++) {
-        const datum* row_ptr = data_[t].data_ptr_const (col, row + y, map, 0);
-        datum* target_row_ptr = data_tensor.data_ptr (0, y, map, sample);
-        std::memcpy (target_row_ptr, row_ptr, patchsize_x_ * sizeof(datum) / sizeof (char));
-      }
-    }
-    
-    // Copy label
-    for (unsigned int map = 0; map < label_maps_; map++) {
-      *label_tensor.data_ptr (0, 0, map, sample) =
-        *labels_[t].data_ptr_const (col + (patchsize_x_ / 2), row + (patchsize_y_ / 2), map, 0);
+  // Copy patch
+  for (unsigned int map = 0; map < input_maps_; map++) {
+    for (unsigned int y = 0; y < patchsize_y_; y++) {
+      const datum* row_ptr = data_[t].data_ptr_const (col, row + y, map, 0);
+      datum* target_row_ptr = data_tensor.data_ptr (0, y, map, sample);
+      std::memcpy (target_row_ptr, row_ptr, patchsize_x_ * sizeof(datum) / sizeof (char));
     }
+  }
 
-		// Copy helper tensor
-		if (data_[t].width() > 1)
-			*helper_tensor.data_ptr(0, 0, 0, sample) = ((datum)col) / ((datum)data_[t].width() - 1);
-		else
-			*helper_tensor.data_ptr(0, 0, 0, sample) = 0;
+  // Copy label
+  for (unsigned int map = 0; map < label_maps_; map++) {
+    *label_tensor.data_ptr (0, 0, map, sample) =
+      *labels_[t].data_ptr_const (col + (patchsize_x_ / 2), row + (patchsize_y_ / 2), map, 0);
+  }
 
-		if (data_[t].height() > 1)
-			*helper_tensor.data_ptr(0, 0, 1, sample) = ((datum)row) / ((datum)data_[t].height() - 1);
-		else
-			*helper_tensor.data_ptr(0, 0, 1, sample) = 0;
+  // Copy helper tensor
+  if (data_[t].width() > 1)
+    *helper_tensor.data_ptr(0, 0, 0, sample) = ((datum)col) / ((datum)data_[t].width() - 1);
+  else
+    *helper_tensor.data_ptr(0, 0, 0, sample) = 0;
 
-		const datum class_weight = class_weights_[label_tensor.PixelMaximum(0, 0, sample)];
+  if (data_[t].height() > 1)
+    *helper_tensor.data_ptr(0, 0, 1, sample) = ((datum)row) / ((datum)data_[t].height() - 1);
+  else
+    *helper_tensor.data_ptr(0, 0, 1, sample) = 0;
 
-    // Copy error
-    *weight_tensor.data_ptr (0, 0, 0, sample) =
-      error_function_ (col + (patchsize_x_ / 2), row + (patchsize_y_ / 2),
-      data_[t].width(), data_[t].height()) * class_weight;
+  const datum class_weight = class_weights_[label_tensor.PixelMaximum(0, 0, sample)];
 
-    return success;
-  } else return false;
+  // Copy error
+  *weight_tensor.data_ptr (0, 0, 0, sample) =
+    error_function_ (col + (patchsize_x_ / 2), row + (patchsize_y_ / 2),
+    data_[t].width(), data_[t].height()) * class_weight;
 }
 
 TensorStreamPatchDataset* TensorStreamPatchDataset::CreateFromConfiguration (std::istream& file , bool dont_load, DatasetLoadSelection selection, unsigned int patchsize_x, unsigned int patchsize_y) {
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Allowed error of the fast activations in units in the last place
+const long double MAX_ULP = 4;
+
+long double UlpError(const Conv::datum value, const long double reference) {
+  int exponent;
+  std::frexp((double)reference, &exponent);
+  const long double ulp = std::ldexp(1.0L, std::max(exponent, -125) - 24);
+  return std::fabs((long double)value - reference) / ulp;
+}
+
+int main() {
+  Conv::System::Init();
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  // The element count is not a multiple of four to test the remainder
+  const unsigned int ELEMENTS = 40003;
+  Conv::CombinedTensor input(1, ELEMENTS);
+  for (unsigned int e = 0; e < ELEMENTS; e++) {
+    const Conv::datum t = -1.0 + 2.0 * (Conv::datum)e / (Conv::datum)(ELEMENTS - 1);
+    // Dense around zero, sparse towards +-30
+    input.data.data_ptr()[e] = 30.0 * t * t * t;
+  }
+
+  Conv::TanhLayer tanh_layer("mode=fast");
+  Conv::SigmoidLayer sigmoid_layer("mode=fast");
+
+  for (Conv::NonLinearityLayer* nl_layer : {(Conv::NonLinearityLayer*)&tanh_layer, (Conv::NonLinearityLayer*)&sigmoid_layer}) {
+    Conv::Layer& layer = *nl_layer;
+    const bool is_tanh = nl_layer == &tanh_layer;
+
+    if (nl_layer->GetActivationMode() != Conv::ACTIVATION_FAST) {
+      LOGERROR << "Mode not parsed from configuration";
+      failed = true;
+    }
+
+    std::vector<Conv::CombinedTensor*> outputs;
+    if (!layer.CreateOutputs({&input}, outputs) || !layer.Connect({&input}, outputs, &net_status)) {
+      LOGERROR << "Cannot connect layer";
+      failed = true;
+      continue;
+    }
+
+    layer.FeedForward();
+#ifdef BUILD_OPENCL
+    outputs[0]->data.MoveToCPU();
+#endif
+
+    long double max_error = 0;
+    for (unsigned int e = 0; e < ELEMENTS; e++) {
+      const long double x = input.data.data_ptr_const()[e];
+      const long double reference = is_tanh ? std::tanh(x) : 1.0L / (1.0L + std::exp(-x));
+      max_error = std::max(max_error, UlpError(outputs[0]->data.data_ptr_const()[e], reference));
+    }
+
+    LOGINFO << layer.GetLayerDescription() << " maximum error: " << (double)max_error << " ULP";
+#ifndef BUILD_OPENCL
+    if (max_error > MAX_ULP) {
+      LOGERROR << "Fast approximation is not accurate enough";
+      failed = true;
+    }
+#endif
+
+    delete outputs[0];
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
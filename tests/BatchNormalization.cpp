@@ -0,0 +1,167 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+// A sum of |x| would give a zero gradient for the normalized input,
+//  so the loss weights every output with a fixed random coefficient
+std::vector<Conv::datum> loss_weights;
+
+void WriteLossDeltas(const std::vector<Conv::CombinedTensor*>& outputs) {
+  for (unsigned int e = 0; e < outputs[0]->delta.elements(); e++)
+    outputs[0]->delta.data_ptr()[e] = loss_weights[e];
+}
+
+Conv::datum CalculateLoss(Conv::Layer* layer, const std::vector<Conv::CombinedTensor*>& outputs) {
+  UNREFERENCED_PARAMETER(layer);
+  double loss = 0;
+  for (unsigned int e = 0; e < outputs[0]->data.elements(); e++)
+    loss += loss_weights[e] * outputs[0]->data.data_ptr_const()[e];
+  return (Conv::datum)loss;
+}
+
+bool Near(const Conv::datum a, const Conv::datum b, const Conv::datum tolerance) {
+  return std::fabs(a - b) <= tolerance * std::max((Conv::datum)1.0, std::fabs(a) + std::fabs(b));
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  // The map size is not a multiple of four to test the remainder
+  const unsigned int SAMPLES = 3, WIDTH = 7, HEIGHT = 5, MAPS = 4;
+  Conv::CombinedTensor input(SAMPLES, WIDTH, HEIGHT, MAPS);
+  for (unsigned int sample = 0; sample < SAMPLES; sample++) {
+    for (unsigned int map = 0; map < MAPS; map++) {
+      // Large offsets make a naive single pass variance lose precision
+      const Conv::datum offset = 1000.0 * (Conv::datum)(map + 1);
+      const Conv::datum spread = 0.5 + (Conv::datum)map;
+      for (unsigned int y = 0; y < HEIGHT; y++)
+        for (unsigned int x = 0; x < WIDTH; x++)
+          *input.data.data_ptr(x, y, map, sample) = offset + spread * dist(rand);
+    }
+  }
+
+  Conv::BatchNormalizationLayer bn_layer("momentum=0.5");
+  Conv::Layer& layer = bn_layer;
+  std::vector<Conv::CombinedTensor*> outputs;
+  if (!layer.CreateOutputs({&input}, outputs) || !layer.Connect({&input}, outputs, &net_status))
+    FATAL("Cannot connect layer");
+
+  // Training output has zero mean and unit variance in every map
+  net_status.SetIsTesting(false);
+  layer.FeedForward();
+  for (unsigned int map = 0; map < MAPS; map++) {
+    double sum = 0, square_sum = 0;
+    for (unsigned int sample = 0; sample < SAMPLES; sample++)
+      for (unsigned int y = 0; y < HEIGHT; y++)
+        for (unsigned int x = 0; x < WIDTH; x++) {
+          const double value = *outputs[0]->data.data_ptr(x, y, map, sample);
+          sum += value;
+          square_sum += value * value;
+        }
+    const double count = SAMPLES * WIDTH * HEIGHT;
+    const double mean = sum / count;
+    const double variance = square_sum / count - mean * mean;
+    if (std::fabs(mean) > 1e-3 || std::fabs(variance - 1.0) > 1e-2) {
+      LOGERROR << "Map " << map << " not normalized, mean: " << mean << ", variance: " << variance;
+      failed = true;
+    }
+  }
+
+  // Gradients with respect to the input, scale and shift
+  for (unsigned int p = 0; p < 2; p++) {
+    for (unsigned int map = 0; map < MAPS; map++)
+      layer.parameters()[p]->data[map] += 0.3 * dist(rand);
+  }
+  loss_weights.resize(outputs[0]->data.elements());
+  for (Conv::datum& weight : loss_weights)
+    weight = dist(rand);
+
+  // Subtracting the offsets keeps the finite differences accurate
+  for (unsigned int sample = 0; sample < SAMPLES; sample++)
+    for (unsigned int map = 0; map < MAPS; map++)
+      for (unsigned int y = 0; y < HEIGHT; y++)
+        for (unsigned int x = 0; x < WIDTH; x++)
+          *input.data.data_ptr(x, y, map, sample) -= 1000.0 * (Conv::datum)(map + 1);
+
+  layer.SetBackpropagationEnabled(true);
+  if (!Conv::GradientTester::DoGradientTest(&layer, input.data, input.delta, outputs, 0.005, WriteLossDeltas, CalculateLoss)) {
+    LOGERROR << "Input gradient test failed";
+    failed = true;
+  }
+  for (unsigned int p = 0; p < 2; p++) {
+    Conv::CombinedTensor* parameter = layer.parameters()[p];
+    if (!Conv::GradientTester::DoGradientTest(&layer, parameter->data, parameter->delta, outputs, 0.005, WriteLossDeltas, CalculateLoss)) {
+      LOGERROR << "Gradient test failed for parameter " << p;
+      failed = true;
+    }
+  }
+
+  for (unsigned int p = 0; p < layer.parameters().size(); p++) {
+    if (layer.IsParameterTrainable(p) != (p < 2)) {
+      LOGERROR << "Only scale and shift should be trainable";
+      failed = true;
+    }
+  }
+
+  // Folding into the preceding convolution gives the same testing output
+  Conv::ConvolutionLayer conv_layer("size=3x3 kernels=4 seed=1");
+  Conv::BatchNormalizationLayer folded_bn_layer;
+  Conv::Layer& conv = conv_layer;
+  Conv::Layer& bn = folded_bn_layer;
+  std::vector<Conv::CombinedTensor*> conv_outputs, bn_outputs;
+  if (!conv.CreateOutputs({&input}, conv_outputs) || !conv.Connect({&input}, conv_outputs, &net_status) ||
+      !bn.CreateOutputs(conv_outputs, bn_outputs) || !bn.Connect(conv_outputs, bn_outputs, &net_status))
+    FATAL("Cannot connect layers");
+  conv_layer.OnLayerConnect({});
+
+  for (unsigned int map = 0; map < MAPS; map++) {
+    bn.parameters()[0]->data[map] = 1.0 + 0.5 * dist(rand);
+    bn.parameters()[1]->data[map] = dist(rand);
+  }
+  for (unsigned int pass = 0; pass < 3; pass++) {
+    conv.FeedForward();
+    bn.FeedForward();
+  }
+
+  net_status.SetIsTesting(true);
+  conv.FeedForward();
+  bn.FeedForward();
+  std::vector<Conv::datum> reference(bn_outputs[0]->data.data_ptr_const(),
+    bn_outputs[0]->data.data_ptr_const() + bn_outputs[0]->data.elements());
+
+  if (!folded_bn_layer.FoldInto(conv_layer)) {
+    LOGERROR << "Cannot fold batch normalization";
+    failed = true;
+  }
+  conv.FeedForward();
+  for (unsigned int e = 0; e < reference.size(); e++) {
+    if (!Near(conv_outputs[0]->data.data_ptr_const()[e], reference[e], 1e-4)) {
+      LOGERROR << "Folded output differs at " << e << ": " << conv_outputs[0]->data.data_ptr_const()[e]
+        << " instead of " << reference[e];
+      failed = true;
+      break;
+    }
+  }
+
+  delete outputs[0];
+  delete conv_outputs[0];
+  delete bn_outputs[0];
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
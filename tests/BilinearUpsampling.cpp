@@ -0,0 +1,120 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool Near(const long double a, const long double b) {
+  return std::fabs(a - b) <= 1e-4 * std::max((long double)1.0, std::fabs(a) + std::fabs(b));
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2015);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  std::uniform_real_distribution<Conv::datum> weight_dist(0.0, 2.0);
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  const unsigned int SAMPLES = 2, WIDTH = 5, HEIGHT = 3, MAPS = 3;
+  const unsigned int FX = 3, FY = 2;
+
+  // A linear function has to be reproduced exactly, apart from the borders
+  Conv::BilinearUpsampling bilinear(WIDTH, HEIGHT, FX, FY);
+  std::vector<Conv::datum> ramp(WIDTH * HEIGHT), ramp_up(WIDTH * FX * HEIGHT * FY), buffer(WIDTH);
+  for (unsigned int y = 0; y < HEIGHT; y++)
+    for (unsigned int x = 0; x < WIDTH; x++)
+      ramp[y * WIDTH + x] = x + 10 * y;
+  bilinear.UpsampleMap(ramp.data(), ramp_up.data(), buffer.data());
+  for (unsigned int y = 0; y < HEIGHT * FY; y++)
+    for (unsigned int x = 0; x < WIDTH * FX; x++) {
+      const double u = std::min(std::max(((double)x + 0.5) / FX - 0.5, 0.0), (double)WIDTH - 1);
+      const double v = std::min(std::max(((double)y + 0.5) / FY - 0.5, 0.0), (double)HEIGHT - 1);
+      if (!Near(ramp_up[y * WIDTH * FX + x], u + 10 * v)) {
+        LOGERROR << "Wrong interpolation at " << x << "," << y;
+        failed = true;
+      }
+    }
+
+  // The backward pass has to be the adjoint of the forward pass
+  std::vector<Conv::datum> small(WIDTH * HEIGHT), large(WIDTH * FX * HEIGHT * FY);
+  std::vector<Conv::datum> small_delta(WIDTH * HEIGHT);
+  for (Conv::datum& value : small) value = dist(rand);
+  for (Conv::datum& value : large) value = dist(rand);
+  bilinear.UpsampleMap(small.data(), ramp_up.data(), buffer.data());
+  bilinear.BackpropagateMap(large.data(), small_delta.data(), buffer.data());
+  long double forward_product = 0, backward_product = 0;
+  for (unsigned int i = 0; i < large.size(); i++)
+    forward_product += ramp_up[i] * large[i];
+  for (unsigned int i = 0; i < small.size(); i++)
+    backward_product += small[i] * small_delta[i];
+  if (!Near(forward_product, backward_product)) {
+    LOGERROR << "Backward pass is not the adjoint";
+    failed = true;
+  }
+
+  // The fused loss has to match upscaling followed by the square loss
+  for (Conv::UpscaleMethod method : {Conv::UPSCALE_NEAREST, Conv::UPSCALE_BILINEAR}) {
+    Conv::CombinedTensor output(SAMPLES, WIDTH, HEIGHT, MAPS);
+    Conv::CombinedTensor labels(SAMPLES, WIDTH * FX, HEIGHT * FY, MAPS);
+    Conv::CombinedTensor weights(SAMPLES, WIDTH * FX, HEIGHT * FY, 1);
+    for (unsigned int e = 0; e < output.data.elements(); e++)
+      output.data.data_ptr()[e] = dist(rand);
+    for (unsigned int e = 0; e < labels.data.elements(); e++)
+      labels.data.data_ptr()[e] = dist(rand);
+    for (unsigned int e = 0; e < weights.data.elements(); e++)
+      weights.data.data_ptr()[e] = weight_dist(rand);
+
+    Conv::UpscaleLayer upscale_layer(FX, FY, method);
+    Conv::ErrorLayer error_layer(0.5);
+    Conv::UpsamplingErrorLayer fused_layer(FX, FY, method, 0.5);
+    Conv::Layer& upscale = upscale_layer;
+    Conv::Layer& error = error_layer;
+    Conv::Layer& fused = fused_layer;
+
+    std::vector<Conv::CombinedTensor*> upscaled, none;
+    if (!upscale.CreateOutputs({&output}, upscaled) || !upscale.Connect({&output}, upscaled, &net_status) ||
+        !error.CreateOutputs({upscaled[0], &labels, &weights}, none) ||
+        !error.Connect({upscaled[0], &labels, &weights}, none, &net_status) ||
+        !fused.CreateOutputs({&output, &labels, &weights}, none) ||
+        !fused.Connect({&output, &labels, &weights}, none, &net_status)) {
+      LOGERROR << "Cannot connect layers";
+      failed = true;
+      continue;
+    }
+
+    upscale.FeedForward();
+    error.FeedForward();
+    upscale.BackPropagate();
+    const Conv::datum loss = error_layer.CalculateLossFunction();
+    std::vector<Conv::datum> delta(output.delta.data_ptr(), output.delta.data_ptr() + output.delta.elements());
+
+    output.delta.Clear(7.0);
+    fused.FeedForward();
+    fused.BackPropagate();
+
+    if (!Near(loss, fused_layer.CalculateLossFunction())) {
+      LOGERROR << "Wrong loss: " << fused_layer.CalculateLossFunction() << ", expected " << loss;
+      failed = true;
+    }
+    for (unsigned int e = 0; e < delta.size(); e++)
+      if (!Near(delta[e], output.delta.data_ptr()[e])) {
+        LOGERROR << "Wrong gradient at " << e;
+        failed = true;
+      }
+
+    delete upscaled[0];
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+const std::string net_config = "manual rfx=3 rfy=3 factorx=1 factory=1\n?convolutional kernels=4 size=4x4\n?tanh\n"
+  "?fullyconnected neurons=(o)\n?output\nmethod=patch\nlr=0.05\nmomentum=0.9\niterations=5\npbatchsize=2\n";
+
+void WriteImage(std::ostream& stream, unsigned int width, unsigned int height, std::mt19937& rand) {
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  Conv::Tensor image(1, width, height, 2);
+  Conv::Tensor label(1, width, height, 3);
+  label.Clear();
+  for (unsigned int e = 0; e < image.elements(); e++)
+    image[e] = dist(rand);
+  for (unsigned int y = 0; y < height; y++)
+    for (unsigned int x = 0; x < width; x++)
+      *label.data_ptr(x, y, rand() % 3, 0) = 1.0;
+  image.Serialize(stream);
+  label.Serialize(stream);
+}
+
+std::vector<Conv::Tensor*> CopyTensors(const std::vector<Conv::CombinedTensor*>& parameters) {
+  std::vector<Conv::Tensor*> copies;
+  for (Conv::CombinedTensor* parameter : parameters)
+    copies.push_back(new Conv::Tensor(parameter->data, true));
+  return copies;
+}
+
+bool SameTensors(const std::vector<Conv::CombinedTensor*>& parameters, const std::vector<Conv::Tensor*>& copies) {
+  for (unsigned int p = 0; p < parameters.size(); p++) {
+    for (unsigned int e = 0; e < copies[p]->elements(); e++) {
+      if (parameters[p]->data[e] != (*copies[p])[e])
+        return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  bool failed = false;
+  const std::string filename = "CheckpointingTest.Tensor";
+  const std::string parameter_filename = "CheckpointingTest.params.Tensor";
+  const std::string auto_filename = "CheckpointingTest.auto.Tensor";
+
+  std::stringstream training_stream, testing_stream;
+  WriteImage(training_stream, 9, 7, rand);
+  WriteImage(training_stream, 6, 8, rand);
+  WriteImage(testing_stream, 5, 5, rand);
+  Conv::TensorStreamPatchDataset dataset(training_stream, testing_stream, 3, {"a", "b", "c"},
+    {0xFF0000, 0x00FF00, 0x0000FF}, {1.0, 1.0, 1.0}, 4, 4);
+
+  std::istringstream config(net_config);
+  Conv::ConfigurableFactory factory(config, 2016, true);
+  factory.InitOptimalSettings();
+  Conv::NetGraph graph;
+  Conv::DatasetInputLayer data_layer(dataset, factory.optimal_settings().pbatchsize, 1.0, 2016);
+  Conv::NetGraphNode input_node(&data_layer);
+  input_node.is_input = true;
+  graph.AddNode(&input_node);
+  if (!factory.AddLayers(graph, Conv::NetGraphConnection(&input_node), 3, true))
+    FATAL("Incomplete graph");
+  graph.Initialize();
+  graph.InitializeWeights();
+
+  Conv::System::stat_aggregator->Initialize();
+  Conv::Trainer trainer(graph, factory.optimal_settings());
+  Conv::Checkpointer checkpointer(graph, trainer);
+  std::vector<Conv::CombinedTensor*> parameters;
+  graph.GetParameters(parameters);
+
+  // Checkpoints every 3 iterations, the last one is before iteration 4 of epoch 1
+  trainer.SetCheckpointing(&checkpointer, 3, auto_filename);
+  trainer.Train(2, false);
+  trainer.SetCheckpointing(nullptr, 0, "");
+
+  checkpointer.Save(filename);
+  checkpointer.Save(parameter_filename, false, Conv::STORAGE_FLOAT16);
+  std::vector<Conv::Tensor*> saved_parameters = CopyTensors(parameters);
+
+  // Training goes on while the snapshots are written
+  trainer.Train(1, false);
+  if (!checkpointer.Wait()) {
+    LOGERROR << "Writing snapshots failed";
+    failed = true;
+  }
+  if (SameTensors(parameters, saved_parameters)) {
+    LOGERROR << "Training did not change the parameters";
+    failed = true;
+  }
+
+  if (!checkpointer.Resume(filename) || trainer.epoch() != 2) {
+    LOGERROR << "Cannot resume from " << filename << ", epoch " << trainer.epoch();
+    failed = true;
+  }
+  if (!SameTensors(parameters, saved_parameters)) {
+    LOGERROR << "Resumed parameters differ from the snapshot";
+    failed = true;
+  }
+
+  // Checkpoints are parameter files followed by the optimizer state
+  std::ifstream checkpoint_file(filename, std::ios::in | std::ios::binary);
+  graph.InitializeWeights();
+  graph.DeserializeParameters(checkpoint_file);
+  if (!SameTensors(parameters, saved_parameters)) {
+    LOGERROR << "Checkpoint cannot be loaded as a parameter file";
+    failed = true;
+  }
+  Conv::Tensor state;
+  for (unsigned int t = 0; t < 2 * parameters.size(); t++)
+    state.Deserialize(checkpoint_file);
+  Conv::Tensor position;
+  position.Deserialize(checkpoint_file);
+  checkpoint_file.peek();
+  if (position.elements() != 2 || position[0] != 2 || position[1] != 0 || !checkpoint_file.eof()) {
+    LOGERROR << "Wrong training position in checkpoint: " << position;
+    failed = true;
+  }
+
+  // Parameter files resume without optimizer state
+  if (!checkpointer.Resume(parameter_filename) || trainer.epoch() != 2) {
+    LOGERROR << "Cannot load parameters from " << parameter_filename;
+    failed = true;
+  }
+
+  if (!checkpointer.Resume(auto_filename) || trainer.epoch() != 1) {
+    LOGERROR << "Cannot resume from " << auto_filename << ", epoch " << trainer.epoch();
+    failed = true;
+  }
+
+  // The remaining iteration of epoch 1 is where the checkpoint was taken
+  std::remove(auto_filename.c_str());
+  trainer.SetCheckpointing(&checkpointer, 3, auto_filename);
+  trainer.Train(1, false);
+  trainer.SetCheckpointing(nullptr, 0, "");
+  checkpointer.Wait();
+  if (trainer.epoch() != 2) {
+    LOGERROR << "Resumed epoch did not finish, epoch " << trainer.epoch();
+    failed = true;
+  }
+  if (std::ifstream(auto_filename).good()) {
+    LOGERROR << "Resuming rewrote the checkpoint it was resumed from";
+    failed = true;
+  }
+
+  for (Conv::Tensor* tensor : saved_parameters)
+    delete tensor;
+  for (const std::string& name : {filename, parameter_filename, auto_filename})
+    std::remove(name.c_str());
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
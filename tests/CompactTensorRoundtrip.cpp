@@ -0,0 +1,94 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <sstream>
+#include <random>
+
+int main() {
+  Conv::System::Init();
+
+  const unsigned int SAMPLES = 2, WIDTH = 7, HEIGHT = 5, CLASSES = 4;
+
+  // Random one-hot labels, class index CLASSES means "no class"
+  std::mt19937 rand(1337);
+  std::uniform_int_distribution<unsigned int> dist(0, CLASSES);
+  Conv::Tensor label_tensor(SAMPLES, WIDTH, HEIGHT, CLASSES);
+  label_tensor.Clear(0.0);
+  for(unsigned int s = 0; s < SAMPLES; s++)
+    for(unsigned int y = 0; y < HEIGHT; y++)
+      for(unsigned int x = 0; x < WIDTH; x++) {
+        unsigned int c = dist(rand);
+        if(c < CLASSES)
+          *label_tensor.data_ptr(x, y, c, s) = 1.0;
+      }
+
+  bool failed = false;
+
+  Conv::CompactTensor compact_tensor;
+  if(!compact_tensor.FromClassTensor(label_tensor)) {
+    LOGERROR << "One-hot tensor rejected";
+    failed = true;
+  }
+
+  std::stringstream ss;
+  compact_tensor.Serialize(ss);
+  Conv::CompactTensor loaded_tensor;
+  loaded_tensor.Deserialize(ss);
+
+  // Expand into a larger tensor to check the padding, too
+  Conv::Tensor target(SAMPLES, WIDTH + 2, HEIGHT + 1, CLASSES);
+  target.Clear(3.0);
+  for(unsigned int s = 0; s < SAMPLES; s++)
+    failed |= !loaded_tensor.CopySample(s, target, s);
+
+  for(unsigned int s = 0; s < SAMPLES; s++)
+    for(unsigned int c = 0; c < CLASSES; c++)
+      for(unsigned int y = 0; y < target.height(); y++)
+        for(unsigned int x = 0; x < target.width(); x++) {
+          const Conv::datum expected = (x < WIDTH && y < HEIGHT) ? *label_tensor.data_ptr(x, y, c, s) : 0.0;
+          if(*target.data_ptr(x, y, c, s) != expected) {
+            LOGERROR << "Mismatch at (" << x << "," << y << "," << c << "," << s << ")";
+            failed = true;
+          }
+        }
+
+  // Non one-hot labels must not be converted
+  *label_tensor.data_ptr(0, 0, 0, 0) = 0.5;
+  if(compact_tensor.FromClassTensor(label_tensor)) {
+    LOGERROR << "Non one-hot tensor accepted";
+    failed = true;
+  }
+
+  // 8-bit images have to survive the byte conversion exactly
+  std::uniform_int_distribution<unsigned int> byte_dist(0, 255);
+  Conv::Tensor image_tensor(SAMPLES, WIDTH, HEIGHT, 3);
+  for(unsigned int e = 0; e < image_tensor.elements(); e++)
+    image_tensor[e] = DATUM_FROM_UCHAR(byte_dist(rand));
+
+  Conv::CompactTensor compact_image_tensor;
+  if(!compact_image_tensor.FromImageTensor(image_tensor)) {
+    LOGERROR << "8-bit image tensor rejected";
+    failed = true;
+  }
+
+  Conv::Tensor image_target(SAMPLES, WIDTH, HEIGHT, 3);
+  for(unsigned int s = 0; s < SAMPLES; s++)
+    failed |= !compact_image_tensor.CopySample(s, image_target, s);
+
+  for(unsigned int e = 0; e < image_tensor.elements(); e++) {
+    if(image_target[e] != image_tensor[e]) {
+      LOGERROR << "Image mismatch at element " << e;
+      failed = true;
+      break;
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool Near(const Conv::datum a, const Conv::datum b) {
+  return std::fabs(a - b) <= 1e-5 * std::max((Conv::datum)1.0, std::fabs(a) + std::fabs(b));
+}
+
+Conv::Layer* ConnectReference(const std::string& descriptor, std::vector<Conv::CombinedTensor*> inputs,
+                              Conv::CombinedTensor*& output, Conv::Layer* graph_layer, Conv::NetStatus* net_status) {
+  Conv::Layer* layer = Conv::LayerFactory::ConstructLayer(descriptor);
+  std::vector<Conv::CombinedTensor*> outputs;
+  if (!layer->CreateOutputs(inputs, outputs) || !layer->Connect(inputs, outputs, net_status))
+    FATAL("Cannot connect reference layer " << descriptor);
+  for (unsigned int p = 0; p < layer->parameters().size(); p++) {
+    const Conv::Tensor& source = graph_layer->parameters()[p]->data;
+    std::copy(source.data_ptr_const(), source.data_ptr_const() + source.elements(), layer->parameters()[p]->data.data_ptr());
+  }
+  output = outputs[0];
+  return layer;
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  Conv::Tensor data_tensor(2, 9, 7, 3);
+  for (unsigned int e = 0; e < data_tensor.elements(); e++)
+    data_tensor.data_ptr()[e] = dist(rand);
+
+  //                .-> conv a -.
+  // input -> conv --> conv b --- sum -.
+  //                '-> conv c --------- concat -> conv
+  const std::vector<std::string> descriptors = {
+    "convolution(size=3x3 kernels=4 seed=1)", "convolution(size=1x1 kernels=3 seed=2)",
+    "convolution(size=1x1 kernels=3 seed=3)", "convolution(size=1x1 kernels=2 seed=4)",
+    "convolution(size=1x1 kernels=2 seed=5)"
+  };
+
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer(data_tensor);
+  Conv::NetGraphNode input_node(&input_layer);
+  input_node.is_input = true;
+  graph.AddNode(&input_node);
+
+  Conv::NetGraphNode* fan_out_node = new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[0]), Conv::NetGraphConnection(&input_node));
+  Conv::NetGraphNode* a_node = new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[1]), Conv::NetGraphConnection(fan_out_node));
+  Conv::NetGraphNode* b_node = new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[2]), Conv::NetGraphConnection(fan_out_node));
+  Conv::NetGraphNode* c_node = new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[3]), Conv::NetGraphConnection(fan_out_node));
+  Conv::NetGraphNode* sum_node = new Conv::NetGraphNode(new Conv::SumLayer(), Conv::NetGraphConnection(a_node));
+  sum_node->input_connections.push_back(Conv::NetGraphConnection(b_node));
+  Conv::NetGraphNode* concatenation_node = new Conv::NetGraphNode(new Conv::ConcatenationLayer(), Conv::NetGraphConnection(sum_node));
+  concatenation_node->input_connections.push_back(Conv::NetGraphConnection(c_node));
+  Conv::NetGraphNode* output_node = new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[4]), Conv::NetGraphConnection(concatenation_node));
+  output_node->is_output = true;
+
+  const std::vector<Conv::NetGraphNode*> conv_nodes = {fan_out_node, a_node, b_node, c_node, output_node};
+  for (Conv::NetGraphNode* node : {fan_out_node, a_node, b_node, c_node, sum_node, concatenation_node, output_node})
+    graph.AddNode(node);
+
+  graph.Initialize();
+  graph.InitializeWeights();
+
+  // The fan-out gets an accumulation node whose outputs share the data
+  //  and whose first output shares the gradient
+  Conv::NetGraphNode* accumulation_node = a_node->input_connections[0].node;
+  if (dynamic_cast<Conv::GradientAccumulationLayer*>(accumulation_node->layer) == nullptr) {
+    FATAL("No gradient accumulation inserted");
+  }
+  Conv::CombinedTensor* fan_out_buffer = fan_out_node->output_buffers[0].combined_tensor;
+  for (unsigned int b = 0; b < accumulation_node->output_buffers.size(); b++) {
+    Conv::CombinedTensor* buffer = accumulation_node->output_buffers[b].combined_tensor;
+    if (buffer->data.data_ptr_const() != fan_out_buffer->data.data_ptr_const() ||
+        (b == 0) != (buffer->delta.data_ptr_const() == fan_out_buffer->delta.data_ptr_const())) {
+      LOGERROR << "Wrong sharing for accumulation output " << b;
+      failed = true;
+    }
+  }
+  if (sum_node->output_buffers[0].combined_tensor->delta.data_ptr_const() != a_node->output_buffers[0].combined_tensor->delta.data_ptr_const()) {
+    LOGERROR << "Sum does not share its gradient with the first input";
+    failed = true;
+  }
+
+  // Build the same net from separate layers, accumulating by hand
+  Conv::CombinedTensor input(data_tensor.samples(), data_tensor.width(), data_tensor.height(), data_tensor.maps());
+  std::copy(data_tensor.data_ptr(), data_tensor.data_ptr() + data_tensor.elements(), input.data.data_ptr());
+  Conv::CombinedTensor* fan_out_output;
+  Conv::Layer* fan_out = ConnectReference(descriptors[0], {&input}, fan_out_output, fan_out_node->layer, &net_status);
+  const Conv::Tensor& shape = fan_out_output->data;
+  std::vector<Conv::CombinedTensor*> copies;
+  std::vector<Conv::Layer*> branches;
+  std::vector<Conv::CombinedTensor*> branch_outputs;
+  for (unsigned int n = 1; n <= 3; n++) {
+    copies.push_back(new Conv::CombinedTensor(shape.samples(), shape.width(), shape.height(), shape.maps()));
+    Conv::CombinedTensor* output;
+    branches.push_back(ConnectReference(descriptors[n], {copies.back()}, output, conv_nodes[n]->layer, &net_status));
+    branch_outputs.push_back(output);
+  }
+  const Conv::Tensor& branch_shape = branch_outputs[0]->data;
+  Conv::CombinedTensor sum(branch_shape.samples(), branch_shape.width(), branch_shape.height(), branch_shape.maps());
+  Conv::ConcatenationLayer concatenation;
+  Conv::Layer& concatenation_layer = concatenation;
+  std::vector<Conv::CombinedTensor*> concatenation_output;
+  concatenation_layer.CreateOutputs({&sum, branch_outputs[2]}, concatenation_output);
+  concatenation_layer.Connect({&sum, branch_outputs[2]}, concatenation_output, &net_status);
+  Conv::CombinedTensor* last_output;
+  Conv::Layer* last = ConnectReference(descriptors[4], concatenation_output, last_output, output_node->layer, &net_status);
+
+  fan_out->FeedForward();
+  for (unsigned int n = 0; n < 3; n++) {
+    std::copy(shape.data_ptr_const(), shape.data_ptr_const() + shape.elements(), copies[n]->data.data_ptr());
+    branches[n]->FeedForward();
+  }
+  for (unsigned int e = 0; e < sum.data.elements(); e++)
+    sum.data[e] = branch_outputs[0]->data[e] + branch_outputs[1]->data[e];
+  concatenation_layer.FeedForward();
+  last->FeedForward();
+
+  graph.FeedForward();
+  Conv::CombinedTensor* graph_output = output_node->output_buffers[0].combined_tensor;
+  for (unsigned int e = 0; e < graph_output->data.elements(); e++) {
+    const Conv::datum delta = dist(rand);
+    graph_output->delta.data_ptr()[e] = delta;
+    last_output->delta.data_ptr()[e] = delta;
+    if (!Near(graph_output->data.data_ptr_const()[e], last_output->data.data_ptr_const()[e])) {
+      LOGERROR << "Wrong output at " << e;
+      failed = true;
+      break;
+    }
+  }
+
+  // Run the backward pass twice to catch stale gradients
+  for (unsigned int pass = 0; pass < 2; pass++)
+    graph.BackPropagate();
+
+  last->BackPropagate();
+  concatenation_layer.BackPropagate();
+  for (unsigned int n = 0; n < 2; n++)
+    std::copy(sum.delta.data_ptr_const(), sum.delta.data_ptr_const() + sum.delta.elements(), branch_outputs[n]->delta.data_ptr());
+  fan_out_output->delta.Clear();
+  for (unsigned int n = 0; n < 3; n++) {
+    branches[n]->BackPropagate();
+    for (unsigned int e = 0; e < shape.elements(); e++)
+      fan_out_output->delta[e] += copies[n]->delta[e];
+  }
+  fan_out->SetBackpropagationEnabled(false);
+  fan_out->BackPropagate();
+
+  std::vector<Conv::Layer*> reference_layers = {fan_out, branches[0], branches[1], branches[2], last};
+  for (unsigned int n = 0; n < conv_nodes.size(); n++) {
+    for (unsigned int p = 0; p < reference_layers[n]->parameters().size(); p++) {
+      const Conv::Tensor& gradient = conv_nodes[n]->layer->parameters()[p]->delta;
+      const Conv::Tensor& reference = reference_layers[n]->parameters()[p]->delta;
+      for (unsigned int e = 0; e < gradient.elements(); e++) {
+        if (!Near(gradient.data_ptr_const()[e], reference.data_ptr_const()[e])) {
+          LOGERROR << "Wrong gradient for convolution " << n << " at " << e;
+          failed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <sstream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdint>
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  bool failed = false;
+
+  LOGINFO << "Using the " << Conv::HalfPrecision::GetImplementation() << " implementation";
+
+  for (Conv::TensorStorage storage : {Conv::STORAGE_FLOAT16, Conv::STORAGE_BFLOAT16}) {
+    // Every 16-bit value survives the round trip, NaNs stay NaNs
+    std::vector<uint16_t> values(65536), packed(65536);
+    std::vector<Conv::datum> unpacked(65536);
+    for (unsigned int v = 0; v < 65536; v++)
+      values[v] = (uint16_t)v;
+    Conv::HalfPrecision::Unpack(&values[0], &unpacked[0], 65536, storage);
+    Conv::HalfPrecision::Pack(&unpacked[0], &packed[0], 65536, storage);
+    const uint16_t exponent_mask = storage == Conv::STORAGE_FLOAT16 ? 0x7C00 : 0x7F80;
+    const uint16_t mantissa_mask = storage == Conv::STORAGE_FLOAT16 ? 0x3FF : 0x7F;
+    for (unsigned int v = 0; v < 65536; v++) {
+      // AVX-512 BF16 flushes subnormals to zero
+      if (storage == Conv::STORAGE_BFLOAT16 && (v & exponent_mask) == 0 && (v & mantissa_mask) != 0)
+        continue;
+      const bool is_nan = (packed[v] & exponent_mask) == exponent_mask && (packed[v] & mantissa_mask) != 0;
+      if (std::isnan(unpacked[v]) ? !is_nan : packed[v] != v) {
+        LOGERROR << "Value " << v << " of storage " << storage << " became " << packed[v];
+        failed = true;
+        break;
+      }
+    }
+
+    // Random floats are rounded to within half a step
+    const Conv::datum step = storage == Conv::STORAGE_FLOAT16 ? std::ldexp(1.0, -10) : std::ldexp(1.0, -7);
+    std::uniform_real_distribution<Conv::datum> dist(-1000.0, 1000.0);
+    std::vector<Conv::datum> source(1001), target(1001);
+    std::vector<uint16_t> converted(1001);
+    for (Conv::datum& s : source)
+      s = dist(rand);
+    Conv::HalfPrecision::Pack(&source[0], &converted[0], source.size(), storage);
+    Conv::HalfPrecision::Unpack(&converted[0], &target[0], source.size(), storage);
+    for (unsigned int e = 0; e < source.size(); e++) {
+      int exponent;
+      std::frexp(source[e], &exponent);
+      if (std::fabs(source[e] - target[e]) > std::ldexp(step, exponent - 1) / 2) {
+        LOGERROR << source[e] << " became " << target[e] << " in storage " << storage;
+        failed = true;
+        break;
+      }
+    }
+  }
+
+  // Ties go to even, overflows to infinity, tiny values to subnormals or zero
+  struct Expectation { Conv::TensorStorage storage; Conv::datum value; uint16_t expected; };
+  const std::vector<Expectation> expectations = {
+    {Conv::STORAGE_FLOAT16, 1.0f + std::ldexp(1.0f, -11), 0x3C00},
+    {Conv::STORAGE_FLOAT16, 1.0f + 3.0f * std::ldexp(1.0f, -11), 0x3C02},
+    {Conv::STORAGE_FLOAT16, 65504.0f, 0x7BFF},
+    {Conv::STORAGE_FLOAT16, 65520.0f, 0x7C00},
+    {Conv::STORAGE_FLOAT16, -1e10f, 0xFC00},
+    {Conv::STORAGE_FLOAT16, std::ldexp(1.0f, -24), 0x0001},
+    {Conv::STORAGE_FLOAT16, std::ldexp(1.0f, -26), 0x0000},
+    {Conv::STORAGE_FLOAT16, -0.0f, 0x8000},
+    {Conv::STORAGE_BFLOAT16, 1.0f + std::ldexp(1.0f, -8), 0x3F80},
+    {Conv::STORAGE_BFLOAT16, 1.0f + 3.0f * std::ldexp(1.0f, -8), 0x3F82},
+    {Conv::STORAGE_BFLOAT16, -2.0f, 0xC000},
+    {Conv::STORAGE_BFLOAT16, 3.4e38f, 0x7F80}
+  };
+  for (const Expectation& expectation : expectations) {
+    uint16_t actual;
+    Conv::HalfPrecision::Pack(&expectation.value, &actual, 1, expectation.storage);
+    if (actual != expectation.expected) {
+      LOGERROR << expectation.value << " became " << actual << " instead of " << expectation.expected
+               << " in storage " << expectation.storage;
+      failed = true;
+    }
+  }
+
+  // Serialized tensors keep their shape at half the size
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  Conv::Tensor tensor(2, 7, 5, 3);
+  for (unsigned int e = 0; e < tensor.elements(); e++)
+    tensor[e] = dist(rand);
+  for (Conv::TensorStorage storage : {Conv::STORAGE_FLOAT32, Conv::STORAGE_FLOAT16, Conv::STORAGE_BFLOAT16}) {
+    std::stringstream ss;
+    tensor.Serialize(ss, false, storage);
+    tensor.Serialize(ss, false, storage);
+    const std::size_t expected_size = 2 * (4 * sizeof(uint64_t) + tensor.elements() * Conv::HalfPrecision::ElementSize(storage));
+    if (ss.str().size() != expected_size) {
+      LOGERROR << "Storage " << storage << " wrote " << ss.str().size() << " bytes instead of " << expected_size;
+      failed = true;
+      continue;
+    }
+
+    std::vector<uint16_t> packed(tensor.elements());
+    std::vector<Conv::datum> expected(tensor.elements());
+    if (storage == Conv::STORAGE_FLOAT32) {
+      for (unsigned int e = 0; e < tensor.elements(); e++)
+        expected[e] = tensor[e];
+    } else {
+      Conv::HalfPrecision::Pack(tensor.data_ptr_const(), &packed[0], tensor.elements(), storage);
+      Conv::HalfPrecision::Unpack(&packed[0], &expected[0], tensor.elements(), storage);
+    }
+
+    Conv::Tensor head, loaded;
+    head.Deserialize(ss, true);
+    loaded.Deserialize(ss);
+    if (head.maps() != 3 || loaded.samples() != 2 || loaded.width() != 7 || loaded.height() != 5 || loaded.maps() != 3) {
+      LOGERROR << "Storage " << storage << " loaded as " << loaded;
+      failed = true;
+      continue;
+    }
+    for (unsigned int e = 0; e < loaded.elements(); e++) {
+      if (loaded[e] != expected[e]) {
+        LOGERROR << "Storage " << storage << " mismatch at element " << e << ": " << loaded[e] << " instead of " << expected[e];
+        failed = true;
+        break;
+      }
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
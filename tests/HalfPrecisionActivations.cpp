@@ -0,0 +1,133 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+// Largest difference relative to the largest reference value
+Conv::datum RelativeError(const std::vector<Conv::datum>& values, const std::vector<Conv::datum>& reference) {
+  Conv::datum maximum = 0, error = 0;
+  for (unsigned int e = 0; e < reference.size(); e++) {
+    maximum = std::max(maximum, (Conv::datum)std::fabs(reference[e]));
+    error = std::max(error, (Conv::datum)std::fabs(values[e] - reference[e]));
+  }
+  return maximum > 0 ? error / maximum : error;
+}
+
+// Runs the graph and returns the output followed by all parameter gradients
+std::vector<Conv::datum> Run(Conv::NetGraph& graph, Conv::CombinedTensor* output, const std::vector<Conv::datum>& output_delta) {
+  graph.FeedForward();
+  std::vector<Conv::datum> results(output->data.data_ptr_const(), output->data.data_ptr_const() + output->data.elements());
+  std::copy(output_delta.begin(), output_delta.end(), output->delta.data_ptr());
+  graph.BackPropagate();
+
+  std::vector<Conv::CombinedTensor*> parameters;
+  graph.GetParameters(parameters);
+  for (Conv::CombinedTensor* parameter : parameters)
+    results.insert(results.end(), parameter->delta.data_ptr_const(), parameter->delta.data_ptr_const() + parameter->delta.elements());
+  return results;
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  bool failed = false;
+
+  Conv::Tensor data_tensor(2, 14, 10, 3);
+  for (unsigned int e = 0; e < data_tensor.elements(); e++)
+    data_tensor.data_ptr()[e] = dist(rand);
+
+  // Every layer but the last one keeps its output in 16 bits
+  const std::vector<std::string> descriptors = {
+    "convolution(size=3x3 kernels=4 seed=1)", "tanh", "maxpooling(size=2x2)",
+    "convolution(size=3x3 kernels=3 seed=2)", "relu",
+    "convolution(size=1x1 kernels=3 seed=3)", "sigm",
+    "convolution(size=1x1 kernels=2 seed=4)"
+  };
+
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer(data_tensor);
+  Conv::NetGraphNode input_node(&input_layer);
+  input_node.is_input = true;
+  graph.AddNode(&input_node);
+
+  std::vector<Conv::NetGraphNode*> nodes;
+  Conv::NetGraphConnection last_connection(&input_node);
+  for (const std::string& descriptor : descriptors) {
+    Conv::NetGraphNode* node = new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptor), last_connection);
+    graph.AddNode(node);
+    nodes.push_back(node);
+    last_connection = Conv::NetGraphConnection(node);
+  }
+  nodes.back()->is_output = true;
+
+  graph.Initialize();
+  graph.InitializeWeights();
+
+  Conv::CombinedTensor* output = nodes.back()->output_buffers[0].combined_tensor;
+  std::vector<Conv::datum> output_delta(output->delta.elements());
+  for (Conv::datum& delta : output_delta)
+    delta = dist(rand);
+
+  const std::vector<Conv::datum> reference = Run(graph, output, output_delta);
+
+  for (Conv::TensorStorage storage : {Conv::STORAGE_FLOAT16, Conv::STORAGE_BFLOAT16}) {
+    if (!graph.SetActivationStorage(storage)) {
+      LOGERROR << "Cannot store activations in storage " << storage;
+      failed = true;
+      continue;
+    }
+
+    for (unsigned int n = 0; n < nodes.size(); n++) {
+      const Conv::CombinedTensor* buffer = nodes[n]->output_buffers[0].combined_tensor;
+      const Conv::TensorStorage expected = n + 1 < nodes.size() ? storage : Conv::STORAGE_FLOAT32;
+      if (buffer->data.storage() != expected || buffer->delta.storage() != expected) {
+        LOGERROR << descriptors[n] << " has storage " << buffer->data.storage() << " instead of " << expected;
+        failed = true;
+      }
+    }
+    if (input_node.output_buffers[0].combined_tensor->data.storage() != Conv::STORAGE_FLOAT32) {
+      LOGERROR << "The input buffer was converted";
+      failed = true;
+    }
+
+    // bfloat16 keeps three bits less than half precision
+    const Conv::datum tolerance = storage == Conv::STORAGE_FLOAT16 ? 2e-3 : 2e-2;
+    const std::vector<Conv::datum> results = Run(graph, output, output_delta);
+    const Conv::datum error = RelativeError(results, reference);
+    LOGINFO << "Relative error in storage " << storage << ": " << error;
+    if (!(error <= tolerance)) {
+      LOGERROR << "Storage " << storage << " is off by " << error;
+      failed = true;
+    }
+  }
+
+  // Reshaping keeps the storage, converting back gives the float results
+  if (!graph.Reshape(18, 14, 1) || !graph.Reshape(14, 10, 2)) {
+    LOGERROR << "Cannot reshape the net";
+    failed = true;
+  } else {
+    output = nodes.back()->output_buffers[0].combined_tensor;
+    if (nodes[0]->output_buffers[0].combined_tensor->data.storage() != Conv::STORAGE_BFLOAT16) {
+      LOGERROR << "Reshaping changed the storage";
+      failed = true;
+    }
+  }
+  if (!graph.SetActivationStorage(Conv::STORAGE_FLOAT32) || Run(graph, output, output_delta) != reference) {
+    LOGERROR << "Float storage does not reproduce the results";
+    failed = true;
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <sstream>
+#include <random>
+#include <vector>
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(1337);
+  std::uniform_int_distribution<unsigned int> dist(0, 255);
+  bool failed = false;
+
+  // Deinterleaving has to match DATUM_FROM_UCHAR for every row length
+  for(unsigned int channels = 1; channels <= 4; channels++) {
+    for(unsigned int width = 0; width < 50; width++) {
+      std::vector<unsigned char> source(width * channels);
+      for(unsigned int i = 0; i < source.size(); i++)
+        source[i] = dist(rand);
+
+      Conv::Tensor planar(1, width > 0 ? width : 1, 1, channels);
+      Conv::datum* targets[4];
+      for(unsigned int c = 0; c < channels; c++)
+        targets[c] = planar.data_ptr(0, 0, c, 0);
+
+      Conv::ImageUtil::DeinterleaveRow(source.data(), width, channels, targets);
+
+      for(unsigned int x = 0; x < width; x++)
+        for(unsigned int c = 0; c < channels; c++)
+          if(targets[c][x] != DATUM_FROM_UCHAR(source[channels * x + c])) {
+            LOGERROR << "Deinterleaving failed for " << channels << " channels, width " << width;
+            failed = true;
+          }
+    }
+  }
+
+#ifdef BUILD_PNG
+  // Decode an image into the second sample of a larger batch Tensor
+  const unsigned int WIDTH = 37, HEIGHT = 11;
+  Conv::Tensor image(1, WIDTH, HEIGHT, 3);
+  for(unsigned int e = 0; e < image.elements(); e++)
+    image.data_ptr()[e] = DATUM_FROM_UCHAR(dist(rand));
+
+  std::stringstream ss;
+  Conv::PNGUtil::WriteToStream(ss, image);
+
+  Conv::Tensor batch(2, WIDTH + 5, HEIGHT + 3, 3);
+  batch.Clear(1.0);
+  ss.seekg(0);
+  if(!Conv::PNGUtil::LoadFromStream(ss, batch, 1)) {
+    LOGERROR << "Cannot decode into batch sample";
+    failed = true;
+  } else {
+    for(unsigned int c = 0; c < 3; c++)
+      for(unsigned int y = 0; y < batch.height(); y++)
+        for(unsigned int x = 0; x < batch.width(); x++) {
+          const Conv::datum expected = (x < WIDTH && y < HEIGHT) ? *image.data_ptr(x, y, c, 0) : 0;
+          if(*batch.data_ptr(x, y, c, 1) != expected || *batch.data_ptr(x, y, c, 0) != 1.0) {
+            LOGERROR << "Wrong value at " << x << "," << y << "," << c;
+            failed = true;
+          }
+        }
+  }
+#endif
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool Near(const Conv::datum a, const Conv::datum b) {
+  return std::fabs(a - b) <= 1e-5 * std::max((Conv::datum)1.0, std::fabs(a) + std::fabs(b));
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  Conv::Tensor data_tensor(2, 10, 8, 3);
+  for (unsigned int e = 0; e < data_tensor.elements(); e++)
+    data_tensor.data_ptr()[e] = dist(rand);
+
+  // input -> conv -> relu -> conv -> sigm -> tanh
+  const std::vector<std::string> descriptors = {
+    "convolution(size=3x3 kernels=4 seed=1)", "relu",
+    "convolution(size=3x3 kernels=2 seed=2)", "sigm", "tanh"
+  };
+
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer(data_tensor);
+  Conv::NetGraphNode input_node(&input_layer);
+  input_node.is_input = true;
+  graph.AddNode(&input_node);
+
+  std::vector<Conv::NetGraphNode*> nodes;
+  Conv::NetGraphConnection last_connection(&input_node);
+  for (const std::string& descriptor : descriptors) {
+    Conv::NetGraphNode* node = new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptor), last_connection);
+    graph.AddNode(node);
+    nodes.push_back(node);
+    last_connection = Conv::NetGraphConnection(node);
+  }
+  nodes.back()->is_output = true;
+
+  graph.Initialize();
+  graph.InitializeWeights();
+
+  // The first activations own their input, tanh would destroy the output
+  //  that sigm needs for backpropagation
+  const std::vector<bool> expected_in_place = {false, true, false, true, false};
+  for (unsigned int n = 0; n < nodes.size(); n++) {
+    if (nodes[n]->in_place != expected_in_place[n]) {
+      LOGERROR << descriptors[n] << (expected_in_place[n] ? " should" : " should not") << " run in place";
+      failed = true;
+    }
+  }
+  if (nodes[1]->output_buffers[0].combined_tensor != nodes[0]->output_buffers[0].combined_tensor) {
+    LOGERROR << "In-place output does not alias the input";
+    failed = true;
+  }
+
+  // Build the same chain from separate layers
+  std::vector<Conv::Layer*> layers;
+  std::vector<Conv::CombinedTensor*> tensors;
+  Conv::CombinedTensor input(data_tensor.samples(), data_tensor.width(), data_tensor.height(), data_tensor.maps());
+  std::copy(data_tensor.data_ptr(), data_tensor.data_ptr() + data_tensor.elements(), input.data.data_ptr());
+  tensors.push_back(&input);
+  for (unsigned int n = 0; n < nodes.size(); n++) {
+    Conv::Layer* layer = Conv::LayerFactory::ConstructLayer(descriptors[n]);
+    std::vector<Conv::CombinedTensor*> outputs;
+    if (!layer->CreateOutputs({tensors.back()}, outputs) || !layer->Connect({tensors.back()}, outputs, &net_status))
+      FATAL("Cannot connect reference layer " << descriptors[n]);
+    for (unsigned int p = 0; p < layer->parameters().size(); p++) {
+      const Conv::Tensor& source = nodes[n]->layer->parameters()[p]->data;
+      std::copy(source.data_ptr_const(), source.data_ptr_const() + source.elements(), layer->parameters()[p]->data.data_ptr());
+    }
+    layers.push_back(layer);
+    tensors.push_back(outputs[0]);
+  }
+
+  graph.FeedForward();
+  for (Conv::Layer* layer : layers)
+    layer->FeedForward();
+
+  Conv::CombinedTensor* graph_output = nodes.back()->output_buffers[0].combined_tensor;
+  for (unsigned int e = 0; e < graph_output->data.elements(); e++) {
+    const Conv::datum delta = dist(rand);
+    graph_output->delta.data_ptr()[e] = delta;
+    tensors.back()->delta.data_ptr()[e] = delta;
+    if (!Near(graph_output->data.data_ptr_const()[e], tensors.back()->data.data_ptr_const()[e])) {
+      LOGERROR << "Wrong output at " << e;
+      failed = true;
+    }
+  }
+
+  graph.BackPropagate();
+  layers[0]->SetBackpropagationEnabled(false);
+  for (unsigned int n = layers.size(); n > 0; n--)
+    layers[n - 1]->BackPropagate();
+
+  for (unsigned int n = 0; n < nodes.size(); n++) {
+    for (unsigned int p = 0; p < layers[n]->parameters().size(); p++) {
+      const Conv::Tensor& gradient = nodes[n]->layer->parameters()[p]->delta;
+      const Conv::Tensor& reference = layers[n]->parameters()[p]->delta;
+      for (unsigned int e = 0; e < gradient.elements(); e++) {
+        if (!Near(gradient.data_ptr_const()[e], reference.data_ptr_const()[e])) {
+          LOGERROR << "Wrong gradient for " << descriptors[n] << " at " << e;
+          failed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  bool failed = false;
+
+  LOGINFO << "Using the " << Conv::Int8Math::GetImplementation() << " implementation";
+
+  // The integer product is exact, also for rows that do not fill a block
+  const int M = 7, N = 37, K = Conv::Int8Math::PaddedDepth(45);
+  std::uniform_int_distribution<int> weight_dist(-Conv::Int8Math::WEIGHT_LIMIT, Conv::Int8Math::WEIGHT_LIMIT);
+  std::uniform_int_distribution<int> input_dist(0, Conv::Int8Math::INPUT_LIMIT);
+  std::vector<int8_t> A(M * K);
+  std::vector<uint8_t> B(N * K);
+  for (int8_t& a : A)
+    a = (int8_t)weight_dist(rand);
+  for (uint8_t& b : B)
+    b = (uint8_t)input_dist(rand);
+  // Extremes would saturate 16-bit pairwise sums of larger inputs
+  for (int k = 0; k < K; k++) {
+    A[k] = Conv::Int8Math::WEIGHT_LIMIT;
+    B[k] = Conv::Int8Math::INPUT_LIMIT;
+  }
+
+  std::vector<int32_t> C(M * (N + 3), 0);
+  Conv::Int8Math::GEMM(M, N, K, &A[0], &B[0], &C[0], N + 3);
+  for (int m = 0; m < M && !failed; m++) {
+    for (int n = 0; n < N; n++) {
+      int32_t expected = 0;
+      for (int k = 0; k < K; k++)
+        expected += (int32_t)A[m * K + k] * (int32_t)B[n * K + k];
+      if (C[m * (N + 3) + n] != expected) {
+        LOGERROR << "GEMM at (" << m << "," << n << "): " << C[m * (N + 3) + n] << " instead of " << expected;
+        failed = true;
+        break;
+      }
+    }
+  }
+
+  // Quantized convolutions stay within the rounding error of their inputs
+  Conv::NetStatus net_status;
+  net_status.SetIsTesting(true);
+  for (const std::string& descriptor : std::vector<std::string>{"convolution(size=3x3 kernels=5 pad=1x1 seed=1)",
+                                        "convolution(size=3x2 kernels=6 stride=2x2 group=2 seed=2)",
+                                        "convolution(size=1x1 kernels=3 seed=3)"}) {
+    Conv::ConvolutionLayer layer(descriptor);
+    Conv::CombinedTensor input(2, 9, 7, 4);
+    for (unsigned int e = 0; e < input.data.elements(); e++)
+      input.data.data_ptr()[e] = 0.5 + dist(rand);
+    std::vector<Conv::CombinedTensor*> outputs;
+    Conv::Layer* base_layer = &layer;
+    if (!base_layer->CreateOutputs({&input}, outputs) || !base_layer->Connect({&input}, outputs, &net_status))
+      FATAL("Cannot connect " << descriptor);
+    Conv::Tensor& weights = layer.parameters()[0]->data;
+    for (unsigned int e = 0; e < weights.elements(); e++)
+      weights.data_ptr()[e] = dist(rand);
+    for (unsigned int e = 0; e < layer.parameters()[1]->data.elements(); e++)
+      layer.parameters()[1]->data.data_ptr()[e] = dist(rand);
+
+    layer.SetCalibrating(true);
+    layer.FeedForward();
+    layer.SetCalibrating(false);
+    Conv::Tensor float_output(outputs[0]->data, true);
+
+    Conv::datum input_min, input_max;
+    const Conv::datum* const input_begin = input.data.data_ptr_const();
+    if (!layer.GetInputRange(input_min, input_max) ||
+        input_min != *std::min_element(input_begin, input_begin + input.data.elements()) ||
+        input_max != *std::max_element(input_begin, input_begin + input.data.elements())) {
+      LOGERROR << "Wrong input range for " << descriptor;
+      failed = true;
+      continue;
+    }
+
+    if (!layer.Quantize(input_min, input_max))
+      FATAL("Cannot quantize " << descriptor);
+    layer.FeedForward();
+
+    // Each product is off by at most half a step of either factor
+    const unsigned int depth = weights.elements() / weights.samples();
+    const Conv::datum input_step = (input_max - std::min((Conv::datum)0, input_min)) / Conv::Int8Math::INPUT_LIMIT;
+    const Conv::datum largest_input = std::max(std::fabs(input_min), std::fabs(input_max));
+    unsigned int exact_outputs = 0;
+    for (unsigned int map = 0; map < float_output.maps() && !failed; map++) {
+      const Conv::datum* kernel = weights.data_ptr_const(0, 0, 0, map);
+      Conv::datum largest_weight = 0;
+      for (unsigned int e = 0; e < depth; e++)
+        largest_weight = std::max(largest_weight, (Conv::datum)std::fabs(kernel[e]));
+      const Conv::datum weight_step = largest_weight / Conv::Int8Math::WEIGHT_LIMIT;
+      const Conv::datum bound = 1.01 * depth * (largest_weight * input_step / 2 + largest_input * weight_step / 2 +
+                                                input_step * weight_step / 4) + 1e-5;
+
+      for (unsigned int sample = 0; sample < float_output.samples(); sample++)
+        for (unsigned int y = 0; y < float_output.height(); y++)
+          for (unsigned int x = 0; x < float_output.width(); x++) {
+            const Conv::datum expected = *float_output.data_ptr_const(x, y, map, sample);
+            const Conv::datum actual = *outputs[0]->data.data_ptr_const(x, y, map, sample);
+            exact_outputs += expected == actual;
+            if (std::fabs(expected - actual) > bound) {
+              LOGERROR << descriptor << " at (" << x << "," << y << ") in map " << map << ": " << actual
+                       << " instead of " << expected;
+              failed = true;
+            }
+          }
+    }
+
+    if (exact_outputs == float_output.elements()) {
+      LOGERROR << descriptor << " was not quantized";
+      failed = true;
+    }
+
+    // Training and dequantized layers are not affected
+    net_status.SetIsTesting(false);
+    layer.FeedForward();
+    net_status.SetIsTesting(true);
+    Conv::Tensor training_output(outputs[0]->data, true);
+    layer.Dequantize();
+    layer.FeedForward();
+    for (unsigned int e = 0; e < float_output.elements(); e++) {
+      if (float_output[e] != training_output[e] || float_output[e] != outputs[0]->data[e]) {
+        LOGERROR << "Floating point output of " << descriptor << " changed at " << e;
+        failed = true;
+        break;
+      }
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <utility>
+#include <limits>
+#include <random>
+
+/*
+ * Compares the specialized max-pooling kernels of both pooling layers to a
+ * straightforward implementation. The widths include full SIMD blocks and
+ * remainders.
+ */
+int main() {
+  Conv::System::Init();
+
+  std::vector<std::pair<unsigned int, unsigned int>> region_sizes = {
+    {2, 2}, {3, 3}, {4, 4}, {3, 2}, {2, 1}, {17, 16}
+  };
+  const unsigned int SAMPLES = 2, MAPS = 3;
+
+  std::mt19937 rand(4711);
+  std::uniform_int_distribution<int> dist(-8, 8);
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  for (std::pair<unsigned int, unsigned int>& region_size : region_sizes) {
+    const unsigned int rw = region_size.first, rh = region_size.second;
+    for (unsigned int output_width = 1; output_width < 10; output_width += 4) {
+      const unsigned int output_height = 3;
+      // Small integers produce ties, the first maximum in row-major order wins
+      Conv::CombinedTensor input(SAMPLES, output_width * rw, output_height * rh, MAPS);
+      for (unsigned int e = 0; e < input.data.elements(); e++)
+        input.data.data_ptr()[e] = dist(rand);
+      input.delta.Clear(7.0);
+
+      Conv::MaxPoolingLayer pooling_layer(rw, rh);
+      Conv::Layer& layer = pooling_layer;
+      std::vector<Conv::CombinedTensor*> outputs;
+      if (!layer.CreateOutputs({&input}, outputs) || !layer.Connect({&input}, outputs, &net_status)) {
+        LOGERROR << "Cannot connect layer for " << rw << "x" << rh;
+        failed = true;
+        continue;
+      }
+      Conv::CombinedTensor* output = outputs[0];
+      for (unsigned int e = 0; e < output->delta.elements(); e++)
+        output->delta.data_ptr()[e] = dist(rand);
+
+      layer.FeedForward();
+      layer.BackPropagate();
+
+      for (unsigned int s = 0; s < SAMPLES; s++) {
+        for (unsigned int m = 0; m < MAPS; m++) {
+          for (unsigned int oy = 0; oy < output_height; oy++) {
+            for (unsigned int ox = 0; ox < output_width; ox++) {
+              Conv::datum maximum = std::numeric_limits<Conv::datum>::lowest();
+              unsigned int mx = 0, my = 0;
+              for (unsigned int y = oy * rh; y < (oy + 1) * rh; y++)
+                for (unsigned int x = ox * rw; x < (ox + 1) * rw; x++)
+                  if (*input.data.data_ptr(x, y, m, s) > maximum) {
+                    maximum = *input.data.data_ptr(x, y, m, s);
+                    mx = x; my = y;
+                  }
+
+              if (*output->data.data_ptr(ox, oy, m, s) != maximum) {
+                LOGERROR << "Wrong maximum for " << rw << "x" << rh;
+                failed = true;
+              }
+
+              for (unsigned int y = oy * rh; y < (oy + 1) * rh; y++)
+                for (unsigned int x = ox * rw; x < (ox + 1) * rw; x++) {
+                  const Conv::datum expected = (x == mx && y == my) ? *output->delta.data_ptr(ox, oy, m, s) : 0;
+                  if (*input.delta.data_ptr(x, y, m, s) != expected) {
+                    LOGERROR << "Wrong delta for " << rw << "x" << rh;
+                    failed = true;
+                  }
+                }
+            }
+          }
+        }
+      }
+
+      delete output;
+    }
+  }
+
+  // Overlapping and sparse regions of the advanced layer, given as
+  //  region width, height, stride width, height
+  std::vector<std::vector<unsigned int>> advanced_configurations = {
+    {3, 3, 2, 2}, {3, 3, 1, 1}, {2, 3, 3, 2}, {4, 4, 2, 2}, {2, 2, 2, 2}
+  };
+  for (std::vector<unsigned int>& configuration : advanced_configurations) {
+    const unsigned int rw = configuration[0], rh = configuration[1], sw = configuration[2], sh = configuration[3];
+    for (unsigned int input_width = 6; input_width < 20; input_width += 7) {
+      const unsigned int input_height = 7;
+      Conv::CombinedTensor input(SAMPLES, input_width, input_height, MAPS);
+      for (unsigned int e = 0; e < input.data.elements(); e++)
+        input.data.data_ptr()[e] = dist(rand);
+      input.delta.Clear(7.0);
+
+      Conv::AdvancedMaxPoolingLayer pooling_layer(rw, rh, sw, sh);
+      Conv::Layer& layer = pooling_layer;
+      std::vector<Conv::CombinedTensor*> outputs;
+      if (!layer.CreateOutputs({&input}, outputs) || !layer.Connect({&input}, outputs, &net_status)) {
+        LOGERROR << "Cannot connect advanced layer for " << rw << "x" << rh;
+        failed = true;
+        continue;
+      }
+      Conv::CombinedTensor* output = outputs[0];
+      for (unsigned int e = 0; e < output->delta.elements(); e++)
+        output->delta.data_ptr()[e] = dist(rand);
+
+      layer.FeedForward();
+      layer.BackPropagate();
+
+      Conv::Tensor expected_delta(SAMPLES, input_width, input_height, MAPS);
+      expected_delta.Clear();
+      for (unsigned int s = 0; s < SAMPLES; s++) {
+        for (unsigned int m = 0; m < MAPS; m++) {
+          for (unsigned int oy = 0; oy < output->data.height(); oy++) {
+            for (unsigned int ox = 0; ox < output->data.width(); ox++) {
+              Conv::datum maximum = std::numeric_limits<Conv::datum>::lowest();
+              unsigned int mx = 0, my = 0;
+              for (unsigned int y = oy * sh; y < oy * sh + rh; y++)
+                for (unsigned int x = ox * sw; x < ox * sw + rw; x++)
+                  if (*input.data.data_ptr(x, y, m, s) > maximum) {
+                    maximum = *input.data.data_ptr(x, y, m, s);
+                    mx = x; my = y;
+                  }
+
+              if (*output->data.data_ptr(ox, oy, m, s) != maximum) {
+                LOGERROR << "Wrong maximum for advanced " << rw << "x" << rh << " stride " << sw << "x" << sh;
+                failed = true;
+              }
+              *expected_delta.data_ptr(mx, my, m, s) += *output->delta.data_ptr(ox, oy, m, s);
+            }
+          }
+        }
+      }
+
+      for (unsigned int e = 0; e < expected_delta.elements(); e++) {
+        if (input.delta.data_ptr()[e] != expected_delta.data_ptr()[e]) {
+          LOGERROR << "Wrong delta for advanced " << rw << "x" << rh << " stride " << sw << "x" << sh;
+          failed = true;
+          break;
+        }
+      }
+
+      delete output;
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
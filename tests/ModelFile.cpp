@@ -0,0 +1,125 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <sstream>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstdint>
+
+const std::string net_config = "?convolutional kernels=4 size=3x3\n?tanh\n?convolutional kernels=(o) size=1x1\n?output\n";
+const std::string other_net_config = "?convolutional kernels=4 size=3x3\n?tanh\n?convolutional kernels=(o) size=3x3\n?output\n";
+const std::string dataset_config = "classes=3\nbackground\nhorizontal\nvertical\ncolors\n0xffffff\n0x0000ff\n0xff0000\n";
+
+struct Net {
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer;
+  Conv::NetGraphNode input_node;
+
+  Net(Conv::Factory& factory, Conv::Tensor& data_tensor) : input_layer(data_tensor), input_node(&input_layer) {
+    input_node.is_input = true;
+    graph.AddNode(&input_node);
+    if (!factory.AddLayers(graph, Conv::NetGraphConnection(&input_node), 3))
+      FATAL("Incomplete graph");
+    graph.Initialize();
+    graph.SetIsTesting(true);
+  }
+
+  Conv::Tensor& Output() {
+    graph.FeedForward();
+    return graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  }
+};
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  bool failed = false;
+  const std::string filename = "ModelFileTest.model";
+
+  Conv::Tensor image(1, 12, 8, 2);
+  for (unsigned int e = 0; e < image.elements(); e++)
+    image[e] = dist(rand);
+
+  std::istringstream trained_net_config(net_config), trained_dataset_config(dataset_config);
+  Conv::ConfigurableFactory trained_factory(trained_net_config, 1, false);
+  Net trained(trained_factory, image);
+  trained.graph.InitializeWeights();
+  Conv::Tensor expected_output(trained.Output(), true);
+
+  if (!Conv::ModelFile::Write(filename, trained_net_config, trained_dataset_config, trained.graph))
+    FATAL("Cannot write " << filename);
+  if (!Conv::ModelFile::IsModelFile(filename) || Conv::ModelFile::IsModelFile(filename + ".missing")) {
+    LOGERROR << "Model files are not recognized";
+    failed = true;
+  }
+
+  // Everything needed for inference comes from the one file
+  Conv::ModelFile model;
+  if (!model.Open(filename))
+    FATAL("Cannot open " << filename);
+  Conv::ConfigurableFactory factory(model.net_config(), 2, false);
+  Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration(model.dataset_config(), true);
+  if (dataset->GetClasses() != 3 || dataset->GetClassNames()[2].compare("vertical") != 0 ||
+      dataset->GetClassColors()[1] != 0x0000ff) {
+    LOGERROR << "Wrong class information";
+    failed = true;
+  }
+
+  Net loaded(factory, image);
+  if (!model.MapParameters(loaded.graph))
+    FATAL("Cannot map parameters");
+
+  std::vector<Conv::CombinedTensor*> parameters;
+  loaded.graph.GetParameters(parameters);
+  for (Conv::CombinedTensor* parameter : parameters) {
+    if (!parameter->data.IsShadow() || ((uintptr_t)parameter->data.data_ptr_const()) % 64 != 0) {
+      LOGERROR << "Parameters are not mapped from the file: " << parameter->data;
+      failed = true;
+    }
+  }
+
+  Conv::Tensor& output = loaded.Output();
+  for (unsigned int e = 0; e < expected_output.elements(); e++) {
+    if (output[e] != expected_output[e]) {
+      LOGERROR << "Output mismatch at element " << e << ": " << output[e] << " instead of " << expected_output[e];
+      failed = true;
+      break;
+    }
+  }
+
+  // A different net must not be loaded
+  std::istringstream other_config(other_net_config);
+  Conv::ConfigurableFactory other_factory(other_config, 3, false);
+  Net other(other_factory, image);
+  std::vector<Conv::CombinedTensor*> other_parameters;
+  other.graph.GetParameters(other_parameters);
+  std::vector<const Conv::datum*> other_memory;
+  for (Conv::CombinedTensor* parameter : other_parameters)
+    other_memory.push_back(parameter->data.data_ptr_const());
+  if (model.MapParameters(other.graph)) {
+    LOGERROR << "Parameters of a different net were mapped";
+    failed = true;
+  }
+
+  // Only the last layer differs, the others must not be mapped either
+  for (unsigned int p = 0; p < other_parameters.size(); p++) {
+    if (other_parameters[p]->data.data_ptr_const() != other_memory[p]) {
+      LOGERROR << "Parameter set " << p << " of a different net was mapped";
+      failed = true;
+    }
+  }
+
+  std::remove(filename.c_str());
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool Near(const Conv::datum a, const Conv::datum b) {
+  return std::fabs(a - b) <= 1e-4 * std::max((Conv::datum)1.0, std::fabs(a) + std::fabs(b));
+}
+
+// input -> resize -> conv -> batchnorm -> relu -> maxpooling -> tconv --.
+//                      '---------------------------------------- conv -- concat -> conv
+const std::vector<std::string> descriptors = {
+  "resize(border=2x2)", "convolution(size=3x3 kernels=4 seed=1)", "batchnorm", "relu",
+  "maxpooling(size=2x2)", "transposedconvolution(size=2x2 stride=2x2 kernels=3 seed=2)",
+  "convolution(size=1x1 kernels=2 seed=3)", "", "convolution(size=1x1 kernels=2 seed=4)"
+};
+const std::vector<std::vector<unsigned int>> sources = {{}, {0}, {1}, {2}, {3}, {4}, {1}, {5, 6}, {7}};
+
+struct Net {
+  Conv::NetGraph graph;
+  Conv::InputLayer* input_layer;
+  std::vector<Conv::NetGraphNode*> nodes;
+
+  explicit Net(Conv::Tensor& data_tensor) {
+    input_layer = new Conv::InputLayer(data_tensor);
+    Conv::NetGraphNode* input_node = new Conv::NetGraphNode(input_layer);
+    input_node->is_input = true;
+    graph.AddNode(input_node);
+    for (unsigned int n = 0; n < descriptors.size(); n++) {
+      Conv::Layer* layer = descriptors[n].length() > 0 ? Conv::LayerFactory::ConstructLayer(descriptors[n]) : new Conv::ConcatenationLayer();
+      Conv::NetGraphNode* node = new Conv::NetGraphNode(layer);
+      if (sources[n].size() == 0)
+        node->input_connections.push_back(Conv::NetGraphConnection(input_node));
+      for (unsigned int source : sources[n])
+        node->input_connections.push_back(Conv::NetGraphConnection(nodes[source]));
+      nodes.push_back(node);
+    }
+    nodes.back()->is_output = true;
+    for (Conv::NetGraphNode* node : nodes)
+      graph.AddNode(node);
+    graph.Initialize();
+  }
+};
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  bool failed = false;
+
+  // A Tensor keeps its memory when it shrinks
+  Conv::Tensor tensor(2, 8, 6, 3);
+  const Conv::datum* const memory = tensor.data_ptr_const();
+  tensor.Resize(1, 5, 7, 3);
+  tensor.Resize(2, 8, 3, 6);
+  if (tensor.data_ptr_const() != memory || tensor.elements() != 2 * 8 * 3 * 6) {
+    LOGERROR << "Tensor did not keep its memory";
+    failed = true;
+  }
+
+  Conv::Tensor data_tensor(2, 10, 8, 3);
+  Net net(data_tensor);
+  std::vector<Conv::CombinedTensor*> parameters;
+  net.graph.GetParameters(parameters);
+  for (Conv::CombinedTensor* parameter : parameters) {
+    for (unsigned int e = 0; e < parameter->data.elements(); e++)
+      parameter->data.data_ptr()[e] = dist(rand);
+  }
+
+  // Each size is compared to a net built for it from scratch
+  const std::vector<std::vector<unsigned int>> sizes = {{6, 12, 3}, {16, 14, 1}, {4, 4, 2}, {10, 8, 2}};
+  for (const std::vector<unsigned int>& size : sizes) {
+    const unsigned int width = size[0], height = size[1], samples = size[2];
+    if (!net.graph.Reshape(width, height, samples)) {
+      LOGERROR << "Cannot reshape to " << samples << "s@" << width << "x" << height;
+      failed = true;
+      break;
+    }
+
+    std::vector<Conv::CombinedTensor*> reshaped_parameters;
+    net.graph.GetParameters(reshaped_parameters);
+    if (reshaped_parameters != parameters) {
+      LOGERROR << "Parameters changed during the reshape";
+      failed = true;
+    }
+
+    if (data_tensor.width() != width || data_tensor.height() != height || data_tensor.samples() != samples) {
+      LOGERROR << "Wrong input size: " << data_tensor;
+      failed = true;
+      break;
+    }
+    for (unsigned int e = 0; e < data_tensor.elements(); e++)
+      data_tensor.data_ptr()[e] = dist(rand);
+
+    Conv::Tensor reference_data_tensor(data_tensor, true);
+    Net reference(reference_data_tensor);
+    std::vector<Conv::CombinedTensor*> reference_parameters;
+    reference.graph.GetParameters(reference_parameters);
+    for (unsigned int p = 0; p < parameters.size(); p++) {
+      const Conv::Tensor& source = parameters[p]->data;
+      std::copy(source.data_ptr_const(), source.data_ptr_const() + source.elements(), reference_parameters[p]->data.data_ptr());
+    }
+
+    // The inputs still write into the concatenation
+    if (net.nodes[7]->inputs_in_place != reference.nodes[7]->inputs_in_place || net.nodes[7]->inputs_in_place == 0) {
+      LOGERROR << net.nodes[7]->inputs_in_place << " inputs write into the concatenation instead of " << reference.nodes[7]->inputs_in_place;
+      failed = true;
+    }
+
+    net.graph.FeedForward();
+    reference.graph.FeedForward();
+
+    Conv::CombinedTensor* output = net.graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor;
+    Conv::CombinedTensor* reference_output = reference.graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor;
+    if (output->data.width() != width || output->data.height() != height || output->data.samples() != samples) {
+      LOGERROR << "Wrong output size: " << output->data;
+      failed = true;
+      break;
+    }
+    for (unsigned int e = 0; e < output->data.elements(); e++) {
+      const Conv::datum delta = dist(rand);
+      output->delta.data_ptr()[e] = delta;
+      reference_output->delta.data_ptr()[e] = delta;
+      if (!Near(output->data.data_ptr_const()[e], reference_output->data.data_ptr_const()[e])) {
+        LOGERROR << "Wrong output at " << e << " for " << output->data;
+        failed = true;
+        break;
+      }
+    }
+
+    net.graph.BackPropagate();
+    reference.graph.BackPropagate();
+    for (unsigned int p = 0; p < parameters.size(); p++) {
+      const Conv::Tensor& gradient = parameters[p]->delta;
+      const Conv::Tensor& reference_gradient = reference_parameters[p]->delta;
+      for (unsigned int e = 0; e < gradient.elements(); e++) {
+        if (!Near(gradient.data_ptr_const()[e], reference_gradient.data_ptr_const()[e])) {
+          LOGERROR << "Wrong gradient of parameter set " << p << " at " << e << " for " << output->data;
+          failed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <sstream>
+#include <algorithm>
+
+void WriteImage(std::ostream& stream, Conv::Tensor& image, unsigned int width, unsigned int height, std::mt19937& rand) {
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  image.Resize(1, width, height, 2);
+  Conv::Tensor label(1, width, height, 3);
+  label.Clear();
+  for (unsigned int e = 0; e < image.elements(); e++)
+    image.data_ptr()[e] = dist(rand);
+  for (unsigned int y = 0; y < height; y++)
+    for (unsigned int x = 0; x < width; x++)
+      *label.data_ptr(x, y, rand() % 3, 0) = 1.0;
+  image.Serialize(stream);
+  label.Serialize(stream);
+}
+
+bool SameSample(const std::vector<Conv::Tensor*>& a, const std::vector<Conv::Tensor*>& b, unsigned int sample_a, unsigned int sample_b) {
+  for (unsigned int t = 0; t < a.size(); t++) {
+    const unsigned int elements = a[t]->elements() / a[t]->samples();
+    if (!std::equal(a[t]->data_ptr_const(0, 0, 0, sample_a), a[t]->data_ptr_const(0, 0, 0, sample_a) + elements,
+                    b[t]->data_ptr_const(0, 0, 0, sample_b)))
+      return false;
+  }
+  return true;
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  bool failed = false;
+
+  // Images of different sizes, with an image too small for any patch
+  std::stringstream training_stream, testing_stream;
+  Conv::Tensor images[6];
+  WriteImage(training_stream, images[0], 9, 7, rand);
+  WriteImage(training_stream, images[1], 4, 4, rand);
+  WriteImage(training_stream, images[2], 5, 3, rand);
+  WriteImage(training_stream, images[3], 12, 6, rand);
+  WriteImage(testing_stream, images[4], 6, 8, rand);
+  WriteImage(testing_stream, images[5], 7, 5, rand);
+
+  const unsigned int PATCH = 4;
+  Conv::TensorStreamPatchDataset dataset(training_stream, testing_stream, 3, {"a", "b", "c"},
+    {0xFF0000, 0x00FF00, 0x0000FF}, {1.0, 2.0, 3.0}, PATCH, PATCH);
+
+  if (dataset.GetTrainingSamples() != 6 * 4 + 1 + 0 + 9 * 3 || dataset.GetTestingSamples() != 3 * 5 + 4 * 2) {
+    LOGERROR << "Wrong sample counts: " << dataset.GetTrainingSamples() << ", " << dataset.GetTestingSamples();
+    failed = true;
+  }
+
+  for (bool testing : {false, true}) {
+    const unsigned int samples = testing ? dataset.GetTestingSamples() : dataset.GetTrainingSamples();
+    const unsigned int BATCH = 64;
+    Conv::Tensor data(BATCH, PATCH, PATCH, 2), label(BATCH, 1, 1, 3), helper(BATCH, 1, 1, 2), weight(BATCH, 1, 1, 1);
+    Conv::Tensor single_data(1, PATCH, PATCH, 2), single_label(1, 1, 1, 3), single_helper(1, 1, 1, 2), single_weight(1, 1, 1, 1);
+    std::vector<Conv::Tensor*> batch_tensors = {&data, &label, &helper, &weight};
+    std::vector<Conv::Tensor*> single_tensors = {&single_data, &single_label, &single_helper, &single_weight};
+
+    // Random indices with repetitions, covering every source image
+    std::vector<unsigned int> indices;
+    for (unsigned int sample = 0; sample < BATCH; sample++)
+      indices.push_back(sample < samples ? sample : rand() % samples);
+    std::shuffle(indices.begin(), indices.end(), rand);
+
+    if (!dataset.GetSampleBatch(data, label, helper, weight, indices, testing)) {
+      LOGERROR << "Cannot load batch";
+      failed = true;
+      continue;
+    }
+    for (unsigned int sample = 0; sample < BATCH; sample++) {
+      bool success = testing ?
+        dataset.GetTestingSample(single_data, single_label, single_helper, single_weight, 0, indices[sample]) :
+        dataset.GetTrainingSample(single_data, single_label, single_helper, single_weight, 0, indices[sample]);
+      if (!success || !SameSample(batch_tensors, single_tensors, sample, 0)) {
+        LOGERROR << "Batch differs from single " << (testing ? "testing" : "training") << " sample " << indices[sample];
+        failed = true;
+      }
+    }
+
+    // The first patch of a set is the top left patch of its first image
+    const std::vector<unsigned int> first = {0};
+    const std::vector<unsigned int> out_of_range = {0, samples};
+    const Conv::Tensor& first_image = images[testing ? 4 : 0];
+    bool first_correct = dataset.GetSampleBatch(data, label, helper, weight, first, testing);
+    for (unsigned int map = 0; map < 2; map++)
+      for (unsigned int y = 0; y < PATCH; y++)
+        for (unsigned int x = 0; x < PATCH; x++)
+          first_correct &= *data.data_ptr_const(x, y, map, 0) == *first_image.data_ptr_const(x, y, map, 0);
+    if (!first_correct) {
+      LOGERROR << "Wrong first " << (testing ? "testing" : "training") << " patch";
+      failed = true;
+    }
+    if (dataset.GetSampleBatch(data, label, helper, weight, out_of_range, testing)) {
+      LOGERROR << "Loaded a sample out of range";
+      failed = true;
+    }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+std::vector<Conv::datum> loss_weights;
+
+void WriteLossDeltas(const std::vector<Conv::CombinedTensor*>& outputs) {
+  for (unsigned int e = 0; e < outputs[0]->delta.elements(); e++)
+    outputs[0]->delta.data_ptr()[e] = loss_weights[e];
+}
+
+Conv::datum CalculateLoss(Conv::Layer* layer, const std::vector<Conv::CombinedTensor*>& outputs) {
+  UNREFERENCED_PARAMETER(layer);
+  double loss = 0;
+  for (unsigned int e = 0; e < outputs[0]->data.elements(); e++)
+    loss += loss_weights[e] * outputs[0]->data.data_ptr_const()[e];
+  return (Conv::datum)loss;
+}
+
+bool Near(const Conv::datum a, const Conv::datum b) {
+  return std::fabs(a - b) <= 1e-5 * std::max((Conv::datum)1.0, std::fabs(a) + std::fabs(b));
+}
+
+const char* net_config =
+  "?convolutional size=3x3 kernels=4\n"
+  "?relu\n"
+  "?maxpooling size=2x2\n"
+  "?convolutional size=3x3 kernels=5\n"
+  "?relu\n"
+  "?amaxpooling size=3x3 stride=2x2\n"
+  "?fullyconnected neurons=6\n"
+  "?tanh\n"
+  "?fullyconnected neurons=(o)\n"
+  "?output\n"
+  "method=patch\n";
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  // Gradients of the layers on their own
+  Conv::CombinedTensor input(2, 7, 6, 3);
+  for (unsigned int e = 0; e < input.data.elements(); e++)
+    input.data.data_ptr()[e] = dist(rand);
+  Conv::ShiftLayer shift_layer(2, 3);
+  Conv::StitchLayer stitch_layer(2, 3);
+  for (Conv::Layer* layer : std::vector<Conv::Layer*>{&shift_layer, &stitch_layer}) {
+    std::vector<Conv::CombinedTensor*> outputs;
+    Conv::CombinedTensor* layer_input = layer == &shift_layer ? &input : new Conv::CombinedTensor(6, 4, 5, 3);
+    if (layer_input != &input) {
+      for (unsigned int e = 0; e < layer_input->data.elements(); e++)
+        layer_input->data.data_ptr()[e] = dist(rand);
+    }
+    if (!layer->CreateOutputs({layer_input}, outputs) || !layer->Connect({layer_input}, outputs, &net_status))
+      FATAL("Cannot connect " << layer->GetLayerDescription());
+    loss_weights.resize(outputs[0]->data.elements());
+    for (Conv::datum& weight : loss_weights)
+      weight = dist(rand);
+    layer->SetBackpropagationEnabled(true);
+    if (!Conv::GradientTester::DoGradientTest(layer, layer_input->data, layer_input->delta, outputs, 0.005, WriteLossDeltas, CalculateLoss)) {
+      LOGERROR << "Gradient test failed for " << layer->GetLayerDescription();
+      failed = true;
+    }
+  }
+
+  // Dense predictions of a patch-trained net
+  const unsigned int CLASSES = 3, WIDTH = 8, HEIGHT = 12, MAPS = 2;
+  std::istringstream patch_config(net_config), dense_config(net_config);
+  Conv::ConfigurableFactory patch_factory(patch_config, 1, true);
+  Conv::ConfigurableFactory dense_factory(dense_config, 1, false);
+  const unsigned int patch_x = patch_factory.patchsizex(), patch_y = patch_factory.patchsizey();
+
+  Conv::Tensor image(1, WIDTH, HEIGHT, MAPS);
+  for (unsigned int e = 0; e < image.elements(); e++)
+    image.data_ptr()[e] = dist(rand);
+
+  // Patches centered on every pixel, the net sees zeros outside
+  Conv::Tensor patches(WIDTH * HEIGHT, patch_x, patch_y, MAPS);
+  patches.Clear();
+  for (unsigned int py = 0; py < HEIGHT; py++)
+    for (unsigned int px = 0; px < WIDTH; px++)
+      for (unsigned int map = 0; map < MAPS; map++)
+        for (unsigned int y = 0; y < patch_y; y++)
+          for (unsigned int x = 0; x < patch_x; x++) {
+            const int image_x = (int)(px + x) - (int)(patch_x / 2), image_y = (int)(py + y) - (int)(patch_y / 2);
+            if (image_x >= 0 && image_y >= 0 && image_x < (int)WIDTH && image_y < (int)HEIGHT)
+              *patches.data_ptr(x, y, map, py * WIDTH + px) = *image.data_ptr_const(image_x, image_y, map, 0);
+          }
+
+  Conv::NetGraph patch_graph, dense_graph;
+  Conv::InputLayer patch_input_layer(patches), dense_input_layer(image);
+  Conv::NetGraphNode patch_input_node(&patch_input_layer), dense_input_node(&dense_input_layer);
+  patch_input_node.is_input = true;
+  dense_input_node.is_input = true;
+  patch_graph.AddNode(&patch_input_node);
+  dense_graph.AddNode(&dense_input_node);
+  if (!patch_factory.AddLayers(patch_graph, Conv::NetGraphConnection(&patch_input_node), CLASSES) ||
+      !dense_factory.AddLayers(dense_graph, Conv::NetGraphConnection(&dense_input_node), CLASSES))
+    FATAL("Incomplete graph");
+  patch_graph.Initialize();
+  dense_graph.Initialize();
+  patch_graph.InitializeWeights();
+
+  unsigned int shift_layers = 0, stitch_layers = 0;
+  for (Conv::NetGraphNode* node : dense_graph.GetNodes()) {
+    shift_layers += dynamic_cast<Conv::ShiftLayer*>(node->layer) != nullptr;
+    stitch_layers += dynamic_cast<Conv::StitchLayer*>(node->layer) != nullptr;
+  }
+  if (shift_layers != 2 || stitch_layers != 2) {
+    LOGERROR << "Expected two shifts and stitches, got " << shift_layers << " and " << stitch_layers;
+    failed = true;
+  }
+
+  std::vector<Conv::CombinedTensor*> patch_parameters, dense_parameters;
+  patch_graph.GetParameters(patch_parameters);
+  dense_graph.GetParameters(dense_parameters);
+  if (patch_parameters.size() != dense_parameters.size())
+    FATAL("Parameter count differs");
+  for (unsigned int p = 0; p < patch_parameters.size(); p++) {
+    const Conv::Tensor& source = patch_parameters[p]->data;
+    std::copy(source.data_ptr_const(), source.data_ptr_const() + source.elements(), dense_parameters[p]->data.data_ptr());
+  }
+
+  patch_graph.SetIsTesting(true);
+  dense_graph.SetIsTesting(true);
+  patch_graph.FeedForward();
+  dense_graph.FeedForward();
+
+  const Conv::Tensor& patch_output = patch_graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  const Conv::Tensor& dense_output = dense_graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  if (dense_output.width() != WIDTH || dense_output.height() != HEIGHT || dense_output.maps() != CLASSES) {
+    LOGERROR << "Wrong dense output size: " << dense_output;
+    failed = true;
+  } else {
+    for (unsigned int y = 0; y < HEIGHT && !failed; y++)
+      for (unsigned int x = 0; x < WIDTH && !failed; x++)
+        for (unsigned int c = 0; c < CLASSES; c++) {
+          const Conv::datum expected = *patch_output.data_ptr_const(0, 0, c, y * WIDTH + x);
+          const Conv::datum actual = *dense_output.data_ptr_const(x, y, c, 0);
+          if (!Near(expected, actual)) {
+            LOGERROR << "Dense output at (" << x << "," << y << "), class " << c << ": " << actual << " instead of " << expected;
+            failed = true;
+            break;
+          }
+        }
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
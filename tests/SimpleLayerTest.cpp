@@ -24,12 +24,26 @@ std::vector<std::pair<std::string, unsigned int>> test_layers_and_runs = {
   {"amaxpooling(size=3x3)",1},
   {"amaxpooling(size=3x2)",1},
   {"amaxpooling(size=3x3 stride=2x2)",1},
+  {"avgpooling(size=3x3)",1},
+  {"avgpooling(size=3x2)",1},
+  {"avgpooling(size=2x2)",1},
+  {"avgpooling(size=3x3 stride=2x2)",1},
+  {"avgpooling(size=2x2 stride=3x3)",1},
+  {"globalavgpooling",1},
   {"convolution(size=3x3 kernels=3)",RANDOM_RUNS},
   {"convolution(size=3x3 stride=2x2 kernels=3)",RANDOM_RUNS},
   {"convolution(size=3x3 group=3 kernels=9)",RANDOM_RUNS},
+  {"transposedconvolution(size=3x3 kernels=3)",RANDOM_RUNS},
+  {"transposedconvolution(size=3x3 stride=2x2 pad=1x1 kernels=2)",RANDOM_RUNS},
+  {"transposedconvolution(size=4x4 stride=2x2 pad=1x1 kernels=3 init=bilinear)",1},
+  {"lrn(size=3 alpha=0.5 beta=0.75 method=across)",1},
+  {"lrn(size=2 alpha=0.5 beta=0.6 method=across)",1},
+  {"lrn(size=3 alpha=0.5 beta=0.75 method=within)",1},
+  {"lrn(size=4 alpha=0.5 beta=0.6 method=within)",1},
   {"hmax(mu=0.1 weight=0.0)",1},
   {"hmax(mu=0.1 weight=0.2)",1},
   {"tanh",1},{"sigm",1},{"relu",1},
+  {"tanh(mode=fast)",1},{"sigm(mode=fast)",1},
   {"gradientaccumulation(outputs=2)",1},
   {"resize(border=2x2)",1}
 };
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool Near(const Conv::datum a, const Conv::datum b) {
+  return std::fabs(a - b) <= 1e-5 * std::max((Conv::datum)1.0, std::fabs(a) + std::fabs(b));
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 rand(2016);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+  Conv::NetStatus net_status;
+  bool failed = false;
+
+  // Views of a range of maps keep the sample stride of their Tensor
+  Conv::Tensor tensor(3, 4, 2, 5);
+  for (unsigned int e = 0; e < tensor.elements(); e++)
+    tensor.data_ptr()[e] = (Conv::datum)e;
+  Conv::Tensor view;
+  if (!view.View(tensor, 1, 3) || view.IsContiguous() || view.elements() != 3 * 4 * 2 * 3 ||
+      view.data_ptr(2, 1, 1, 2) != tensor.data_ptr(2, 1, 2, 2)) {
+    LOGERROR << "Wrong view";
+    failed = true;
+  }
+  Conv::Tensor copy(view, true);
+  view.Clear(-1.0);
+  for (unsigned int s = 0; s < tensor.samples(); s++) {
+    for (unsigned int m = 0; m < tensor.maps(); m++) {
+      const bool in_view = m >= 1 && m < 4;
+      if (*tensor.data_ptr_const(3, 1, m, s) != (in_view ? -1.0 : (Conv::datum)tensor.Offset(3, 1, m, s)) ||
+          (in_view && *copy.data_ptr_const(3, 1, m - 1, s) != (Conv::datum)tensor.Offset(3, 1, m, s))) {
+        LOGERROR << "Wrong view contents in sample " << s << ", map " << m;
+        failed = true;
+      }
+    }
+  }
+
+  Conv::Tensor data_tensor(2, 10, 8, 3);
+  for (unsigned int e = 0; e < data_tensor.elements(); e++)
+    data_tensor.data_ptr()[e] = dist(rand);
+
+  // input -> conv ----------.
+  // input -> conv ---------- concat -> conv
+  // input -> conv -> relu --'
+  const std::vector<std::string> descriptors = {
+    "convolution(size=3x3 kernels=4 seed=1)", "convolution(size=3x3 kernels=2 seed=2)",
+    "convolution(size=3x3 kernels=3 seed=3)", "relu", "", "convolution(size=1x1 kernels=2 seed=4)"
+  };
+
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer(data_tensor);
+  Conv::NetGraphNode input_node(&input_layer);
+  input_node.is_input = true;
+  graph.AddNode(&input_node);
+
+  std::vector<Conv::NetGraphNode*> nodes;
+  for (unsigned int n = 0; n < 3; n++)
+    nodes.push_back(new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[n]), Conv::NetGraphConnection(&input_node)));
+  nodes.push_back(new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[3]), Conv::NetGraphConnection(nodes[2])));
+  Conv::ConcatenationLayer* concatenation_layer = new Conv::ConcatenationLayer();
+  Conv::NetGraphNode* concatenation_node = new Conv::NetGraphNode(concatenation_layer, Conv::NetGraphConnection(nodes[0]));
+  concatenation_node->input_connections.push_back(Conv::NetGraphConnection(nodes[1]));
+  concatenation_node->input_connections.push_back(Conv::NetGraphConnection(nodes[3]));
+  nodes.push_back(concatenation_node);
+  nodes.push_back(new Conv::NetGraphNode(Conv::LayerFactory::ConstructLayer(descriptors[5]), Conv::NetGraphConnection(concatenation_node)));
+  nodes.back()->is_output = true;
+  for (Conv::NetGraphNode* node : nodes)
+    graph.AddNode(node);
+
+  graph.Initialize();
+  graph.InitializeWeights();
+
+  // The convolutions write into the output, but ReLU needs contiguous
+  //  samples
+  if (concatenation_node->inputs_in_place != 2 || !concatenation_layer->IsInputInPlace(0) ||
+      !concatenation_layer->IsInputInPlace(1) || concatenation_layer->IsInputInPlace(2)) {
+    LOGERROR << "Expected the two convolutions to write into the concatenation, got " << concatenation_node->inputs_in_place;
+    failed = true;
+  }
+
+  // Build the same net from separate layers
+  std::vector<Conv::Layer*> layers;
+  std::vector<Conv::CombinedTensor*> tensors;
+  Conv::CombinedTensor input(data_tensor.samples(), data_tensor.width(), data_tensor.height(), data_tensor.maps());
+  std::copy(data_tensor.data_ptr(), data_tensor.data_ptr() + data_tensor.elements(), input.data.data_ptr());
+  const std::vector<std::vector<int>> sources = {{-1}, {-1}, {-1}, {2}, {0, 1, 3}, {4}};
+  for (unsigned int n = 0; n < nodes.size(); n++) {
+    Conv::Layer* layer = n == 4 ? new Conv::ConcatenationLayer() : Conv::LayerFactory::ConstructLayer(descriptors[n]);
+    std::vector<Conv::CombinedTensor*> inputs, outputs;
+    for (int source : sources[n])
+      inputs.push_back(source < 0 ? &input : tensors[source]);
+    if (!layer->CreateOutputs(inputs, outputs) || !layer->Connect(inputs, outputs, &net_status))
+      FATAL("Cannot connect reference layer " << n);
+    for (unsigned int p = 0; p < layer->parameters().size(); p++) {
+      const Conv::Tensor& source = nodes[n]->layer->parameters()[p]->data;
+      std::copy(source.data_ptr_const(), source.data_ptr_const() + source.elements(), layer->parameters()[p]->data.data_ptr());
+    }
+    layers.push_back(layer);
+    tensors.push_back(outputs[0]);
+  }
+
+  graph.FeedForward();
+  for (Conv::Layer* layer : layers)
+    layer->FeedForward();
+
+  Conv::CombinedTensor* graph_output = nodes.back()->output_buffers[0].combined_tensor;
+  for (unsigned int e = 0; e < graph_output->data.elements(); e++) {
+    const Conv::datum delta = dist(rand);
+    graph_output->delta.data_ptr()[e] = delta;
+    tensors.back()->delta.data_ptr()[e] = delta;
+    if (!Near(graph_output->data.data_ptr_const()[e], tensors.back()->data.data_ptr_const()[e])) {
+      LOGERROR << "Wrong output at " << e;
+      failed = true;
+      break;
+    }
+  }
+
+  graph.BackPropagate();
+  for (unsigned int n = 0; n < 3; n++)
+    layers[n]->SetBackpropagationEnabled(false);
+  for (unsigned int n = layers.size(); n > 0; n--)
+    layers[n - 1]->BackPropagate();
+
+  for (unsigned int n = 0; n < nodes.size(); n++) {
+    for (unsigned int p = 0; p < layers[n]->parameters().size(); p++) {
+      const Conv::Tensor& gradient = nodes[n]->layer->parameters()[p]->delta;
+      const Conv::Tensor& reference = layers[n]->parameters()[p]->delta;
+      for (unsigned int e = 0; e < gradient.elements(); e++) {
+        if (!Near(gradient.data_ptr_const()[e], reference.data_ptr_const()[e])) {
+          LOGERROR << "Wrong gradient for node " << n << " at " << e;
+          failed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // Inputs of different sizes are rejected
+  Conv::ConcatenationLayer mismatched_layer;
+  Conv::CombinedTensor small_input(data_tensor.samples(), data_tensor.width() - 1, data_tensor.height(), 1);
+  std::vector<Conv::CombinedTensor*> mismatched_outputs;
+  if (mismatched_layer.CreateOutputs({&input, &small_input}, mismatched_outputs)) {
+    LOGERROR << "Concatenation accepted inputs of different sizes";
+    failed = true;
+  }
+  Conv::CombinedTensor concatenated(data_tensor.samples(), data_tensor.width(), data_tensor.height(), data_tensor.maps() + 1);
+  if (mismatched_layer.Connect({&input, &small_input}, {&concatenated}, &net_status)) {
+    LOGERROR << "Concatenation connected inputs of different sizes";
+    failed = true;
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file classifyClient.cpp
+ * @brief Application that sends images to classifyServer and saves the
+ *   replies.
+ *
+ * Every image is sent over its own connection at the same time, so the
+ * server can segment them in one batch. Colorized replies are saved as
+ * they are, label maps are saved as a Tensor of class indices.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#ifdef BUILD_POSIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include <cn24.h>
+
+#ifdef BUILD_POSIX
+const uint32_t REQUEST_MAGIC = 0x34324E43; // "CN24" on little-endian hosts
+const uint32_t REPLY_LABELS = 0;
+const uint32_t REPLY_PNG = 1;
+const uint32_t STATUS_OK = 0;
+
+bool ReadFully (int fd, void* buffer, std::size_t bytes) {
+  char* target = (char*)buffer;
+  while (bytes > 0) {
+    const ssize_t bytes_read = read (fd, target, bytes);
+    if (bytes_read <= 0)
+      return false;
+    target += bytes_read;
+    bytes -= bytes_read;
+  }
+  return true;
+}
+
+bool WriteFully (int fd, const void* buffer, std::size_t bytes) {
+  const char* source = (const char*)buffer;
+  while (bytes > 0) {
+    const ssize_t bytes_written = write (fd, source, bytes);
+    if (bytes_written <= 0)
+      return false;
+    source += bytes_written;
+    bytes -= bytes_written;
+  }
+  return true;
+}
+
+int ConnectSocket (const std::string& address) {
+  int fd = -1;
+  const std::size_t colon = address.rfind (':');
+  if (colon != std::string::npos) {
+    // host:port
+    const std::string host = address.substr (0, colon), port = address.substr (colon + 1);
+    addrinfo hints;
+    std::memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo (host.length() > 0 ? host.c_str() : "localhost", port.c_str(), &hints, &addresses) != 0)
+      return -1;
+
+    for (addrinfo* candidate = addresses; candidate != nullptr; candidate = candidate->ai_next) {
+      fd = socket (candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+      if (fd < 0)
+        continue;
+      if (connect (fd, candidate->ai_addr, candidate->ai_addrlen) == 0)
+        break;
+      close (fd);
+      fd = -1;
+    }
+    freeaddrinfo (addresses);
+  } else {
+    // Path of a Unix domain socket
+    sockaddr_un socket_address;
+    std::memset (&socket_address, 0, sizeof (socket_address));
+    if (address.length() >= sizeof (socket_address.sun_path))
+      return -1;
+    socket_address.sun_family = AF_UNIX;
+    std::strcpy (socket_address.sun_path, address.c_str());
+
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect (fd, (sockaddr*)&socket_address, sizeof (socket_address)) != 0) {
+      close (fd);
+      fd = -1;
+    }
+  }
+  return fd;
+}
+
+bool Classify (const std::string& address, uint32_t mode, const std::string& input_image_fname,
+               const std::string& output_fname) {
+  Conv::Tensor image;
+  if (!Conv::ImageUtil::LoadFromFile (input_image_fname, image)) {
+    LOGERROR << "Cannot load " << input_image_fname;
+    return false;
+  }
+
+  const uint32_t header[5] = {REQUEST_MAGIC, mode, (uint32_t)image.width(), (uint32_t)image.height(), (uint32_t)image.maps()};
+  std::vector<unsigned char> pixels (image.elements());
+  for (std::size_t e = 0; e < image.elements(); e++)
+    pixels[e] = (unsigned char)std::lround (255.0 * image.data_ptr_const()[e]);
+
+  const int fd = ConnectSocket (address);
+  if (fd < 0) {
+    LOGERROR << "Cannot connect to " << address;
+    return false;
+  }
+
+  uint32_t reply_header[4];
+  if (!WriteFully (fd, header, sizeof (header)) || !WriteFully (fd, &pixels[0], pixels.size()) ||
+      !ReadFully (fd, reply_header, sizeof (reply_header))) {
+    LOGERROR << "Connection to " << address << " failed";
+    close (fd);
+    return false;
+  }
+
+  std::string reply (reply_header[3], '\0');
+  const bool complete = reply.length() == 0 || ReadFully (fd, &reply[0], reply.length());
+  close (fd);
+  if (!complete) {
+    LOGERROR << "Connection to " << address << " failed";
+    return false;
+  }
+
+  if (reply_header[0] != STATUS_OK) {
+    LOGERROR << input_image_fname << ": " << reply;
+    return false;
+  }
+
+  std::ofstream output_file (output_fname, std::ios::out | std::ios::binary);
+  if (mode == REPLY_PNG) {
+    output_file.write (reply.data(), reply.length());
+  } else {
+    const unsigned int width = reply_header[1], height = reply_header[2];
+    if (reply.length() != (std::size_t)width * height * sizeof (uint16_t)) {
+      LOGERROR << "Reply for " << input_image_fname << " has the wrong size";
+      return false;
+    }
+    Conv::Tensor labels (1, width, height, 1);
+    for (std::size_t e = 0; e < labels.elements(); e++) {
+      uint16_t label;
+      std::memcpy (&label, reply.data() + e * sizeof (uint16_t), sizeof (uint16_t));
+      labels[e] = (Conv::datum)label;
+    }
+    labels.Serialize (output_file);
+  }
+
+  if (!output_file.good()) {
+    LOGERROR << "Cannot write " << output_fname;
+    return false;
+  }
+
+  LOGINFO << input_image_fname << " -> " << output_fname;
+  return true;
+}
+#endif
+
+int main (int argc, char* argv[]) {
+  if (argc < 5 || (argc % 2) != 1) {
+    LOGERROR << "USAGE: " << argv[0] << " <socket path or [host]:port> <labels|png> <input image file> <output file> [<input image file> <output file> ...]";
+    LOGEND;
+    return -1;
+  }
+
+#ifdef BUILD_POSIX
+  const std::string address (argv[1]);
+  const std::string mode_name (argv[2]);
+  if (mode_name.compare ("labels") != 0 && mode_name.compare ("png") != 0) {
+    LOGERROR << "Unknown reply mode: " << mode_name;
+    LOGEND;
+    return -1;
+  }
+  const uint32_t mode = mode_name.compare ("png") == 0 ? REPLY_PNG : REPLY_LABELS;
+
+  // Initialize CN24
+  Conv::System::Init();
+
+  const unsigned int images = (argc - 3) / 2;
+  std::vector<std::thread> requests;
+  std::vector<char> success (images, 0);
+  for (unsigned int i = 0; i < images; i++) {
+    const std::string input_image_fname (argv[3 + 2 * i]), output_fname (argv[4 + 2 * i]);
+    requests.push_back (std::thread ([&success, address, mode, input_image_fname, output_fname, i] {
+      success[i] = Classify (address, mode, input_image_fname, output_fname);
+    }));
+  }
+  for (std::thread& request : requests)
+    request.join();
+
+  const bool failed = std::find (success.begin(), success.end(), 0) != success.end();
+  LOGEND;
+  return failed ? -1 : 0;
+#else
+  UNREFERENCED_PARAMETER (argv);
+  FATAL ("The client needs POSIX sockets!");
+  return -1;
+#endif
+}
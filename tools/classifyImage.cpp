@@ -15,12 +15,18 @@
 #include <fstream>
 #include <cstring>
 #include <sstream>
+#include <cstdlib>
+#include <algorithm>
 
 #include <cn24.h>
 
+void ClassifyTiled (Conv::ConfigurableFactory* factory, Conv::Dataset* dataset, std::istream& param_tensor_file,
+                    const std::string& input_image_fname, const std::string& output_image_fname,
+                    unsigned int tile_size, unsigned int tiles_per_batch);
+
 int main (int argc, char* argv[]) {
   if (argc < 6) {
-    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <input image file> <output image file>";
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <input image file> <output image file> [tile size] [tiles per batch]";
     LOGEND;
     return -1;
   }
@@ -31,6 +37,13 @@ int main (int argc, char* argv[]) {
   std::string param_tensor_fname (argv[3]);
   std::string net_config_fname (argv[2]);
   std::string dataset_config_fname (argv[1]);
+
+  // Large images can be segmented in tiles to bound the memory usage
+  unsigned int tile_size = 0, tiles_per_batch = 1;
+  if (argc > 6)
+    tile_size = std::atoi (argv[6]);
+  if (argc > 7)
+    tiles_per_batch = std::max (1, std::atoi (argv[7]));
   
   // Initialize CN24
   Conv::System::Init();
@@ -55,15 +68,23 @@ int main (int argc, char* argv[]) {
   // Parse dataset configuration file
   Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration(dataset_config_file, true);
   unsigned int CLASSES = dataset->GetClasses();
+
+  if (tile_size > 0) {
+    ClassifyTiled (factory, dataset, param_tensor_file, input_image_fname, output_image_fname, tile_size, tiles_per_batch);
+    LOGINFO << "DONE!";
+    LOGEND;
+    return 0;
+  }
   
-  // Load image
-  Conv::Tensor original_data_tensor(input_image_fname);
+  // Read image size
+  std::size_t original_width = 0, original_height = 0, original_maps = 0;
+  if(!Conv::ImageUtil::ReadSize(input_image_fname, original_width, original_height, original_maps)) {
+    FATAL("Cannot load " << input_image_fname);
+  }
   
   // Rescale image
-  unsigned int width = original_data_tensor.width();
-  unsigned int height = original_data_tensor.height();
-  unsigned int original_width = original_data_tensor.width();
-  unsigned int original_height = original_data_tensor.height();
+  unsigned int width = original_width;
+  unsigned int height = original_height;
   if(width & 1)
     width++;
   if(height & 1)
@@ -79,13 +100,14 @@ int main (int argc, char* argv[]) {
   if(height & 4)
     height+=4;
   
-  Conv::Tensor data_tensor(1, width, height, original_data_tensor.maps());
+  Conv::Tensor data_tensor(1, width, height, original_maps);
   Conv::Tensor helper_tensor(1, width, height, 2);
-  data_tensor.Clear();
   helper_tensor.Clear();
 
-  // Copy sample because data_tensor may be slightly larger
-  Conv::Tensor::CopySample(original_data_tensor, 0, data_tensor, 0);
+  // Decode directly into data_tensor, it may be slightly larger
+  if(!Conv::ImageUtil::LoadFromFile(input_image_fname, data_tensor, 0)) {
+    FATAL("Cannot load " << input_image_fname);
+  }
 
   // Initialize helper (spatial prior) tensor
 
@@ -137,7 +159,7 @@ int main (int argc, char* argv[]) {
   dataset->Colorize(*net_output_tensor, image_output_tensor);
   
   // Recrop image down
-  Conv::Tensor small(1, original_data_tensor.width(), original_data_tensor.height(), 3);
+  Conv::Tensor small(1, original_width, original_height, 3);
   for(unsigned int m = 0; m < 3; m++)
     for(unsigned int y = 0; y < small.height(); y++)
       for(unsigned int x = 0; x < small.width(); x++)
@@ -149,3 +171,97 @@ int main (int argc, char* argv[]) {
   LOGEND;
   return 0;
 }
+
+void ClassifyTiled (Conv::ConfigurableFactory* factory, Conv::Dataset* dataset, std::istream& param_tensor_file,
+                    const std::string& input_image_fname, const std::string& output_image_fname,
+                    unsigned int tile_size, unsigned int tiles_per_batch) {
+  Conv::Tensor image;
+  if (!Conv::ImageUtil::LoadFromFile (input_image_fname, image)) {
+    FATAL ("Cannot load " << input_image_fname);
+  }
+  const unsigned int width = image.width(), height = image.height();
+
+  // Tiles start on the pooling grid so that they see the same pooling
+  //  regions as the whole image. The margin covers the receptive field
+  //  of every pixel in the valid region of a tile.
+  const unsigned int factor_x = factory->downsamplingx(), factor_y = factory->downsamplingy();
+  const unsigned int tile_x = ((tile_size + factor_x - 1) / factor_x) * factor_x;
+  const unsigned int tile_y = ((tile_size + factor_y - 1) / factor_y) * factor_y;
+  const unsigned int margin_x = ((factory->patchsizex() / 2 + 2 * factor_x - 1) / factor_x) * factor_x;
+  const unsigned int margin_y = ((factory->patchsizey() / 2 + 2 * factor_y - 1) / factor_y) * factor_y;
+  const unsigned int input_x = tile_x + 2 * margin_x, input_y = tile_y + 2 * margin_y;
+
+  const unsigned int tiles_h = (width + tile_x - 1) / tile_x, tiles_v = (height + tile_y - 1) / tile_y;
+  const unsigned int tiles = tiles_h * tiles_v;
+  tiles_per_batch = std::min (tiles_per_batch, tiles);
+  LOGINFO << "Segmenting " << tiles << " tiles of " << tile_x << "x" << tile_y << " pixels, "
+    << input_x << "x" << input_y << " with context";
+
+  // One graph of fixed size for all tiles
+  Conv::Tensor data_tensor (tiles_per_batch, input_x, input_y, image.maps());
+  Conv::Tensor helper_tensor (tiles_per_batch, input_x, input_y, 2);
+
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer (data_tensor, helper_tensor);
+  Conv::NetGraphNode input_node (&input_layer);
+  input_node.is_input = true;
+  graph.AddNode (&input_node);
+  if (!factory->AddLayers (graph, Conv::NetGraphConnection (&input_node), dataset->GetClasses()))
+    FATAL ("Failed completeness check, inspect model!");
+  graph.Initialize();
+
+  for (Conv::NetGraphNode* node : graph.GetNodes()) {
+    if (dynamic_cast<Conv::GlobalAveragePoolingLayer*> (node->layer) != nullptr)
+      FATAL ("Nets with global pooling cannot be segmented in tiles!");
+  }
+
+  graph.DeserializeParameters (param_tensor_file);
+  graph.SetIsTesting (true);
+
+  Conv::Tensor* net_output_tensor = &graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  if (net_output_tensor->width() != input_x || net_output_tensor->height() != input_y)
+    FATAL ("Net output size " << net_output_tensor->width() << "x" << net_output_tensor->height() << " does not match the tiles!");
+  Conv::Tensor tile_output_tensor (tiles_per_batch, input_x, input_y, 3);
+  Conv::Tensor output_tensor (1, width, height, 3);
+
+  for (unsigned int first_tile = 0; first_tile < tiles; first_tile += tiles_per_batch) {
+    data_tensor.Clear();
+    helper_tensor.Clear();
+
+    // Copy the tiles with their context, zero outside of the image
+    for (unsigned int sample = 0; sample < tiles_per_batch && first_tile + sample < tiles; sample++) {
+      const int origin_x = (int)(((first_tile + sample) % tiles_h) * tile_x) - (int)margin_x;
+      const int origin_y = (int)(((first_tile + sample) / tiles_h) * tile_y) - (int)margin_y;
+      for (unsigned int y = 0; y < input_y; y++) {
+        const int image_y = origin_y + (int)y;
+        if (image_y < 0 || image_y >= (int)height)
+          continue;
+        for (unsigned int x = 0; x < input_x; x++) {
+          const int image_x = origin_x + (int)x;
+          if (image_x < 0 || image_x >= (int)width)
+            continue;
+          for (unsigned int map = 0; map < image.maps(); map++)
+            *data_tensor.data_ptr (x, y, map, sample) = *image.data_ptr_const (image_x, image_y, map, 0);
+          *helper_tensor.data_ptr (x, y, 0, sample) = ((Conv::datum)image_x) / ((Conv::datum)width - 1);
+          *helper_tensor.data_ptr (x, y, 1, sample) = ((Conv::datum)image_y) / ((Conv::datum)height - 1);
+        }
+      }
+    }
+
+    graph.FeedForward();
+    dataset->Colorize (*net_output_tensor, tile_output_tensor);
+
+    // Keep the valid region of every tile
+    for (unsigned int sample = 0; sample < tiles_per_batch && first_tile + sample < tiles; sample++) {
+      const unsigned int tile_origin_x = ((first_tile + sample) % tiles_h) * tile_x;
+      const unsigned int tile_origin_y = ((first_tile + sample) / tiles_h) * tile_y;
+      for (unsigned int map = 0; map < 3; map++)
+        for (unsigned int y = 0; y < tile_y && tile_origin_y + y < height; y++)
+          for (unsigned int x = 0; x < tile_x && tile_origin_x + x < width; x++)
+            *output_tensor.data_ptr (tile_origin_x + x, tile_origin_y + y, map, 0) =
+              *tile_output_tensor.data_ptr_const (margin_x + x, margin_y + y, map, sample);
+    }
+  }
+
+  output_tensor.WriteToFile (output_image_fname);
+}
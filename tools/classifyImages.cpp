@@ -0,0 +1,362 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file classifyImages.cpp
+ * @brief Application that uses a pretrained net to segment a list of images.
+ *
+ * Decoding, the forward pass and colorizing plus writing run in three
+ * stages connected by bounded queues, so the net never waits for the disk.
+ * Images that pad to the same size are segmented in one batch.
+ *
+ * The image list has one image per line, optionally followed by the name
+ * of the output image. Without it, the output is written to the output
+ * directory under the name of the input with a .png extension.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#include <cn24.h>
+
+/**
+ * @brief Queue that blocks producers while full and consumers while empty.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue (std::size_t capacity) : capacity_ (std::max ((std::size_t)1, capacity)) {}
+
+  void Push (T item) {
+    std::unique_lock<std::mutex> lock (mutex_);
+    not_full_.wait (lock, [this] { return items_.size() < capacity_; });
+    items_.push_back (std::move (item));
+    not_empty_.notify_one();
+  }
+
+  // Returns false once the queue is closed and empty
+  bool Pop (T& item) {
+    std::unique_lock<std::mutex> lock (mutex_);
+    not_empty_.wait (lock, [this] { return !items_.empty() || closed_; });
+    if (items_.empty())
+      return false;
+    item = std::move (items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Takes the oldest waiting item that matches without blocking
+  template <typename Predicate>
+  bool TryPopIf (Predicate predicate, T& item) {
+    std::unique_lock<std::mutex> lock (mutex_);
+    auto it = std::find_if (items_.begin(), items_.end(), predicate);
+    if (it == items_.end())
+      return false;
+    item = std::move (*it);
+    items_.erase (it);
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::unique_lock<std::mutex> lock (mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+  }
+
+private:
+  std::deque<T> items_;
+  const std::size_t capacity_;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+struct Job {
+  std::string input_image_fname;
+  std::string output_image_fname;
+  // Decoded image, then the net output cropped to the image size
+  std::unique_ptr<Conv::Tensor> tensor;
+};
+
+unsigned int PaddedSize (unsigned int size, unsigned int factor) {
+  return ((size + factor - 1) / factor) * factor;
+}
+
+std::string OutputName (const std::string& output_directory, const std::string& input_image_fname) {
+  const std::size_t slash = input_image_fname.find_last_of ("/\\");
+  std::string name = slash == std::string::npos ? input_image_fname : input_image_fname.substr (slash + 1);
+  const std::size_t dot = name.rfind ('.');
+  if (dot != std::string::npos)
+    name = name.substr (0, dot);
+  return output_directory + "/" + name + ".png";
+}
+
+int main (int argc, char* argv[]) {
+  if (argc < 6) {
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <image list file> <output directory> [batch size] [decoder threads] [writer threads]";
+    LOGEND;
+    return -1;
+  }
+
+  // Capture command line arguments
+  std::string output_directory (argv[5]);
+  std::string image_list_fname (argv[4]);
+  std::string param_tensor_fname (argv[3]);
+  std::string net_config_fname (argv[2]);
+  std::string dataset_config_fname (argv[1]);
+  const unsigned int batch_size = argc > 6 ? std::max (1, std::atoi (argv[6])) : 1;
+  const unsigned int decoder_threads = argc > 7 ? std::max (1, std::atoi (argv[7])) : 2;
+  const unsigned int writer_threads = argc > 8 ? std::max (1, std::atoi (argv[8])) : 2;
+
+  // Initialize stat descriptors
+  Conv::StatDescriptor images_per_second;
+  images_per_second.description = "Throughput";
+  images_per_second.unit = "images/s";
+  Conv::StatDescriptor pixels_per_second;
+  pixels_per_second.description = "Pixel throughput";
+  pixels_per_second.unit = "pixels/s";
+  for (Conv::StatDescriptor* stat : {&images_per_second, &pixels_per_second}) {
+    stat->nullable = false;
+    stat->init_function = [] (Conv::Stat& stat) {
+      stat.is_null = false;
+      stat.value = 0.0;
+    };
+    stat->output_function = [] (Conv::HardcodedStats& hc_stats, Conv::Stat& stat) {
+      Conv::Stat return_stat = stat;
+      return_stat.value = stat.value / hc_stats.seconds_elapsed;
+      return return_stat;
+    };
+    stat->update_function = [] (Conv::Stat& stat, double user_value) {
+      stat.value += user_value;
+    };
+  }
+
+  // Initialize CN24
+  Conv::System::Init();
+
+  Conv::ConsoleStatSink sink;
+  Conv::System::stat_aggregator->RegisterSink (&sink);
+  Conv::System::stat_aggregator->RegisterStat (&images_per_second);
+  Conv::System::stat_aggregator->RegisterStat (&pixels_per_second);
+
+  // Open network and dataset configuration files
+  std::ifstream param_tensor_file (param_tensor_fname, std::ios::in | std::ios::binary);
+  std::ifstream net_config_file (net_config_fname, std::ios::in);
+  std::ifstream dataset_config_file (dataset_config_fname, std::ios::in);
+  std::ifstream image_list_file (image_list_fname, std::ios::in);
+
+  if (!param_tensor_file.good()) {
+    FATAL ("Cannot open param tensor file!");
+  }
+  if (!net_config_file.good()) {
+    FATAL ("Cannot open net configuration file!");
+  }
+  if (!dataset_config_file.good()) {
+    FATAL ("Cannot open dataset configuration file!");
+  }
+  if (!image_list_file.good()) {
+    FATAL ("Cannot open image list file!");
+  }
+
+  // Read image list
+  std::vector<std::pair<std::string, std::string>> images;
+  std::string line;
+  while (std::getline (image_list_file, line)) {
+    std::istringstream line_stream (line);
+    std::string input_image_fname, output_image_fname;
+    if (!(line_stream >> input_image_fname))
+      continue;
+    if (!(line_stream >> output_image_fname))
+      output_image_fname = OutputName (output_directory, input_image_fname);
+    images.push_back ({input_image_fname, output_image_fname});
+  }
+  LOGINFO << "Segmenting " << images.size() << " images in batches of up to " << batch_size;
+
+  Conv::ConfigurableFactory* factory = new Conv::ConfigurableFactory (net_config_file, 238238, false);
+  Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration (dataset_config_file, true);
+  const unsigned int classes = dataset->GetClasses();
+  const unsigned int factor_x = factory->downsamplingx(), factor_y = factory->downsamplingy();
+
+  BoundedQueue<Job> decoded (2 * batch_size);
+  BoundedQueue<Job> segmented (2 * batch_size);
+  std::atomic<unsigned int> failed_images (0);
+  std::mutex stat_mutex;
+
+  Conv::System::stat_aggregator->Initialize();
+  Conv::System::stat_aggregator->StartRecording();
+
+  // Stage 1: decode images
+  std::atomic<std::size_t> next_image (0);
+  std::vector<std::thread> decoders;
+  for (unsigned int t = 0; t < decoder_threads; t++) {
+    decoders.push_back (std::thread ([&] {
+      for (std::size_t i = next_image++; i < images.size(); i = next_image++) {
+        Job job;
+        job.input_image_fname = images[i].first;
+        job.output_image_fname = images[i].second;
+        job.tensor.reset (new Conv::Tensor());
+        if (!Conv::ImageUtil::LoadFromFile (job.input_image_fname, *job.tensor)) {
+          LOGERROR << "Cannot load " << job.input_image_fname;
+          failed_images++;
+          continue;
+        }
+        decoded.Push (std::move (job));
+      }
+    }));
+  }
+  std::thread decoders_done ([&] {
+    for (std::thread& decoder : decoders)
+      decoder.join();
+    decoded.Close();
+  });
+
+  // Stage 3: colorize and write images
+  std::vector<std::thread> writers;
+  for (unsigned int t = 0; t < writer_threads; t++) {
+    writers.push_back (std::thread ([&] {
+      Job job;
+      while (segmented.Pop (job)) {
+        Conv::Tensor image_output_tensor (1, job.tensor->width(), job.tensor->height(), 3);
+        dataset->Colorize (*job.tensor, image_output_tensor);
+        image_output_tensor.WriteToFile (job.output_image_fname);
+
+        std::unique_lock<std::mutex> lock (stat_mutex);
+        Conv::System::stat_aggregator->Update (images_per_second.stat_id, 1.0);
+        Conv::System::stat_aggregator->Update (pixels_per_second.stat_id, (double)(job.tensor->width() * job.tensor->height()));
+      }
+    }));
+  }
+
+  // Stage 2: segment batches of images that pad to the same size. The
+  //  net is built for the first image and reshaped for the others.
+  Conv::Tensor data_tensor;
+  Conv::Tensor helper_tensor;
+  Conv::NetGraph graph;
+  Conv::InputLayer* input_layer = nullptr;
+  Conv::NetGraphNode* input_node = nullptr;
+  unsigned int width = 0, height = 0, samples = 0;
+
+  Job first_job;
+  while (decoded.Pop (first_job)) {
+    const unsigned int batch_width = PaddedSize (first_job.tensor->width(), factor_x);
+    const unsigned int batch_height = PaddedSize (first_job.tensor->height(), factor_y);
+    const unsigned int maps = first_job.tensor->maps();
+    std::vector<Job> batch;
+    batch.push_back (std::move (first_job));
+    auto is_compatible = [&] (const Job& job) {
+      return PaddedSize (job.tensor->width(), factor_x) == batch_width &&
+             PaddedSize (job.tensor->height(), factor_y) == batch_height && job.tensor->maps() == maps;
+    };
+    Job job;
+    while (batch.size() < batch_size && decoded.TryPopIf (is_compatible, job))
+      batch.push_back (std::move (job));
+
+    if (input_node == nullptr) {
+      width = batch_width;
+      height = batch_height;
+      samples = batch.size();
+      data_tensor.Resize (samples, width, height, maps);
+      helper_tensor.Resize (samples, width, height, 2);
+
+      // Assemble net
+      input_layer = new Conv::InputLayer (data_tensor, helper_tensor);
+      input_node = new Conv::NetGraphNode (input_layer);
+      input_node->is_input = true;
+      graph.AddNode (input_node);
+      if (!factory->AddLayers (graph, Conv::NetGraphConnection (input_node), classes))
+        FATAL ("Failed completeness check, inspect model!");
+      graph.Initialize();
+
+      for (Conv::NetGraphNode* node : graph.GetNodes()) {
+        if (dynamic_cast<Conv::GlobalAveragePoolingLayer*> (node->layer) != nullptr)
+          FATAL ("Nets with global pooling cannot segment images!");
+      }
+
+      // Load network parameters
+      graph.DeserializeParameters (param_tensor_file);
+      graph.SetIsTesting (true);
+    } else if (maps != data_tensor.maps()) {
+      for (Job& failed_job : batch)
+        LOGERROR << failed_job.input_image_fname << " has " << maps << " channels instead of " << data_tensor.maps();
+      failed_images += batch.size();
+      continue;
+    } else if (batch_width != width || batch_height != height || batch.size() != samples) {
+      if (!graph.Reshape (batch_width, batch_height, batch.size()))
+        FATAL ("Cannot reshape the net to " << batch.size() << "s@" << batch_width << "x" << batch_height);
+      width = batch_width;
+      height = batch_height;
+      samples = batch.size();
+    }
+
+    data_tensor.Clear();
+    helper_tensor.Clear();
+    for (unsigned int sample = 0; sample < batch.size(); sample++) {
+      const Conv::Tensor& image = *batch[sample].tensor;
+      for (unsigned int map = 0; map < maps; map++)
+        for (unsigned int y = 0; y < image.height(); y++)
+          std::copy (image.data_ptr_const (0, y, map, 0), image.data_ptr_const (0, y, map, 0) + image.width(),
+                     data_tensor.data_ptr (0, y, map, sample));
+
+      // Write spatial prior data to helper tensor
+      for (unsigned int y = 0; y < image.height(); y++) {
+        for (unsigned int x = 0; x < image.width(); x++) {
+          *helper_tensor.data_ptr (x, y, 0, sample) = ((Conv::datum)x) / ((Conv::datum)image.width() - 1);
+          *helper_tensor.data_ptr (x, y, 1, sample) = ((Conv::datum)y) / ((Conv::datum)image.height() - 1);
+        }
+      }
+    }
+
+    graph.FeedForward();
+
+    Conv::Tensor& net_output_tensor = graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+    if (net_output_tensor.width() != width || net_output_tensor.height() != height)
+      FATAL ("Net output size " << net_output_tensor.width() << "x" << net_output_tensor.height() << " does not match the input!");
+
+    // Hand the cropped outputs to the writers
+    for (unsigned int sample = 0; sample < batch.size(); sample++) {
+      Job& done_job = batch[sample];
+      const unsigned int image_width = done_job.tensor->width(), image_height = done_job.tensor->height();
+      done_job.tensor.reset (new Conv::Tensor (1, image_width, image_height, net_output_tensor.maps()));
+      for (unsigned int map = 0; map < net_output_tensor.maps(); map++)
+        for (unsigned int y = 0; y < image_height; y++)
+          std::copy (net_output_tensor.data_ptr_const (0, y, map, sample), net_output_tensor.data_ptr_const (0, y, map, sample) + image_width,
+                     done_job.tensor->data_ptr (0, y, map, 0));
+      segmented.Push (std::move (done_job));
+    }
+  }
+
+  segmented.Close();
+  decoders_done.join();
+  for (std::thread& writer : writers)
+    writer.join();
+
+  Conv::System::stat_aggregator->StopRecording();
+  Conv::System::stat_aggregator->Generate();
+
+  if (failed_images > 0) {
+    LOGWARN << failed_images << " images could not be segmented";
+  }
+
+  LOGINFO << "DONE!";
+  LOGEND;
+  return failed_images > 0 ? -1 : 0;
+}
@@ -0,0 +1,434 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file classifyServer.cpp
+ * @brief Application that keeps a pretrained net in memory and segments
+ *   images sent over a Unix domain or TCP socket.
+ *
+ * Requests whose images have the same size after padding to the net's
+ * downsampling factor are segmented as one batch. The first request of
+ * a batch waits at most for the latency window.
+ *
+ * All fields are 32 bit unsigned integers in the host's byte order.
+ * A request is: magic, reply mode, width, height, maps, followed by
+ * width * height * maps bytes of pixels, one map after the other.
+ * A reply is: status, width, height, length, followed by length bytes.
+ * These are one 16 bit class index per pixel for REPLY_LABELS and a
+ * colorized PNG file for REPLY_PNG. A failed request has a non-zero
+ * status and its reply carries the error message.
+ *
+ * A model file written by exportModel can replace the configuration and
+ * parameter files. Servers using the same model file share its memory.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+#ifdef BUILD_POSIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
+
+#include <cn24.h>
+
+#ifdef BUILD_POSIX
+const uint32_t REQUEST_MAGIC = 0x34324E43; // "CN24" on little-endian hosts
+const uint32_t REPLY_LABELS = 0;
+const uint32_t REPLY_PNG = 1;
+const uint32_t STATUS_OK = 0;
+const uint32_t STATUS_ERROR = 1;
+const unsigned int MAX_SIDE = 65536;
+const std::size_t MAX_REQUEST_BYTES = 1 << 28;
+
+struct Request {
+  uint32_t mode = REPLY_LABELS;
+  unsigned int width = 0;
+  unsigned int height = 0;
+  unsigned int maps = 0;
+  std::vector<unsigned char> pixels;
+  std::chrono::steady_clock::time_point arrival;
+
+  // Filled in by the segmentation
+  bool done = false;
+  uint32_t status = STATUS_ERROR;
+  std::string reply;
+};
+
+std::mutex queue_mutex;
+std::condition_variable queue_condition;
+std::condition_variable done_condition;
+std::deque<Request*> queue;
+
+bool ReadFully (int fd, void* buffer, std::size_t bytes) {
+  char* target = (char*)buffer;
+  while (bytes > 0) {
+    const ssize_t bytes_read = read (fd, target, bytes);
+    if (bytes_read <= 0)
+      return false;
+    target += bytes_read;
+    bytes -= bytes_read;
+  }
+  return true;
+}
+
+bool WriteFully (int fd, const void* buffer, std::size_t bytes) {
+  const char* source = (const char*)buffer;
+  while (bytes > 0) {
+    const ssize_t bytes_written = write (fd, source, bytes);
+    if (bytes_written <= 0)
+      return false;
+    source += bytes_written;
+    bytes -= bytes_written;
+  }
+  return true;
+}
+
+void ServeConnection (int fd, unsigned int input_maps) {
+  while (true) {
+    uint32_t header[5];
+    if (!ReadFully (fd, header, sizeof (header)))
+      break;
+
+    Request request;
+    request.mode = header[1];
+    request.width = header[2];
+    request.height = header[3];
+    request.maps = header[4];
+    const std::size_t bytes = (std::size_t)request.width * request.height * request.maps;
+
+    // A broken header leaves us out of step with the stream
+    if (header[0] != REQUEST_MAGIC || request.width > MAX_SIDE || request.height > MAX_SIDE ||
+        request.maps > MAX_SIDE || bytes == 0 || bytes > MAX_REQUEST_BYTES) {
+      LOGWARN << "Dropping connection after an invalid request";
+      break;
+    }
+
+    request.pixels.resize (bytes);
+    if (!ReadFully (fd, &request.pixels[0], bytes))
+      break;
+
+    if (request.mode != REPLY_LABELS && request.mode != REPLY_PNG) {
+      request.reply = "Unknown reply mode";
+    } else if (request.maps != input_maps) {
+      std::stringstream ss;
+      ss << "The net needs " << input_maps << " maps, got " << request.maps;
+      request.reply = ss.str();
+    } else {
+      // Wait for the batch that contains this request
+      std::unique_lock<std::mutex> lock (queue_mutex);
+      request.arrival = std::chrono::steady_clock::now();
+      queue.push_back (&request);
+      queue_condition.notify_one();
+      done_condition.wait (lock, [&request] { return request.done; });
+    }
+
+    uint32_t reply_header[4] = {request.status, request.width, request.height, (uint32_t)request.reply.length()};
+    if (!WriteFully (fd, reply_header, sizeof (reply_header)) ||
+        !WriteFully (fd, request.reply.data(), request.reply.length()))
+      break;
+  }
+  close (fd);
+}
+
+int OpenSocket (const std::string& address) {
+  int fd = -1;
+  const std::size_t colon = address.rfind (':');
+  if (colon != std::string::npos) {
+    // host:port
+    const std::string host = address.substr (0, colon), port = address.substr (colon + 1);
+    addrinfo hints;
+    std::memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo (host.length() > 0 ? host.c_str() : nullptr, port.c_str(), &hints, &addresses) != 0)
+      FATAL ("Cannot resolve " << address);
+
+    for (addrinfo* candidate = addresses; candidate != nullptr; candidate = candidate->ai_next) {
+      fd = socket (candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+      if (fd < 0)
+        continue;
+      int reuse = 1;
+      setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+      if (bind (fd, candidate->ai_addr, candidate->ai_addrlen) == 0)
+        break;
+      close (fd);
+      fd = -1;
+    }
+    freeaddrinfo (addresses);
+  } else {
+    // Path of a Unix domain socket
+    sockaddr_un socket_address;
+    std::memset (&socket_address, 0, sizeof (socket_address));
+    if (address.length() >= sizeof (socket_address.sun_path))
+      FATAL ("Socket path too long: " << address);
+    socket_address.sun_family = AF_UNIX;
+    std::strcpy (socket_address.sun_path, address.c_str());
+    unlink (address.c_str());
+
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && bind (fd, (sockaddr*)&socket_address, sizeof (socket_address)) != 0) {
+      close (fd);
+      fd = -1;
+    }
+  }
+
+  if (fd < 0 || listen (fd, 64) != 0)
+    FATAL ("Cannot listen on " << address);
+  return fd;
+}
+
+unsigned int PaddedSize (unsigned int size, unsigned int factor) {
+  return ((size + factor - 1) / factor) * factor;
+}
+#endif
+
+int main (int argc, char* argv[]) {
+  // A model file replaces the configuration and parameter files
+  const bool from_model = argc > 2 && Conv::ModelFile::IsModelFile (argv[1]);
+  if (argc < (from_model ? 3 : 5)) {
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <socket path or [host]:port> [input maps] [max batch size] [max latency in ms]";
+    LOGERROR << "   OR: " << argv[0] << " <model file> <socket path or [host]:port> [input maps] [max batch size] [max latency in ms]";
+    LOGEND;
+    return -1;
+  }
+
+#ifdef BUILD_POSIX
+  // The options follow the address
+  const int address_index = from_model ? 2 : 4;
+  std::string address (argv[address_index]);
+  const unsigned int input_maps = argc > address_index + 1 ? std::max (1, std::atoi (argv[address_index + 1])) : 3;
+  const unsigned int max_batch = argc > address_index + 2 ? std::max (1, std::atoi (argv[address_index + 2])) : 8;
+  const std::chrono::milliseconds max_latency (argc > address_index + 3 ? std::max (0, std::atoi (argv[address_index + 3])) : 10);
+
+  // Initialize CN24
+  Conv::System::Init();
+
+  // Open model or network and dataset configuration files
+  Conv::ModelFile model;
+  std::ifstream param_tensor_file, net_config_file, dataset_config_file;
+  if (from_model) {
+    if (!model.Open (argv[1])) {
+      FATAL ("Cannot open model file!");
+    }
+  } else {
+    param_tensor_file.open (argv[3], std::ios::in | std::ios::binary);
+    net_config_file.open (argv[2], std::ios::in);
+    dataset_config_file.open (argv[1], std::ios::in);
+
+    if (!param_tensor_file.good()) {
+      FATAL ("Cannot open param tensor file!");
+    }
+    if (!net_config_file.good()) {
+      FATAL ("Cannot open net configuration file!");
+    }
+    if (!dataset_config_file.good()) {
+      FATAL ("Cannot open dataset configuration file!");
+    }
+  }
+
+  Conv::ConfigurableFactory* factory = new Conv::ConfigurableFactory (from_model ? model.net_config() : net_config_file, 238238, false);
+  Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration (from_model ? model.dataset_config() : dataset_config_file, true);
+  const unsigned int classes = dataset->GetClasses();
+  if (classes > 65536)
+    FATAL ("Labels are sent as 16 bit indices, the net has " << classes << " classes!");
+  const unsigned int factor_x = factory->downsamplingx(), factor_y = factory->downsamplingy();
+
+  // The net is built and loaded once, batches only reshape it
+  unsigned int width = PaddedSize (64, factor_x), height = PaddedSize (64, factor_y), samples = 1;
+  Conv::Tensor data_tensor (samples, width, height, input_maps);
+  Conv::Tensor helper_tensor (samples, width, height, 2);
+
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer (data_tensor, helper_tensor);
+  Conv::NetGraphNode input_node (&input_layer);
+  input_node.is_input = true;
+  graph.AddNode (&input_node);
+  if (!factory->AddLayers (graph, Conv::NetGraphConnection (&input_node), classes))
+    FATAL ("Failed completeness check, inspect model!");
+  graph.Initialize();
+  if (from_model) {
+    // Servers using the same model share its parameters in memory
+    if (!model.MapParameters (graph))
+      FATAL ("Model does not match the net!");
+  } else {
+    graph.DeserializeParameters (param_tensor_file);
+  }
+  graph.SetIsTesting (true);
+
+  for (Conv::NetGraphNode* node : graph.GetNodes()) {
+    if (dynamic_cast<Conv::GlobalAveragePoolingLayer*> (node->layer) != nullptr)
+      FATAL ("Nets with global pooling cannot segment images!");
+  }
+
+  Conv::Tensor colorized_tensor;
+
+  // A closed connection must not end the server
+  signal (SIGPIPE, SIG_IGN);
+
+  const int server_fd = OpenSocket (address);
+  LOGINFO << "Listening on " << address << ", batches of up to " << max_batch << " images, " << max_latency.count() << "ms latency";
+
+  std::thread acceptor ([server_fd, input_maps] {
+    while (true) {
+      const int fd = accept (server_fd, nullptr, nullptr);
+      if (fd < 0) {
+        LOGWARN << "Cannot accept connection";
+        continue;
+      }
+      std::thread (ServeConnection, fd, input_maps).detach();
+    }
+  });
+  acceptor.detach();
+
+  while (true) {
+    std::vector<Request*> batch;
+    {
+      std::unique_lock<std::mutex> lock (queue_mutex);
+      queue_condition.wait (lock, [] { return !queue.empty(); });
+
+      // Requests are compatible if they share the padded size
+      const unsigned int batch_width = PaddedSize (queue.front()->width, factor_x);
+      const unsigned int batch_height = PaddedSize (queue.front()->height, factor_y);
+      auto is_compatible = [&] (const Request* request) {
+        return PaddedSize (request->width, factor_x) == batch_width && PaddedSize (request->height, factor_y) == batch_height;
+      };
+
+      // Wait for more until the batch is full or the first request has
+      //  waited long enough
+      const std::chrono::steady_clock::time_point deadline = queue.front()->arrival + max_latency;
+      while ((unsigned int)std::count_if (queue.begin(), queue.end(), is_compatible) < max_batch &&
+             std::chrono::steady_clock::now() < deadline)
+        queue_condition.wait_until (lock, deadline);
+
+      for (auto it = queue.begin(); it != queue.end() && batch.size() < max_batch;) {
+        if (is_compatible (*it)) {
+          batch.push_back (*it);
+          it = queue.erase (it);
+        } else {
+          it++;
+        }
+      }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const unsigned int batch_width = PaddedSize (batch[0]->width, factor_x);
+    const unsigned int batch_height = PaddedSize (batch[0]->height, factor_y);
+    std::string error;
+    if (batch_width != width || batch_height != height || batch.size() != samples) {
+      const bool reshaped = graph.Reshape (batch_width, batch_height, batch.size());
+      width = reshaped ? batch_width : 0;
+      height = reshaped ? batch_height : 0;
+      samples = batch.size();
+      if (!reshaped)
+        error = "Cannot reshape the net for this image size";
+    }
+
+    if (error.length() == 0) {
+      data_tensor.Clear();
+      helper_tensor.Clear();
+      for (unsigned int sample = 0; sample < batch.size(); sample++) {
+        const Request* request = batch[sample];
+        const unsigned char* pixels = &request->pixels[0];
+        for (unsigned int map = 0; map < input_maps; map++)
+          for (unsigned int y = 0; y < request->height; y++)
+            for (unsigned int x = 0; x < request->width; x++)
+              *data_tensor.data_ptr (x, y, map, sample) = DATUM_FROM_UCHAR (*pixels++);
+
+        // Write spatial prior data to helper tensor
+        for (unsigned int y = 0; y < request->height; y++) {
+          for (unsigned int x = 0; x < request->width; x++) {
+            *helper_tensor.data_ptr (x, y, 0, sample) = request->width > 1 ? ((Conv::datum)x) / ((Conv::datum)request->width - 1) : 0;
+            *helper_tensor.data_ptr (x, y, 1, sample) = request->height > 1 ? ((Conv::datum)y) / ((Conv::datum)request->height - 1) : 0;
+          }
+        }
+      }
+
+      graph.FeedForward();
+      Conv::Tensor& net_output_tensor = graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+      if (net_output_tensor.width() != width || net_output_tensor.height() != height) {
+        // Only this batch fails, the server keeps running
+        std::stringstream ss;
+        ss << "Net output size " << net_output_tensor.width() << "x" << net_output_tensor.height() << " does not match the input";
+        error = ss.str();
+        LOGERROR << error;
+      }
+    }
+
+    if (error.length() == 0) {
+      Conv::Tensor& net_output_tensor = graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+      if (std::any_of (batch.begin(), batch.end(), [] (const Request* request) { return request->mode == REPLY_PNG; })) {
+        colorized_tensor.Resize (samples, width, height, 3);
+        dataset->Colorize (net_output_tensor, colorized_tensor);
+      }
+
+      for (unsigned int sample = 0; sample < batch.size(); sample++) {
+        Request* request = batch[sample];
+        if (request->mode == REPLY_LABELS) {
+          std::vector<uint16_t> labels (request->width * request->height);
+          for (unsigned int y = 0; y < request->height; y++) {
+            for (unsigned int x = 0; x < request->width; x++) {
+              const unsigned int label = classes == 1 ?
+                (*net_output_tensor.data_ptr_const (x, y, 0, sample) > 0 ? 1 : 0) :
+                net_output_tensor.PixelMaximum (x, y, sample);
+              labels[y * request->width + x] = (uint16_t)label;
+            }
+          }
+          request->reply.assign ((const char*)&labels[0], labels.size() * sizeof (uint16_t));
+        } else {
+          Conv::Tensor image (1, request->width, request->height, 3);
+          for (unsigned int map = 0; map < 3; map++)
+            for (unsigned int y = 0; y < request->height; y++)
+              for (unsigned int x = 0; x < request->width; x++)
+                *image.data_ptr (x, y, map, 0) = *colorized_tensor.data_ptr_const (x, y, map, sample);
+          std::ostringstream png;
+          Conv::PNGUtil::WriteToStream (png, image);
+          request->reply = png.str();
+        }
+        request->status = STATUS_OK;
+      }
+    } else {
+      for (Request* request : batch)
+        request->reply = error;
+    }
+
+    LOGINFO << "Segmented " << batch.size() << " images of " << batch_width << "x" << batch_height << " in "
+      << std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - start).count() << "ms" << std::flush;
+
+    {
+      std::unique_lock<std::mutex> lock (queue_mutex);
+      for (Request* request : batch)
+        request->done = true;
+    }
+    done_condition.notify_all();
+  }
+#else
+  UNREFERENCED_PARAMETER (argv);
+  FATAL ("The server needs POSIX sockets!");
+#endif
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */  
+/**
+ * @file compactTensorStream.cpp
+ * @brief Converts a float tensor stream into a compact tensor stream
+ *
+ * Every second tensor is a label tensor. One-hot labels are stored as
+ * class indices and 8-bit images as bytes, everything else is stored as is.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cn24.h>
+
+#include <iostream>
+#include <fstream>
+
+int main(int argc, char** argv) {
+  Conv::System::Init();
+  
+  if(argc != 3) {
+    LOGERROR << "USAGE: " << argv[0] << " <input (float) tensor stream> <output (compact) tensor stream>";
+    LOGEND;
+    return -1;
+  }
+  
+  std::string input_file_name(argv[1]);
+  std::string output_file_name(argv[2]);
+  
+  std::ifstream input_tensor_stream(input_file_name, std::ios::in | std::ios::binary);
+  std::ofstream output_tensor_stream(output_file_name, std::ios::out | std::ios::binary);
+  
+  if(!input_tensor_stream.good())
+    FATAL("Cannot open " << input_file_name);
+  
+  if(!output_tensor_stream.good())
+    FATAL("Cannot open " << output_file_name);
+  
+  long original_total = 0;
+  long compact_total = 0;
+  
+  Conv::Tensor tensor;
+  
+  uint64_t magic = CN24_KTS_MAGIC;
+  output_tensor_stream.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
+  
+  for(unsigned int t = 0; !input_tensor_stream.eof(); t++) {
+    tensor.Deserialize(input_tensor_stream);
+    if(tensor.elements() == 0)
+      break;
+    
+    LOGDEBUG << "Input tensor: " << tensor;
+    
+    Conv::CompactTensor ctensor;
+    bool converted = (t & 1) ? ctensor.FromClassTensor(tensor) : ctensor.FromImageTensor(tensor);
+    if(!converted)
+      ctensor.FromTensor(tensor);
+    
+    ctensor.Serialize(output_tensor_stream);
+    
+    LOGDEBUG << "Compact tensor: " << ctensor << ", " << ctensor.data_length() << " bytes";
+    original_total += tensor.elements() * sizeof(Conv::datum)/sizeof(char);
+    compact_total += ctensor.data_length();
+    
+    input_tensor_stream.peek();
+  }
+  LOGINFO << "Overall ratio: " << 100.0 * (double)compact_total / (double)original_total << "%";
+  LOGINFO << "Original: " << original_total;
+  LOGINFO << "Compact : " << compact_total;
+  LOGEND;
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file exportModel.cpp
+ * @brief Application that combines a net configuration, the class
+ *   information of a dataset and trained parameters into one model file.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include <cn24.h>
+
+int main (int argc, char* argv[]) {
+  if (argc < 5) {
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <model file>";
+    LOGEND;
+    return -1;
+  }
+
+  // Capture command line arguments
+  std::string model_fname (argv[4]);
+  std::string param_tensor_fname (argv[3]);
+  std::string net_config_fname (argv[2]);
+  std::string dataset_config_fname (argv[1]);
+
+  // Initialize CN24
+  Conv::System::Init();
+
+  // Open network and dataset configuration files
+  std::ifstream param_tensor_file(param_tensor_fname,std::ios::in | std::ios::binary);
+  std::ifstream net_config_file(net_config_fname,std::ios::in);
+  std::ifstream dataset_config_file(dataset_config_fname,std::ios::in);
+
+  if(!param_tensor_file.good()) {
+    FATAL("Cannot open param tensor file!");
+  }
+  if(!net_config_file.good()) {
+    FATAL("Cannot open net configuration file!");
+  }
+  if(!dataset_config_file.good()) {
+    FATAL("Cannot open dataset configuration file!");
+  }
+
+  // Parse network configuration file
+  Conv::ConfigurableFactory* factory = new Conv::ConfigurableFactory(net_config_file, 238238, false);
+  // Parse dataset configuration file, the testing set tells us the input maps
+  Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration(dataset_config_file, false, Conv::LOAD_TESTING_ONLY);
+  unsigned int CLASSES = dataset->GetClasses();
+
+  // The parameters do not depend on the input size, one receptive field
+  //  is enough
+  Conv::Tensor data_tensor(1, factory->patchsizex(), factory->patchsizey(), dataset->GetInputMaps());
+  Conv::Tensor helper_tensor(1, factory->patchsizex(), factory->patchsizey(), 2);
+  data_tensor.Clear();
+  helper_tensor.Clear();
+
+  // Assemble net the way the tools that load the model do
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer(data_tensor, helper_tensor);
+
+  Conv::NetGraphNode input_node(&input_layer);
+  input_node.is_input = true;
+
+  graph.AddNode(&input_node);
+  bool complete = factory->AddLayers(graph, Conv::NetGraphConnection(&input_node), CLASSES);
+  if (!complete)
+    FATAL("Failed completeness check, inspect model!");
+
+  graph.Initialize();
+
+  // Load network parameters
+  graph.DeserializeParameters(param_tensor_file);
+
+  if (!Conv::ModelFile::Write(model_fname, net_config_file, dataset_config_file, graph))
+    FATAL("Cannot write " << model_fname);
+
+  LOGINFO << "Written model to " << model_fname;
+  LOGINFO << "DONE!";
+  LOGEND;
+  return 0;
+}
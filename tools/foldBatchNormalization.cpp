@@ -0,0 +1,139 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file foldBatchNormalization.cpp
+ * @brief Application that folds batch normalization layers into the
+ *   convolutions feeding them for faster inference.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include <cn24.h>
+
+int main (int argc, char* argv[]) {
+  if (argc < 6) {
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <folded net config file> <folded net parameter tensor>";
+    LOGEND;
+    return -1;
+  }
+
+  // Capture command line arguments
+  std::string folded_param_tensor_fname (argv[5]);
+  std::string folded_net_config_fname (argv[4]);
+  std::string param_tensor_fname (argv[3]);
+  std::string net_config_fname (argv[2]);
+  std::string dataset_config_fname (argv[1]);
+
+  // Initialize CN24
+  Conv::System::Init();
+
+  // Open network and dataset configuration files
+  std::ifstream param_tensor_file(param_tensor_fname,std::ios::in | std::ios::binary);
+  std::ifstream net_config_file(net_config_fname,std::ios::in);
+  std::ifstream dataset_config_file(dataset_config_fname,std::ios::in);
+
+  if(!param_tensor_file.good()) {
+    FATAL("Cannot open param tensor file!");
+  }
+  if(!net_config_file.good()) {
+    FATAL("Cannot open net configuration file!");
+  }
+  if(!dataset_config_file.good()) {
+    FATAL("Cannot open dataset configuration file!");
+  }
+
+  // Parse network configuration file
+  Conv::ConfigurableFactory factory(net_config_file, 238238, false);
+  // Parse dataset configuration file, the testing set tells us the input maps
+  Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration(dataset_config_file, false, Conv::LOAD_TESTING_ONLY);
+  unsigned int CLASSES = dataset->GetClasses();
+
+  // The parameters do not depend on the input size, one receptive field
+  //  is enough
+  Conv::Tensor data_tensor(1, factory.patchsizex(), factory.patchsizey(), dataset->GetInputMaps());
+  Conv::Tensor helper_tensor(1, factory.patchsizex(), factory.patchsizey(), 2);
+  data_tensor.Clear();
+  helper_tensor.Clear();
+
+  // Assemble net
+  Conv::NetGraph graph;
+  Conv::InputLayer input_layer(data_tensor, helper_tensor);
+
+  Conv::NetGraphNode input_node(&input_layer);
+  input_node.is_input = true;
+
+  graph.AddNode(&input_node);
+  bool complete = factory.AddLayers(graph, Conv::NetGraphConnection(&input_node), CLASSES);
+  if (!complete)
+    FATAL("Failed completeness check, inspect model!");
+
+  graph.Initialize();
+
+  // Load network parameters
+  graph.DeserializeParameters(param_tensor_file);
+
+  // Fold every batch normalization into its convolution
+  unsigned int folded = 0;
+  for (Conv::NetGraphNode* node : graph.GetNodes()) {
+    Conv::BatchNormalizationLayer* bn_layer = dynamic_cast<Conv::BatchNormalizationLayer*>(node->layer);
+    if (bn_layer == nullptr)
+      continue;
+
+    Conv::NetGraphNode* source = node->input_connections[0].node;
+    Conv::ConvolutionLayer* conv_layer = dynamic_cast<Conv::ConvolutionLayer*>(source->layer);
+    if (conv_layer == nullptr)
+      FATAL("Batch normalization in node " << node->unique_name << " does not follow a convolution!");
+
+    // The unnormalized output must not be used anywhere else
+    for (Conv::NetGraphNode* other_node : graph.GetNodes()) {
+      for (Conv::NetGraphConnection& connection : other_node->input_connections) {
+        if (other_node != node && connection.node == source)
+          FATAL("Output of node " << source->unique_name << " is used without normalization!");
+      }
+    }
+
+    if (!bn_layer->FoldInto(*conv_layer))
+      FATAL("Cannot fold node " << node->unique_name << " into " << source->unique_name);
+    folded++;
+  }
+  LOGINFO << "Folded " << folded << " batch normalization layers";
+
+  // Write the remaining parameters in the same order as NetGraph
+  std::ofstream folded_param_tensor_file(folded_param_tensor_fname,std::ios::out | std::ios::binary);
+  if(!folded_param_tensor_file.good()) {
+    FATAL("Cannot open " << folded_param_tensor_fname);
+  }
+  for (Conv::NetGraphNode* node : graph.GetNodes()) {
+    if (dynamic_cast<Conv::BatchNormalizationLayer*>(node->layer) != nullptr)
+      continue;
+    for (Conv::CombinedTensor* parameter : node->layer->parameters())
+      parameter->data.Serialize(folded_param_tensor_file);
+  }
+  folded_param_tensor_file.close();
+
+  // Write the configuration without batch normalization
+  std::ofstream folded_net_config_file(folded_net_config_fname,std::ios::out);
+  if(!folded_net_config_file.good()) {
+    FATAL("Cannot open " << folded_net_config_fname);
+  }
+  net_config_file.clear();
+  net_config_file.seekg(0, std::ios::beg);
+  std::string line;
+  while (std::getline(net_config_file, line)) {
+    if (line.compare(0, 10, "?batchnorm") != 0)
+      folded_net_config_file << line << "\n";
+  }
+  folded_net_config_file.close();
+
+  LOGINFO << "DONE!";
+  LOGEND;
+  return 0;
+}
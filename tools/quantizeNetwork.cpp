@@ -0,0 +1,160 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file quantizeNetwork.cpp
+ * @brief Application that quantizes the convolutions of a pretrained net
+ *   to 8-bit integers and compares its accuracy to floating point.
+ *
+ * The input ranges of the convolutions are calibrated on the first images
+ * of the testing set. Fully connected layers are convolutions, too.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+#include <cn24.h>
+
+void addStatLayers(Conv::NetGraph& graph, Conv::NetGraphNode* input_node, Conv::Dataset* dataset);
+
+int main (int argc, char* argv[]) {
+  if (argc < 4) {
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> [calibration images]";
+    LOGEND;
+    return -1;
+  }
+
+  // Capture command line arguments
+  std::string param_tensor_fname (argv[3]);
+  std::string net_config_fname (argv[2]);
+  std::string dataset_config_fname (argv[1]);
+  const unsigned int calibration_images = argc > 4 ? std::max (1, std::atoi (argv[4])) : 16;
+
+  // Initialize CN24
+  Conv::System::Init();
+
+  // Register stat sink
+  Conv::ConsoleStatSink console_stat_sink;
+  Conv::System::stat_aggregator->RegisterSink(&console_stat_sink);
+
+  // Open network and dataset configuration files
+  std::ifstream param_tensor_file(param_tensor_fname,std::ios::in | std::ios::binary);
+  std::ifstream net_config_file(net_config_fname,std::ios::in);
+  std::ifstream dataset_config_file(dataset_config_fname,std::ios::in);
+
+  if(!param_tensor_file.good()) {
+    FATAL("Cannot open param tensor file!");
+  }
+  if(!net_config_file.good()) {
+    FATAL("Cannot open net configuration file!");
+  }
+  if(!dataset_config_file.good()) {
+    FATAL("Cannot open dataset configuration file!");
+  }
+
+  // Parse network configuration file
+  Conv::ConfigurableFactory* factory = new Conv::ConfigurableFactory(net_config_file, 8347734, false);
+  Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration(dataset_config_file, false, Conv::LOAD_TESTING_ONLY);
+  unsigned int CLASSES = dataset->GetClasses();
+  if (dataset->GetTestingSamples() == 0)
+    FATAL("The dataset has no testing samples!");
+
+  // Assemble net
+  Conv::NetGraph graph;
+  Conv::DatasetInputLayer* data_layer = new Conv::DatasetInputLayer(*dataset, 1, 1.0, 983923);
+  Conv::NetGraphNode* input_node = new Conv::NetGraphNode(data_layer);
+  input_node->is_input = true;
+  graph.AddNode(input_node);
+
+  bool complete = factory->AddLayers(graph, Conv::NetGraphConnection(input_node), CLASSES, true);
+  if (!complete)
+    FATAL("Failed completeness check, inspect model!");
+  addStatLayers(graph, input_node, dataset);
+
+  graph.Initialize();
+
+  // Load network parameters
+  graph.DeserializeParameters(param_tensor_file);
+
+  std::vector<Conv::ConvolutionLayer*> conv_layers;
+  for (Conv::NetGraphNode* node : graph.GetNodes()) {
+    Conv::ConvolutionLayer* conv_layer = dynamic_cast<Conv::ConvolutionLayer*>(node->layer);
+    if (conv_layer != nullptr)
+      conv_layers.push_back(conv_layer);
+  }
+
+  Conv::TrainerSettings settings = factory->optimal_settings();
+  settings.pbatchsize = 1;
+  settings.sbatchsize = 1;
+  Conv::Trainer trainer(graph, settings);
+
+  Conv::System::stat_aggregator->Initialize();
+
+  LOGINFO << "Testing with floating point..." << std::flush;
+  Conv::System::stat_aggregator->StartRecording();
+  trainer.Test();
+  Conv::System::stat_aggregator->StopRecording();
+  Conv::System::stat_aggregator->Generate();
+  Conv::System::stat_aggregator->Reset();
+
+  // Record the input ranges on the first testing images
+  LOGINFO << "Calibrating " << conv_layers.size() << " convolutions on " << calibration_images << " images..." << std::flush;
+  data_layer->SetTestingMode(true);
+  graph.SetIsTesting(true);
+  graph.SetStatLayersEnabled(false);
+  for (Conv::ConvolutionLayer* conv_layer : conv_layers)
+    conv_layer->SetCalibrating(true);
+  for (unsigned int i = 0; i < std::min(calibration_images, dataset->GetTestingSamples()); i++)
+    graph.FeedForward();
+  for (Conv::ConvolutionLayer* conv_layer : conv_layers)
+    conv_layer->SetCalibrating(false);
+  graph.SetStatLayersEnabled(true);
+  data_layer->SetTestingMode(false);
+
+  for (Conv::ConvolutionLayer* conv_layer : conv_layers) {
+    Conv::datum input_min = 0, input_max = 0;
+    conv_layer->GetInputRange(input_min, input_max);
+    if (!conv_layer->Quantize(input_min, input_max))
+      FATAL("Cannot quantize " << conv_layer->GetLayerDescription());
+    LOGDEBUG << conv_layer->GetLayerDescription() << ": inputs from " << input_min << " to " << input_max;
+  }
+
+  LOGINFO << "Testing with 8-bit integers (" << Conv::Int8Math::GetImplementation() << ")..." << std::flush;
+  Conv::System::stat_aggregator->StartRecording();
+  trainer.Test();
+  Conv::System::stat_aggregator->StopRecording();
+  Conv::System::stat_aggregator->Generate();
+  Conv::System::stat_aggregator->Reset();
+
+  LOGINFO << "DONE!";
+  LOGEND;
+  return 0;
+}
+
+void addStatLayers(Conv::NetGraph& graph, Conv::NetGraphNode* input_node, Conv::Dataset* dataset) {
+  for (Conv::NetGraphNode* output_node : graph.GetOutputNodes()) {
+    // Add appropriate statistics layer
+    Conv::NetGraphNode* stat_node = nullptr;
+    if (dataset->GetClasses() == 1) {
+      Conv::BinaryStatLayer* binary_stat_layer = new Conv::BinaryStatLayer (13, -1, 1);
+      stat_node = new Conv::NetGraphNode(binary_stat_layer);
+    } else {
+      std::vector<std::string> class_names = dataset->GetClassNames();
+      Conv::ConfusionMatrixLayer* confusion_matrix_layer = new Conv::ConfusionMatrixLayer (class_names, dataset->GetClasses());
+      stat_node = new Conv::NetGraphNode(confusion_matrix_layer);
+    }
+    stat_node->input_connections.push_back(Conv::NetGraphConnection(output_node, 0, false));
+    stat_node->input_connections.push_back(Conv::NetGraphConnection(input_node,1));
+    stat_node->input_connections.push_back(Conv::NetGraphConnection(input_node,3));
+    graph.AddNode(stat_node);
+  }
+}
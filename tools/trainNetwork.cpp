@@ -24,7 +24,8 @@
 #include <private/ConfigParsing.h>
 
 void addStatLayers(Conv::NetGraph& graph, Conv::NetGraphNode* input_node, Conv::Dataset* dataset);
-bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::Trainer& trainer, Conv::Trainer& testing_trainer, bool hybrid, std::string& command);
+void shadowParameters(Conv::NetGraph& graph, Conv::NetGraph& testing_graph);
+bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::Trainer& trainer, Conv::Trainer& testing_trainer, Conv::Checkpointer& checkpointer, bool hybrid, std::string& command);
 void help();
 
 int main (int argc, char* argv[]) {
@@ -180,6 +181,9 @@ int main (int argc, char* argv[]) {
   } else {
     Conv::Trainer trainer (graph, settings);
 
+    // Finishes writing checkpoints when it goes out of scope
+    Conv::Checkpointer checkpointer (graph, trainer);
+
     Conv::NetGraph* testing_graph;
     Conv::Trainer* testing_trainer;
 
@@ -211,18 +215,7 @@ int main (int argc, char* argv[]) {
 
       testing_graph->Initialize();
 
-      // Shadow training net weights
-      std::vector<Conv::CombinedTensor*> training_params;
-      std::vector<Conv::CombinedTensor*> testing_params;
-      graph.GetParameters (training_params);
-      testing_graph->GetParameters (testing_params);
-
-      for (unsigned int p = 0; p < training_params.size(); p++) {
-        Conv::CombinedTensor* training_ct = training_params[p];
-        Conv::CombinedTensor* testing_ct = testing_params[p];
-        testing_ct->data.Shadow (training_ct->data);
-        testing_ct->delta.Shadow (training_ct->delta);
-      }
+      shadowParameters (graph, *testing_graph);
 
       Conv::TrainerSettings settings = tfactory->optimal_settings();
       settings.pbatchsize = 1;
@@ -248,7 +241,7 @@ int main (int argc, char* argv[]) {
         std::string command;
         std::getline (script_file, command);
 
-        if (!parseCommand (graph, *testing_graph, trainer, *testing_trainer, patchwise_training, command) || script_file.eof())
+        if (!parseCommand (graph, *testing_graph, trainer, *testing_trainer, checkpointer, patchwise_training, command) || script_file.eof())
           break;
       }
     } else {
@@ -259,7 +252,7 @@ int main (int argc, char* argv[]) {
         std::string command;
         std::getline (std::cin, command);
 
-        if (!parseCommand (graph, *testing_graph, trainer, *testing_trainer, patchwise_training, command))
+        if (!parseCommand (graph, *testing_graph, trainer, *testing_trainer, checkpointer, patchwise_training, command))
           break;
       }
     }
@@ -289,8 +282,23 @@ void addStatLayers(Conv::NetGraph& graph, Conv::NetGraphNode* input_node, Conv::
 	}
 }
 
+void shadowParameters(Conv::NetGraph& graph, Conv::NetGraph& testing_graph) {
+  LOGDEBUG << "Reshadowing tensors...";
+  // Shadow training net weights
+  std::vector<Conv::CombinedTensor*> training_params;
+  std::vector<Conv::CombinedTensor*> testing_params;
+  graph.GetParameters (training_params);
+  testing_graph.GetParameters (testing_params);
+
+  for (unsigned int p = 0; p < training_params.size(); p++) {
+    Conv::CombinedTensor* training_ct = training_params[p];
+    Conv::CombinedTensor* testing_ct = testing_params[p];
+    testing_ct->data.Shadow (training_ct->data);
+    testing_ct->delta.Shadow (training_ct->delta);
+  }
+}
 
-bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::Trainer& trainer, Conv::Trainer& testing_trainer, bool hybrid, std::string& command) {
+bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::Trainer& trainer, Conv::Trainer& testing_trainer, Conv::Checkpointer& checkpointer, bool hybrid, std::string& command) {
   if (command.compare ("q") == 0 || command.compare ("quit") == 0) {
     return false;
   } else if (command.compare (0, 5, "train") == 0) {
@@ -335,27 +343,19 @@ bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::T
     if (param_file_name.length() == 0) {
       LOGERROR << "Filename needed!";
     } else {
+      // The file could be a snapshot that is still being written
+      if (!checkpointer.Wait()) {
+        LOGWARN << "Writing a snapshot failed";
+      }
+
       std::ifstream param_file (param_file_name, std::ios::in | std::ios::binary);
 
       if (param_file.good()) {
         graph.DeserializeParameters (param_file, last_layer);
         LOGINFO << "Loaded parameters from " << param_file_name;
 
-        if (hybrid) {
-          LOGDEBUG << "Reshadowing tensors...";
-          // Shadow training net weights
-          std::vector<Conv::CombinedTensor*> training_params;
-          std::vector<Conv::CombinedTensor*> testing_params;
-          graph.GetParameters (training_params);
-          testing_graph.GetParameters (testing_params);
-
-          for (unsigned int p = 0; p < training_params.size(); p++) {
-            Conv::CombinedTensor* training_ct = training_params[p];
-            Conv::CombinedTensor* testing_ct = testing_params[p];
-            testing_ct->data.Shadow (training_ct->data);
-            testing_ct->delta.Shadow (training_ct->delta);
-          }
-        }
+        if (hybrid)
+          shadowParameters (graph, testing_graph);
       } else {
         LOGERROR << "Cannot open " << param_file_name;
       }
@@ -364,21 +364,63 @@ bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::T
     }
   } else if (command.compare (0, 4, "save") == 0) {
     std::string param_file_name;
+    std::string format = "fp32";
+    Conv::TensorStorage storage = Conv::STORAGE_FLOAT32;
     Conv::ParseStringParamIfPossible (command, "file", param_file_name);
+    Conv::ParseStringParamIfPossible (command, "format", format);
 
     if (param_file_name.length() == 0) {
       LOGERROR << "Filename needed!";
+    } else if (!Conv::HalfPrecision::ParseStorage (format, storage)) {
+      LOGERROR << "Unknown format " << format << ", use fp32, fp16 or bf16";
     } else {
-      std::ofstream param_file (param_file_name, std::ios::out | std::ios::binary);
-
-      if (param_file.good()) {
-        graph.SerializeParameters (param_file);
-        LOGINFO << "Written parameters to " << param_file_name;
+      // Training can go on while the copy is written
+      checkpointer.Save (param_file_name, false, storage);
+      LOGINFO << "Writing " << format << " parameters to " << param_file_name;
+    }
+  } else if (command.compare (0, 11, "activations") == 0) {
+    std::string format = "fp32";
+    Conv::TensorStorage storage = Conv::STORAGE_FLOAT32;
+    Conv::ParseStringParamIfPossible (command, "format", format);
+
+    if (!Conv::HalfPrecision::ParseStorage (format, storage)) {
+      LOGERROR << "Unknown format " << format << ", use fp32, fp16 or bf16";
+    } else if (!graph.SetActivationStorage (storage) ||
+               (hybrid && !testing_graph.SetActivationStorage (storage))) {
+      LOGERROR << "Cannot store activations as " << format;
+    } else {
+      LOGINFO << "Storing activations and deltas as " << format;
+    }
+  } else if (command.compare (0, 10, "checkpoint") == 0) {
+    std::string checkpoint_file_name;
+    unsigned int every = 0;
+    const bool has_every = command.find ("every=") != std::string::npos;
+    Conv::ParseStringParamIfPossible (command, "file", checkpoint_file_name);
+    Conv::ParseCountIfPossible (command, "every", every);
+
+    if (checkpoint_file_name.length() == 0) {
+      LOGERROR << "Filename needed!";
+    } else if (has_every) {
+      trainer.SetCheckpointing (&checkpointer, every, checkpoint_file_name);
+      if (every > 0) {
+        LOGINFO << "Writing a checkpoint to " << checkpoint_file_name << " every " << every << " iterations";
       } else {
-        LOGERROR << "Cannot open " << param_file_name;
+        LOGINFO << "Checkpoints disabled";
       }
+    } else {
+      checkpointer.Save (checkpoint_file_name);
+      LOGINFO << "Writing checkpoint to " << checkpoint_file_name;
+    }
+  } else if (command.compare (0, 6, "resume") == 0) {
+    std::string checkpoint_file_name;
+    Conv::ParseStringParamIfPossible (command, "file", checkpoint_file_name);
 
-      param_file.close();
+    if (checkpoint_file_name.length() == 0) {
+      LOGERROR << "Filename needed!";
+    } else if (checkpointer.Resume (checkpoint_file_name)) {
+      testing_trainer.SetEpoch (trainer.epoch());
+      if (hybrid)
+        shadowParameters (graph, testing_graph);
     }
   } else if (command.compare (0, 14, "set experiment") == 0) {
     std::string experiment_name = "";
@@ -399,21 +441,8 @@ bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::T
     graph.InitializeWeights();
     trainer.Reset();
 
-    if (hybrid) {
-      LOGDEBUG << "Reshadowing tensors...";
-      // Shadow training net weights
-      std::vector<Conv::CombinedTensor*> training_params;
-      std::vector<Conv::CombinedTensor*> testing_params;
-      graph.GetParameters (training_params);
-      testing_graph.GetParameters (testing_params);
-
-      for (unsigned int p = 0; p < training_params.size(); p++) {
-        Conv::CombinedTensor* training_ct = training_params[p];
-        Conv::CombinedTensor* testing_ct = testing_params[p];
-        testing_ct->data.Shadow (training_ct->data);
-        testing_ct->delta.Shadow (training_ct->delta);
-      }
-    }
+    if (hybrid)
+      shadowParameters (graph, testing_graph);
   } else if (command.compare (0, 4, "help") == 0) {
     help();
 	} else if (command.compare (0, 5, "graph") == 0) {
@@ -498,8 +527,14 @@ void help() {
       << "    Load parameters from a file for all layers up to l (default: all layers)\n\n"
 			<< "  graph file=<path> {test|train}\n"
 			<< "    Write the network architecture for training/testing to a file in graphviz format\n\n"
-      << "  save file=<path>\n"
-      << "    Save parameters to a file\n\n"
+      << "  save file=<path> [format={fp32|fp16|bf16}]\n"
+      << "    Save parameters to a file in the background, fp16 and bf16 halve its size\n\n"
+      << "  activations format={fp32|fp16|bf16}\n"
+      << "    Store activations and deltas between layers that support it in 16 bits\n\n"
+      << "  checkpoint file=<path> [every=<n>]\n"
+      << "    Save parameters and optimizer state in the background, every n iterations if given (0: stop)\n\n"
+      << "  resume file=<path>\n"
+      << "    Load a checkpoint and continue training where it was taken\n\n"
       << "  tstat enable=<1|0>\n"
       << "    Enable statistics during training (1: yes, 0: no)\n";
 }